@@ -19,13 +19,21 @@ print_error() {
 
 mkdir -p output
 
+# -O3 lets GCC vectorize the plugin batch loops (plugin_transform_batch)
+CFLAGS="${CFLAGS:--O3}"
 
-for plugin_name in logger uppercaser rotator flipper typewriter expander; do
+for plugin_name in logger uppercaser rotator flipper typewriter expander grep aggregator; do
     print_status "Building $plugin_name"
-    gcc -fPIC -shared -o output/$plugin_name.so plugins/$plugin_name.c plugins/plugin_common.c  plugins/sync/monitor.c plugins/sync/consumer_producer.c \
+    # Sources only some plugins need
+    extra_sources=""
+    if [ "$plugin_name" = "aggregator" ]; then
+        extra_sources="plugins/sync/window_summary.c -lm"
+    fi
+    gcc $CFLAGS -fPIC -shared -o output/$plugin_name.so plugins/$plugin_name.c plugins/plugin_common.c  plugins/sync/monitor.c plugins/sync/consumer_producer.c plugins/sync/stage_cache.c plugins/sync/token_bucket.c plugins/sync/huge_alloc.c plugins/sync/spill_file.c plugins/sync/timer_wheel.c plugins/sync/scratch_pool.c $extra_sources \
     -ldl -lpthread || {
         print_error "Failed to build $plugin_name"
         exit 1
     }
 done
-gcc main.c plugins/plugin_common.c plugins/sync/consumer_producer.c plugins/sync/monitor.c -o output/analyzer
+gcc $CFLAGS main.c runtime/queue_controller.c runtime/checkpoint.c runtime/framing.c runtime/compress.c runtime/tracer.c runtime/control.c runtime/metrics.c runtime/offline.c runtime/ingest.c runtime/autotune.c runtime/sink.c plugins/plugin_common.c plugins/sync/consumer_producer.c plugins/sync/monitor.c plugins/sync/stage_cache.c plugins/sync/token_bucket.c plugins/sync/huge_alloc.c plugins/sync/spill_file.c plugins/sync/timer_wheel.c plugins/sync/scratch_pool.c -o output/analyzer \
+    -ldl -lpthread -lz
@@ -2,133 +2,1006 @@
 #include "plugins/plugin_common.h"
 #include "plugins/sync/consumer_producer.h"
 #include "plugins/sync/monitor.h"
+#include "runtime/pipeline.h"
+#include "runtime/queue_controller.h"
+#include "runtime/checkpoint.h"
+#include "runtime/framing.h"
+#include "runtime/compress.h"
+#include "runtime/tracer.h"
+#include "runtime/control.h"
+#include "runtime/metrics.h"
+#include "runtime/offline.h"
+#include "runtime/ingest.h"
+#include "runtime/autotune.h"
+#include "runtime/sink.h"
 #include <dlfcn.h>
+#include <getopt.h>
+#include <unistd.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <link.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
 
 #define MAX_LINE 1024
+#define SHUTDOWN_POLL_MS 100
+#define MAX_RATE_RULES 16
+#define MAX_PLUGIN_SETTINGS 32
+#define MAX_STAGE_RULES 32
+
+typedef enum {
+    SHUTDOWN_DRAIN = 0, // Process everything that is queued
+    SHUTDOWN_DEADLINE,  // Drain, then drop what is left when the deadline passes
+    SHUTDOWN_ABORT      // Drop everything that is queued
+} shutdown_mode_t;
 
 int g_queue_size = 0;
 int g_num_plugins = 0;
 
-typedef const char* (*init_fn)(int);
-typedef const char* (*place_work_fn)(const char*);
-typedef void (*attach_fn)(const char* (*next_place_work)(const char*));
-typedef const char* (*wait_finished_fn)(void);
-typedef const char* (*fini_fn)(void);
+plugin_handle_t* g_plugin_handles = NULL;
+pthread_mutex_t g_stages_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+static int g_autosize = 0;
+static queue_controller_config_t g_controller_config = { 0, 0, 200 };
+static const char* g_checkpoint_path = NULL;
+static int g_checkpoint_interval_ms = 1000;
+static int g_resume = 0;
+static long long g_input_offset = 0;
+static int g_use_records = 0;
+static int g_framed_input = 0;
+static int g_framed_output = 0;
+static int g_frame_checksum_every = 0;
+static frame_writer_t g_frame_writer;
+static FILE* g_input = NULL;
+static const char* g_output_path = NULL;
+static codec_t g_output_codec = CODEC_NONE;
+static int g_output_codec_set = 0;
+static int g_compress_threads = 0;
+static FILE* g_output_file = NULL; // Destination opened for --output, or stdout
+static FILE* g_output = NULL; // Stream the sink writes to (compressed wrapper if any)
+static const char* g_trace_path = NULL;
+static int g_trace_sample_every = 1000;
+static shutdown_mode_t g_shutdown_mode = SHUTDOWN_DRAIN;
+static long g_shutdown_deadline_ms = 0;
+static volatile sig_atomic_t g_cancel = 0; // Count of SIGINT/SIGTERM received
+static int g_cache_entries = 0;
+static int g_tracing = 0;
+static const char* g_control_path = NULL;
+static const char* g_send_path = NULL;
+static int g_offline = 0;
+static int g_offline_threads = 0;
+static huge_pages_t g_huge_pages = HUGE_PAGES_OFF;
+static const char* g_spill_dir = NULL;
+static int g_input_threads = 0; // Reader threads for --input files, 0 for online CPUs
+static ingest_order_t g_input_order = INGEST_ORDERED;
 typedef struct {
-    char* name;
-    void* handle;
-    init_fn init;
-    place_work_fn place_work;
-    attach_fn attach;
-    wait_finished_fn wait_finished;
-    fini_fn fini;
-} plugin_handle_t;
+    char target[64]; // "ingest", a stage index or a plugin name
+    int stage; // Stage the rule applies to once resolved, -1 for ingest
+    double lines_per_sec;
+    double bytes_per_sec;
+} rate_rule_t;
 
-plugin_handle_t* g_plugin_handles = NULL;
+static rate_rule_t g_rate_rules[MAX_RATE_RULES];
+static int g_num_rate_rules = 0;
+static token_bucket_t g_ingest_limiter;
+static int g_ingest_limited = 0;
+typedef struct {
+    char target[64]; // A stage index or a plugin name
+    char key[64];
+    const char* value; // Points into the --set argument
+} plugin_setting_t;
+
+static plugin_setting_t g_settings[MAX_PLUGIN_SETTINGS];
+static int g_num_settings = 0;
+typedef enum {
+    STAGE_CAPACITY = 0,
+    STAGE_BATCH,
+    STAGE_WORKERS
+} stage_knob_t;
+
+static const char* const g_knob_names[] = { "capacity", "batch", "workers" };
+typedef struct {
+    char target[64]; // A stage index or a plugin name
+    int stage; // Stage the rule applies to once resolved
+    stage_knob_t knob;
+    int value;
+} stage_rule_t;
+
+static stage_rule_t g_stage_rules[MAX_STAGE_RULES];
+static int g_num_stage_rules = 0;
+static long long g_autotune_lines = 0; // Input lines the calibration runs over, 0 when off
+static long long g_autotune_placed = 0; // Lines placed while calibrating, guarded by g_place_mutex
+static autotune_choice_t* g_autotuned = NULL; // Settings chosen by the calibration, one per stage
+static int g_cpus = 1;
+typedef struct {
+    const char* spec; // The --lane argument after the weight, used as the lane's label
+    int field; // 1-based whitespace-separated field compared with value, 0 to match value as a prefix
+    const char* value; // Prefix, or expected field value
+    size_t length; // Length of value
+} lane_rule_t;
+
+static lane_rule_t g_lane_rules[CP_MAX_LANES - 1]; // Rule i tags matching lines for lane i + 1
+static int g_num_lanes = 1; // Lanes in use, including the default lane 0
+static int g_lane_weights[CP_MAX_LANES] = { 1, 1, 1, 1 };
+static pthread_mutex_t g_place_mutex = PTHREAD_MUTEX_INITIALIZER; // Held by the reader while it places a line in stage 0
 
 static void build_plugin_path(char* path, size_t path_size, const char* plugin_name) {
     snprintf(path, path_size, "./output/%s.so", plugin_name);
 }
 
 void print_help() {
-    printf("Usage: ./analyzer <queue_size> <plugin1> <plugin2> ... <pluginN>\n");
+    printf("Usage: ./analyzer [options] <queue_size> <plugin1> <plugin2> ... <pluginN>\n");
+    printf("       ./analyzer --send <socket> <command...>\n");
     printf("\n");
     printf("Arguments:\n");
     printf("  queue_size   Maximum number of items in each plugin's queue\n");
     printf("  plugin1..N   Name of plugins to load (without .so extension)\n");
     printf("\n");
+    printf("Options:\n");
+    printf("  --autosize <min>:<max>     Resize each queue at runtime within [min, max]\n");
+    printf("                             from its measured producer and consumer rates\n");
+    printf("  --autosize-interval <ms>   Sampling interval of the resize controller (default 200)\n");
+    printf("  --checkpoint <file>        Periodically record the input offset committed at the sink\n");
+    printf("  --checkpoint-interval <ms> Time between two checkpoint writes (default 1000)\n");
+    printf("  --resume                   Skip the input up to the offset stored in the checkpoint\n");
+    printf("  --framed-input             Read length-prefixed binary frames instead of text lines\n");
+    printf("  --input <file|glob>        Read these files instead of stdin; repeatable\n");
+    printf("  --input-threads <n>        Reader threads for --input files (default: online CPUs)\n");
+    printf("  --input-order <mode>       ordered (default): each file whole, in the given order;\n");
+    printf("                             unordered: interleave files as fast as they are read\n");
+    printf("  --framed-output            Write the last stage's output to stdout as binary frames\n");
+    printf("  --frame-checksum <n>       Add a CRC32 checksum frame after every n output records\n");
+    printf("  --output <file>            Write the last stage's output to a file (.gz/.zst are compressed)\n");
+    printf("  --compress <codec>         Compress the output with gzip, zstd or none\n");
+    printf("  --sink <path>[,<key>=<value>...]\n");
+    printf("                             Also write the last stage's output to a file, named pipe or\n");
+    printf("                             stdout (-) on its own writer thread; keys: format=raw|json|\n");
+    printf("                             framed, policy=block|drop|spill (when its buffer is full),\n");
+    printf("                             buffer=<lines>, rotate=<bytes>[k|m], keep=<files>; repeatable\n");
+    printf("  --compress-threads <n>     Worker threads for (de)compression (default: online CPUs)\n");
+    printf("                             Compressed input (gzip/zstd) is detected automatically\n");
+    printf("  --trace <file>             Write per-stage timings of sampled lines as Chrome trace JSON\n");
+    printf("  --trace-sample <n>         Trace one line out of every n (default 1000)\n");
+    printf("  --cache <entries>          Memoize results of stateless plugins for repeated lines\n");
+    printf("  --shutdown <mode>          How queued lines are handled at shutdown: drain (default),\n");
+    printf("                             deadline:<ms> (drain, then drop the rest) or abort (drop)\n");
+    printf("                             SIGINT/SIGTERM stops the input; a second signal aborts\n");
+    printf("  --lane <weight>:<match>    Give matching lines their own priority lane served <weight>\n");
+    printf("                             times as often as weight 1; <match> is a line prefix or\n");
+    printf("                             #<n>=<value> for the n-th whitespace-separated field\n");
+    printf("  --lane-weight <weight>     Weight of the default lane (default 1)\n");
+    printf("  --rate-limit <at>:<lines/s>[:<bytes/s>]\n");
+    printf("                             Token-bucket limit at ingest (<at> = ingest) or before a\n");
+    printf("                             stage (index or name); 0 leaves that dimension unlimited\n");
+    printf("  --control <socket>         Accept commands on a UNIX socket while the pipeline runs:\n");
+    printf("                             metrics prints per-stage counters in Prometheus format;\n");
+    printf("                             reload <stage> [plugin] swaps a stage (index or name) for a\n");
+    printf("                             freshly loaded plugin without losing queued lines;\n");
+    printf("                             pause|resume <stage>, capacity <stage> <n>, verbosity <level>\n");
+    printf("  --send <socket>            Send the command given after the options and print the reply\n");
+    printf("  --offline                  Read the whole input, then run one stage at a time over all\n");
+    printf("                             lines (stateless stages in parallel); same output, no queues\n");
+    printf("  --offline-threads <n>      Worker threads per stateless stage offline (default: online CPUs)\n");
+    printf("  --set <stage>:<key>=<value> Pass an option to a stage (index or name) before it\n");
+    printf("                             starts, e.g. grep:pattern=ERROR; repeatable\n");
+    printf("  --huge-pages <mode>        Back queue rings and offline buffers with 2 MB pages: off\n");
+    printf("                             (default), transparent or explicit (hugetlb pool first);\n");
+    printf("                             falls back to the heap and reports what each one got\n");
+    printf("  --spill <dir>              Write lines that find a queue full to segment files in <dir>\n");
+    printf("                             instead of blocking; read back in order as the queue drains\n");
+    printf("  --capacity <stage>:<n>     Queue capacity of one stage (index or name)\n");
+    printf("  --batch <stage>:<n>        Most lines a stage takes from its queue at once (1-64)\n");
+    printf("  --workers <stage>:<n>      Consumer threads of a stateless stage; output stays in order\n");
+    printf("  --autotune <lines>         Measure each stage over the first <lines> input lines, then\n");
+    printf("                             set capacities, batches and workers and print them as options\n");
+    printf("\n");
     printf("Available plugins:\n");
     printf("  logger        - Logs all strings that pass through\n");
     printf("  typewriter    - Simulates typewriter effect with delays\n");
+    printf("                  (--set typewriter:delay-ms=<ms>, lines=<lines typed at once>)\n");
     printf("  uppercaser    - Converts strings to uppercase\n");
     printf("  rotator       - Move every character to the right.  Last character moves to the beginning.\n");
     printf("  flipper       - Reverses the order of the characters\n");
     printf("  expander      - Expands each character with spaces\n");
+    printf("  grep          - Keeps only lines with a pattern (--set grep:pattern=..., regex=..., invert=1)\n");
+    printf("  aggregator    - Replaces lines by per-window counts, distinct keys and top keys\n");
+    printf("                  (--set aggregator:key=<field>, window=<lines>|window-ms=<ms>, slide=..., top=<k>)\n");
     printf("\n");
     printf("Example:\n");
     printf("  ./analyzer 20 uppercaser rotator logger\n");
     fflush(stdout);
 }
 
-static void init_plugins(char** argv) {
+// Pass each --set aimed at this stage, by index or plugin name, to the freshly loaded plugin
+static int configure_plugin(plugin_handle_t* stage, int index, char* err_buf, size_t err_size) {
+    char index_text[16];
+    snprintf(index_text, sizeof(index_text), "%d", index);
+    for (int i = 0; i < g_num_settings; i++) {
+        const plugin_setting_t* setting = &g_settings[i];
+        if (strcmp(setting->target, index_text) != 0 && strcmp(setting->target, stage->name) != 0) continue;
+        const char* err = stage->configure ? stage->configure(setting->key, setting->value) : "plugin takes no options";
+        if (err) {
+            snprintf(err_buf, err_size, "Failed to set %s of plugin %s: %s", setting->key, stage->name, err);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Load a plugin into its own namespace, resolve its entry points and apply its
+ * --set options, without starting it.
+ * On failure nothing stays loaded and the error is written to err_buf.
+ */
+static int load_plugin(plugin_handle_t* stage, const char* name, int index, char* err_buf, size_t err_size) {
+    char path[256];
+    build_plugin_path(path, sizeof(path), name);
+    memset(stage, 0, sizeof(*stage));
+    stage->handle = dlmopen(LM_ID_NEWLM, path, RTLD_NOW | RTLD_LOCAL);
+    if (!stage->handle) {
+        snprintf(err_buf, err_size, "%s", dlerror());
+        return -1;
+    }
+    dlerror();
+    stage->init = (init_fn)dlsym(stage->handle, "plugin_init");
+    stage->place_work = (place_work_fn)dlsym(stage->handle, "plugin_place_work");
+    stage->attach = (attach_fn)dlsym(stage->handle, "plugin_attach");
+    stage->wait_finished = (wait_finished_fn)dlsym(stage->handle, "plugin_wait_finished");
+    stage->fini = (fini_fn)dlsym(stage->handle, "plugin_fini");
+
+    const char *sym_error = dlerror();
+    if (sym_error || !stage->init || !stage->place_work ||
+        !stage->attach || !stage->wait_finished || !stage->fini) {
+        snprintf(err_buf, err_size, "dlsym error in %s: %s", path, sym_error ? sym_error : "missing symbol(s)");
+        dlclose(stage->handle);
+        return -1;
+    }
+    // Optional symbols: features that need them are skipped for this plugin
+    stage->queue_stats = (queue_stats_fn)dlsym(stage->handle, "plugin_queue_stats");
+    stage->resize_queue = (resize_queue_fn)dlsym(stage->handle, "plugin_resize_queue");
+    stage->place_record = (place_record_fn)dlsym(stage->handle, "plugin_place_record");
+    stage->attach_record = (attach_record_fn)dlsym(stage->handle, "plugin_attach_record");
+    stage->attach_tracer = (attach_tracer_fn)dlsym(stage->handle, "plugin_attach_tracer");
+    stage->drain = (drain_fn)dlsym(stage->handle, "plugin_drain");
+    stage->abort = (abort_fn)dlsym(stage->handle, "plugin_abort");
+    stage->enable_cache = (enable_cache_fn)dlsym(stage->handle, "plugin_enable_cache");
+    stage->cache_stats = (cache_stats_fn)dlsym(stage->handle, "plugin_cache_stats");
+    stage->transform_batch = (transform_batch_fn)dlsym(stage->handle, "plugin_transform_batch");
+    stage->pause = (pause_fn)dlsym(stage->handle, "plugin_pause");
+    stage->resume = (resume_fn)dlsym(stage->handle, "plugin_resume");
+    stage->handoff = (handoff_fn)dlsym(stage->handle, "plugin_handoff");
+    stage->metrics = (metrics_fn)dlsym(stage->handle, "plugin_metrics");
+    stage->set_verbosity = (set_verbosity_fn)dlsym(stage->handle, "plugin_set_verbosity");
+    stage->set_lane_weights = (set_lane_weights_fn)dlsym(stage->handle, "plugin_set_lane_weights");
+    stage->transform_lines = (transform_batch_fn)dlsym(stage->handle, "plugin_transform_lines");
+    stage->is_stateless = (is_stateless_fn)dlsym(stage->handle, "plugin_is_stateless");
+    stage->set_rate_limit = (set_rate_limit_fn)dlsym(stage->handle, "plugin_set_rate_limit");
+    stage->set_huge_pages = (set_huge_pages_fn)dlsym(stage->handle, "plugin_set_huge_pages");
+    stage->set_spill = (set_spill_fn)dlsym(stage->handle, "plugin_set_spill");
+    stage->configure = (configure_fn)dlsym(stage->handle, "plugin_configure");
+    stage->set_workers = (set_workers_fn)dlsym(stage->handle, "plugin_set_workers");
+    stage->set_batch = (set_batch_fn)dlsym(stage->handle, "plugin_set_batch");
+    dlerror();
+    stage->name = strdup(name);
+    if (configure_plugin(stage, index, err_buf, err_size) != 0) {
+        dlclose(stage->handle);
+        free(stage->name);
+        return -1;
+    }
+    return 0;
+}
+
+// Load a plugin and initialize it, which starts its consumer thread
+static int open_plugin(plugin_handle_t* stage, const char* name, int index, int queue_size, char* err_buf, size_t err_size) {
+    if (load_plugin(stage, name, index, err_buf, err_size) != 0) return -1;
+    const char* init_error = stage->init(queue_size);
+    if (init_error) {
+        snprintf(err_buf, err_size, "Failed to initialize plugin %s: %s", name, init_error);
+        dlclose(stage->handle);
+        free(stage->name);
+        return -1;
+    }
+    return 0;
+}
+
+static void init_plugins(char** names) {
+    for (int s = 0; s < g_num_settings; s++) {
+        char* end;
+        long index = strtol(g_settings[s].target, &end, 10);
+        int found = *end == '\0' && index >= 0 && index < g_num_plugins;
+        for (int i = 0; i < g_num_plugins && !found; i++) found = strcmp(g_settings[s].target, names[i]) == 0;
+        if (!found) {
+            fprintf(stderr, "No stage %s for --set\n", g_settings[s].target);
+            free(g_plugin_handles);
+            exit(1);
+        }
+    }
     for (int i = 0; i < g_num_plugins; i++) {
-        g_plugin_handles[i].name = argv[i + 2];
-        
-        char path[256];
-        build_plugin_path(path, sizeof(path), g_plugin_handles[i].name);
-        g_plugin_handles[i].handle = dlmopen(LM_ID_NEWLM, path, RTLD_NOW | RTLD_LOCAL);
-
-        if (!g_plugin_handles[i].handle) {
-            fprintf(stderr, "%s\n", dlerror());
+        char err[512];
+        // Offline runs call the transforms directly, so no stage is started
+        int failed = g_offline ? load_plugin(&g_plugin_handles[i], names[i], i, err, sizeof(err))
+                               : open_plugin(&g_plugin_handles[i], names[i], i, g_queue_size, err, sizeof(err));
+        if (failed == 0 && g_offline && !g_plugin_handles[i].transform_lines) {
+            snprintf(err, sizeof(err), "Plugin %s does not export plugin_transform_lines, needed by --offline", names[i]);
+            dlclose(g_plugin_handles[i].handle);
+            free(g_plugin_handles[i].name);
+            failed = 1;
+        }
+        if (failed) {
+            fprintf(stderr, "%s\n", err);
             for (int j = 0; j < i; j++) {
                 dlclose(g_plugin_handles[j].handle);
+                free(g_plugin_handles[j].name);
             }
             free(g_plugin_handles);
             print_help();
             exit(1);
         }
-        dlerror();
-        g_plugin_handles[i].init = (init_fn)dlsym(g_plugin_handles[i].handle, "plugin_init");
-        g_plugin_handles[i].place_work = (place_work_fn)dlsym(g_plugin_handles[i].handle, "plugin_place_work");
-        g_plugin_handles[i].attach = (attach_fn)dlsym(g_plugin_handles[i].handle, "plugin_attach");
-        g_plugin_handles[i].wait_finished = (wait_finished_fn)dlsym(g_plugin_handles[i].handle, "plugin_wait_finished");
-        g_plugin_handles[i].fini = (fini_fn)dlsym(g_plugin_handles[i].handle, "plugin_fini");
-
-        const char *sym_error = dlerror();
-        if (sym_error || !g_plugin_handles[i].init || !g_plugin_handles[i].place_work ||
-            !g_plugin_handles[i].attach || !g_plugin_handles[i].wait_finished || !g_plugin_handles[i].fini) {
-            fprintf(stderr, "dlsym error in %s: %s\n", path, sym_error ? sym_error : "missing symbol(s)");
-            for (int j = 0; j <= i; j++) dlclose(g_plugin_handles[j].handle);
-            free(g_plugin_handles);
-            print_help();
-            exit(1);
-        }
+    }
+}
 
-        const char* init_error = g_plugin_handles[i].init(g_queue_size);
-        if (init_error) {
-            fprintf(stderr, "Failed to initialize plugin %s: %s\n", g_plugin_handles[i].name, init_error);
-            for (int j = 0; j <= i; j++) dlclose(g_plugin_handles[j].handle);
-            free(g_plugin_handles);
-            print_help();
-            exit(1);
+// Sink attached after the last stage when the analyzer itself consumes the output
+static const char* emit_record(const char* str, const record_meta_t* meta) {
+    if (meta && meta->ingest_ns) metrics_lane_latency(meta->lane, trace_now_ns() - meta->ingest_ns);
+    if (g_framed_output) {
+        const char* err = frame_write(&g_frame_writer, str, strlen(str));
+        if (err) fprintf(stderr, "Failed to write output frame: %s\n", err);
+    } else if (g_output) {
+        fputs(str, g_output);
+        fputc('\n', g_output);
+    }
+    sink_emit(str);
+    if (g_checkpoint_path) checkpoint_commit(str, meta);
+    return NULL;
+}
+
+// Connect one stage's output to the next stage, or to the analyzer's sink after the last one
+static void attach_stage(plugin_handle_t* stage, int index) {
+    if (index < g_num_plugins - 1) {
+        if (g_use_records) {
+            stage->attach_record(g_plugin_handles[index + 1].place_record);
+        } else {
+            stage->attach(g_plugin_handles[index + 1].place_work);
         }
+    } else if (g_use_records && (g_checkpoint_path || g_output || sink_count() > 0 || g_num_lanes > 1)) {
+        stage->attach_record(emit_record);
     }
 }
 
+static void apply_lane_weights(plugin_handle_t* stage) {
+    if (g_num_lanes == 1 || !stage->set_lane_weights) return;
+    const char* err = stage->set_lane_weights(g_lane_weights, g_num_lanes);
+    if (err) fprintf(stderr, "Failed to set lane weights of plugin %s: %s\n", stage->name, err);
+}
+
+static void apply_huge_pages(plugin_handle_t* stage) {
+    if (g_huge_pages == HUGE_PAGES_OFF) return;
+    const char* err = stage->set_huge_pages ? stage->set_huge_pages(g_huge_pages) : "plugin does not support huge pages";
+    consumer_producer_stats_t stats;
+    if (err) {
+        fprintf(stderr, "Failed to set huge pages of plugin %s: %s\n", stage->name, err);
+    } else if (stage->queue_stats && stage->queue_stats(&stats, 0) == NULL) {
+        fprintf(stderr, "Queue of plugin %s: %s (%zu KB)\n", stage->name, huge_backing_name(stats.backing),
+                stats.ring_bytes / 1024);
+    }
+}
+
+static void apply_spill(plugin_handle_t* stage) {
+    if (!g_spill_dir) return;
+    const char* err = stage->set_spill ? stage->set_spill(g_spill_dir) : "plugin does not support spilling";
+    if (err) fprintf(stderr, "Failed to enable spilling for plugin %s: %s\n", stage->name, err);
+}
+
+static void apply_rate_limits(plugin_handle_t* stage, int index) {
+    for (int i = 0; i < g_num_rate_rules; i++) {
+        const rate_rule_t* rule = &g_rate_rules[i];
+        if (rule->stage != index) continue;
+        const char* err = stage->set_rate_limit ? stage->set_rate_limit(rule->lines_per_sec, rule->bytes_per_sec)
+                                                : "plugin does not support rate limits";
+        if (err) fprintf(stderr, "Failed to set rate limit of plugin %s: %s\n", stage->name, err);
+    }
+}
+
+static void apply_knob(plugin_handle_t* stage, stage_knob_t knob, int value) {
+    const char* err;
+    if (knob == STAGE_CAPACITY) {
+        err = stage->resize_queue ? stage->resize_queue(value) : "plugin does not support resizing";
+    } else if (knob == STAGE_BATCH) {
+        err = stage->set_batch ? stage->set_batch(value) : "plugin does not support batches";
+    } else {
+        err = stage->set_workers ? stage->set_workers(value) : "plugin does not support workers";
+    }
+    if (err) fprintf(stderr, "Failed to set %s of plugin %s: %s\n", g_knob_names[knob], stage->name, err);
+}
+
+// --capacity, --batch and --workers of one stage, then what the calibration chose for it
+static void apply_stage_rules(plugin_handle_t* stage, int index) {
+    for (int i = 0; i < g_num_stage_rules; i++) {
+        if (g_stage_rules[i].stage == index) apply_knob(stage, g_stage_rules[i].knob, g_stage_rules[i].value);
+    }
+    if (!g_autotuned || g_autotuned[index].service_ns <= 0) return;
+    apply_knob(stage, STAGE_CAPACITY, g_autotuned[index].capacity);
+    apply_knob(stage, STAGE_BATCH, g_autotuned[index].batch);
+    if (g_autotuned[index].workers > 1) apply_knob(stage, STAGE_WORKERS, g_autotuned[index].workers);
+}
+
 static void attach_plugins(void) {
-    for (int i = 0; i < g_num_plugins - 1; i++) {
-        g_plugin_handles[i].attach(g_plugin_handles[i + 1].place_work);
+    // Record metadata can only flow if every stage understands it
+    g_use_records = 1;
+    for (int i = 0; i < g_num_plugins; i++) {
+        if (!g_plugin_handles[i].place_record || !g_plugin_handles[i].attach_record) g_use_records = 0;
+    }
+    for (int i = 0; i < g_num_plugins; i++) {
+        attach_stage(&g_plugin_handles[i], i);
+        apply_lane_weights(&g_plugin_handles[i]);
+        apply_huge_pages(&g_plugin_handles[i]);
+        apply_spill(&g_plugin_handles[i]);
     }
 }
 
-static int read_input(void) {
-    char line[MAX_LINE];
-    while (1) {
-        fgets(line, sizeof(line), stdin);
-        if (feof(stdin)) {
+// Stages with side effects (logger, typewriter) refuse the cache and keep running every line
+static void enable_caches(void) {
+    if (g_cache_entries == 0) return;
+    for (int i = 0; i < g_num_plugins; i++) {
+        if (g_plugin_handles[i].enable_cache) g_plugin_handles[i].enable_cache(g_cache_entries);
+    }
+}
+
+static void report_cache(plugin_handle_t* stage) {
+    stage_cache_stats_t stats;
+    if (!stage->cache_stats || stage->cache_stats(&stats) != NULL) return;
+    unsigned long long lookups = stats.hits + stats.misses;
+    fprintf(stderr, "Cache %s: %llu lookups, %.1f%% hits, %llu evictions, %d/%d entries, %zu bytes\n",
+            stage->name, lookups, lookups ? 100.0 * stats.hits / lookups : 0.0, stats.evictions,
+            stats.entries, stats.capacity, stats.bytes);
+}
+
+static void start_tracing(void) {
+    if (!g_trace_path) return;
+    if (!g_use_records) {
+        fprintf(stderr, "Failed to start tracing: plugins do not carry record metadata\n");
+        return;
+    }
+    const char* err = tracer_open(g_trace_path, g_trace_sample_every);
+    if (err) {
+        fprintf(stderr, "Failed to start tracing: %s\n", err);
+        return;
+    }
+    for (int i = 0; i < g_num_plugins; i++) {
+        tracer_name_stage(i, g_plugin_handles[i].name);
+        if (g_plugin_handles[i].attach_tracer) g_plugin_handles[i].attach_tracer(tracer_span, i);
+    }
+    g_tracing = 1;
+}
+
+static double elapsed_ms(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000.0 + (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+/*
+ * Replace stage `index` with a freshly loaded instance of plugin `name`.
+ * The new instance is fully wired downstream before anything reaches it. Then the
+ * upstream producer is held at a batch boundary while the old instance hands its
+ * queued lines over, untransformed and in order, so no line is lost or reordered.
+ * A paused stage hands over first: a producer blocked on its full queue only gets
+ * to a boundary once the queue moves, and the input reader holds g_place_mutex
+ * while it waits. Otherwise the producer is held first, so it cannot keep filling
+ * the new instance while the reload waits for it.
+ * Queues cannot simply change owner: each plugin namespace has its own allocator.
+ */
+static int reload_stage(int index, const char* name, char* reply, size_t reply_size) {
+    plugin_handle_t* old = &g_plugin_handles[index];
+    if (!old->handoff || (index > 0 && (!old->pause || !old->resume))) {
+        snprintf(reply, reply_size, "ERR plugin %s does not support reload", old->name);
+        return -1;
+    }
+    plugin_handle_t* upstream = index > 0 ? &g_plugin_handles[index - 1] : NULL;
+    if (upstream && (!upstream->pause || !upstream->resume)) {
+        snprintf(reply, reply_size, "ERR plugin %s cannot be paused", upstream->name);
+        return -1;
+    }
+    int capacity = g_queue_size;
+    consumer_producer_stats_t stats;
+    if (old->queue_stats && old->queue_stats(&stats, 0) == NULL) capacity = stats.capacity;
+
+    plugin_handle_t fresh;
+    char err[512];
+    if (open_plugin(&fresh, name, index, capacity, err, sizeof(err)) != 0) {
+        snprintf(reply, reply_size, "ERR %s", err);
+        return -1;
+    }
+    if (!fresh.place_record || (g_use_records && !fresh.attach_record)) {
+        fresh.fini();
+        dlclose(fresh.handle);
+        free(fresh.name);
+        snprintf(reply, reply_size, "ERR plugin %s does not support reload", name);
+        return -1;
+    }
+    attach_stage(&fresh, index);
+    apply_lane_weights(&fresh);
+    apply_huge_pages(&fresh);
+    apply_spill(&fresh);
+    apply_rate_limits(&fresh, index);
+    apply_stage_rules(&fresh, index);
+    if (g_tracing && fresh.attach_tracer) fresh.attach_tracer(tracer_span, index);
+    if (g_cache_entries > 0 && fresh.enable_cache) fresh.enable_cache(g_cache_entries);
+
+    int forward_first = old->paused;
+    if (forward_first) old->handoff(fresh.place_record);
+    struct timespec paused;
+    clock_gettime(CLOCK_MONOTONIC, &paused);
+    if (upstream) {
+        upstream->pause();
+    } else {
+        pthread_mutex_lock(&g_place_mutex);
+    }
+    if (!forward_first) old->handoff(fresh.place_record);
+    // Nothing new reaches the old queue now, so this only flushes it into the new one
+    old->wait_finished();
+    if (upstream) {
+        if (g_use_records) {
+            upstream->attach_record(fresh.place_record);
+        } else {
+            upstream->attach(fresh.place_work);
+        }
+    }
+    // A stage paused from the control socket is paused again under its new instance,
+    // once the lines its old instance held have been passed on
+    if (old->paused && fresh.pause) {
+        fresh.pause();
+        fresh.paused = 1;
+    }
+    pthread_mutex_lock(&g_stages_mutex);
+    plugin_handle_t retired = *old;
+    *old = fresh;
+    pthread_mutex_unlock(&g_stages_mutex);
+    if (upstream) {
+        upstream->resume();
+    } else {
+        pthread_mutex_unlock(&g_place_mutex);
+    }
+    double pause_ms = elapsed_ms(&paused);
+
+    const char* fini_err = retired.fini();
+    if (fini_err) fprintf(stderr, "Failed to finalize plugin %s: %s\n", retired.name, fini_err);
+    dlclose(retired.handle);
+    snprintf(reply, reply_size, "OK stage %d: %s replaced by %s, paused %.3f ms", index, retired.name, name, pause_ms);
+    free(retired.name);
+    return 0;
+}
+
+static int find_stage(const char* key) {
+    char* end;
+    long index = strtol(key, &end, 10);
+    if (*key != '\0' && *end == '\0') return index >= 0 && index < g_num_plugins ? (int)index : -1;
+    for (int i = 0; i < g_num_plugins; i++) {
+        if (strcmp(g_plugin_handles[i].name, key) == 0) return i;
+    }
+    return -1;
+}
+
+// Bind each --rate-limit to ingest or to its stage; must run before any input is read
+static int start_rate_limits(void) {
+    for (int i = 0; i < g_num_rate_rules; i++) {
+        rate_rule_t* rule = &g_rate_rules[i];
+        if (strcmp(rule->target, "ingest") == 0) {
+            rule->stage = -1;
+            token_bucket_init(&g_ingest_limiter, rule->lines_per_sec, rule->bytes_per_sec);
+            g_ingest_limited = 1;
             continue;
         }
-        if (strcmp(line, "<END>\n") == 0) break;
-        line[strcspn(line, "\n")] = '\0';
-        const char* err = g_plugin_handles[0].place_work(line);
+        rule->stage = find_stage(rule->target);
+        if (rule->stage < 0) {
+            fprintf(stderr, "No stage %s for --rate-limit\n", rule->target);
+            return -1;
+        }
+    }
+    for (int i = 0; i < g_num_plugins; i++) apply_rate_limits(&g_plugin_handles[i], i);
+    if (g_ingest_limited) metrics_watch_ingest(&g_ingest_limiter);
+    return 0;
+}
+
+// Bind each --capacity, --batch and --workers to its stage and apply it
+static int start_stage_rules(void) {
+    for (int i = 0; i < g_num_stage_rules; i++) {
+        stage_rule_t* rule = &g_stage_rules[i];
+        rule->stage = find_stage(rule->target);
+        if (rule->stage < 0) {
+            fprintf(stderr, "No stage %s for --%s\n", rule->target, g_knob_names[rule->knob]);
+            return -1;
+        }
+    }
+    for (int i = 0; i < g_num_plugins; i++) apply_stage_rules(&g_plugin_handles[i], i);
+    return 0;
+}
+
+/*
+ * End the calibration and apply its choices to the running stages. Runs on
+ * whichever thread placed the last sample line; the workers it starts must
+ * not take the cancel signals, so they are blocked while it runs.
+ */
+static void finish_autotune(void) {
+    autotune_choice_t* choices = calloc(g_num_plugins, sizeof(autotune_choice_t));
+    if (!choices) {
+        fprintf(stderr, "Failed to allocate memory for autotune results\n");
+        return;
+    }
+    sigset_t cancel_signals;
+    sigset_t previous;
+    sigemptyset(&cancel_signals);
+    sigaddset(&cancel_signals, SIGINT);
+    sigaddset(&cancel_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &cancel_signals, &previous);
+    fprintf(stderr, "Autotune sample: %lld lines\n", g_autotune_placed);
+    autotune_finish(g_cpus, choices, stderr);
+    pthread_mutex_lock(&g_stages_mutex);
+    g_autotuned = choices;
+    for (int i = 0; i < g_num_plugins; i++) apply_stage_rules(&g_plugin_handles[i], i);
+    pthread_mutex_unlock(&g_stages_mutex);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+}
+
+static void report_throttle(plugin_handle_t* stage, int index) {
+    stage_metrics_t metrics;
+    for (int i = 0; i < g_num_rate_rules; i++) {
+        if (g_rate_rules[i].stage != index) continue;
+        if (stage->metrics && stage->metrics(&metrics) == NULL) {
+            fprintf(stderr, "Rate limit of plugin %s: throttled %.3f s\n", stage->name, metrics.throttled_ns / 1e9);
+        }
+        return;
+    }
+}
+
+static void report_spill(plugin_handle_t* stage) {
+    consumer_producer_stats_t stats;
+    if (!g_spill_dir || !stage->queue_stats || stage->queue_stats(&stats, 0) != NULL) return;
+    if (stats.spilled_total > 0) {
+        fprintf(stderr, "Queue of plugin %s: spilled %llu lines to disk\n", stage->name, stats.spilled_total);
+    }
+}
+
+static void pause_stage(plugin_handle_t* stage, int pause, char* reply, size_t reply_size) {
+    if (!stage->pause || !stage->resume) {
+        snprintf(reply, reply_size, "ERR plugin %s cannot be paused", stage->name);
+        return;
+    }
+    if (pause && !stage->paused) stage->pause();
+    if (!pause && stage->paused) stage->resume();
+    stage->paused = pause;
+    snprintf(reply, reply_size, "OK %s %s", stage->name, pause ? "paused" : "resumed");
+}
+
+static void resize_stage(plugin_handle_t* stage, const char* value, char* reply, size_t reply_size) {
+    int capacity = atoi(value);
+    if (capacity <= 0) {
+        snprintf(reply, reply_size, "ERR capacity must be greater than 0");
+        return;
+    }
+    const char* err = stage->resize_queue ? stage->resize_queue(capacity) : "plugin cannot resize its queue";
+    if (err) {
+        snprintf(reply, reply_size, "ERR %s", err);
+        return;
+    }
+    snprintf(reply, reply_size, "OK %s capacity %d", stage->name, capacity);
+}
+
+// Applies to one stage, or to every stage when index is -1
+static void set_verbosity(const char* value, int index, char* reply, size_t reply_size) {
+    int level = atoi(value);
+    int changed = 0;
+    for (int i = 0; i < g_num_plugins; i++) {
+        if (index >= 0 && i != index) continue;
+        if (!g_plugin_handles[i].set_verbosity) continue;
+        g_plugin_handles[i].set_verbosity(level);
+        changed++;
+    }
+    snprintf(reply, reply_size, "OK verbosity %d on %d stage(s)", level, changed);
+}
+
+/*
+ * Runs on the control thread, one command at a time:
+ *   metrics                      Prometheus text exposition of every stage
+ *   reload <stage> [plugin]      swap a stage for a fresh instance
+ *   pause|resume <stage>         hold or release a stage at a batch boundary
+ *   capacity <stage> <n>         resize a stage's queue
+ *   verbosity <level> [stage]    set logging verbosity (0 silences the logger)
+ */
+static void handle_command(const char* command, char* reply, size_t reply_size) {
+    char verb[32], key[256], arg[256];
+    int fields = sscanf(command, "%31s %255s %255s", verb, key, arg);
+    if (fields >= 1 && strcmp(verb, "metrics") == 0) {
+        metrics_render(reply, reply_size);
+        return;
+    }
+    if (fields >= 2 && strcmp(verb, "verbosity") == 0) {
+        int index = fields == 3 ? find_stage(arg) : -1;
+        if (fields == 3 && index < 0) {
+            snprintf(reply, reply_size, "ERR no stage %s", arg);
+            return;
+        }
+        set_verbosity(key, index, reply, reply_size);
+        return;
+    }
+    int index = fields >= 2 ? find_stage(key) : -1;
+    if (fields >= 2 && index < 0) {
+        snprintf(reply, reply_size, "ERR no stage %s", key);
+        return;
+    }
+    if (fields >= 2 && strcmp(verb, "reload") == 0) {
+        reload_stage(index, fields == 3 ? arg : g_plugin_handles[index].name, reply, reply_size);
+    } else if (fields == 2 && (strcmp(verb, "pause") == 0 || strcmp(verb, "resume") == 0)) {
+        pause_stage(&g_plugin_handles[index], verb[0] == 'p', reply, reply_size);
+    } else if (fields == 3 && strcmp(verb, "capacity") == 0) {
+        resize_stage(&g_plugin_handles[index], arg, reply, reply_size);
+    } else {
+        snprintf(reply, reply_size, "ERR unknown command, expected: metrics, reload <stage> [plugin], "
+                 "pause <stage>, resume <stage>, capacity <stage> <n> or verbosity <level> [stage]");
+    }
+}
+
+static int open_output(void) {
+    if (!g_framed_output && !g_output_path && !g_output_codec_set) return 0;
+    g_output_file = stdout;
+    if (g_output_path) {
+        g_output_file = fopen(g_output_path, "w");
+        if (!g_output_file) {
+            perror(g_output_path);
+            return -1;
+        }
+    }
+    codec_t codec = g_output_codec_set ? g_output_codec : compress_codec_from_path(g_output_path);
+    g_output = g_output_file;
+    if (codec != CODEC_NONE) {
+        const char* err = compress_open_output(g_output_file, codec, g_compress_threads, &g_output);
         if (err) {
-            fprintf(stderr, "Failed to place work in plugin %s: %s\n", g_plugin_handles[0].name, err);
-            for (int j = 0; j < g_num_plugins; j++) dlclose(g_plugin_handles[j].handle);
-            free(g_plugin_handles);
-            print_help();
-            return 1;
+            fprintf(stderr, "Failed to open compressed output: %s\n", err);
+            if (g_output_file != stdout) fclose(g_output_file);
+            g_output = NULL;
+            return -1;
         }
     }
+    if (g_framed_output) frame_writer_init(&g_frame_writer, g_output, g_frame_checksum_every);
+    return 0;
+}
+
+static void close_output(void) {
+    if (!g_output) return;
+    if (g_framed_output) {
+        const char* err = frame_write_end(&g_frame_writer);
+        if (err) fprintf(stderr, "Failed to end framed output: %s\n", err);
+    }
+    if (g_output != g_output_file) {
+        if (fclose(g_output) != 0) fprintf(stderr, "Failed to finish compressed output\n");
+    }
+    if (g_output_file != stdout) {
+        fclose(g_output_file);
+    } else {
+        fflush(stdout);
+    }
+    g_output = NULL;
+}
+
+// Checkpoint hook: what emit_record wrote so far reaches the disk before its offset is stored
+static const char* sync_output(void) {
+    if (!g_output) return NULL;
+    if (g_output != g_output_file) return compress_sync_output(g_output);
+    if (fflush(g_output) != 0) return "Could not flush output";
+    // Pipes and terminals cannot be synced, and need not be
+    if (fsync(fileno(g_output)) != 0 && errno != EINVAL && errno != EROFS) return "Could not sync output";
+    return NULL;
+}
+
+static int skip_input(long long offset) {
+    if (fseeko(g_input, (off_t)offset, SEEK_SET) == 0) return 0;
+    // Not seekable (pipe): consume the already processed bytes instead
+    char buffer[8192];
+    long long remaining = offset;
+    while (remaining > 0) {
+        size_t chunk = remaining < (long long)sizeof(buffer) ? (size_t)remaining : sizeof(buffer);
+        size_t got = fread(buffer, 1, chunk, g_input);
+        if (got == 0) return -1;
+        remaining -= got;
+    }
     return 0;
 }
 
+// Does the n-th whitespace-separated field of line equal value?
+static int field_equals(const char* line, int field, const char* value, size_t length) {
+    const char* p = line;
+    for (int n = 1; ; n++) {
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '\0') return 0;
+        const char* end = p;
+        while (*end && *end != ' ' && *end != '\t') end++;
+        if (n == field) return (size_t)(end - p) == length && strncmp(p, value, length) == 0;
+        p = end;
+    }
+}
+
+// Lane of a line: the first matching --lane rule, or the default lane 0
+static int classify_line(const char* line) {
+    for (int i = 0; i < g_num_lanes - 1; i++) {
+        const lane_rule_t* rule = &g_lane_rules[i];
+        int match = rule->field ? field_equals(line, rule->field, rule->value, rule->length)
+                                : strncmp(line, rule->value, rule->length) == 0;
+        if (match) return i + 1;
+    }
+    return 0;
+}
+
+static int place_line(const char* line, long long end_offset) {
+    const char* err;
+    // Bytes are only counted when they are limited
+    if (g_ingest_limited) token_bucket_take(&g_ingest_limiter, 1, g_ingest_limiter.bytes_per_sec > 0 ? (long long)strlen(line) : 0);
+    if (g_offline) {
+        err = offline_add_line(line);
+        if (err) fprintf(stderr, "Failed to buffer input: %s\n", err);
+        return err ? 1 : 0;
+    }
+    pthread_mutex_lock(&g_place_mutex);
+    if (g_use_records) {
+        record_meta_t meta;
+        meta.end_offset = end_offset;
+        meta.trace_id = tracer_sample();
+        meta.put_ns = 0;
+        meta.enqueue_ns = 0;
+        meta.lane = 0;
+        meta.ingest_ns = 0;
+        if (g_num_lanes > 1) {
+            meta.lane = classify_line(line);
+            meta.ingest_ns = trace_now_ns();
+        }
+        err = g_plugin_handles[0].place_record(line, &meta);
+    } else {
+        err = g_plugin_handles[0].place_work(line);
+    }
+    int sampled = !err && g_autotune_lines > 0 && ++g_autotune_placed == g_autotune_lines;
+    pthread_mutex_unlock(&g_place_mutex);
+    if (err) {
+        fprintf(stderr, "Failed to place work in plugin %s: %s\n", g_plugin_handles[0].name, err);
+        return 1;
+    }
+    if (sampled) finish_autotune();
+    return 0;
+}
+
+static int read_text_input(void) {
+    char line[MAX_LINE];
+    long long offset = g_input_offset;
+    while (!g_cancel && fgets(line, sizeof(line), g_input) != NULL) {
+        size_t len = strlen(line);
+        offset += len;
+        if (line[0] == '<' && (strcmp(line, "<END>\n") == 0 || strcmp(line, "<END>") == 0)) break;
+        if (len > 0 && line[len - 1] == '\n') line[len - 1] = '\0';
+        if (place_line(line, offset) != 0) return 1;
+    }
+    return 0;
+}
+
+static int read_framed_input(void) {
+    frame_reader_t reader;
+    frame_reader_init(&reader, g_input, g_input_offset);
+    int status = 0;
+    const char* record;
+    const char* err;
+    while (!g_cancel && (err = frame_read(&reader, &record)) == NULL && record != NULL) {
+        if (place_line(record, reader.offset) != 0) {
+            status = 1;
+            break;
+        }
+    }
+    if (err && !g_cancel) {
+        fprintf(stderr, "Invalid framed input at offset %lld: %s\n", reader.offset, err);
+        status = 1;
+    }
+    frame_reader_destroy(&reader);
+    return status;
+}
+
+static int read_input(void) {
+    if (ingest_file_count() > 0) {
+        int threads = g_input_threads < ingest_file_count() ? g_input_threads : ingest_file_count();
+        // Parallel block-gzip decoding shares the CPUs between the files read at once
+        int decode_threads = g_compress_threads / threads > 0 ? g_compress_threads / threads : 1;
+        int status = ingest_run(threads, g_input_order, g_framed_input, decode_threads, place_line, &g_cancel);
+        ingest_report(stderr);
+        return status;
+    }
+    int status = g_framed_input ? read_framed_input() : read_text_input();
+    const char* err = compress_close_input();
+    if (err) {
+        fprintf(stderr, "Failed to decode input: %s\n", err);
+        status = 1;
+    }
+    return status;
+}
+
+static long long now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static void on_cancel_signal(int sig) {
+    (void)sig;
+    g_cancel++;
+}
+
+/*
+ * Wait for one stage to process everything queued, in short slices so that
+ * the deadline and a cancel signal are noticed while a slow stage runs.
+ * Returns 0 once drained, -1 if the deadline passed or a signal asked to abort.
+ */
+static int drain_stage(plugin_handle_t* stage, long long deadline, int cancel_seen) {
+    if (!stage->drain) {
+        // No bounded wait available: drain fully
+        stage->wait_finished();
+        return 0;
+    }
+    for (;;) {
+        long slice = SHUTDOWN_POLL_MS;
+        if (deadline > 0) {
+            long long remaining = deadline - now_ms();
+            if (remaining <= 0) return -1;
+            if (remaining < slice) slice = (long)remaining;
+        }
+        if (stage->drain(slice) == 0) return 0;
+        if (g_cancel != cancel_seen) return -1;
+    }
+}
+
+// Finish every stage according to the shutdown mode; returns the index of the first aborted stage
+static int stop_stages(void) {
+    int cancel_seen = g_cancel;
+    long long deadline = g_shutdown_mode == SHUTDOWN_DEADLINE ? now_ms() + g_shutdown_deadline_ms : 0;
+    int first_aborted = g_shutdown_mode == SHUTDOWN_ABORT ? 0 : g_num_plugins;
+    for (int i = 0; i < first_aborted; i++) {
+        if (drain_stage(&g_plugin_handles[i], deadline, cancel_seen) != 0) first_aborted = i;
+    }
+    // Stop the remaining stages together so no dropped line flows further down the chain
+    for (int i = first_aborted; i < g_num_plugins; i++) {
+        if (g_plugin_handles[i].abort) g_plugin_handles[i].abort();
+    }
+    return first_aborted;
+}
+
+// Unload every stage and close the output; the stages must be stopped or never started
+static void release_pipeline(void) {
+    for (int i = g_num_plugins - 1; i >= 0; i--) {
+        dlclose(g_plugin_handles[i].handle);
+        free(g_plugin_handles[i].name);
+    }
+    free(g_plugin_handles);
+    free(g_autotuned);
+    ingest_free();
+    int output_on_stdout = (g_output && g_output_file == stdout) || sink_uses_stdout();
+    sink_free();
+    close_output();
+    if (output_on_stdout) {
+        // stdout carries the pipeline output only
+        fprintf(stderr, "Pipeline shutdown complete\n");
+        return;
+    }
+    printf("Pipeline shutdown complete\n");
+}
+
 static void shutdown_pipeline(void) {
+    // A reload in progress completes first; no command runs once stages stop
+    control_stop();
+    // A stage left paused would never drain
+    for (int i = 0; i < g_num_plugins; i++) {
+        if (g_plugin_handles[i].paused) g_plugin_handles[i].resume();
+    }
+    queue_controller_stop();
+    // An input shorter than the sample still gets its report
+    if (autotune_running()) finish_autotune();
+    int first_aborted = stop_stages();
+    unsigned long long dropped = 0;
     for (int i = 0; i < g_num_plugins; i++) {
         if (g_plugin_handles[i].wait_finished) {
             const char* wait_finished_err = g_plugin_handles[i].wait_finished();
@@ -136,6 +1009,14 @@ static void shutdown_pipeline(void) {
                 fprintf(stderr, "Failed to wait for plugin %s to finish: %s\n", g_plugin_handles[i].name, wait_finished_err);
             }
         }
+        consumer_producer_stats_t stats;
+        if (i >= first_aborted && g_plugin_handles[i].queue_stats &&
+            g_plugin_handles[i].queue_stats(&stats, 0) == NULL) {
+            dropped += stats.dropped;
+        }
+        report_cache(&g_plugin_handles[i]);
+        report_throttle(&g_plugin_handles[i], i);
+        report_spill(&g_plugin_handles[i]);
         if (g_plugin_handles[i].fini) {
             const char* fini_err = g_plugin_handles[i].fini();
             if (fini_err) {
@@ -143,29 +1024,461 @@ static void shutdown_pipeline(void) {
             }
         }
     }
-    for (int i = g_num_plugins - 1; i >= 0; i--) {
-        dlclose(g_plugin_handles[i].handle);
+    if (first_aborted < g_num_plugins) {
+        fprintf(stderr, "Shutdown aborted from plugin %s, %llu lines dropped\n",
+                g_plugin_handles[first_aborted].name, dropped);
     }
-    free(g_plugin_handles);
-    printf("Pipeline shutdown complete\n");
+    // Every line reached the sinks by now; their writers finish what they buffered
+    sink_stop();
+    sink_report(stderr);
+    if (g_num_lanes > 1) metrics_report_lanes(stderr);
+    if (g_ingest_limited) {
+        fprintf(stderr, "Rate limit at ingest: throttled %.3f s\n", token_bucket_throttled_ns(&g_ingest_limiter) / 1e9);
+    }
+    // Every stage is stopped here, so the final checkpoint covers exactly the committed lines
+    checkpoint_stop();
+    tracer_close();
+    release_pipeline();
+}
+
+/*
+ * Bulk-synchronous run: buffer the whole input, then let each stage transform
+ * all of it before the next one starts. Output matches the streaming pipeline.
+ */
+static int run_offline(const sigset_t* cancel_signals) {
+    pthread_sigmask(SIG_UNBLOCK, cancel_signals, NULL);
+    offline_set_huge_pages(g_huge_pages);
+    const char* err = ingest_file_count() > 0 ? NULL : compress_open_input(stdin, g_compress_threads, &g_input);
+    if (err) fprintf(stderr, "Failed to open input: %s\n", err);
+    int status = err ? 1 : read_input();
+    // Worker threads take no cancel signals
+    pthread_sigmask(SIG_BLOCK, cancel_signals, NULL);
+    if (status == 0) {
+        err = offline_run(g_offline_threads);
+        if (err) {
+            fprintf(stderr, "Offline run failed: %s\n", err);
+            status = 1;
+        } else {
+            offline_emit(emit_record);
+        }
+    }
+    sink_stop();
+    sink_report(stderr);
+    if (g_huge_pages != HUGE_PAGES_OFF) {
+        size_t bytes;
+        huge_backing_t backing = offline_buffer_backing(&bytes);
+        fprintf(stderr, "Offline buffers: %s (%zu KB)\n", huge_backing_name(backing), bytes / 1024);
+    }
+    offline_free();
+    release_pipeline();
+    return status;
+}
+
+// Parse <at>:<lines/s>[:<bytes/s>] into the next rate rule
+static int parse_rate_limit(const char* arg) {
+    if (g_num_rate_rules == MAX_RATE_RULES) {
+        fprintf(stderr, "At most %d --rate-limit options are supported\n", MAX_RATE_RULES);
+        return -1;
+    }
+    rate_rule_t* rule = &g_rate_rules[g_num_rate_rules];
+    const char* colon = strchr(arg, ':');
+    int consumed = 0;
+    rule->bytes_per_sec = 0;
+    if (!colon || colon == arg || (size_t)(colon - arg) >= sizeof(rule->target) ||
+        sscanf(colon + 1, "%lf%n:%lf%n", &rule->lines_per_sec, &consumed, &rule->bytes_per_sec, &consumed) < 1 ||
+        colon[1 + consumed] != '\0' || rule->lines_per_sec < 0 || rule->bytes_per_sec < 0 ||
+        (rule->lines_per_sec == 0 && rule->bytes_per_sec == 0)) {
+        fprintf(stderr, "Invalid --rate-limit, expected <at>:<lines/s>[:<bytes/s>]: %s\n", arg);
+        return -1;
+    }
+    memcpy(rule->target, arg, colon - arg);
+    rule->target[colon - arg] = '\0';
+    g_num_rate_rules++;
+    return 0;
+}
+
+// Parse <stage>:<key>=<value> into the next plugin setting
+static int parse_setting(const char* arg) {
+    if (g_num_settings == MAX_PLUGIN_SETTINGS) {
+        fprintf(stderr, "At most %d --set options are supported\n", MAX_PLUGIN_SETTINGS);
+        return -1;
+    }
+    plugin_setting_t* setting = &g_settings[g_num_settings];
+    const char* colon = strchr(arg, ':');
+    const char* equals = colon ? strchr(colon + 1, '=') : NULL;
+    if (!colon || colon == arg || (size_t)(colon - arg) >= sizeof(setting->target) ||
+        !equals || equals == colon + 1 || (size_t)(equals - colon - 1) >= sizeof(setting->key)) {
+        fprintf(stderr, "Invalid --set, expected <stage>:<key>=<value>: %s\n", arg);
+        return -1;
+    }
+    memcpy(setting->target, arg, colon - arg);
+    setting->target[colon - arg] = '\0';
+    memcpy(setting->key, colon + 1, equals - colon - 1);
+    setting->key[equals - colon - 1] = '\0';
+    setting->value = equals + 1;
+    g_num_settings++;
+    return 0;
+}
+
+// Parse <stage>:<n> into the next stage rule
+static int parse_stage_rule(const char* arg, stage_knob_t knob) {
+    if (g_num_stage_rules == MAX_STAGE_RULES) {
+        fprintf(stderr, "At most %d --capacity, --batch and --workers options are supported\n", MAX_STAGE_RULES);
+        return -1;
+    }
+    stage_rule_t* rule = &g_stage_rules[g_num_stage_rules];
+    const char* colon = strrchr(arg, ':');
+    char* end = NULL;
+    long value = colon ? strtol(colon + 1, &end, 10) : 0;
+    if (!colon || colon == arg || (size_t)(colon - arg) >= sizeof(rule->target) || end == colon + 1 ||
+        *end != '\0' || value <= 0 || value > 1 << 30) {
+        fprintf(stderr, "Invalid --%s, expected <stage>:<n>: %s\n", g_knob_names[knob], arg);
+        return -1;
+    }
+    memcpy(rule->target, arg, colon - arg);
+    rule->target[colon - arg] = '\0';
+    rule->knob = knob;
+    rule->value = (int)value;
+    g_num_stage_rules++;
+    return 0;
+}
+
+// Parse <weight>:<match> into the next lane rule
+static int parse_lane(const char* arg) {
+    if (g_num_lanes == CP_MAX_LANES) {
+        fprintf(stderr, "At most %d --lane options are supported\n", CP_MAX_LANES - 1);
+        return -1;
+    }
+    int weight = 0;
+    int consumed = 0;
+    if (sscanf(arg, "%d:%n", &weight, &consumed) != 1 || consumed == 0 || weight <= 0 || arg[consumed] == '\0') {
+        fprintf(stderr, "Invalid --lane, expected <weight>:<match>: %s\n", arg);
+        return -1;
+    }
+    lane_rule_t* rule = &g_lane_rules[g_num_lanes - 1];
+    rule->spec = arg + consumed;
+    rule->field = 0;
+    rule->value = rule->spec;
+    int field = 0;
+    int value_at = 0;
+    if (sscanf(rule->spec, "#%d=%n", &field, &value_at) == 1 && value_at > 0 && field > 0) {
+        rule->field = field;
+        rule->value = rule->spec + value_at;
+    }
+    rule->length = strlen(rule->value);
+    g_lane_weights[g_num_lanes] = weight;
+    metrics_name_lane(g_num_lanes, rule->spec);
+    g_num_lanes++;
+    return 0;
+}
+
+static int parse_options(int argc, char** argv) {
+    static const struct option long_options[] = {
+        {"autosize", required_argument, NULL, 'a'},
+        {"autosize-interval", required_argument, NULL, 'I'},
+        {"checkpoint", required_argument, NULL, 'c'},
+        {"checkpoint-interval", required_argument, NULL, 'C'},
+        {"resume", no_argument, NULL, 'r'},
+        {"framed-input", no_argument, NULL, 'f'},
+        {"framed-output", no_argument, NULL, 'F'},
+        {"frame-checksum", required_argument, NULL, 'k'},
+        {"output", required_argument, NULL, 'o'},
+        {"compress", required_argument, NULL, 'z'},
+        {"compress-threads", required_argument, NULL, 'Z'},
+        {"trace", required_argument, NULL, 't'},
+        {"trace-sample", required_argument, NULL, 'T'},
+        {"shutdown", required_argument, NULL, 's'},
+        {"cache", required_argument, NULL, 'm'},
+        {"lane", required_argument, NULL, 'l'},
+        {"lane-weight", required_argument, NULL, 'L'},
+        {"control", required_argument, NULL, 'x'},
+        {"send", required_argument, NULL, 'X'},
+        {"offline", no_argument, NULL, 'O'},
+        {"rate-limit", required_argument, NULL, 'R'},
+        {"offline-threads", required_argument, NULL, 'W'},
+        {"huge-pages", required_argument, NULL, 'G'},
+        {"set", required_argument, NULL, 'S'},
+        {"spill", required_argument, NULL, 'D'},
+        {"input", required_argument, NULL, 'i'},
+        {"input-threads", required_argument, NULL, 'J'},
+        {"input-order", required_argument, NULL, 'P'},
+        {"capacity", required_argument, NULL, 'q'},
+        {"batch", required_argument, NULL, 'b'},
+        {"workers", required_argument, NULL, 'w'},
+        {"autotune", required_argument, NULL, 'A'},
+        {"sink", required_argument, NULL, 'K'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    // Leading '+' stops at the first non-option so plugin names are never permuted
+    while ((opt = getopt_long(argc, argv, "+h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'a':
+                if (sscanf(optarg, "%d:%d", &g_controller_config.min_capacity,
+                           &g_controller_config.max_capacity) != 2 ||
+                    g_controller_config.min_capacity <= 0 ||
+                    g_controller_config.max_capacity < g_controller_config.min_capacity) {
+                    fprintf(stderr, "Invalid --autosize bounds: %s\n", optarg);
+                    return -1;
+                }
+                g_autosize = 1;
+                break;
+            case 'I':
+                g_controller_config.interval_ms = atoi(optarg);
+                if (g_controller_config.interval_ms <= 0) {
+                    fprintf(stderr, "Autosize interval must be greater than 0\n");
+                    return -1;
+                }
+                break;
+            case 'c':
+                g_checkpoint_path = optarg;
+                break;
+            case 'C':
+                g_checkpoint_interval_ms = atoi(optarg);
+                if (g_checkpoint_interval_ms <= 0) {
+                    fprintf(stderr, "Checkpoint interval must be greater than 0\n");
+                    return -1;
+                }
+                break;
+            case 'r':
+                g_resume = 1;
+                break;
+            case 'f':
+                g_framed_input = 1;
+                break;
+            case 'F':
+                g_framed_output = 1;
+                break;
+            case 'k':
+                g_frame_checksum_every = atoi(optarg);
+                if (g_frame_checksum_every <= 0) {
+                    fprintf(stderr, "Frame checksum interval must be greater than 0\n");
+                    return -1;
+                }
+                break;
+            case 'o':
+                g_output_path = optarg;
+                break;
+            case 'z': {
+                const char* err = compress_codec_from_name(optarg, &g_output_codec);
+                if (err) {
+                    fprintf(stderr, "%s: %s\n", err, optarg);
+                    return -1;
+                }
+                g_output_codec_set = 1;
+                break;
+            }
+            case 'Z':
+                g_compress_threads = atoi(optarg);
+                if (g_compress_threads <= 0) {
+                    fprintf(stderr, "Compression threads must be greater than 0\n");
+                    return -1;
+                }
+                break;
+            case 't':
+                g_trace_path = optarg;
+                break;
+            case 'T':
+                g_trace_sample_every = atoi(optarg);
+                if (g_trace_sample_every <= 0) {
+                    fprintf(stderr, "Trace sample rate must be greater than 0\n");
+                    return -1;
+                }
+                break;
+            case 'm':
+                g_cache_entries = atoi(optarg);
+                if (g_cache_entries <= 0) {
+                    fprintf(stderr, "Cache size must be greater than 0\n");
+                    return -1;
+                }
+                break;
+            case 'l':
+                if (parse_lane(optarg) != 0) return -1;
+                break;
+            case 'L':
+                g_lane_weights[0] = atoi(optarg);
+                if (g_lane_weights[0] <= 0) {
+                    fprintf(stderr, "Lane weight must be greater than 0\n");
+                    return -1;
+                }
+                break;
+            case 'x':
+                g_control_path = optarg;
+                break;
+            case 'X':
+                g_send_path = optarg;
+                break;
+            case 'O':
+                g_offline = 1;
+                break;
+            case 'R':
+                if (parse_rate_limit(optarg) != 0) return -1;
+                break;
+            case 'W':
+                g_offline_threads = atoi(optarg);
+                if (g_offline_threads <= 0) {
+                    fprintf(stderr, "Offline threads must be greater than 0\n");
+                    return -1;
+                }
+                break;
+            case 'S':
+                if (parse_setting(optarg) != 0) return -1;
+                break;
+            case 'G':
+                if (strcmp(optarg, "off") == 0) {
+                    g_huge_pages = HUGE_PAGES_OFF;
+                } else if (strcmp(optarg, "transparent") == 0) {
+                    g_huge_pages = HUGE_PAGES_TRANSPARENT;
+                } else if (strcmp(optarg, "explicit") == 0) {
+                    g_huge_pages = HUGE_PAGES_EXPLICIT;
+                } else {
+                    fprintf(stderr, "Invalid --huge-pages mode: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'D':
+                g_spill_dir = optarg;
+                break;
+            case 'i': {
+                const char* err = ingest_add(optarg);
+                if (err) {
+                    fprintf(stderr, "%s: %s\n", err, optarg);
+                    return -1;
+                }
+                break;
+            }
+            case 'J':
+                g_input_threads = atoi(optarg);
+                if (g_input_threads <= 0) {
+                    fprintf(stderr, "Input threads must be greater than 0\n");
+                    return -1;
+                }
+                break;
+            case 'P':
+                if (strcmp(optarg, "ordered") == 0) {
+                    g_input_order = INGEST_ORDERED;
+                } else if (strcmp(optarg, "unordered") == 0) {
+                    g_input_order = INGEST_UNORDERED;
+                } else {
+                    fprintf(stderr, "Invalid --input-order mode: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'q':
+                if (parse_stage_rule(optarg, STAGE_CAPACITY) != 0) return -1;
+                break;
+            case 'b':
+                if (parse_stage_rule(optarg, STAGE_BATCH) != 0) return -1;
+                break;
+            case 'w':
+                if (parse_stage_rule(optarg, STAGE_WORKERS) != 0) return -1;
+                break;
+            case 'A':
+                g_autotune_lines = atoll(optarg);
+                if (g_autotune_lines <= 0) {
+                    fprintf(stderr, "Autotune sample must be greater than 0 lines\n");
+                    return -1;
+                }
+                break;
+            case 'K': {
+                const char* err = sink_add(optarg);
+                if (err) {
+                    fprintf(stderr, "Invalid --sink, %s: %s\n", err, optarg);
+                    return -1;
+                }
+                break;
+            }
+            case 's':
+                if (strcmp(optarg, "drain") == 0) {
+                    g_shutdown_mode = SHUTDOWN_DRAIN;
+                } else if (strcmp(optarg, "abort") == 0) {
+                    g_shutdown_mode = SHUTDOWN_ABORT;
+                } else if (sscanf(optarg, "deadline:%ld", &g_shutdown_deadline_ms) == 1 && g_shutdown_deadline_ms > 0) {
+                    g_shutdown_mode = SHUTDOWN_DEADLINE;
+                } else {
+                    fprintf(stderr, "Invalid --shutdown mode: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            default:
+                return -1;
+        }
+    }
+    if (g_resume && !g_checkpoint_path) {
+        fprintf(stderr, "--resume requires --checkpoint\n");
+        return -1;
+    }
+    if (ingest_file_count() > 0 && g_checkpoint_path) {
+        // A checkpoint is one offset into one stream
+        fprintf(stderr, "--input cannot be combined with --checkpoint\n");
+        return -1;
+    }
+    if (g_num_lanes > 1 && g_checkpoint_path) {
+        // Lanes overtake each other, so no single input offset marks what was committed
+        fprintf(stderr, "--lane cannot be combined with --checkpoint\n");
+        return -1;
+    }
+    if (g_offline && (g_checkpoint_path || g_trace_path || g_control_path || g_autosize ||
+                      g_cache_entries || g_num_lanes > 1 || g_num_rate_rules > 0 || g_spill_dir ||
+                      g_num_stage_rules > 0 || g_autotune_lines > 0)) {
+        // These act on queued lines, and an offline run queues nothing
+        fprintf(stderr, "--offline cannot be combined with --checkpoint, --trace, --control, "
+                        "--autosize, --cache, --lane, --rate-limit, --spill, --capacity, --batch, "
+                        "--workers or --autotune\n");
+        return -1;
+    }
+    if (g_autotune_lines > 0 && g_autosize) {
+        // Both size the queues; the resize controller would undo the calibration
+        fprintf(stderr, "--autotune cannot be combined with --autosize\n");
+        return -1;
+    }
+    return optind;
 }
+
 int main(int argc, char** argv) {
-    if (argc < 3) {
+    int first_arg = parse_options(argc, argv);
+    if (first_arg >= 0 && g_send_path && first_arg < argc) {
+        char command[1024] = "";
+        for (int i = first_arg; i < argc; i++) {
+            if (i > first_arg) strncat(command, " ", sizeof(command) - strlen(command) - 1);
+            strncat(command, argv[i], sizeof(command) - strlen(command) - 1);
+        }
+        return control_send(g_send_path, command);
+    }
+    if (first_arg < 0 || argc - first_arg < 2) {
         print_help();
         return 1;
     }
-    g_queue_size = atoi(argv[1]);
+    g_queue_size = atoi(argv[first_arg]);
     if (g_queue_size <= 0) {
         fprintf(stderr, "Queue size must be greater than 0\n");
         print_help();
         return 1;
     }
-    g_num_plugins = argc - 2;
+    if (g_autosize) {
+        if (g_queue_size < g_controller_config.min_capacity) g_queue_size = g_controller_config.min_capacity;
+        if (g_queue_size > g_controller_config.max_capacity) g_queue_size = g_controller_config.max_capacity;
+    }
+    g_num_plugins = argc - first_arg - 1;
     if (g_num_plugins <= 0) {
         fprintf(stderr, "At least one plugin is required\n");
         print_help();
         return 1;
     }
+    // Every thread started from here on inherits the blocked mask; the main thread
+    // unblocks the signals once it reads input, so they interrupt that read
+    sigset_t cancel_signals;
+    sigemptyset(&cancel_signals);
+    sigaddset(&cancel_signals, SIGINT);
+    sigaddset(&cancel_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &cancel_signals, NULL);
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_cancel_signal; // No SA_RESTART: a pending read returns EINTR
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
     g_plugin_handles = (plugin_handle_t*)malloc(g_num_plugins * sizeof(plugin_handle_t));
     if (!g_plugin_handles) {
         fprintf(stderr, "Failed to allocate memory for plugin handles\n");
@@ -173,8 +1486,88 @@ int main(int argc, char** argv) {
         return 1;
     }
 
-    init_plugins(argv);
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (g_compress_threads == 0) g_compress_threads = cpus > 0 ? (int)cpus : 1;
+    if (g_input_threads == 0) g_input_threads = cpus > 0 ? (int)cpus : 1;
+    if (g_offline_threads == 0) g_offline_threads = cpus > 0 ? (int)cpus : 1;
+    g_cpus = cpus > 0 ? (int)cpus : 1;
+    if (open_output() != 0) {
+        free(g_plugin_handles);
+        return 1;
+    }
+
+    init_plugins(argv + first_arg + 1);
+    // Writer threads take no cancel signals: they are still blocked here
+    const char* sink_err = sink_start(g_spill_dir);
+    if (sink_err) {
+        fprintf(stderr, "Failed to start sinks: %s\n", sink_err);
+        if (g_offline) {
+            release_pipeline();
+        } else {
+            shutdown_pipeline();
+        }
+        return 1;
+    }
+    if (g_offline) return run_offline(&cancel_signals);
     attach_plugins();
+    enable_caches();
+    if (start_rate_limits() != 0 || start_stage_rules() != 0) {
+        shutdown_pipeline();
+        return 1;
+    }
+    if ((g_output || sink_count() > 0 || g_num_lanes > 1) && !g_use_records) {
+        fprintf(stderr, "Analyzer output and lanes need plugins that export plugin_attach_record\n");
+        shutdown_pipeline();
+        return 1;
+    }
+
+    // The socket is up before the first input byte, so an idle pipeline can already be inspected
+    if (g_control_path) {
+        metrics_start();
+        const char* err = control_start(g_control_path, handle_command);
+        if (err) fprintf(stderr, "Failed to open control socket: %s\n", err);
+    }
+
+    // Input is only touched once the plugins loaded, so a bad plugin name never waits on stdin
+    pthread_sigmask(SIG_UNBLOCK, &cancel_signals, NULL);
+    const char* input_err =
+        ingest_file_count() > 0 ? NULL : compress_open_input(stdin, g_compress_threads, &g_input);
+    if (input_err) {
+        fprintf(stderr, "Failed to open input: %s\n", input_err);
+        shutdown_pipeline();
+        return 1;
+    }
+    if (g_resume) {
+        long long offset = checkpoint_load(g_checkpoint_path);
+        if (offset < 0) {
+            fprintf(stderr, "No checkpoint found in %s, starting from the beginning\n", g_checkpoint_path);
+        } else if (skip_input(offset) != 0) {
+            fprintf(stderr, "Input is shorter than checkpoint offset %lld\n", offset);
+            compress_close_input();
+            shutdown_pipeline();
+            return 1;
+        } else {
+            g_input_offset = offset;
+        }
+    }
+    // Helper threads started here take no cancel signals either
+    pthread_sigmask(SIG_BLOCK, &cancel_signals, NULL);
+    start_tracing();
+    if (g_checkpoint_path) {
+        const char* err = g_use_records
+                              ? checkpoint_start(g_checkpoint_path, g_checkpoint_interval_ms, g_input_offset, sync_output)
+                              : "plugins do not carry record metadata";
+        if (err) fprintf(stderr, "Failed to start checkpointing: %s\n", err);
+    }
+    if (g_autosize) {
+        const char* err = queue_controller_start(&g_controller_config);
+        if (err) fprintf(stderr, "Failed to start queue controller: %s\n", err);
+    }
+    if (g_autotune_lines > 0) {
+        const char* err = autotune_start();
+        if (err) fprintf(stderr, "Failed to start autotune: %s\n", err);
+    }
+    pthread_sigmask(SIG_UNBLOCK, &cancel_signals, NULL);
     if (read_input() != 0) {
         shutdown_pipeline();
         return 1;
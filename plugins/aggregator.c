@@ -0,0 +1,200 @@
+#include "plugin_common.h"
+#include "plugin_sdk.h"
+#include "sync/window_summary.h"
+#include <stdio.h>
+#include <ctype.h>
+#include <time.h>
+
+#define AGG_MAX_PANES 64 // Most slides a sliding window spans
+#define AGG_MAX_TOP 32
+#define AGG_FLUSH_MAX_MS 100 // Time windows close at most this late while no line arrives
+
+/*
+ * A window is cut into panes of one slide each; a tumbling window is a single pane.
+ * Each pane summarizes its own lines, and at every slide boundary the panes of
+ * the window are merged into one summary line. Memory is fixed by the options:
+ * panes times the monitored keys, whatever the input.
+ */
+typedef struct {
+    int key_field; // 1-based whitespace-separated field used as key, 0 for the whole line
+    long window; // Window length, in lines or milliseconds
+    long slide; // Distance between two windows, same unit as window
+    int by_time; // Window and slide are milliseconds rather than lines
+    int top; // Heaviest keys reported per window
+    int keys; // Keys monitored per pane
+} agg_options_t;
+
+static agg_options_t g_options = { 0, 1000, 0, 0, 5, 256 };
+static window_summary_t g_panes[AGG_MAX_PANES];
+static window_summary_t g_merged; // Scratch summary of a sliding window
+static int g_num_panes = 0; // 0 until plugin_init sets the panes up
+static int g_current = 0; // Pane receiving lines
+static long long g_pane_index = 0; // Windows closed so far, numbers the next summary
+static long long g_pane_start = 0; // Time or line count where the current pane began
+static unsigned long long g_unreported = 0; // Lines counted since the last summary
+
+static long long now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+// Key of a line: the configured field, or the whole line
+static const char* line_key(const char* line, size_t* len) {
+    if (g_options.key_field == 0) {
+        *len = strlen(line);
+        return line;
+    }
+    const char* p = line;
+    for (int field = 1;; field++) {
+        while (*p && isspace((unsigned char)*p)) p++;
+        const char* start = p;
+        while (*p && !isspace((unsigned char)*p)) p++;
+        if (field == g_options.key_field || !*p) {
+            *len = field == g_options.key_field ? (size_t)(p - start) : 0;
+            return start;
+        }
+    }
+}
+
+static const char* setup_panes(void) {
+    if (g_options.slide == 0) g_options.slide = g_options.window;
+    g_num_panes = (int)(g_options.window / g_options.slide);
+    for (int i = 0; i < g_num_panes; i++) {
+        const char* err = window_summary_init(&g_panes[i], g_options.keys);
+        if (err) return err;
+    }
+    if (g_num_panes > 1) return window_summary_init(&g_merged, g_options.keys);
+    return NULL;
+}
+
+// Emit one summary line for the window that ends with the current pane
+static void report_window(void) {
+    const window_summary_t* window = &g_panes[g_current];
+    if (g_num_panes > 1) {
+        window_summary_reset(&g_merged);
+        for (int i = 0; i < g_num_panes; i++) window_summary_merge(&g_merged, &g_panes[i]);
+        window = &g_merged;
+    }
+    if (window->lines == 0) return;
+    const summary_counter_t* top[AGG_MAX_TOP];
+    int found = window_summary_top(window, top, g_options.top);
+    char line[128 + AGG_MAX_TOP * (SUMMARY_KEY_MAX + 24)];
+    int used = snprintf(line, sizeof(line), "window=%lld lines=%llu distinct=%.0f top=", g_pane_index,
+                        window->lines, window_summary_distinct(window));
+    for (int i = 0; i < found; i++) {
+        used += snprintf(line + used, sizeof(line) - used, "%s%s:%llu", i ? "," : "", top[i]->key, top[i]->count);
+    }
+    plugin_emit(line);
+    g_unreported = 0;
+}
+
+// Close the current pane: report its window and start the next pane empty
+static void close_pane(void) {
+    report_window();
+    g_pane_index++;
+    g_current = (g_current + 1) % g_num_panes;
+    window_summary_reset(&g_panes[g_current]);
+}
+
+// Close every time pane that ended before now; after a long idle gap the old panes are just emptied
+static void advance_time(long long now) {
+    long long elapsed = (now - g_pane_start) / g_options.slide;
+    if (elapsed <= 0) return;
+    for (long long i = 0; i < elapsed; i++) {
+        if (g_unreported == 0 && i >= g_num_panes) {
+            // Every pane is empty already; skip to the pane that holds now
+            g_pane_index += elapsed - i;
+            break;
+        }
+        close_pane();
+    }
+    g_pane_start += elapsed * g_options.slide;
+}
+
+const char* plugin_transform(const char* input) {
+    if (!input) {
+        return NULL;
+    }
+    if (g_options.by_time) advance_time(now_ms());
+    size_t len;
+    const char* key = line_key(input, &len);
+    window_summary_add(&g_panes[g_current], key, len);
+    g_unreported++;
+    if (!g_options.by_time && ++g_pane_start == g_options.slide) {
+        close_pane();
+        g_pane_start = 0;
+    }
+    // Input lines are consumed; only the summaries go on
+    return PLUGIN_DROP;
+}
+
+void plugin_flush(int final) {
+    if (g_num_panes == 0) return;
+    if (g_options.by_time) advance_time(now_ms());
+    // The last window is reported even though it is cut short
+    if (final && g_unreported > 0) report_window();
+}
+
+long plugin_flush_interval_ms(void) {
+    if (!g_options.by_time) return 0;
+    long interval = g_options.slide / 10;
+    if (interval < 1) interval = 1;
+    return interval < AGG_FLUSH_MAX_MS ? interval : AGG_FLUSH_MAX_MS;
+}
+
+static int parse_positive(const char* value, long* out) {
+    char* end;
+    long parsed = strtol(value, &end, 10);
+    if (*value == '\0' || *end != '\0' || parsed <= 0) return -1;
+    *out = parsed;
+    return 0;
+}
+
+const char* plugin_configure(const char* key, const char* value) {
+    long parsed;
+    if (g_num_panes > 0) return "Options must be set before the stage starts";
+    if (strcmp(key, "key") == 0) {
+        char* end;
+        parsed = strtol(value, &end, 10);
+        if (*value == '\0' || *end != '\0' || parsed < 0) return "key must be a field number, 0 for the whole line";
+        g_options.key_field = (int)parsed;
+    } else if (strcmp(key, "window") == 0 || strcmp(key, "window-ms") == 0) {
+        if (parse_positive(value, &parsed) != 0) return "window must be greater than 0";
+        g_options.window = parsed;
+        g_options.by_time = strcmp(key, "window-ms") == 0;
+    } else if (strcmp(key, "slide") == 0 || strcmp(key, "slide-ms") == 0) {
+        if (parse_positive(value, &parsed) != 0) return "slide must be greater than 0";
+        g_options.slide = parsed;
+    } else if (strcmp(key, "top") == 0) {
+        if (parse_positive(value, &parsed) != 0 || parsed > AGG_MAX_TOP) return "top must be between 1 and 32";
+        g_options.top = (int)parsed;
+    } else if (strcmp(key, "keys") == 0) {
+        if (parse_positive(value, &parsed) != 0 || parsed > 1 << 20) return "keys must be between 1 and 1048576";
+        g_options.keys = (int)parsed;
+    } else {
+        return "Unknown option, expected key, window, window-ms, slide, slide-ms, top or keys";
+    }
+    return NULL;
+}
+
+__attribute__((destructor)) static void free_panes(void) {
+    for (int i = 0; i < g_num_panes; i++) window_summary_destroy(&g_panes[i]);
+    if (g_num_panes > 1) window_summary_destroy(&g_merged);
+}
+
+const char* plugin_init(int queue_size) {
+    // Options arrive one at a time, so window and slide are checked together here
+    long slide = g_options.slide ? g_options.slide : g_options.window;
+    if (g_options.window % slide != 0 || g_options.window / slide > AGG_MAX_PANES) {
+        return "window must be a multiple of slide, at most 64 slides long";
+    }
+    const char* err = setup_panes();
+    if (err) return err;
+    g_pane_start = g_options.by_time ? now_ms() : 0;
+    return common_plugin_init(plugin_transform, "aggregator", queue_size);
+}
+
+const char* get_plugin_name(void) {
+    return "aggregator";
+}
@@ -8,15 +8,17 @@ const char* plugin_transform(const char* input) {
         return NULL;
     }
     
-    char* output = malloc(strlen(input) * 2 + 1);
+    size_t len = strlen(input);
+    char* output = plugin_output_buffer(len * 2 + 1);
     if (!output) {
         return "Could not allocate memory for output";
     }
-    for (int i = 0; i < strlen(input); i++) {
+    for (size_t i = 0; i < len; i++) {
         output[i * 2] = input[i];
         output[i * 2 + 1] = ' ';
     }
-    output[strlen(input) * 2 - 1] = '\0';
+    // The last separator is dropped; an empty line stays empty
+    output[len > 0 ? len * 2 - 1 : 0] = '\0';
     return output;
 }
 
@@ -28,3 +30,8 @@ const char* get_plugin_name(void) {
     return "expander";
 }
 
+// Output depends only on the input bytes, so the analyzer may cache it
+int plugin_is_stateless(void) {
+    return 1;
+}
+
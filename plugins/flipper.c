@@ -9,21 +9,52 @@ const char* plugin_transform(const char* input) {
         return NULL;
     }
     
-    // Allocate memory for the output string
-    char* output = malloc(strlen(input) + 1);
+    size_t len = strlen(input);
+    char* output = plugin_in_place(input);
+    if (output) {
+        // Swap from both ends, so each character is read before it is overwritten
+        for (size_t i = 0; i < len / 2; i++) {
+            char c = output[i];
+            output[i] = output[len - i - 1];
+            output[len - i - 1] = c;
+        }
+        return output;
+    }
+    
+    output = plugin_output_buffer(len + 1);
     if (!output) {
         return NULL;
     }
-    
-    // Convert each character to uppercase
-    for (int i = 0; input[i] != '\0'; i++) {
-        output[i] = input[strlen(input) - i - 1];
+    for (size_t i = 0; i < len; i++) {
+        output[i] = input[len - i - 1];
     }
-    output[strlen(input)] = '\0';
+    output[len] = '\0';
     
     return output;
 }
 
+const char* plugin_transform_batch(const char* lines, const size_t* offsets, int count,
+                                   char* output, size_t output_size, size_t* output_offsets) {
+    if (output_size < offsets[count]) {
+        return "Output buffer too small";
+    }
+    
+    // Each result takes the place of its line, so offsets carry over unchanged
+    for (int i = 0; i < count; i++) {
+        const char* input = lines + offsets[i];
+        char* result = output + offsets[i];
+        size_t len = offsets[i + 1] - offsets[i] - 1;
+        for (size_t j = 0; j < len; j++) {
+            result[j] = input[len - j - 1];
+        }
+        result[len] = '\0';
+        output_offsets[i] = offsets[i];
+    }
+    output_offsets[count] = offsets[count];
+    
+    return NULL;
+}
+
 const char* plugin_init(int queue_size) {
     return common_plugin_init(plugin_transform, "flipper", queue_size);
 }
@@ -32,3 +63,8 @@ const char* get_plugin_name(void) {
     return "flipper";
 }
 
+// Output depends only on the input bytes, so the analyzer may cache it
+int plugin_is_stateless(void) {
+    return 1;
+}
+
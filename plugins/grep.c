@@ -0,0 +1,166 @@
+#include "plugin_common.h"
+#include "plugin_sdk.h"
+#include <stdint.h>
+#include <regex.h>
+
+#define GREP_MAX_PATTERNS 64
+#define GREP_VECTOR_BYTES 16
+#define GREP_VECTOR_FIRST_BYTES 8 // Beyond this many distinct first bytes, a table lookup per byte is cheaper
+
+typedef unsigned char byte_vector_t __attribute__((vector_size(GREP_VECTOR_BYTES)));
+
+typedef struct {
+    char* text;
+    size_t length;
+} grep_pattern_t;
+
+// Set by plugin_configure before any line is seen, read-only afterwards
+static grep_pattern_t g_patterns[GREP_MAX_PATTERNS]; // Sorted by first byte
+static int g_num_patterns = 0;
+static unsigned char g_bucket_start[256]; // First pattern starting with each byte
+static unsigned char g_bucket_count[256]; // Patterns starting with each byte, 0 for most bytes
+static byte_vector_t g_first_vectors[GREP_VECTOR_FIRST_BYTES]; // Each distinct first byte, splatted
+static int g_num_first_bytes = 0;
+static regex_t g_regex;
+static int g_has_regex = 0;
+static int g_invert = 0;
+
+static int compare_first_byte(const void* a, const void* b) {
+    return (int)(unsigned char)((const grep_pattern_t*)a)->text[0] -
+           (int)(unsigned char)((const grep_pattern_t*)b)->text[0];
+}
+
+// Group the patterns by first byte and rebuild the prefilter
+static void index_patterns(void) {
+    qsort(g_patterns, g_num_patterns, sizeof(grep_pattern_t), compare_first_byte);
+    memset(g_bucket_count, 0, sizeof(g_bucket_count));
+    g_num_first_bytes = 0;
+    for (int i = 0; i < g_num_patterns; i++) {
+        unsigned char first = (unsigned char)g_patterns[i].text[0];
+        if (g_bucket_count[first]++ > 0) continue;
+        g_bucket_start[first] = (unsigned char)i;
+        if (g_num_first_bytes < GREP_VECTOR_FIRST_BYTES) {
+            for (int lane = 0; lane < GREP_VECTOR_BYTES; lane++) g_first_vectors[g_num_first_bytes][lane] = first;
+        }
+        g_num_first_bytes++;
+    }
+}
+
+/*
+ * Offset of the first byte at or after from that starts some pattern, length if none does.
+ * With few distinct first bytes, 16 bytes are compared against all of them at
+ * once (SSE2 or NEON, whichever the target has) and only a chunk with a hit is
+ * scanned byte by byte.
+ */
+static size_t next_candidate(const char* line, size_t from, size_t length) {
+    size_t i = from;
+    if (g_num_first_bytes <= GREP_VECTOR_FIRST_BYTES) {
+        for (; i + GREP_VECTOR_BYTES <= length; i += GREP_VECTOR_BYTES) {
+            byte_vector_t chunk;
+            memcpy(&chunk, line + i, sizeof(chunk));
+            byte_vector_t hits = { 0 };
+            for (int b = 0; b < g_num_first_bytes; b++) hits |= (byte_vector_t)(chunk == g_first_vectors[b]);
+            uint64_t halves[2];
+            memcpy(halves, &hits, sizeof(halves));
+            if (halves[0] | halves[1]) break;
+        }
+    }
+    for (; i < length; i++) {
+        if (g_bucket_count[(unsigned char)line[i]]) return i;
+    }
+    return length;
+}
+
+static int matches_pattern(const char* line, size_t length) {
+    for (size_t i = next_candidate(line, 0, length); i < length; i = next_candidate(line, i + 1, length)) {
+        unsigned char first = (unsigned char)line[i];
+        const grep_pattern_t* pattern = &g_patterns[g_bucket_start[first]];
+        for (int p = 0; p < g_bucket_count[first]; p++, pattern++) {
+            if (pattern->length <= length - i && memcmp(line + i + 1, pattern->text + 1, pattern->length - 1) == 0) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Kept when it contains any pattern or matches the regex; everything is kept without either
+static int keep_line(const char* line, size_t length) {
+    if (g_num_patterns == 0 && !g_has_regex) return 1;
+    int matched = g_num_patterns > 0 && matches_pattern(line, length);
+    if (!matched && g_has_regex) matched = regexec(&g_regex, line, 0, NULL, 0) == 0;
+    return matched != g_invert;
+}
+
+const char* plugin_transform(const char* input) {
+    if (!input) {
+        return NULL;
+    }
+    return keep_line(input, strlen(input)) ? input : PLUGIN_DROP;
+}
+
+const char* plugin_transform_batch(const char* lines, const size_t* offsets, int count,
+                                   char* output, size_t output_size, size_t* output_offsets) {
+    if (output_size < offsets[count]) {
+        return "Output buffer too small";
+    }
+
+    // Kept lines are copied back to back; dropped ones take no room
+    size_t used = 0;
+    for (int i = 0; i < count; i++) {
+        size_t length = offsets[i + 1] - offsets[i];
+        if (!keep_line(lines + offsets[i], length - 1)) {
+            output_offsets[i] = PLUGIN_DROP_OFFSET;
+            continue;
+        }
+        memcpy(output + used, lines + offsets[i], length);
+        output_offsets[i] = used;
+        used += length;
+    }
+    output_offsets[count] = used;
+
+    return NULL;
+}
+
+const char* plugin_configure(const char* key, const char* value) {
+    if (strcmp(key, "pattern") == 0) {
+        if (value[0] == '\0') return "Pattern must not be empty";
+        if (g_num_patterns == GREP_MAX_PATTERNS) return "Too many patterns";
+        char* text = strdup(value);
+        if (!text) return "Could not allocate memory for pattern";
+        g_patterns[g_num_patterns].text = text;
+        g_patterns[g_num_patterns].length = strlen(text);
+        g_num_patterns++;
+        index_patterns();
+        return NULL;
+    }
+    if (strcmp(key, "regex") == 0) {
+        if (g_has_regex) return "Only one regex is supported";
+        if (regcomp(&g_regex, value, REG_EXTENDED | REG_NOSUB) != 0) return "Invalid regex";
+        g_has_regex = 1;
+        return NULL;
+    }
+    if (strcmp(key, "invert") == 0) {
+        g_invert = strcmp(value, "0") != 0;
+        return NULL;
+    }
+    return "Unknown option, expected pattern, regex or invert";
+}
+
+__attribute__((destructor)) static void free_patterns(void) {
+    for (int i = 0; i < g_num_patterns; i++) free(g_patterns[i].text);
+    if (g_has_regex) regfree(&g_regex);
+}
+
+const char* plugin_init(int queue_size) {
+    return common_plugin_init(plugin_transform, "grep", queue_size);
+}
+
+const char* get_plugin_name(void) {
+    return "grep";
+}
+
+// Output depends only on the input bytes and the options, so the analyzer may cache it
+int plugin_is_stateless(void) {
+    return 1;
+}
@@ -6,8 +6,11 @@ const char* plugin_transform(const char* input) {
         return NULL;
     }
     
-    printf("[logger] %s\n", input);
-    fflush(stdout);
+    // Verbosity 0 passes lines through without logging them
+    if (plugin_verbosity() > 0) {
+        printf("[logger] %s\n", input);
+        fflush(stdout);
+    }
     return input;
 }
 
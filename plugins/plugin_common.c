@@ -2,21 +2,414 @@
 #include "plugin_common.h"
 #include "plugin_sdk.h"
 #include <unistd.h>
+#include <time.h>
+
+#define DEFERRED_ABORTED 0x80000000u // Set in plugin_context_t.deferred by plugin_abort
+#define TIMER_IDLE_WAIT_MS 100 // Longest sleep between timer checks while lines are held
+
+struct plugin_deferred {
+    char* line;
+    record_meta_t meta;
+};
+
+/*
+ * Where the line being transformed on this thread may put its result: a slot of
+ * the thread's scratch pool, and the input when it may be overwritten. Set
+ * around each transform call, NULL otherwise.
+ */
+typedef struct {
+    scratch_pool_t* pool;
+    int slot;
+    char* writable;
+} line_scope_t;
 
 static plugin_context_t* g_context = NULL;
+static atomic_int g_verbosity = 1;
+static __thread line_scope_t* t_scope = NULL;
+
+int plugin_verbosity(void) {
+    return atomic_load_explicit(&g_verbosity, memory_order_relaxed);
+}
+
+static void count_placed(plugin_context_t* context, const char* err) {
+    if (!err) atomic_fetch_add_explicit(&context->placed, 1, memory_order_relaxed);
+}
+
+// One timestamp pair per batch: every line of the batch is charged the batch's latency
+static void record_latency(plugin_context_t* context, int count, int processed, long long ns) {
+    atomic_fetch_add_explicit(&context->processed, processed, memory_order_relaxed);
+    atomic_fetch_add_explicit(&context->latency_sum_ns, (unsigned long long)ns * count, memory_order_relaxed);
+    atomic_fetch_add_explicit(&context->latency[metrics_latency_bucket(ns)], count, memory_order_relaxed);
+}
+
+// Free a transform result unless it is the input or a scratch buffer
+static void free_result(const scratch_pool_t* pool, int slot, const char* output, const char* input) {
+    if (output != input && !scratch_pool_owns(pool, slot, output)) free((char*)output);
+}
+
+/*
+ * Run the stage's transform, going through the memo cache when it is enabled.
+ * Returns the output and sets *cached to the cache reference backing it, if any.
+ */
+static const char* transform(plugin_context_t* context, const char* input, cache_value_t** cached) {
+    *cached = NULL;
+    if (!context->cache) return context->process_function(input);
+    size_t len = strlen(input);
+    uint64_t hash = stage_cache_hash(input, len);
+    *cached = stage_cache_get(context->cache, input, len, hash);
+    if (*cached) return (*cached)->dropped ? PLUGIN_DROP : (*cached)->data;
+    const char* output = context->process_function(input);
+    if (!output) return NULL;
+    if (output == PLUGIN_DROP) {
+        *cached = stage_cache_put(context->cache, input, len, hash, NULL);
+        return PLUGIN_DROP;
+    }
+    *cached = stage_cache_put(context->cache, input, len, hash, output);
+    if (!*cached) return output;
+    free_result(t_scope->pool, t_scope->slot, output, input);
+    return (*cached)->data;
+}
+
+// Report the spans of one sampled record; no-op for everything else
+static void trace_record(plugin_context_t* context, const record_meta_t* meta, long long dequeue_ns, long long end_ns) {
+    context->trace_span(context->trace_stage, TRACE_SPAN_PUT, meta->trace_id, meta->put_ns, meta->enqueue_ns);
+    context->trace_span(context->trace_stage, TRACE_SPAN_QUEUE, meta->trace_id, meta->enqueue_ns, dequeue_ns);
+    context->trace_span(context->trace_stage, TRACE_SPAN_PROCESS, meta->trace_id, dequeue_ns, end_ns);
+}
+
+static void place_next(plugin_context_t* context, const char* output, const record_meta_t* meta) {
+    if (context->next_place_record != NULL) {
+        context->next_place_record(output, meta);
+    } else if (context->next_place_work != NULL) {
+        context->next_place_work(output);
+    }
+}
+
+// Pass queued lines on untouched to the instance that replaced this one
+static void forward_batch(plugin_context_t* context, char** inputs, const record_meta_t* metas, int count) {
+    for (int i = 0; i < count; i++) {
+        context->forward_to(inputs[i], &metas[i]);
+        free(inputs[i]);
+    }
+}
+
+typedef struct {
+    char* lines; // Packed NUL-terminated input lines
+    size_t lines_size;
+    size_t offsets[PLUGIN_BATCH_MAX + 1];
+    char* output; // Packed NUL-terminated results
+    size_t output_size;
+    size_t output_offsets[PLUGIN_BATCH_MAX + 1];
+    int packed; // The last batch went through plugin_transform_batch, its results are in output
+    const char* results[PLUGIN_BATCH_MAX]; // Otherwise the result of each line, PLUGIN_DROP or PLUGIN_DEFER
+    cache_value_t* cached[PLUGIN_BATCH_MAX]; // Cache references backing those results
+    scratch_pool_t scratch; // Output buffers of the per-line path, slot i for line i
+    unsigned long long allocations; // scratch.allocations already added to the stage's counter
+} batch_buffers_t;
+
+static int reserve(char** buffer, size_t* size, size_t needed) {
+    if (*size >= needed) return 0;
+    char* grown = realloc(*buffer, needed);
+    if (!grown) return -1;
+    *buffer = grown;
+    *size = needed;
+    return 0;
+}
+
+/*
+ * Transform a batch with one plugin_transform_batch call. Returns -1 if the
+ * batch entry point refuses it, so the caller can fall back to the per-line path.
+ */
+static int transform_packed(plugin_context_t* context, char** inputs, const record_meta_t* metas, int count,
+                            batch_buffers_t* buffers) {
+    size_t total = 0;
+    for (int i = 0; i < count; i++) {
+        buffers->offsets[i] = total;
+        total += strlen(inputs[i]) + 1;
+    }
+    buffers->offsets[count] = total;
+    if (reserve(&buffers->lines, &buffers->lines_size, total) != 0 ||
+        reserve(&buffers->output, &buffers->output_size, total * 2) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        memcpy(buffers->lines + buffers->offsets[i], inputs[i], buffers->offsets[i + 1] - buffers->offsets[i]);
+    }
+
+    int traced = 0;
+    for (int i = 0; i < count && context->trace_span; i++) traced |= metas[i].trace_id != 0;
+    long long dequeue_ns = traced ? trace_now_ns() : 0;
+    if (plugin_transform_batch(buffers->lines, buffers->offsets, count, buffers->output,
+                               buffers->output_size, buffers->output_offsets) != NULL) {
+        return -1;
+    }
+    long long end_ns = traced ? trace_now_ns() : 0;
+    for (int i = 0; i < count && traced; i++) {
+        if (metas[i].trace_id) trace_record(context, &metas[i], dequeue_ns, end_ns);
+    }
+    return 0;
+}
+
+/*
+ * Run the transform over a batch without placing anything, in one batch call
+ * when the plugin has one, line by line otherwise. Cached stages skip the
+ * transform for hits, so they stay on the per-line path. track_meta lets the
+ * transform defer its line; only a stage's single consumer thread sets it.
+ */
+static void transform_lines(plugin_context_t* context, char** inputs, const record_meta_t* metas, int count,
+                            batch_buffers_t* buffers, int track_meta) {
+    buffers->packed = count > 1 && plugin_transform_batch && !context->cache &&
+                      transform_packed(context, inputs, metas, count, buffers) == 0;
+    if (buffers->packed) return;
+    line_scope_t scope = { &buffers->scratch, 0, NULL };
+    t_scope = &scope;
+    for (int i = 0; i < count; i++) {
+        // Only sampled records pay for timestamps
+        int traced = metas[i].trace_id != 0 && context->trace_span != NULL;
+        long long dequeue_ns = traced ? trace_now_ns() : 0;
+        scope.slot = i;
+        // The cache still needs the input as its key after the transform
+        scope.writable = context->cache ? NULL : inputs[i];
+        if (track_meta) context->current_meta = &metas[i];
+        buffers->results[i] = transform(context, inputs[i], &buffers->cached[i]);
+        if (track_meta) context->current_meta = NULL;
+        if (traced) trace_record(context, &metas[i], dequeue_ns, trace_now_ns());
+    }
+    t_scope = NULL;
+}
+
+// Pass a transformed batch downstream and free its lines
+static void place_results(plugin_context_t* context, char** inputs, const record_meta_t* metas, int count,
+                          batch_buffers_t* buffers) {
+    int filtered = 0;
+    for (int i = 0; i < count; i++) {
+        if (buffers->packed) {
+            if (buffers->output_offsets[i] == PLUGIN_DROP_OFFSET) {
+                filtered++;
+            } else {
+                place_next(context, buffers->output + buffers->output_offsets[i], &metas[i]);
+            }
+        } else {
+            char* output = (char*)buffers->results[i];
+            if (output == PLUGIN_DROP) {
+                filtered++;
+            } else if (output != PLUGIN_DEFER) {
+                place_next(context, output, &metas[i]);
+                if (!buffers->cached[i]) free_result(&buffers->scratch, i, output, inputs[i]);
+            }
+            stage_cache_release(buffers->cached[i]);
+        }
+        free(inputs[i]);
+    }
+    if (filtered) atomic_fetch_add_explicit(&context->filtered, filtered, memory_order_relaxed);
+    scratch_pool_end_round(&buffers->scratch);
+    if (buffers->scratch.allocations != buffers->allocations) {
+        atomic_fetch_add_explicit(&context->buffer_allocations, buffers->scratch.allocations - buffers->allocations,
+                                  memory_order_relaxed);
+        buffers->allocations = buffers->scratch.allocations;
+    }
+}
+
+// Wait for the rate limit before a batch; bytes are only counted when they are limited
+static void throttle(plugin_context_t* context, char** inputs, int count) {
+    long long bytes = 0;
+    if (context->limiter->bytes_per_sec > 0) {
+        for (int i = 0; i < count; i++) bytes += (long long)strlen(inputs[i]);
+    }
+    token_bucket_take(context->limiter, count, bytes);
+}
+
+// Let a stateful plugin pass on its state; held at batch boundaries like any placement
+static void flush_state(plugin_context_t* context, int final) {
+    pthread_mutex_lock(&context->next_mutex);
+    while (!final && context->pause_count > 0 && !context->forward_to) {
+        pthread_cond_wait(&context->resume_cond, &context->next_mutex);
+    }
+    plugin_flush(final);
+    pthread_mutex_unlock(&context->next_mutex);
+}
+
+static int stage_aborted(plugin_context_t* context) {
+    return (atomic_load_explicit(&context->deferred, memory_order_acquire) & DEFERRED_ABORTED) != 0;
+}
+
+// Fire the timers that are due, at a batch boundary; an abort or a hand-off cuts the pending ones short
+static void run_timers(plugin_context_t* context) {
+    if (!context->timers || timer_wheel_pending(context->timers) == 0) return;
+    pthread_mutex_lock(&context->next_mutex);
+    while (context->pause_count > 0 && !context->forward_to && !stage_aborted(context)) {
+        pthread_cond_wait(&context->resume_cond, &context->next_mutex);
+    }
+    if (context->forward_to || stage_aborted(context)) {
+        // Held lines are released now, ahead of the queued lines the next instance gets
+        timer_wheel_cancel_all(context->timers);
+    } else {
+        timer_wheel_advance(context->timers, trace_now_ns());
+    }
+    pthread_mutex_unlock(&context->next_mutex);
+}
+
+static int holding_full(plugin_context_t* context) {
+    unsigned held = atomic_load_explicit(&context->deferred, memory_order_acquire);
+    return context->defer_limit > 0 && !(held & DEFERRED_ABORTED) && held >= (unsigned)context->defer_limit;
+}
+
+// Sleep until the next timer is due, or until a resume, a hand-off or an abort
+static void wait_for_timer(plugin_context_t* context) {
+    long long wait_ns = TIMER_IDLE_WAIT_MS * 1000000LL;
+    long long due = context->timers ? timer_wheel_next_ns(context->timers) : -1;
+    if (due >= 0 && due - trace_now_ns() < wait_ns) wait_ns = due - trace_now_ns();
+    if (wait_ns <= 0) return;
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += wait_ns / 1000000000LL;
+    deadline.tv_nsec += wait_ns % 1000000000LL;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&context->next_mutex);
+    if (!context->forward_to && !stage_aborted(context)) {
+        pthread_cond_timedwait(&context->resume_cond, &context->next_mutex, &deadline);
+    }
+    pthread_mutex_unlock(&context->next_mutex);
+}
+
+// How long the consumer may wait for lines before a flush or a timer is due, -1 for no limit
+static long wait_ms(plugin_context_t* context, long flush_ms, long long next_flush_ns) {
+    long long due = context->timers ? timer_wheel_next_ns(context->timers) : -1;
+    if (flush_ms > 0 && (due < 0 || next_flush_ns < due)) due = next_flush_ns;
+    if (due < 0) return -1;
+    long long wait_ns = due - trace_now_ns();
+    return wait_ns <= 0 ? 0 : (long)((wait_ns + 999999) / 1000000);
+}
+
+// Wait, holding next_mutex, until the batch with this ticket may be placed
+static void wait_turn(plugin_context_t* context, unsigned long long ticket) {
+    // A handed-off stage keeps forwarding even while paused, so the hand-off can complete
+    while (context->turn != ticket || (context->pause_count > 0 && !context->forward_to)) {
+        pthread_cond_wait(&context->resume_cond, &context->next_mutex);
+    }
+}
+
+static void end_turn(plugin_context_t* context) {
+    context->turn++;
+    pthread_cond_broadcast(&context->resume_cond);
+}
+
+/*
+ * One batch of a stage with several workers. The transform runs outside
+ * next_mutex, so workers transform side by side; batches are placed one at a
+ * time in the order their tickets were drawn, so the stream keeps its order.
+ * A batch drawn after a hand-off is forwarded untransformed. That is decided
+ * with the ticket, so every batch placed directly comes before the first one
+ * forwarded to the new instance.
+ */
+static int run_parallel(plugin_context_t* context, char** inputs, const record_meta_t* metas, int count,
+                        batch_buffers_t* buffers, unsigned long long ticket, int forward) {
+    if (forward) {
+        pthread_mutex_lock(&context->next_mutex);
+        wait_turn(context, ticket);
+        forward_batch(context, inputs, metas, count);
+        end_turn(context);
+        pthread_mutex_unlock(&context->next_mutex);
+        return 0;
+    }
+    long long start_ns = trace_now_ns();
+    transform_lines(context, inputs, metas, count, buffers, 0);
+    atomic_fetch_add_explicit(&context->service_ns, trace_now_ns() - start_ns, memory_order_relaxed);
+    pthread_mutex_lock(&context->next_mutex);
+    wait_turn(context, ticket);
+    place_results(context, inputs, metas, count, buffers);
+    end_turn(context);
+    pthread_mutex_unlock(&context->next_mutex);
+    return count;
+}
+
+// One batch of a single-worker stage: transform and placement both at a batch boundary
+static int run_serial(plugin_context_t* context, char** inputs, record_meta_t* metas, int count,
+                      batch_buffers_t* buffers, unsigned long long ticket) {
+    pthread_mutex_lock(&context->next_mutex);
+    wait_turn(context, ticket);
+    int processed = count;
+    if (context->forward_to) {
+        forward_batch(context, inputs, metas, count);
+        processed = 0;
+    } else {
+        long long start_ns = trace_now_ns();
+        transform_lines(context, inputs, metas, count, buffers, 1);
+        atomic_fetch_add_explicit(&context->service_ns, trace_now_ns() - start_ns, memory_order_relaxed);
+        place_results(context, inputs, metas, count, buffers);
+    }
+    end_turn(context);
+    pthread_mutex_unlock(&context->next_mutex);
+    return processed;
+}
 
 void* plugin_consumer_thread(void* arg) {
     plugin_context_t* context = (plugin_context_t*)arg;
-    char* input;
-    while ((input = consumer_producer_get(context->queue)) != NULL) {
-        char* output = (char*)context->process_function(input);
-        if (context->next_place_work != NULL) {
-            context->next_place_work(output);
+    char* inputs[PLUGIN_BATCH_MAX];
+    record_meta_t metas[PLUGIN_BATCH_MAX];
+    batch_buffers_t buffers;
+    memset(&buffers, 0, sizeof(buffers));
+    scratch_pool_init(&buffers.scratch, PLUGIN_SCRATCH_WATERMARK);
+    // Stateful plugins are woken up to flush even while no line arrives
+    long flush_ms = plugin_flush && plugin_flush_interval_ms ? plugin_flush_interval_ms() : 0;
+    long long next_flush_ns = trace_now_ns() + flush_ms * 1000000LL;
+    for (;;) {
+        run_timers(context);
+        // A stage holding its limit of lines takes no more until a timer releases some
+        if (holding_full(context)) {
+            wait_for_timer(context);
+            continue;
+        }
+        // Workers take batches one at a time, each with the next ticket
+        pthread_mutex_lock(&context->take_mutex);
+        int count = consumer_producer_get_batch_timed(context->queue, inputs, metas,
+                                                      atomic_load_explicit(&context->batch, memory_order_relaxed),
+                                                      wait_ms(context, flush_ms, next_flush_ns));
+        unsigned long long ticket = context->next_ticket;
+        int parallel = atomic_load_explicit(&context->workers, memory_order_relaxed) > 1;
+        int forward = 0;
+        if (count > 0) {
+            context->next_ticket++;
+            forward = atomic_load_explicit(&context->handed_off, memory_order_acquire);
+            // Forwarded lines are throttled by the new instance
+            if (context->limiter && !forward) throttle(context, inputs, count);
         }
-        if (output != input) free(output);
+        pthread_mutex_unlock(&context->take_mutex);
+        if (count == 0) break;
+        if (flush_ms > 0 && trace_now_ns() >= next_flush_ns) {
+            flush_state(context, 0);
+            next_flush_ns = trace_now_ns() + flush_ms * 1000000LL;
+        }
+        if (count < 0) continue;
+        long long start_ns = trace_now_ns();
+        int processed = count;
+        if (parallel) {
+            processed = run_parallel(context, inputs, metas, count, &buffers, ticket, forward);
+        } else {
+            processed = run_serial(context, inputs, metas, count, &buffers, ticket);
+        }
+        record_latency(context, count, processed, trace_now_ns() - start_ns);
+        atomic_fetch_add_explicit(&context->retired, count, memory_order_release);
+    }
+    free(buffers.lines);
+    free(buffers.output);
+    scratch_pool_destroy(&buffers.scratch);
+    // The last worker out finishes the stage
+    pthread_mutex_lock(&context->next_mutex);
+    int last = --context->running == 0;
+    pthread_mutex_unlock(&context->next_mutex);
+    if (!last) return NULL;
+    // The input ended; held lines still get their timed output unless the stage aborts
+    while (context->timers && timer_wheel_pending(context->timers) > 0) {
+        wait_for_timer(context);
+        run_timers(context);
     }
-    free(input);
+    if (plugin_flush) flush_state(context, 1);
     context->finished = 1;
+    monitor_broadcast(&context->done_monitor);
     return NULL;
 }
 
@@ -29,7 +422,8 @@ void log_info(plugin_context_t* context, const char* message) {
 }
 
 const char* common_plugin_init(const char* (*process_function)(const char*), const char* name, int queue_size) {
-    plugin_context_t* context = malloc(sizeof(plugin_context_t));
+    // Aligned, so the cache line groups of the context and its queue start on line boundaries
+    plugin_context_t* context = aligned_alloc(CP_CACHE_LINE, sizeof(plugin_context_t));
     if (!context) {
         return "Could not allocate memory for plugin context";
     }
@@ -38,19 +432,82 @@ const char* common_plugin_init(const char* (*process_function)(const char*), con
     context->initialized = 0;
     context->finished = 0;
     context->consumer_thread = 0;
+    atomic_init(&context->workers, 1);
+    context->running = 1;
+    context->next_ticket = 0;
+    context->turn = 0;
+    atomic_init(&context->batch, plugin_transform_batch ? PLUGIN_BATCH_MAX : 1);
     context->next_place_work = NULL; 
-    context->queue = malloc(sizeof(consumer_producer_t));
+    context->next_place_record = NULL;
+    context->trace_span = NULL;
+    context->trace_stage = 0;
+    context->cache = NULL;
+    context->limiter = NULL;
+    context->forward_to = NULL;
+    atomic_init(&context->handed_off, 0);
+    context->pause_count = 0;
+    atomic_init(&context->placed, 0);
+    atomic_init(&context->retired, 0);
+    atomic_init(&context->processed, 0);
+    atomic_init(&context->filtered, 0);
+    atomic_init(&context->latency_sum_ns, 0);
+    atomic_init(&context->service_ns, 0);
+    atomic_init(&context->buffer_allocations, 0);
+    for (int i = 0; i < METRICS_LATENCY_BUCKETS; i++) atomic_init(&context->latency[i], 0);
+    atomic_init(&context->capacity, queue_size);
+    atomic_init(&context->paused, 0);
+    context->timers = NULL;
+    context->current_meta = NULL;
+    atomic_init(&context->deferred, 0);
+    context->defer_limit = 0;
+    atomic_init(&context->deferred_dropped, 0);
+    if (pthread_mutex_init(&context->next_mutex, NULL) != 0) {
+        free(context);
+        return "Could not initialize plugin mutex";
+    }
+    if (pthread_mutex_init(&context->take_mutex, NULL) != 0) {
+        pthread_mutex_destroy(&context->next_mutex);
+        free(context);
+        return "Could not initialize plugin mutex";
+    }
+    if (pthread_cond_init(&context->resume_cond, NULL) != 0) {
+        pthread_mutex_destroy(&context->take_mutex);
+        pthread_mutex_destroy(&context->next_mutex);
+        free(context);
+        return "Could not initialize plugin condition";
+    }
+    context->queue = aligned_alloc(CP_CACHE_LINE, sizeof(consumer_producer_t));
     if (!context->queue) {
+        pthread_cond_destroy(&context->resume_cond);
+        pthread_mutex_destroy(&context->take_mutex);
+        pthread_mutex_destroy(&context->next_mutex);
         free(context);
         return "Could not allocate memory for plugin queue";
     }
     if (consumer_producer_init(context->queue, queue_size) != NULL) {
         free(context->queue);
+        pthread_cond_destroy(&context->resume_cond);
+        pthread_mutex_destroy(&context->take_mutex);
+        pthread_mutex_destroy(&context->next_mutex);
         free(context);
         return "Could not initialize plugin queue";
     }
+    if (monitor_init(&context->done_monitor) != 0) {
+        consumer_producer_destroy(context->queue);
+        free(context->queue);
+        pthread_cond_destroy(&context->resume_cond);
+        pthread_mutex_destroy(&context->take_mutex);
+        pthread_mutex_destroy(&context->next_mutex);
+        free(context);
+        return "Could not initialize plugin monitor";
+    }
     if (pthread_create(&context->consumer_thread, NULL, plugin_consumer_thread, context) != 0) {
+        monitor_destroy(&context->done_monitor);
+        consumer_producer_destroy(context->queue);
         free(context->queue);
+        pthread_cond_destroy(&context->resume_cond);
+        pthread_mutex_destroy(&context->take_mutex);
+        pthread_mutex_destroy(&context->next_mutex);
         free(context);
         return "Could not create consumer thread";
     }
@@ -68,6 +525,19 @@ __attribute__((visibility("default"))) const char* plugin_fini(void) {
     consumer_producer_destroy(g_context->queue);
     free(g_context->queue);
     g_context->queue = NULL;
+    monitor_destroy(&g_context->done_monitor);
+    pthread_cond_destroy(&g_context->resume_cond);
+    pthread_mutex_destroy(&g_context->take_mutex);
+    pthread_mutex_destroy(&g_context->next_mutex);
+    free(g_context->limiter);
+    if (g_context->timers) {
+        timer_wheel_destroy(g_context->timers);
+        free(g_context->timers);
+    }
+    if (g_context->cache) {
+        stage_cache_destroy(g_context->cache);
+        free(g_context->cache);
+    }
     free(g_context);
     g_context = NULL;
     return NULL;
@@ -85,22 +555,380 @@ __attribute__((visibility("default"))) const char* plugin_place_work(const char*
     // }
     //return NULL;
     const char* err = consumer_producer_put(g_context->queue, str);
+    count_placed(g_context, err);
     return err;
 }
 
 __attribute__((visibility("default"))) void plugin_attach(const char* (*next_place_work)(const char*)) {
+    pthread_mutex_lock(&g_context->next_mutex);
     g_context->next_place_work = next_place_work;
+    pthread_mutex_unlock(&g_context->next_mutex);
+}
+
+__attribute__((visibility("default"))) const char* plugin_place_record(const char* str, const record_meta_t* meta) {
+    if (!g_context) return "Plugin context not initialized";
+    const char* err;
+    if (meta && meta->trace_id) {
+        record_meta_t traced = *meta;
+        traced.put_ns = trace_now_ns();
+        err = consumer_producer_put_meta(g_context->queue, str, &traced);
+    } else {
+        err = consumer_producer_put_meta(g_context->queue, str, meta);
+    }
+    count_placed(g_context, err);
+    return err;
+}
+
+__attribute__((visibility("default"))) void plugin_attach_record(const char* (*next_place_record)(const char*, const record_meta_t*)) {
+    pthread_mutex_lock(&g_context->next_mutex);
+    g_context->next_place_record = next_place_record;
+    pthread_mutex_unlock(&g_context->next_mutex);
+}
+
+__attribute__((visibility("default"))) void plugin_pause(void) {
+    // Taking next_mutex waits for the batch in flight to be placed
+    pthread_mutex_lock(&g_context->next_mutex);
+    g_context->pause_count++;
+    atomic_store_explicit(&g_context->paused, 1, memory_order_relaxed);
+    pthread_mutex_unlock(&g_context->next_mutex);
+}
+
+__attribute__((visibility("default"))) void plugin_resume(void) {
+    pthread_mutex_lock(&g_context->next_mutex);
+    if (g_context->pause_count > 0 && --g_context->pause_count == 0) {
+        atomic_store_explicit(&g_context->paused, 0, memory_order_relaxed);
+        pthread_cond_broadcast(&g_context->resume_cond);
+    }
+    pthread_mutex_unlock(&g_context->next_mutex);
+}
+
+__attribute__((visibility("default"))) const char* plugin_handoff(const char* (*place_record)(const char*, const record_meta_t*)) {
+    if (!g_context) return "Plugin context not initialized";
+    if (!place_record) return "Receiver is NULL";
+    pthread_mutex_lock(&g_context->next_mutex);
+    g_context->forward_to = place_record;
+    atomic_store_explicit(&g_context->handed_off, 1, memory_order_release);
+    pthread_cond_broadcast(&g_context->resume_cond);
+    pthread_mutex_unlock(&g_context->next_mutex);
+    return NULL;
+}
+
+__attribute__((visibility("default"))) void plugin_attach_tracer(trace_span_fn trace_span, int stage) {
+    g_context->trace_stage = stage;
+    g_context->trace_span = trace_span;
+}
+
+// Join every consumer thread of the stage
+static int join_workers(plugin_context_t* context) {
+    int failed = 0;
+    int workers = atomic_load_explicit(&context->workers, memory_order_relaxed);
+    for (int i = 0; i < workers - 1; i++) {
+        if (context->extra_workers[i] && pthread_join(context->extra_workers[i], NULL) != 0) failed = 1;
+        context->extra_workers[i] = 0;
+    }
+    if (context->consumer_thread && pthread_join(context->consumer_thread, NULL) != 0) failed = 1;
+    context->consumer_thread = 0;
+    return failed ? -1 : 0;
 }
 
 __attribute__((visibility("default"))) const char* plugin_wait_finished(void) {
     if (!g_context) return  "Plugin context not initialized";
     consumer_producer_signal_finished(g_context->queue);
-    if (g_context->consumer_thread) {
-        int err = pthread_join(g_context->consumer_thread, NULL);
-        if (err != 0) {
-            return "Could not join consumer thread";
+    if (g_context->consumer_thread && join_workers(g_context) != 0) {
+        return "Could not join consumer thread";
+    }
+    return NULL;
+}
+
+__attribute__((visibility("default"))) int plugin_drain(long timeout_ms) {
+    if (!g_context) return -1;
+    consumer_producer_signal_finished(g_context->queue);
+    if (!g_context->consumer_thread) return 0;
+    // Signaled by the last worker to exit
+    if (monitor_timed_wait(&g_context->done_monitor, timeout_ms) != 0) return -1;
+    join_workers(g_context);
+    return 0;
+}
+
+__attribute__((visibility("default"))) int plugin_abort(void) {
+    if (!g_context) return 0;
+    int discarded = consumer_producer_abort(g_context->queue);
+    atomic_fetch_add_explicit(&g_context->retired, discarded, memory_order_relaxed);
+    // Lines the plugin holds are dropped too; a release after this point discards its line
+    unsigned held = atomic_fetch_or_explicit(&g_context->deferred, DEFERRED_ABORTED, memory_order_acq_rel);
+    if (!(held & DEFERRED_ABORTED)) {
+        atomic_fetch_add_explicit(&g_context->deferred_dropped, held, memory_order_relaxed);
+        discarded += (int)held;
+    }
+    pthread_cond_broadcast(&g_context->resume_cond);
+    return discarded;
+}
+
+__attribute__((visibility("default"))) const char* plugin_enable_cache(int capacity) {
+    if (!g_context) return "Plugin context not initialized";
+    if (!plugin_is_stateless || !plugin_is_stateless()) return "Plugin is not stateless";
+    if (g_context->cache) return "Cache already enabled";
+    stage_cache_t* cache = malloc(sizeof(stage_cache_t));
+    if (!cache) return "Could not allocate memory for cache";
+    const char* err = stage_cache_init(cache, capacity);
+    if (err) {
+        free(cache);
+        return err;
+    }
+    g_context->cache = cache;
+    return NULL;
+}
+
+__attribute__((visibility("default"))) const char* plugin_cache_stats(stage_cache_stats_t* stats) {
+    if (!g_context) return "Plugin context not initialized";
+    if (!stats) return "Stats is NULL";
+    if (!g_context->cache) return "Cache not enabled";
+    stage_cache_stats(g_context->cache, stats);
+    return NULL;
+}
+
+__attribute__((visibility("default"))) const char* plugin_queue_stats(consumer_producer_stats_t* stats, int reset_watermark) {
+    if (!g_context) return "Plugin context not initialized";
+    if (!stats) return "Stats is NULL";
+    consumer_producer_stats(g_context->queue, stats, reset_watermark);
+    stats->dropped += atomic_load_explicit(&g_context->deferred_dropped, memory_order_relaxed);
+    return NULL;
+}
+
+__attribute__((visibility("default"))) const char* plugin_resize_queue(int capacity) {
+    if (!g_context) return "Plugin context not initialized";
+    const char* err = consumer_producer_resize(g_context->queue, capacity);
+    if (!err) atomic_store_explicit(&g_context->capacity, capacity, memory_order_relaxed);
+    return err;
+}
+
+__attribute__((visibility("default"))) const char* plugin_set_huge_pages(int mode) {
+    if (!g_context) return "Plugin context not initialized";
+    return consumer_producer_set_huge_pages(g_context->queue, (huge_pages_t)mode);
+}
+
+__attribute__((visibility("default"))) const char* plugin_set_spill(const char* dir) {
+    if (!g_context) return "Plugin context not initialized";
+    return consumer_producer_set_spill(g_context->queue, dir);
+}
+
+__attribute__((visibility("default"))) const char* plugin_metrics(stage_metrics_t* metrics) {
+    if (!g_context) return "Plugin context not initialized";
+    if (!metrics) return "Metrics is NULL";
+    // Read retired before placed, so a line finishing during the scrape never shows a negative depth
+    metrics->retired = atomic_load_explicit(&g_context->retired, memory_order_acquire);
+    metrics->placed = atomic_load_explicit(&g_context->placed, memory_order_acquire);
+    if (metrics->placed < metrics->retired) metrics->placed = metrics->retired;
+    metrics->processed = atomic_load_explicit(&g_context->processed, memory_order_relaxed);
+    metrics->filtered = atomic_load_explicit(&g_context->filtered, memory_order_relaxed);
+    metrics->latency_sum_ns = atomic_load_explicit(&g_context->latency_sum_ns, memory_order_relaxed);
+    metrics->service_ns = atomic_load_explicit(&g_context->service_ns, memory_order_relaxed);
+    metrics->buffer_allocations = atomic_load_explicit(&g_context->buffer_allocations, memory_order_relaxed);
+    for (int i = 0; i < METRICS_LATENCY_BUCKETS; i++) {
+        metrics->latency[i] = atomic_load_explicit(&g_context->latency[i], memory_order_relaxed);
+    }
+    metrics->capacity = atomic_load_explicit(&g_context->capacity, memory_order_relaxed);
+    metrics->finished = atomic_load_explicit(&g_context->finished, memory_order_relaxed);
+    metrics->paused = atomic_load_explicit(&g_context->paused, memory_order_relaxed);
+    metrics->workers = atomic_load_explicit(&g_context->workers, memory_order_relaxed);
+    metrics->batch = atomic_load_explicit(&g_context->batch, memory_order_relaxed);
+    metrics->throttled_ns = g_context->limiter ? token_bucket_throttled_ns(g_context->limiter) : 0;
+    metrics->spilled = atomic_load_explicit(&g_context->queue->spilled, memory_order_relaxed);
+    metrics->spilled_total = atomic_load_explicit(&g_context->queue->spilled_total, memory_order_relaxed);
+    return NULL;
+}
+
+__attribute__((visibility("default"))) const char* plugin_set_rate_limit(double lines_per_sec, double bytes_per_sec) {
+    if (!g_context) return "Plugin context not initialized";
+    if (g_context->limiter) return "Rate limit already set";
+    token_bucket_t* limiter = malloc(sizeof(token_bucket_t));
+    if (!limiter) return "Could not allocate memory for rate limit";
+    const char* err = token_bucket_init(limiter, lines_per_sec, bytes_per_sec);
+    if (err) {
+        free(limiter);
+        return err;
+    }
+    g_context->limiter = limiter;
+    return NULL;
+}
+
+__attribute__((visibility("default"))) const char* plugin_set_workers(int workers) {
+    if (!g_context) return "Plugin context not initialized";
+    if (workers < 1 || workers > PLUGIN_MAX_WORKERS) return "Workers out of range";
+    // Only a transform without state can run on several threads at once
+    if (!plugin_is_stateless || !plugin_is_stateless()) return "Plugin is not stateless";
+    // Not take_mutex: an idle worker holds it while it waits for lines
+    pthread_mutex_lock(&g_context->next_mutex);
+    int started = atomic_load_explicit(&g_context->workers, memory_order_relaxed);
+    const char* err = NULL;
+    if (workers < started) {
+        err = "Workers can only be added";
+    } else if (g_context->running == 0) {
+        err = "Stage already finished";
+    }
+    while (!err && started < workers) {
+        pthread_t* thread = &g_context->extra_workers[started - 1];
+        if (pthread_create(thread, NULL, plugin_consumer_thread, g_context) != 0) {
+            *thread = 0;
+            err = "Could not create consumer thread";
+            break;
+        }
+        atomic_store_explicit(&g_context->workers, ++started, memory_order_relaxed);
+        g_context->running++;
+    }
+    pthread_mutex_unlock(&g_context->next_mutex);
+    return err;
+}
+
+__attribute__((visibility("default"))) const char* plugin_set_batch(int lines) {
+    if (!g_context) return "Plugin context not initialized";
+    if (lines < 1 || lines > PLUGIN_BATCH_MAX) return "Batch out of range";
+    // A batch is placed after all its lines are transformed, so lines a stateful
+    // plugin emits from its transform would overtake the batch's earlier results
+    if (lines > 1 && plugin_flush) return "Plugin keeps state across lines";
+    atomic_store_explicit(&g_context->batch, lines, memory_order_relaxed);
+    return NULL;
+}
+
+__attribute__((visibility("default"))) const char* plugin_set_lane_weights(const int* weights, int count) {
+    if (!g_context) return "Plugin context not initialized";
+    return consumer_producer_set_lane_weights(g_context->queue, weights, count);
+}
+
+const char* plugin_emit(const char* line) {
+    if (!g_context) return "Plugin context not initialized";
+    if (!line) return "Line is NULL";
+    record_meta_t meta;
+    memset(&meta, 0, sizeof(meta));
+    meta.end_offset = -1; // Not an input line, so nothing for a checkpoint to commit
+    place_next(g_context, line, &meta);
+    return NULL;
+}
+
+const char* plugin_schedule(long long due_ns, timer_fn fn, void* arg) {
+    if (!g_context) return "Plugin context not initialized";
+    if (!g_context->timers) {
+        timer_wheel_t* timers = malloc(sizeof(timer_wheel_t));
+        if (!timers) return "Could not allocate memory for timers";
+        const char* err = timer_wheel_init(timers, PLUGIN_TIMER_TICK_NS, trace_now_ns());
+        if (err) {
+            free(timers);
+            return err;
+        }
+        g_context->timers = timers;
+    }
+    return timer_wheel_schedule(g_context->timers, due_ns, fn, arg);
+}
+
+plugin_deferred_t* plugin_defer(const char* output) {
+    if (!g_context || !g_context->current_meta || !output) return NULL;
+    plugin_deferred_t* deferred = malloc(sizeof(plugin_deferred_t));
+    if (!deferred) return NULL;
+    deferred->line = strdup(output);
+    if (!deferred->line) {
+        free(deferred);
+        return NULL;
+    }
+    deferred->meta = *g_context->current_meta;
+    unsigned held = atomic_load_explicit(&g_context->deferred, memory_order_acquire);
+    do {
+        if (held & DEFERRED_ABORTED) {
+            free(deferred->line);
+            free(deferred);
+            return NULL;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&g_context->deferred, &held, held + 1, memory_order_acq_rel,
+                                                    memory_order_acquire));
+    return deferred;
+}
+
+const char* plugin_release(plugin_deferred_t* deferred) {
+    if (!g_context) return "Plugin context not initialized";
+    if (!deferred) return "Deferred line is NULL";
+    // Whether the line counts as dropped is settled by the same step that stops holding it
+    unsigned held = atomic_load_explicit(&g_context->deferred, memory_order_acquire);
+    while (!atomic_compare_exchange_weak_explicit(&g_context->deferred, &held, held - 1, memory_order_acq_rel,
+                                                  memory_order_acquire)) {
+    }
+    if (!(held & DEFERRED_ABORTED)) place_next(g_context, deferred->line, &deferred->meta);
+    free(deferred->line);
+    free(deferred);
+    return NULL;
+}
+
+void plugin_set_defer_limit(int lines) {
+    if (g_context) g_context->defer_limit = lines > 0 ? lines : 0;
+}
+
+char* plugin_output_buffer(size_t size) {
+    if (!t_scope) return malloc(size);
+    return scratch_pool_get(t_scope->pool, t_scope->slot, size);
+}
+
+char* plugin_in_place(const char* input) {
+    return t_scope && input && t_scope->writable == input ? t_scope->writable : NULL;
+}
+
+__attribute__((visibility("default"))) const char* plugin_transform_lines(const char* lines, const size_t* offsets, int count,
+                                                                         char* output, size_t output_size, size_t* output_offsets) {
+    if (!plugin_transform) return "Plugin has no transform";
+    // Lines a stateful plugin emits have no input line to be written after
+    if (plugin_flush) return "Plugin keeps state across lines and needs the streaming pipeline";
+    size_t batch_offsets[PLUGIN_BATCH_MAX + 1];
+    size_t batch_results[PLUGIN_BATCH_MAX + 1];
+    size_t used = 0;
+    int first = 0;
+    // Each result is copied out at once, so one scratch buffer serves every line of the call
+    scratch_pool_t scratch;
+    scratch_pool_init(&scratch, PLUGIN_SCRATCH_WATERMARK);
+    line_scope_t scope = { &scratch, 0, NULL };
+    const char* err = NULL;
+    while (first < count && !err) {
+        int n = count - first < PLUGIN_BATCH_MAX ? count - first : PLUGIN_BATCH_MAX;
+        if (plugin_transform_batch && n > 1) {
+            for (int i = 0; i <= n; i++) batch_offsets[i] = offsets[first + i] - offsets[first];
+            if (plugin_transform_batch(lines + offsets[first], batch_offsets, n, output + used,
+                                       output_size - used, batch_results) == NULL) {
+                for (int i = 0; i < n; i++) {
+                    output_offsets[first + i] = batch_results[i] == PLUGIN_DROP_OFFSET ? PLUGIN_DROP_OFFSET
+                                                                                     : used + batch_results[i];
+                }
+                used += batch_results[n];
+                first += n;
+                continue;
+            }
+        }
+        // Per-line path, also taken for a batch the batch entry point refused
+        for (int i = first; i < first + n && !err; i++) {
+            const char* input = lines + offsets[i];
+            t_scope = &scope;
+            const char* result = plugin_transform(input);
+            t_scope = NULL;
+            if (!result) {
+                err = "Transform failed";
+            } else if (result == PLUGIN_DROP) {
+                output_offsets[i] = PLUGIN_DROP_OFFSET;
+            } else {
+                size_t length = strlen(result) + 1;
+                if (length > output_size - used) {
+                    err = "Output buffer too small";
+                } else {
+                    memcpy(output + used, result, length);
+                    output_offsets[i] = used;
+                    used += length;
+                }
+            }
+            if (result && result != PLUGIN_DROP) free_result(&scratch, 0, result, input);
         }
-        g_context->consumer_thread = 0;
+        scratch_pool_end_round(&scratch);
+        first += n;
     }
+    scratch_pool_destroy(&scratch);
+    if (err) return err;
+    output_offsets[count] = used;
     return NULL;
-}
\ No newline at end of file
+}
+
+__attribute__((visibility("default"))) void plugin_set_verbosity(int level) {
+    atomic_store_explicit(&g_verbosity, level, memory_order_relaxed);
+}
@@ -6,18 +6,225 @@
 #include <string.h>
 #include <dlfcn.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include "sync/consumer_producer.h"
+#include "sync/stage_cache.h"
+#include "sync/metrics.h"
+#include "sync/token_bucket.h"
+#include "sync/timer_wheel.h"
+#include "sync/scratch_pool.h"
 
+#define PLUGIN_BATCH_MAX 64 // Most lines handed to plugin_transform_batch at once
+#define PLUGIN_DEFER ((const char*)-2) // Transform result: the plugin passes the line on later with plugin_release
+#define PLUGIN_TIMER_TICK_NS 1000000LL // Resolution of plugin_schedule
+#define PLUGIN_MAX_WORKERS 64 // Most consumer threads of one stateless stage
+#define PLUGIN_SCRATCH_WATERMARK 4096 // Bytes an output buffer keeps when it is trimmed
+#define PLUGIN_CACHE_ALIGNED CP_CACHE_ALIGNED
+
+typedef struct plugin_deferred plugin_deferred_t;
+
+/*
+ * Fields are grouped by the threads that write them, each group starting on
+ * its own cache line: a write from one group never invalidates a line another
+ * thread keeps reading or writing. The first group is read on every batch and
+ * written only by init and configuration calls.
+ */
 typedef struct {
     const char* name; // plugin name
     consumer_producer_t* queue; // Input queue
-    pthread_t consumer_thread; // Consumer thread
     const char* (*next_place_work)(const char*); // Next plugin's place_work function
+    const char* (*next_place_record)(const char*, const record_meta_t*); // Next stage's place_record function, preferred over next_place_work
     const char* (*process_function)(const char*); // Plugin-specific process function
+    trace_span_fn trace_span; // Receiver of spans for sampled records, NULL when tracing is off
+    stage_cache_t* cache; // Memo cache of process_function results, NULL when disabled
+    token_bucket_t* limiter; // Rate limit applied before each batch, NULL when unlimited
+    timer_wheel_t* timers; // Created by the first plugin_schedule, driven by the consumer thread
+    int trace_stage; // Index of this stage reported with each span
     int initialized; // Initialized flag
-    int finished; // Finished processing flag
+    int defer_limit; // Held lines that stop the consumer from taking more, 0 for no limit
+    atomic_int batch; // Most lines taken at once
+    atomic_int workers; // Consumer threads started
+    atomic_int capacity;
+    pthread_t consumer_thread; // Consumer thread
+    pthread_t extra_workers[PLUGIN_MAX_WORKERS - 1]; // Consumer threads added by plugin_set_workers
+    // Written by the upstream stage for every line it places
+    atomic_ullong placed PLUGIN_CACHE_ALIGNED;
+    // Written by the workers for every batch; lock-free, so a scrape never contends with them
+    atomic_ullong retired PLUGIN_CACHE_ALIGNED;
+    atomic_ullong processed;
+    atomic_ullong filtered;
+    atomic_ullong latency_sum_ns;
+    atomic_ullong service_ns; // Time spent in the transform, summed over the workers
+    atomic_ullong buffer_allocations; // Output buffers allocated or resized by the workers' scratch pools
+    // plugin_abort also writes these once, from the main thread, as the stage shuts down
+    atomic_ullong deferred_dropped; // Held lines the abort discarded
+    atomic_uint deferred; // Lines held by plugin_defer, with DEFERRED_ABORTED set once the stage aborts
+    atomic_ullong latency[METRICS_LATENCY_BUCKETS];
+    pthread_mutex_t take_mutex PLUGIN_CACHE_ALIGNED; // Held while a worker waits for a batch and draws its ticket
+    unsigned long long next_ticket; // Ticket of the next batch taken, guarded by take_mutex
+    pthread_mutex_t next_mutex PLUGIN_CACHE_ALIGNED; // Held while a batch is placed downstream, so attach and pause wait for a batch boundary
+    unsigned long long turn; // Ticket of the next batch to place, guarded by next_mutex
+    int running; // Consumer threads not yet exited, guarded by next_mutex
+    int pause_count; // Nested plugin_pause calls, guarded by next_mutex
+    const char* (*forward_to)(const char*, const record_meta_t*); // Receiver of untransformed lines after a hand-off, NULL otherwise
+    atomic_int handed_off; // Set with forward_to; workers read it when drawing a ticket, without next_mutex
+    atomic_int paused; // Set by plugin_pause and cleared by plugin_resume under next_mutex; read by scrapes
+    const record_meta_t* current_meta; // Metadata of the line being transformed, NULL between lines, guarded by next_mutex
+    pthread_cond_t resume_cond; // Signaled when the pause count drops to zero or the queue is handed off
+    // Written once, when the last worker exits
+    atomic_int finished PLUGIN_CACHE_ALIGNED; // Finished processing flag
+    monitor_t done_monitor; // Signaled when the consumer thread exits
 } plugin_context_t;
 
+/**
+ * Optional hook a plugin defines to declare that its transform is a pure
+ * function of the input bytes (no output, no state), so results may be cached
+ * @return Non-zero if the transform is stateless
+ */
+int plugin_is_stateless(void) __attribute__((weak));
+
+/**
+ * Optional hook a plugin defines to transform several lines in one call
+ * The consumer thread drains up to PLUGIN_BATCH_MAX queued lines and packs them
+ * back to back into one buffer, so the loop can run across lines. Declared in
+ * plugin_sdk.h with its full contract.
+ */
+const char* plugin_transform_batch(const char* lines, const size_t* offsets, int count,
+                                   char* output, size_t output_size, size_t* output_offsets) __attribute__((weak));
+
+/**
+ * The plugin's per-line transform, defined by every plugin
+ * Declared weak because the analyzer links this file without a plugin.
+ */
+const char* plugin_transform(const char* input) __attribute__((weak));
+
+/*
+ * Stateful plugins
+ * A plugin that keeps state across lines (windows, sessions) usually returns
+ * PLUGIN_DROP from its transform and passes its own lines on with plugin_emit.
+ * The consumer thread calls plugin_flush between batches, at least every
+ * plugin_flush_interval_ms when that hook is defined, even while no line
+ * arrives; and once more with final set after the last line, before the stage
+ * reports finished, so what the state still holds reaches the next stage
+ * before that stage is drained. Transform, flush and emit all run on the
+ * consumer thread, so the state needs no lock.
+ */
+
+/**
+ * Optional hook: pass on what the plugin's state holds
+ * @param final Non-zero for the last call, after the input ended
+ */
+void plugin_flush(int final) __attribute__((weak));
+
+/**
+ * Optional hook: how often plugin_flush runs while the stage is running
+ * @return Interval in milliseconds, 0 to flush only after the last line
+ */
+long plugin_flush_interval_ms(void) __attribute__((weak));
+
+/**
+ * Pass a line of the plugin's own to the next stage, with empty record metadata
+ * Only valid on the consumer thread: from the transform or from plugin_flush.
+ * @param line Line to pass on (copied)
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_emit(const char* line);
+
+/*
+ * Paced and delayed output
+ * A stage that spaces its output out in time (typewriter) schedules callbacks on
+ * the stage's timer wheel instead of sleeping in its transform. The transform
+ * takes the line with plugin_defer, returns PLUGIN_DEFER and returns at once;
+ * the consumer thread goes on taking lines while the callbacks run between
+ * batches, and the plugin hands each line on with plugin_release when its
+ * output is complete. Callbacks run on the consumer thread, held by a pause
+ * like any batch. At the end of the input the stage finishes once no timer is
+ * pending. An abort or a reload cancels the pending timers: callbacks then run
+ * at once with cancelled set, and lines held at an abort are counted as dropped.
+ */
+
+/**
+ * Schedule a callback on the stage's timer wheel
+ * Only valid on the consumer thread: from the transform or from a callback.
+ * @param due_ns When to call, on the trace_now_ns() clock
+ * @param fn Callback, passed arg and whether the timer was cancelled
+ * @param arg Passed to the callback
+ * @return NULL on success, error message when the stage has no consumer thread
+ */
+const char* plugin_schedule(long long due_ns, timer_fn fn, void* arg);
+
+/**
+ * Take over the line being transformed, to pass it on later with plugin_release
+ * The transform then returns PLUGIN_DEFER. The line keeps its record metadata.
+ * @param output Line to pass on once released (copied)
+ * @return Handle, NULL outside a streaming transform or once the stage aborted
+ */
+plugin_deferred_t* plugin_defer(const char* output);
+
+/**
+ * Pass a deferred line on to the next stage and free the handle
+ * Only valid on the consumer thread. After an abort the line is discarded.
+ * Release lines in the order they were deferred to keep the stream in order.
+ * @param deferred Handle from plugin_defer
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_release(plugin_deferred_t* deferred);
+
+/**
+ * Bound the lines a stage holds at once
+ * While that many lines are deferred, the consumer thread only runs timers and
+ * leaves new lines in the queue, so backpressure reaches the producer as usual.
+ * @param lines Most lines held, 0 for no limit
+ */
+void plugin_set_defer_limit(int lines);
+
+/*
+ * Workers
+ * A stateless stage may run several consumer threads (plugin_set_workers).
+ * Each takes a batch under take_mutex and draws a ticket with it; the
+ * transforms run side by side, and the batches are placed downstream one at a
+ * time in ticket order, so the stream keeps its order. Stages with one worker
+ * transform under next_mutex as before, so plugin_defer and plugin_emit keep
+ * their single-thread contract.
+ */
+
+/*
+ * Output buffers
+ * A transform that builds a new line takes its buffer from
+ * plugin_output_buffer instead of malloc. On a consumer thread, and in
+ * plugin_transform_lines, the buffer belongs to the stage and is reused for the
+ * next lines once the result is placed, so a steady stream allocates nothing.
+ * A transform that keeps the length of its line can skip the buffer and
+ * overwrite the input it was given, when plugin_in_place allows it.
+ */
+
+/**
+ * Buffer for the result of the line being transformed
+ * The transform returns it as its result. A second call for the same line
+ * returns a buffer of the new size with the contents kept, like realloc.
+ * Outside the runtime (a test calling plugin_transform) the buffer comes from
+ * malloc and the caller frees it as before.
+ * @param size Bytes needed, including the terminating NUL
+ * @return Buffer, NULL when out of memory
+ */
+char* plugin_output_buffer(size_t size);
+
+/**
+ * The line being transformed, writable, when the runtime owns it
+ * The input is freed after the result is placed, so a transform may write its
+ * result over it and return it. Not available when the stage caches results,
+ * whose key is the input, or outside a consumer thread.
+ * @param input The transform's input
+ * @return input as a writable pointer, NULL when it must not be changed
+ */
+char* plugin_in_place(const char* input);
+
+/**
+ * Verbosity requested through plugin_set_verbosity
+ * @return 0 for quiet, 1 (default) to log every line
+ */
+int plugin_verbosity(void);
+
 /**
  * Generic consumer thread function
  * @param arg Pointer to plugin_context_t
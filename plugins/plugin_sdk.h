@@ -1,6 +1,22 @@
 #ifndef PLUGIN_SDK_H
 #define PLUGIN_SDK_H
 
+#include "sync/consumer_producer.h"
+#include "sync/stage_cache.h"
+#include "sync/metrics.h"
+
+/*
+ * Dropping lines
+ * A filtering stage returns PLUGIN_DROP from its per-line transform, or sets
+ * output_offsets[i] to PLUGIN_DROP_OFFSET for line i of a batch (writing no
+ * bytes for it). The consumer thread then frees the input and passes nothing
+ * downstream, so later stages never see the line. Dropped lines are counted in
+ * stage_metrics_t.filtered. A checkpoint covers a dropped line once a later
+ * line reaches the sink; a resume may read it again and drop it again.
+ */
+#define PLUGIN_DROP ((const char*)-1) // Per-line result: no output for this line
+#define PLUGIN_DROP_OFFSET ((size_t)-1) // Batch result offset: no output for this line
+
 /**
  * Get the plugin's name
  * @return The plugin's name (should be modified or freed)
@@ -40,4 +56,222 @@ void plugin_attach(const char* (*next_place_work)(const char*));
  */
 const char* plugin_wait_finished(void);
 
+/*
+ * Optional runtime control functions
+ * The analyzer resolves these if present and skips the related features otherwise
+ */
+
+/**
+ * Get a snapshot of the plugin's input queue counters
+ * @param stats Output snapshot
+ * @param reset_watermark Non-zero to restart high watermark tracking, left to the queue controller
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_queue_stats(consumer_producer_stats_t* stats, int reset_watermark);
+
+/**
+ * Change the capacity of the plugin's input queue while it is running
+ * @param capacity New maximum number of items that can be queued
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_resize_queue(int capacity);
+
+/**
+ * Back the plugin's queue rings with 2 MB huge pages, or move them back to the heap
+ * Falls back to the heap when the kernel has no huge pages to give;
+ * plugin_queue_stats reports the backing actually obtained.
+ * @param mode A huge_pages_t: HUGE_PAGES_OFF, _TRANSPARENT or _EXPLICIT
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_set_huge_pages(int mode);
+
+/**
+ * Spill lines that find the plugin's queue full to disk instead of blocking the producer
+ * They are read back in order once the queue drains; plugin_queue_stats
+ * reports how many are on disk.
+ * @param dir Existing writable directory for the spill files, NULL to block again
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_set_spill(const char* dir);
+
+/**
+ * Run the stage on more consumer threads
+ * Only for plugins whose plugin_is_stateless returns non-zero. Workers transform
+ * batches side by side; the batches are placed downstream in the order they were
+ * taken, so the output keeps its order. Workers can only be added.
+ * @param workers Consumer threads in total, at most PLUGIN_MAX_WORKERS
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_set_workers(int workers);
+
+/**
+ * Change how many lines the consumer threads take from the queue at once
+ * Plugins with plugin_flush stay at 1, so lines they emit keep their place.
+ * @param lines Lines per batch, 1 to PLUGIN_BATCH_MAX
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_set_batch(int lines);
+
+/**
+ * Place work together with its record metadata in the plugin's queue
+ * The metadata travels with the transformed output to the next stage
+ * @param str The string to process
+ * @param meta Record metadata (copied), NULL for none
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_place_record(const char* str, const record_meta_t* meta);
+
+/**
+ * Attach this plugin to the next stage using the metadata-carrying entry point
+ * Takes precedence over plugin_attach when both are set
+ * @param next_place_record Function pointer to the next stage's place_record function
+ */
+void plugin_attach_record(const char* (*next_place_record)(const char*, const record_meta_t*));
+
+/**
+ * Finish the plugin's input and wait a bounded time for the queue to drain
+ * Can be called repeatedly until it succeeds; plugin_wait_finished stays valid afterwards.
+ * @param timeout_ms Maximum time to wait in milliseconds
+ * @return 0 once the consumer thread exited, -1 if it is still running at the timeout
+ */
+int plugin_drain(long timeout_ms);
+
+/**
+ * Stop the plugin immediately: queued work is freed without being processed
+ * The item being processed, if any, still completes. Call plugin_wait_finished
+ * afterwards to join the consumer thread.
+ * @return Number of queued items discarded
+ */
+int plugin_abort(void);
+
+/**
+ * Transform a batch of lines (optional, plugins without it are called per line)
+ * Line i starts at lines + offsets[i] and is NUL terminated; offsets has count + 1
+ * entries and offsets[count] is the packed size. Result i must be written NUL
+ * terminated at output + output_offsets[i], and output_offsets[count] set to the
+ * bytes used. output_size is at least twice offsets[count]; a plugin whose results
+ * could be longer returns an error, and the batch is then processed line by line.
+ * A line without a result has output_offsets[i] == PLUGIN_DROP_OFFSET.
+ * @param lines Packed input lines
+ * @param offsets Start of each line in lines
+ * @param count Number of lines, at most PLUGIN_BATCH_MAX
+ * @param output Caller-provided result buffer
+ * @param output_size Size of output in bytes
+ * @param output_offsets Start of each result in output
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_transform_batch(const char* lines, const size_t* offsets, int count,
+                                   char* output, size_t output_size, size_t* output_offsets);
+
+/**
+ * Transform any number of packed lines on the calling thread, without the queue
+ * Uses plugin_transform_batch in chunks of PLUGIN_BATCH_MAX lines when the plugin
+ * defines it, plugin_transform otherwise. Needs no plugin_init, and stateless
+ * plugins may be called from several threads at once on disjoint lines.
+ * Lines and results are packed as for plugin_transform_batch, with offsets[0] == 0;
+ * dropped lines get PLUGIN_DROP_OFFSET.
+ * @param lines Packed input lines
+ * @param offsets Start of each line in lines, count + 1 entries
+ * @param count Number of lines
+ * @param output Caller-provided result buffer
+ * @param output_size Size of output in bytes
+ * @param output_offsets Start of each result in output, count + 1 entries
+ * @return NULL on success, "Output buffer too small" if the results do not fit,
+ *         another error message on failure
+ */
+const char* plugin_transform_lines(const char* lines, const size_t* offsets, int count,
+                                   char* output, size_t output_size, size_t* output_offsets);
+
+/**
+ * Set a plugin-specific option, such as a filter pattern
+ * Called for each --set given for the stage, right after the plugin is loaded
+ * and before plugin_init, so options are also in effect for --offline runs.
+ * @param key Option name
+ * @param value Option value
+ * @return NULL on success, error message for an unknown key or invalid value
+ */
+const char* plugin_configure(const char* key, const char* value);
+
+/**
+ * Memoize the plugin's transform in a bounded cache keyed on the input bytes
+ * Only allowed for plugins that define plugin_is_stateless. Must be called
+ * before work is placed.
+ * @param capacity Maximum number of cached results
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_enable_cache(int capacity);
+
+/**
+ * Get hit, eviction and memory counters of the plugin's cache
+ * @param stats Output snapshot
+ * @return NULL on success, error message if the cache is not enabled
+ */
+const char* plugin_cache_stats(stage_cache_stats_t* stats);
+
+/**
+ * Report timing spans for sampled records (those with a nonzero trace_id)
+ * Unsampled records are not timed at all
+ * @param trace_span Receiver of the spans, NULL to stop tracing
+ * @param stage Index of this plugin in the pipeline, passed back with each span
+ */
+void plugin_attach_tracer(trace_span_fn trace_span, int stage);
+
+/**
+ * Hold the plugin at its next batch boundary: the batch being placed downstream
+ * completes, then the consumer thread waits before placing another one.
+ * Pauses nest; each one is released by one plugin_resume. Lines keep queueing
+ * up to the queue capacity while the plugin is paused.
+ */
+void plugin_pause(void);
+
+/**
+ * Release one plugin_pause; the plugin runs again once every pause is released
+ */
+void plugin_resume(void);
+
+/**
+ * Snapshot the plugin's queue and latency counters
+ * Only atomic loads: never blocks the consumer thread or producers
+ * @param metrics Output snapshot
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_metrics(stage_metrics_t* metrics);
+
+/**
+ * Share the consumer thread between priority lanes
+ * Records carry their lane in record_meta_t.lane; each lane queues up to the
+ * queue capacity on its own and lanes are served in proportion to their weight.
+ * @param weights Weight of lanes 0..count-1, each greater than 0
+ * @param count Number of lanes, at most CP_MAX_LANES
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_set_lane_weights(const int* weights, int count);
+
+/**
+ * Limit how fast the plugin takes lines from its queue
+ * The consumer thread takes tokens for each batch before transforming it and
+ * sleeps when they run out; the time spent waiting is reported in
+ * stage_metrics_t.throttled_ns. Must be called before work is placed.
+ * @param lines_per_sec Lines per second, 0 for no limit on lines
+ * @param bytes_per_sec Bytes per second, 0 for no limit on bytes
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_set_rate_limit(double lines_per_sec, double bytes_per_sec);
+
+/**
+ * Set how much the plugin logs; the logger plugin prints nothing at level 0
+ * @param level 0 for quiet, 1 (default) to log every line
+ */
+void plugin_set_verbosity(int level);
+
+/**
+ * Hand the plugin's queue over to a replacement instance
+ * Once the current batch is placed, every line still queued or placed later is
+ * passed untransformed, with its metadata, to the replacement's place_record.
+ * Call plugin_wait_finished afterwards to flush the queue into it.
+ * @param place_record The replacement instance's place_record function
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_handoff(const char* (*place_record)(const char*, const record_meta_t*));
+
 #endif
\ No newline at end of file
@@ -8,14 +8,24 @@ const char* plugin_transform(const char* input) {
         return NULL;
     }
     
-    // Allocate memory for the output string
-    char* output = malloc(strlen(input) + 1);
+    size_t len = strlen(input);
+    char* output = plugin_in_place(input);
+    if (output) {
+        // Shift right by one within the line, the last character wraps to the front
+        if (len > 1) {
+            char last = output[len - 1];
+            memmove(output + 1, output, len - 1);
+            output[0] = last;
+        }
+        return output;
+    }
+    
+    output = plugin_output_buffer(len + 1);
     if (!output) {
         return NULL;
     }
-    int len = strlen(input);
     // Rotate the string by 1 character to the right
-    for (int i = 0; i < len; i++) {
+    for (size_t i = 0; i < len; i++) {
         output[(i + 1) % len] = input[i];
     }
     output[len] = '\0';
@@ -30,3 +40,8 @@ const char* plugin_init(int queue_size) {
 const char* get_plugin_name(void) {
     return "rotator";
 }
+// Output depends only on the input bytes, so the analyzer may cache it
+int plugin_is_stateless(void) {
+    return 1;
+}
+
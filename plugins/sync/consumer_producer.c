@@ -5,17 +5,293 @@
 #include <pthread.h>
 #include "consumer_producer.h"
 
+// Bytes of the items array, rounded so metas starts on its own cache line
+static size_t items_bytes(int capacity) {
+    return (capacity * sizeof(char*) + 63) & ~(size_t)63;
+}
+
+static int alloc_lane(consumer_producer_lane_t* lane, int capacity, huge_pages_t huge_pages) {
+    if (huge_alloc(&lane->ring, items_bytes(capacity) + capacity * sizeof(record_meta_t), huge_pages) != NULL) {
+        return -1;
+    }
+    lane->items = (char**)lane->ring.ptr;
+    lane->metas = (record_meta_t*)((char*)lane->ring.ptr + items_bytes(capacity));
+    return 0;
+}
+
+static void free_lane(consumer_producer_lane_t* lane) {
+    huge_free(&lane->ring);
+    lane->items = NULL;
+    lane->metas = NULL;
+}
+
+// Whether some lane still has items on disk or on their way there
+static int has_spilled(const consumer_producer_t* queue) {
+    for (int l = 0; l < CP_MAX_LANES; l++) {
+        if (queue->lanes[l].spilled > 0) return 1;
+    }
+    return 0;
+}
+
+static int any_refilling(const consumer_producer_t* queue) {
+    for (int l = 0; l < CP_MAX_LANES; l++) {
+        if (queue->lanes[l].refilling > 0) return 1;
+    }
+    return 0;
+}
+
+/*
+ * Free every queued item of every lane, on disk too; returns how many there
+ * were. Called with the mutex held: it waits for reads back in flight to land
+ * in the rings, and closes the spill files so appends still waiting fail.
+ */
+static int free_items(consumer_producer_t* queue) {
+    while (any_refilling(queue)) pthread_cond_wait(&queue->refill_cond, &queue->mutex);
+    int freed = 0;
+    for (int l = 0; l < CP_MAX_LANES; l++) {
+        consumer_producer_lane_t* lane = &queue->lanes[l];
+        for (int i = 0; i < lane->size; i++) {
+            free(lane->items[(lane->head + i) % queue->capacity]);
+        }
+        freed += lane->size;
+        if (lane->spill) {
+            consumer_producer_spill_t* spill = lane->spill;
+            pthread_mutex_lock(&spill->mutex);
+            int on_disk = (int)spill->file.count;
+            atomic_fetch_sub_explicit(&queue->spill_bytes, spill->file.bytes, memory_order_relaxed);
+            spill_file_destroy(&spill->file);
+            spill->closed = 1;
+            pthread_mutex_unlock(&spill->mutex);
+            // Items still waiting for their turn to append are left to their producers
+            freed += on_disk;
+            lane->spilled -= on_disk;
+            atomic_fetch_sub_explicit(&queue->spilled, on_disk, memory_order_relaxed);
+        }
+        lane->size = 0;
+        lane->head = 0;
+        lane->tail = 0;
+        lane->credit = 0;
+    }
+    queue->size = 0;
+    return freed;
+}
+
+/*
+ * Pick the lane to serve next, by smooth weighted round robin over the lanes
+ * that hold items. With a single busy lane this is just that lane.
+ */
+static consumer_producer_lane_t* next_lane(consumer_producer_t* queue) {
+    consumer_producer_lane_t* busy = NULL;
+    int busy_count = 0;
+    for (int l = 0; l < CP_MAX_LANES; l++) {
+        if (queue->lanes[l].size > 0) {
+            busy = &queue->lanes[l];
+            busy_count++;
+        }
+    }
+    if (busy_count <= 1) return busy;
+    int total = 0;
+    consumer_producer_lane_t* best = NULL;
+    for (int l = 0; l < CP_MAX_LANES; l++) {
+        consumer_producer_lane_t* lane = &queue->lanes[l];
+        if (lane->size == 0) continue;
+        lane->credit += lane->weight;
+        total += lane->weight;
+        if (!best || lane->credit > best->credit) best = lane;
+    }
+    best->credit -= total;
+    return best;
+}
+
+// Copy the record metadata into a ring slot, stamping sampled records with their enqueue time
+static void store_meta(record_meta_t* slot, const record_meta_t* meta) {
+    if (meta) {
+        *slot = *meta;
+        if (meta->trace_id) slot->enqueue_ns = trace_now_ns();
+    } else {
+        memset(slot, 0, sizeof(record_meta_t));
+        slot->end_offset = -1;
+    }
+}
+
+static void free_spill(consumer_producer_spill_t* spill) {
+    spill_file_destroy(&spill->file);
+    pthread_mutex_destroy(&spill->mutex);
+    pthread_cond_destroy(&spill->turn_cond);
+    free(spill);
+}
+
+// The lane's spill file, created in the spill directory on first use; called with the mutex held
+static const char* open_spill(consumer_producer_t* queue, int lane_index) {
+    consumer_producer_lane_t* lane = &queue->lanes[lane_index];
+    if (lane->spill) return NULL;
+    char name[96];
+    // Plugins share the process, so the queue's address keeps their files apart
+    snprintf(name, sizeof(name), "analyzer-%d-%lx-%d", (int)getpid(), (unsigned long)queue, lane_index);
+    consumer_producer_spill_t* spill = calloc(1, sizeof(consumer_producer_spill_t));
+    if (!spill) return "Failed to allocate memory";
+    const char* err = spill_file_init(&spill->file, queue->spill_dir, name, sizeof(record_meta_t));
+    if (err) {
+        free(spill);
+        return err;
+    }
+    pthread_mutex_init(&spill->mutex, NULL);
+    pthread_cond_init(&spill->turn_cond, NULL);
+    lane->spill = spill;
+    return NULL;
+}
+
+/*
+ * Append an item to the lane's spill file. Called with the mutex held and
+ * returns with it released: the item takes its place in the lane under the
+ * mutex, and is written to disk after the mutex is given up, in that order.
+ */
+static const char* spill_item(consumer_producer_t* queue, int lane_index, const char* item, const record_meta_t* meta) {
+    consumer_producer_lane_t* lane = &queue->lanes[lane_index];
+    const char* err = open_spill(queue, lane_index);
+    if (err) {
+        pthread_mutex_unlock(&queue->mutex);
+        return err;
+    }
+    consumer_producer_spill_t* spill = lane->spill;
+    record_meta_t stored;
+    store_meta(&stored, meta);
+    unsigned long long ticket = lane->spill_ticket++;
+    lane->spilled++;
+    atomic_fetch_add_explicit(&queue->spilled, 1, memory_order_relaxed);
+    pthread_mutex_unlock(&queue->mutex);
+
+    pthread_mutex_lock(&spill->mutex);
+    while (spill->turn != ticket) pthread_cond_wait(&spill->turn_cond, &spill->mutex);
+    int closed = spill->closed;
+    if (!closed) {
+        unsigned long long bytes = spill->file.bytes;
+        err = spill_file_append(&spill->file, item, &stored);
+        if (!err) {
+            atomic_fetch_add_explicit(&queue->spill_bytes, spill->file.bytes - bytes, memory_order_relaxed);
+            atomic_fetch_add_explicit(&queue->spilled_total, 1, memory_order_relaxed);
+        }
+    }
+    spill->turn++;
+    pthread_cond_broadcast(&spill->turn_cond);
+    pthread_mutex_unlock(&spill->mutex);
+
+    pthread_mutex_lock(&queue->mutex);
+    if (closed || err) {
+        lane->spilled--;
+        atomic_fetch_sub_explicit(&queue->spilled, 1, memory_order_relaxed);
+        if (closed) {
+            queue->dropped++;
+            err = "Queue is finished";
+        }
+    } else {
+        queue->puts++;
+        lane->appends++;
+        // A consumer found nothing to read back before this append; it can now
+        if (lane->size == 0 && lane->refilling == 0 && queue->waiting_consumers > 0) {
+            monitor_signal(&queue->not_empty_monitor);
+        }
+    }
+    pthread_mutex_unlock(&queue->mutex);
+    return err;
+}
+
+/*
+ * Read the oldest spilled items of an empty lane back into its ring. Called
+ * with the mutex held; it is released for the reads, so producers and the
+ * other lanes keep moving meanwhile. Returns 1 if items came back or a retry
+ * may find some, 0 when no lane has anything to read back now.
+ */
+static int refill_lane(consumer_producer_t* queue) {
+    consumer_producer_lane_t* lane = NULL;
+    for (int l = 0; l < CP_MAX_LANES && !lane; l++) {
+        consumer_producer_lane_t* candidate = &queue->lanes[l];
+        if (candidate->size == 0 && candidate->spilled > 0 && candidate->refilling == 0) lane = candidate;
+    }
+    if (!lane) return 0;
+    int wanted = queue->capacity;
+    if (wanted > lane->spilled) wanted = lane->spilled;
+    if (wanted > CP_REFILL_MAX) wanted = CP_REFILL_MAX;
+    // Producers keep spilling and resizes keep room for these while the mutex is released
+    lane->refilling = wanted;
+    unsigned long long appends = lane->appends;
+    consumer_producer_spill_t* spill = lane->spill;
+    pthread_mutex_unlock(&queue->mutex);
+
+    char* items[CP_REFILL_MAX];
+    record_meta_t metas[CP_REFILL_MAX];
+    int count = 0;
+    int lost = 0;
+    pthread_mutex_lock(&spill->mutex);
+    unsigned long long bytes = spill->file.bytes;
+    while (count < wanted && spill->file.count > 0) {
+        const char* err = spill_file_read(&spill->file, &items[count], &metas[count]);
+        if (err) {
+            // The rest of the lane is lost; count it rather than stall on a broken file
+            lost = (int)spill->file.count;
+            fprintf(stderr, "Failed to read spilled items: %s, %d dropped\n", err, lost);
+            spill_file_destroy(&spill->file);
+            break;
+        }
+        count++;
+    }
+    atomic_fetch_sub_explicit(&queue->spill_bytes, bytes - spill->file.bytes, memory_order_relaxed);
+    pthread_mutex_unlock(&spill->mutex);
+
+    pthread_mutex_lock(&queue->mutex);
+    for (int i = 0; i < count; i++) {
+        lane->items[lane->tail] = items[i];
+        lane->metas[lane->tail] = metas[i];
+        lane->tail = (lane->tail + 1) % queue->capacity;
+    }
+    lane->size += count;
+    queue->size += count;
+    lane->spilled -= count + lost;
+    atomic_fetch_sub_explicit(&queue->spilled, count + lost, memory_order_relaxed);
+    queue->dropped += lost;
+    lane->refilling = 0;
+    pthread_cond_broadcast(&queue->refill_cond);
+    if (count > 0 && queue->waiting_consumers > 0) monitor_signal(&queue->not_empty_monitor);
+    return count > 0 || lost > 0 || lane->appends != appends;
+}
+
+// Remove the oldest item of the next lane; the queue must not be empty
+static char* take_item(consumer_producer_t* queue, record_meta_t* meta) {
+    consumer_producer_lane_t* lane = next_lane(queue);
+    char* item = lane->items[lane->head];
+    if (meta) *meta = lane->metas[lane->head];
+    lane->head = (lane->head + 1) % queue->capacity;
+    lane->size--;
+    queue->size--;
+    queue->gets++;
+    if (lane->size == 0) lane->credit = 0;
+    return item;
+}
+
 const char* consumer_producer_init(consumer_producer_t* queue, int capacity){
     if (!queue) return "Queue is NULL";
     if (capacity <= 0) return "Capacity must be greater than 0";
-    queue->items = malloc(capacity * sizeof(char*));
-    if (!queue->items) return "Failed to allocate memory";
+    memset(queue->lanes, 0, sizeof(queue->lanes));
+    for (int i = 0; i < CP_MAX_LANES; i++) queue->lanes[i].weight = 1;
     queue->capacity = capacity;
+    // Lane 0 carries all traffic unless records are tagged, so it is allocated up front
+    queue->huge_pages = HUGE_PAGES_OFF;
+    if (alloc_lane(&queue->lanes[0], capacity, HUGE_PAGES_OFF) != 0) return "Failed to allocate memory";
     queue->size = 0;
-    queue->head = 0;
-    queue->tail = 0;
     queue->finished = 0;  
+    queue->waiting_consumers = 0;
+    queue->waiting_producers = 0;
+    queue->high_watermark = 0;
+    queue->puts = 0;
+    queue->gets = 0;
+    queue->full_waits = 0;
+    queue->dropped = 0;
+    atomic_init(&queue->spilled, 0);
+    atomic_init(&queue->spilled_total, 0);
+    atomic_init(&queue->spill_bytes, 0);
+    queue->spill_dir = NULL;
     pthread_mutex_init(&queue->mutex, NULL);
+    pthread_cond_init(&queue->refill_cond, NULL);
     monitor_init(&queue->not_full_monitor);
     monitor_init(&queue->not_empty_monitor);
     monitor_init(&queue->finished_monitor);
@@ -24,8 +300,16 @@ const char* consumer_producer_init(consumer_producer_t* queue, int capacity){
 
 void consumer_producer_destroy(consumer_producer_t* queue){
     if (!queue) return;
-    free(queue->items);
+    free_items(queue);
+    for (int l = 0; l < CP_MAX_LANES; l++) {
+        free_lane(&queue->lanes[l]);
+        if (queue->lanes[l].spill) free_spill(queue->lanes[l].spill);
+        queue->lanes[l].spill = NULL;
+    }
+    free(queue->spill_dir);
+    queue->spill_dir = NULL;
     pthread_mutex_destroy(&queue->mutex);
+    pthread_cond_destroy(&queue->refill_cond);
     monitor_destroy(&queue->not_full_monitor);
     monitor_destroy(&queue->not_empty_monitor);
     monitor_destroy(&queue->finished_monitor);
@@ -33,61 +317,130 @@ void consumer_producer_destroy(consumer_producer_t* queue){
 }
 
 const char* consumer_producer_put(consumer_producer_t* queue, const char* item){
+    return consumer_producer_put_meta(queue, item, NULL);
+}
+
+const char* consumer_producer_put_meta(consumer_producer_t* queue, const char* item, const record_meta_t* meta){
     if (!queue) return "Queue is NULL";
     if (!item) return "Item is NULL";
     pthread_mutex_lock(&queue->mutex);
     if (queue->finished) {
+        queue->dropped++;
         pthread_mutex_unlock(&queue->mutex);
         return "Queue is finished";
     }
-    while (queue->size == queue->capacity) {
+    int lane_index = meta ? meta->lane : 0;
+    if (lane_index < 0 || lane_index >= CP_MAX_LANES) {
+        pthread_mutex_unlock(&queue->mutex);
+        return "Invalid lane";
+    }
+    consumer_producer_lane_t* lane = &queue->lanes[lane_index];
+    if (!lane->items && alloc_lane(lane, queue->capacity, queue->huge_pages) != 0) {
+        pthread_mutex_unlock(&queue->mutex);
+        return "Failed to allocate memory";
+    }
+    while (lane->size >= queue->capacity && !queue->spill_dir) {
+        queue->full_waits++;
+        queue->waiting_producers++;
         pthread_mutex_unlock(&queue->mutex);
         monitor_wait(&queue->not_full_monitor);
         pthread_mutex_lock(&queue->mutex);
+        queue->waiting_producers--;
         if (queue->finished) {
+            queue->dropped++;
             pthread_mutex_unlock(&queue->mutex);
             return "Queue is finished";
         }
     }
-    queue->items[queue->tail] = strdup(item);
-    queue->tail = (queue->tail + 1) % queue->capacity;
+    // Behind spilled items, a new item goes to disk too even if the ring has room
+    if (lane->size >= queue->capacity || lane->spilled > 0) return spill_item(queue, lane_index, item, meta);
+    lane->items[lane->tail] = strdup(item);
+    store_meta(&lane->metas[lane->tail], meta);
+    lane->tail = (lane->tail + 1) % queue->capacity;
+    lane->size++;
     queue->size++;
-    monitor_signal(&queue->not_empty_monitor);
+    queue->puts++;
+    if (queue->size > queue->high_watermark) queue->high_watermark = queue->size;
+    // A consumer that is about to wait registered under the mutex, so none is missed
+    if (queue->waiting_consumers > 0) monitor_signal(&queue->not_empty_monitor);
     pthread_mutex_unlock(&queue->mutex);
     return NULL;
 }
 
 char* consumer_producer_get(consumer_producer_t* queue){
+    return consumer_producer_get_meta(queue, NULL);
+}
+
+char* consumer_producer_get_meta(consumer_producer_t* queue, record_meta_t* meta){
     if (!queue) return NULL;
     pthread_mutex_lock(&queue->mutex);
     while (queue->size == 0) {
-        if (queue->finished) {
+        if (refill_lane(queue)) continue;
+        if (queue->finished && !has_spilled(queue)) {
             pthread_mutex_unlock(&queue->mutex);
             return NULL; 
         }
+        queue->waiting_consumers++;
         pthread_mutex_unlock(&queue->mutex);
         monitor_wait(&queue->not_empty_monitor);
         pthread_mutex_lock(&queue->mutex);
-        if (queue->finished && queue->size == 0) {
+        queue->waiting_consumers--;
+    }
+    char* item = take_item(queue, meta);
+    if (queue->waiting_producers > 0) monitor_signal(&queue->not_full_monitor);
+    refill_lane(queue);
+    pthread_mutex_unlock(&queue->mutex);
+    return item;
+}
+
+int consumer_producer_get_batch(consumer_producer_t* queue, char** items, record_meta_t* metas, int max){
+    return consumer_producer_get_batch_timed(queue, items, metas, max, -1);
+}
+
+int consumer_producer_get_batch_timed(consumer_producer_t* queue, char** items, record_meta_t* metas, int max,
+                                      long timeout_ms){
+    if (!queue || !items || max <= 0) return 0;
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->size == 0) {
+        if (refill_lane(queue)) continue;
+        if (queue->finished && !has_spilled(queue)) {
             pthread_mutex_unlock(&queue->mutex);
-            return NULL; 
+            return 0;
+        }
+        queue->waiting_consumers++;
+        pthread_mutex_unlock(&queue->mutex);
+        int timed_out = 0;
+        if (timeout_ms < 0) {
+            monitor_wait(&queue->not_empty_monitor);
+        } else {
+            timed_out = monitor_timed_wait(&queue->not_empty_monitor, timeout_ms) != 0;
+        }
+        pthread_mutex_lock(&queue->mutex);
+        queue->waiting_consumers--;
+        if (timed_out) {
+            pthread_mutex_unlock(&queue->mutex);
+            return -1;
         }
     }
-    char* item = queue->items[queue->head];
-    queue->head = (queue->head + 1) % queue->capacity;
-    queue->size--;
-    monitor_signal(&queue->not_full_monitor);
+    int count = queue->size < max ? queue->size : max;
+    for (int i = 0; i < count; i++) {
+        items[i] = take_item(queue, metas ? &metas[i] : NULL);
+    }
+    if (queue->waiting_producers > 0) monitor_signal(&queue->not_full_monitor);
+    // A lane this batch emptied reads its spilled items back now, before its next put comes
+    refill_lane(queue);
     pthread_mutex_unlock(&queue->mutex);
-    return item;
+    return count;
 }
 
 void consumer_producer_signal_finished(consumer_producer_t* queue){
     if (!queue) return;
     pthread_mutex_lock(&queue->mutex);
     queue->finished = 1;  
-    monitor_signal(&queue->finished_monitor);
-    monitor_signal(&queue->not_empty_monitor);
-    monitor_signal(&queue->not_full_monitor);
+    // Every blocked producer and consumer has to see the queue finish, not just one of each
+    monitor_broadcast(&queue->finished_monitor);
+    monitor_broadcast(&queue->not_empty_monitor);
+    monitor_broadcast(&queue->not_full_monitor);
     pthread_mutex_unlock(&queue->mutex);
     return;
 }
@@ -96,4 +449,145 @@ int consumer_producer_wait_finished(consumer_producer_t* queue){
     if (!queue) return -1;
     monitor_wait(&queue->finished_monitor);
     return 0;
-}
\ No newline at end of file
+}
+
+int consumer_producer_wait_finished_timed(consumer_producer_t* queue, long timeout_ms){
+    if (!queue) return -1;
+    return monitor_timed_wait(&queue->finished_monitor, timeout_ms);
+}
+
+int consumer_producer_abort(consumer_producer_t* queue){
+    if (!queue) return 0;
+    pthread_mutex_lock(&queue->mutex);
+    int discarded = free_items(queue);
+    queue->dropped += discarded;
+    queue->finished = 1;
+    // Every blocked producer and consumer has to see the queue finish, not just one of each
+    monitor_broadcast(&queue->finished_monitor);
+    monitor_broadcast(&queue->not_empty_monitor);
+    monitor_broadcast(&queue->not_full_monitor);
+    pthread_mutex_unlock(&queue->mutex);
+    return discarded;
+}
+
+// Move every allocated lane onto a new ring; called with the mutex held
+static const char* rebuild_rings(consumer_producer_t* queue, int new_capacity) {
+    // Allocate every lane's new ring first, so a failure leaves the queue untouched
+    consumer_producer_lane_t grown[CP_MAX_LANES];
+    memset(grown, 0, sizeof(grown));
+    for (int l = 0; l < CP_MAX_LANES; l++) {
+        if (!queue->lanes[l].items) continue;
+        if (alloc_lane(&grown[l], new_capacity, queue->huge_pages) != 0) {
+            for (int j = 0; j < l; j++) free_lane(&grown[j]);
+            return "Failed to allocate memory";
+        }
+    }
+    for (int l = 0; l < CP_MAX_LANES; l++) {
+        consumer_producer_lane_t* lane = &queue->lanes[l];
+        if (!lane->items) continue;
+        // Unwrap the ring so the oldest item lands at index 0
+        for (int i = 0; i < lane->size; i++) {
+            int index = (lane->head + i) % queue->capacity;
+            grown[l].items[i] = lane->items[index];
+            grown[l].metas[i] = lane->metas[index];
+        }
+        free_lane(lane);
+        lane->ring = grown[l].ring;
+        lane->items = grown[l].items;
+        lane->metas = grown[l].metas;
+        lane->head = 0;
+        lane->tail = lane->size % new_capacity;
+    }
+    queue->capacity = new_capacity;
+    return NULL;
+}
+
+const char* consumer_producer_resize(consumer_producer_t* queue, int new_capacity){
+    if (!queue) return "Queue is NULL";
+    if (new_capacity <= 0) return "Capacity must be greater than 0";
+    pthread_mutex_lock(&queue->mutex);
+    for (int l = 0; l < CP_MAX_LANES; l++) {
+        // Items being read back need their room in the ring when they land
+        int held = queue->lanes[l].size + queue->lanes[l].refilling;
+        if (new_capacity < held) new_capacity = held;
+    }
+    if (new_capacity == queue->capacity) {
+        pthread_mutex_unlock(&queue->mutex);
+        return NULL;
+    }
+    int grew = new_capacity > queue->capacity;
+    const char* err = rebuild_rings(queue, new_capacity);
+    if (!err && grew) monitor_signal(&queue->not_full_monitor);
+    pthread_mutex_unlock(&queue->mutex);
+    return err;
+}
+
+const char* consumer_producer_set_huge_pages(consumer_producer_t* queue, huge_pages_t mode){
+    if (!queue) return "Queue is NULL";
+    if (mode < HUGE_PAGES_OFF || mode > HUGE_PAGES_EXPLICIT) return "Invalid huge page mode";
+    pthread_mutex_lock(&queue->mutex);
+    huge_pages_t previous = queue->huge_pages;
+    queue->huge_pages = mode;
+    const char* err = rebuild_rings(queue, queue->capacity);
+    if (err) queue->huge_pages = previous;
+    pthread_mutex_unlock(&queue->mutex);
+    return err;
+}
+
+const char* consumer_producer_set_spill(consumer_producer_t* queue, const char* dir){
+    if (!queue) return "Queue is NULL";
+    char* copy = NULL;
+    if (dir) {
+        if (access(dir, W_OK | X_OK) != 0) return "Spill directory is not writable";
+        copy = strdup(dir);
+        if (!copy) return "Failed to allocate memory";
+    }
+    pthread_mutex_lock(&queue->mutex);
+    free(queue->spill_dir);
+    queue->spill_dir = copy;
+    // Producers blocked on a full lane can spill now
+    if (copy) monitor_broadcast(&queue->not_full_monitor);
+    pthread_mutex_unlock(&queue->mutex);
+    return NULL;
+}
+
+const char* consumer_producer_set_lane_weights(consumer_producer_t* queue, const int* weights, int count){
+    if (!queue || !weights) return "Queue or weights is NULL";
+    if (count <= 0 || count > CP_MAX_LANES) return "Invalid number of lanes";
+    for (int l = 0; l < count; l++) {
+        if (weights[l] <= 0) return "Lane weights must be greater than 0";
+    }
+    pthread_mutex_lock(&queue->mutex);
+    for (int l = 0; l < count; l++) {
+        queue->lanes[l].weight = weights[l];
+        queue->lanes[l].credit = 0;
+    }
+    pthread_mutex_unlock(&queue->mutex);
+    return NULL;
+}
+
+void consumer_producer_stats(consumer_producer_t* queue, consumer_producer_stats_t* stats, int reset_watermark){
+    if (!queue || !stats) return;
+    pthread_mutex_lock(&queue->mutex);
+    stats->capacity = queue->capacity;
+    stats->size = queue->size;
+    stats->high_watermark = queue->high_watermark;
+    stats->puts = queue->puts;
+    stats->gets = queue->gets;
+    stats->full_waits = queue->full_waits;
+    stats->dropped = queue->dropped;
+    stats->backing = HUGE_BACKING_EXPLICIT;
+    stats->ring_bytes = 0;
+    stats->spilled = atomic_load_explicit(&queue->spilled, memory_order_relaxed);
+    stats->spilled_total = atomic_load_explicit(&queue->spilled_total, memory_order_relaxed);
+    stats->spill_bytes = atomic_load_explicit(&queue->spill_bytes, memory_order_relaxed);
+    for (int l = 0; l < CP_MAX_LANES; l++) {
+        const huge_region_t* ring = &queue->lanes[l].ring;
+        if (!ring->ptr) continue;
+        if (ring->backing < stats->backing) stats->backing = ring->backing;
+        stats->ring_bytes += ring->size;
+    }
+    if (reset_watermark) queue->high_watermark = queue->size;
+    pthread_mutex_unlock(&queue->mutex);
+    return;
+}
@@ -1,21 +1,105 @@
 #ifndef CONSUMER_PRODUCER_H
 #define CONSUMER_PRODUCER_H
 
+#include <stdatomic.h>
 #include "monitor.h"
+#include "trace.h"
+#include "huge_alloc.h"
+#include "spill_file.h"
+
+#define CP_MAX_LANES 4 // Priority lanes per queue; lane 0 takes every untagged record
+#define CP_CACHE_LINE 64
+#define CP_CACHE_ALIGNED __attribute__((aligned(CP_CACHE_LINE))) // Starts a field group on its own cache line
+#define CP_REFILL_MAX 256 // Most spilled items a consumer reads back per trip to disk
 
 typedef struct {
-    char** items;
-    int capacity;
+    long long end_offset; // Input byte offset just past this record, -1 when unknown
+    unsigned long long trace_id; // Nonzero when the record is sampled for tracing
+    long long put_ns; // Sampled only: when the producer started placing the record
+    long long enqueue_ns; // Sampled only: when the record entered the queue, set by the queue
+    long long ingest_ns; // When the record was read, 0 unless lanes are in use
+    int lane; // Priority lane, below CP_MAX_LANES
+} record_meta_t;
+
+/*
+ * A lane's spill file with the lock of its own that its disk I/O runs under,
+ * so a slow disk never holds the queue mutex. Producers draw a ticket under
+ * the queue mutex and append in ticket order, which keeps the lane FIFO.
+ */
+typedef struct {
+    pthread_mutex_t mutex; // Held for each append or read back; the queue mutex may be taken before it, never after
+    pthread_cond_t turn_cond; // Signaled when an append is done, for the producer holding the next ticket
+    unsigned long long turn; // Ticket of the next append, guarded by mutex
+    int closed; // Set by an abort, guarded by mutex: appends still waiting for their turn fail
+    spill_file_t file; // Guarded by mutex
+} consumer_producer_spill_t;
+
+// Fields every put and get touches come first, so they share the lane's first cache line
+typedef struct {
+    char** items; // Ring of capacity slots, NULL until the lane is first used
+    record_meta_t* metas; // Per-item metadata, parallel to items
+    consumer_producer_spill_t* spill; // Items that came while the ring was full, NULL until the first one
     int size;
     int head;
     int tail;
-    int finished; 
-    pthread_mutex_t mutex;
-    monitor_t not_full_monitor;
-    monitor_t not_empty_monitor;
-    monitor_t finished_monitor;
+    int weight; // Share of dequeues while several lanes hold items
+    int credit; // Smooth weighted round-robin state
+    int spilled; // Items sent to disk, written or not yet, and not back in the ring
+    int refilling; // Items a consumer is reading back with the mutex released, 0 when none
+    unsigned long long spill_ticket; // Ticket of the next item sent to disk
+    unsigned long long appends; // Appends finished, so a consumer that found nothing to read can tell it may retry
+    huge_region_t ring; // One block holding items, then metas
+} CP_CACHE_ALIGNED consumer_producer_lane_t;
+
+/*
+ * Every field above the monitors is guarded by mutex, so it moves between
+ * cores together with the lock: the state a put or get always reads sits on
+ * the mutex's own line, and the rest is packed onto as few lines as possible.
+ * Each monitor has a lock of its own taken by a different pair of threads,
+ * so each one gets separate lines. Waiter counts let a put or get skip the
+ * other side's monitor, and the cross-core traffic it costs, while nobody waits.
+ * The spill counters come last: they change outside the mutex, around the disk
+ * I/O, and are read without it.
+ */
+typedef struct {
+    pthread_mutex_t mutex CP_CACHE_ALIGNED;
+    int size; // Items queued over all lanes
+    int finished;
+    int waiting_consumers; // Consumers between giving up the mutex and waking on not_empty_monitor
+    int waiting_producers; // Producers between giving up the mutex and waking on not_full_monitor
+    unsigned long long puts CP_CACHE_ALIGNED; // Total items added
+    unsigned long long gets; // Total items removed
+    unsigned long long full_waits; // Times a producer blocked on a full queue
+    unsigned long long dropped; // Items discarded by an abort or rejected after it
+    int high_watermark; // Largest size seen since the last stats reset
+    int capacity; // Per lane, so a backlog in one lane never blocks another
+    huge_pages_t huge_pages; // Backing requested for lane rings
+    char* spill_dir; // Where full lanes spill, NULL to block producers instead
+    pthread_cond_t refill_cond; // Signaled when a consumer is done reading a lane back, for an abort waiting on it
+    consumer_producer_lane_t lanes[CP_MAX_LANES]; // Each lane is a FIFO of up to capacity items
+    monitor_t not_full_monitor CP_CACHE_ALIGNED;
+    monitor_t not_empty_monitor CP_CACHE_ALIGNED;
+    monitor_t finished_monitor CP_CACHE_ALIGNED;
+    atomic_ullong spilled CP_CACHE_ALIGNED; // Items sent to disk and not read back yet
+    atomic_ullong spilled_total; // Items written to disk instead of waiting for room
+    atomic_ullong spill_bytes; // Bytes on disk now
 } consumer_producer_t;
 
+typedef struct {
+    int capacity;
+    int size;
+    int high_watermark;
+    unsigned long long puts;
+    unsigned long long gets;
+    unsigned long long full_waits;
+    unsigned long long dropped;
+    huge_backing_t backing; // Weakest backing among the allocated lane rings
+    size_t ring_bytes; // Bytes held by the lane rings
+    unsigned long long spilled; // Items sent to disk and not read back yet, not counted in size
+    unsigned long long spilled_total; // Items ever written to disk
+    unsigned long long spill_bytes; // Bytes on disk now
+} consumer_producer_stats_t;
+
 /**
  * Initialize a consumer_producer_t queue
  * @param queue Pointer to the queue structure
@@ -32,13 +116,23 @@ void consumer_producer_destroy(consumer_producer_t* queue);
 
 /**
  * Add an item to the queue (producer)
- * Blocks if the queue is full
+ * Blocks if the queue is full, unless spilling is enabled
  * @param queue Pointer to the queue structure
  * @param item String to add (queue takes ownership)
  * @return NULL on success, error message on failure
  */
 const char* consumer_producer_put(consumer_producer_t* queue, const char* item);
 
+/**
+ * Add an item together with its record metadata (producer)
+ * The item joins the lane named in meta->lane and blocks only if that lane is full
+ * @param queue Pointer to the queue structure
+ * @param item String to add (queue takes ownership)
+ * @param meta Metadata copied alongside the item, NULL for none
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_put_meta(consumer_producer_t* queue, const char* item, const record_meta_t* meta);
+
 /**
  * Remove an item from the queue (consumer) and returns it
  * Blocks if the queue is empty
@@ -47,6 +141,77 @@ const char* consumer_producer_put(consumer_producer_t* queue, const char* item);
  */
 char* consumer_producer_get(consumer_producer_t* queue);
 
+/**
+ * Remove an item and its record metadata from the queue (consumer)
+ * Blocks if the queue is empty
+ * @param queue Pointer to the queue structure
+ * @param meta Output metadata of the returned item, may be NULL
+ * @return String item or NULL if queue is empty
+ */
+char* consumer_producer_get_meta(consumer_producer_t* queue, record_meta_t* meta);
+
+/**
+ * Remove up to max items and their metadata in one locked step (consumer)
+ * Items come from the lanes by weight, oldest first within each lane.
+ * Blocks until at least one item is available or the queue is finished
+ * @param queue Pointer to the queue structure
+ * @param items Output array receiving up to max items (caller takes ownership)
+ * @param metas Output array receiving their metadata, may be NULL
+ * @param max Capacity of the output arrays
+ * @return Number of items removed, 0 once the queue is finished and empty
+ */
+int consumer_producer_get_batch(consumer_producer_t* queue, char** items, record_meta_t* metas, int max);
+
+/**
+ * Remove up to max items like consumer_producer_get_batch, waiting a bounded time
+ * @param queue Pointer to the queue structure
+ * @param items Output array receiving up to max items (caller takes ownership)
+ * @param metas Output array receiving their metadata, may be NULL
+ * @param max Capacity of the output arrays
+ * @param timeout_ms Longest wait for a first item, negative to wait without limit
+ * @return Number of items removed, 0 once the queue is finished and empty,
+ *         -1 if the timeout passed with nothing queued
+ */
+int consumer_producer_get_batch_timed(consumer_producer_t* queue, char** items, record_meta_t* metas, int max,
+                                      long timeout_ms);
+
+/**
+ * Set how dequeues are shared between lanes that hold items
+ * A lane with weight w is served w times for every weight-1 lane, so a busy
+ * high-weight lane cannot starve the others. Lanes default to weight 1.
+ * @param queue Pointer to the queue structure
+ * @param weights Weight of each lane, each greater than 0
+ * @param count Number of weights, at most CP_MAX_LANES
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_set_lane_weights(consumer_producer_t* queue, const int* weights, int count);
+
+/**
+ * Move the lane rings onto huge pages, or back onto the heap
+ * Rings allocated later, by a lane's first use or a resize, get the same
+ * backing. Falls back to the heap when huge pages are unavailable; the backing
+ * obtained is reported by consumer_producer_stats.
+ * @param queue Pointer to the queue structure
+ * @param mode Requested backing
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_set_huge_pages(consumer_producer_t* queue, huge_pages_t mode);
+
+/**
+ * Let producers spill to disk instead of blocking while a lane is full
+ * Once a lane has spilled, later items follow on disk until the consumer has
+ * read every spilled item back into the ring, so each lane stays FIFO and its
+ * memory stays bounded by the capacity. Segment files are deleted as they are
+ * read through and when the queue is destroyed or aborted. Turning spilling
+ * off lets the items already on disk drain first. Disk writes and reads run
+ * under a per-lane lock with the queue mutex released, so a slow disk only
+ * holds up the producers and consumer of the lane that spilled.
+ * @param queue Pointer to the queue structure
+ * @param dir Existing writable directory for the segment files, NULL to block again
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_set_spill(consumer_producer_t* queue, const char* dir);
+
 /**
  * Signal that processing is finished
  * @param queue Pointer to the queue structure
@@ -56,8 +221,43 @@ void consumer_producer_signal_finished(consumer_producer_t* queue);
 /**
  * Wait for processing to be finished
  * @param queue Pointer to the queue structure
- * @return 0 on success, -1 on timeout
+ * @return 0 on success, -1 on failure
  */
 int consumer_producer_wait_finished(consumer_producer_t* queue);
 
+/**
+ * Wait for processing to be finished, giving up after a timeout
+ * @param queue Pointer to the queue structure
+ * @param timeout_ms Maximum time to wait in milliseconds
+ * @return 0 on success, -1 on timeout or failure
+ */
+int consumer_producer_wait_finished_timed(consumer_producer_t* queue, long timeout_ms);
+
+/**
+ * Finish the queue immediately and free every item still queued
+ * Blocked producers and consumers wake up; later puts are rejected and counted
+ * as dropped too, so the caller keeps ownership of those items.
+ * @param queue Pointer to the queue structure
+ * @return Number of queued items discarded
+ */
+int consumer_producer_abort(consumer_producer_t* queue);
+
+/**
+ * Change the per-lane capacity of the queue while producers and consumers are running
+ * Queued items keep their order. No lane shrinks below its current size,
+ * so a shrink request on a busy queue only goes as far as it safely can.
+ * @param queue Pointer to the queue structure
+ * @param new_capacity Requested maximum number of items
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_resize(consumer_producer_t* queue, int new_capacity);
+
+/**
+ * Take a snapshot of the queue counters
+ * @param queue Pointer to the queue structure
+ * @param stats Output snapshot
+ * @param reset_watermark Non-zero to restart high watermark tracking from the current size
+ */
+void consumer_producer_stats(consumer_producer_t* queue, consumer_producer_stats_t* stats, int reset_watermark);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,125 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include "huge_alloc.h"
+
+static size_t round_to_huge_pages(size_t size) {
+    return (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+}
+
+// Kilobytes of transparent huge pages in the mapping that contains ptr
+static long anon_huge_kb(const void* ptr) {
+    FILE* smaps = fopen("/proc/self/smaps", "r");
+    if (!smaps) return 0;
+    uintptr_t address = (uintptr_t)ptr;
+    char line[512];
+    int inside = 0;
+    long kb = 0;
+    while (fgets(line, sizeof(line), smaps)) {
+        unsigned long start, end;
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+            if (inside) break;
+            inside = address >= start && address < end;
+        } else if (inside && sscanf(line, "AnonHugePages: %ld kB", &kb) == 1) {
+            break;
+        }
+    }
+    fclose(smaps);
+    return kb;
+}
+
+static int map_explicit(huge_region_t* region, size_t size) {
+    // MAP_POPULATE takes the pages from the pool now, so a later fault cannot SIGBUS
+    void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+    if (ptr == MAP_FAILED) return -1;
+    region->ptr = ptr;
+    region->size = size;
+    region->backing = HUGE_BACKING_EXPLICIT;
+    return 0;
+}
+
+static int map_transparent(huge_region_t* region, size_t size) {
+    // Over-map by one huge page, then trim, so the block starts on a huge page boundary
+    size_t mapped = size + HUGE_PAGE_SIZE;
+    char* raw = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return -1;
+    char* aligned = (char*)(((uintptr_t)raw + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+    if (aligned > raw) munmap(raw, aligned - raw);
+    size_t tail = (size_t)(raw + mapped - (aligned + size));
+    if (tail) munmap(aligned + size, tail);
+    if (madvise(aligned, size, MADV_HUGEPAGE) != 0) {
+        munmap(aligned, size);
+        return -1;
+    }
+    // One write per huge page faults each one in whole, if the kernel has one to give
+    for (size_t offset = 0; offset < size; offset += HUGE_PAGE_SIZE) ((volatile char*)aligned)[offset] = 0;
+    // THP disabled, or no free huge page: small pages would only cost the alignment slack
+    if (anon_huge_kb(aligned) == 0) {
+        munmap(aligned, size);
+        return -1;
+    }
+    region->ptr = aligned;
+    region->size = size;
+    region->backing = HUGE_BACKING_TRANSPARENT;
+    return 0;
+}
+
+const char* huge_alloc(huge_region_t* region, size_t size, huge_pages_t mode) {
+    if (!region) return "Region is NULL";
+    memset(region, 0, sizeof(*region));
+    if (size == 0) size = 1;
+    if (mode != HUGE_PAGES_OFF && size >= HUGE_PAGE_SIZE / 2) {
+        size_t rounded = round_to_huge_pages(size);
+        if (mode == HUGE_PAGES_EXPLICIT && map_explicit(region, rounded) == 0) return NULL;
+        if (map_transparent(region, rounded) == 0) return NULL;
+    }
+    region->ptr = malloc(size);
+    if (!region->ptr) return "Could not allocate memory";
+    region->size = size;
+    region->backing = HUGE_BACKING_HEAP;
+    return NULL;
+}
+
+const char* huge_realloc(huge_region_t* region, size_t size, huge_pages_t mode) {
+    if (!region) return "Region is NULL";
+    if (size == 0) size = 1;
+    // A heap block that would stay on the heap can be grown in place
+    if (region->backing == HUGE_BACKING_HEAP && (mode == HUGE_PAGES_OFF || size < HUGE_PAGE_SIZE / 2)) {
+        void* resized = realloc(region->ptr, size);
+        if (!resized) return "Could not allocate memory";
+        region->ptr = resized;
+        region->size = size;
+        return NULL;
+    }
+    // Mapped blocks are whole huge pages, which often already hold the new size
+    if (region->backing != HUGE_BACKING_HEAP && size <= region->size) return NULL;
+    huge_region_t resized;
+    const char* err = huge_alloc(&resized, size, mode);
+    if (err) return err;
+    if (region->ptr) memcpy(resized.ptr, region->ptr, region->size < size ? region->size : size);
+    huge_free(region);
+    *region = resized;
+    return NULL;
+}
+
+void huge_free(huge_region_t* region) {
+    if (!region || !region->ptr) return;
+    if (region->backing == HUGE_BACKING_HEAP) {
+        free(region->ptr);
+    } else {
+        munmap(region->ptr, region->size);
+    }
+    memset(region, 0, sizeof(*region));
+}
+
+const char* huge_backing_name(huge_backing_t backing) {
+    switch (backing) {
+        case HUGE_BACKING_TRANSPARENT: return "transparent huge pages";
+        case HUGE_BACKING_EXPLICIT: return "explicit huge pages";
+        default: return "heap";
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef HUGE_ALLOC_H
+#define HUGE_ALLOC_H
+
+#include <stddef.h>
+
+#define HUGE_PAGE_SIZE (2UL * 1024 * 1024) // x86-64 and arm64 (4 KB granule) PMD size
+
+typedef enum {
+    HUGE_PAGES_OFF = 0, // Heap only
+    HUGE_PAGES_TRANSPARENT, // Aligned anonymous mappings advised with MADV_HUGEPAGE
+    HUGE_PAGES_EXPLICIT // Reserved hugetlb pages (MAP_HUGETLB), transparent when the pool is empty
+} huge_pages_t;
+
+typedef enum {
+    HUGE_BACKING_HEAP = 0, // malloc: huge pages were off, refused, or not worth it for the size
+    HUGE_BACKING_TRANSPARENT, // Transparent huge pages, confirmed in /proc/self/smaps
+    HUGE_BACKING_EXPLICIT // Reserved hugetlb pages
+} huge_backing_t;
+
+/**
+ * A block of memory together with how it was obtained, needed to free it
+ */
+typedef struct {
+    void* ptr;
+    size_t size; // Bytes usable at ptr; whole huge pages unless on the heap
+    huge_backing_t backing;
+} huge_region_t;
+
+/**
+ * Allocate a block, on huge pages when the mode asks for them and the kernel has them
+ * Tries reserved pages first (explicit mode), then transparent huge pages, then
+ * the heap. A block smaller than half a huge page always goes to the heap, since
+ * rounding it up would waste more memory than the TLB entries it saves. Huge
+ * pages are faulted in here so the hot path never takes the fault.
+ * @param region Output block; region->backing tells what was actually obtained
+ * @param size Bytes needed
+ * @param mode Backing to try for
+ * @return NULL on success, error message on failure
+ */
+const char* huge_alloc(huge_region_t* region, size_t size, huge_pages_t mode);
+
+/**
+ * Grow or shrink a block, keeping the first min(old, new) bytes
+ * The new block is allocated before the old one is released, so on failure
+ * the old block is left untouched.
+ * @param region Block to resize, updated in place
+ * @param size Bytes needed
+ * @param mode Backing to try for
+ * @return NULL on success, error message on failure
+ */
+const char* huge_realloc(huge_region_t* region, size_t size, huge_pages_t mode);
+
+/**
+ * Release a block allocated by huge_alloc and clear the region
+ * @param region Block to release; a cleared region is ignored
+ */
+void huge_free(huge_region_t* region);
+
+/**
+ * Human readable name of a backing, for reports
+ * @param backing Backing to name
+ * @return Static string
+ */
+const char* huge_backing_name(huge_backing_t backing);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#define METRICS_LATENCY_BUCKETS 40 // Bucket k counts latencies in [2^(k-1), 2^k) ns; the last one is open ended
+
+/**
+ * Snapshot of one stage's counters, read without taking any lock
+ * Counters only grow; placed - retired is the number of lines queued or in flight
+ */
+typedef struct {
+    unsigned long long placed; // Lines accepted into the queue
+    unsigned long long retired; // Lines passed on, handed off or discarded by an abort
+    unsigned long long processed; // Lines transformed and placed downstream
+    unsigned long long filtered; // Lines the transform dropped (PLUGIN_DROP), included in processed
+    unsigned long long latency_sum_ns; // Sum of per-line latencies
+    unsigned long long service_ns; // Time spent in the transform alone, summed over the workers
+    unsigned long long buffer_allocations; // Output buffers the workers allocated or resized
+    unsigned long long latency[METRICS_LATENCY_BUCKETS]; // Lines per latency bucket
+    int capacity; // Current queue capacity
+    int finished; // Consumer thread exited
+    int paused; // Held by plugin_pause
+    int workers; // Consumer threads
+    int batch; // Most lines taken at once
+    unsigned long long throttled_ns; // Time the consumer thread waited on its rate limit
+    unsigned long long spilled; // Lines on disk now, waiting for room in the queue
+    unsigned long long spilled_total; // Lines ever spilled to disk
+} stage_metrics_t;
+
+/**
+ * Latency bucket of a duration
+ * @param ns Duration in nanoseconds
+ * @return Index into stage_metrics_t.latency
+ */
+static inline int metrics_latency_bucket(long long ns) {
+    if (ns <= 0) return 0;
+    int bucket = 64 - __builtin_clzll((unsigned long long)ns);
+    return bucket < METRICS_LATENCY_BUCKETS ? bucket : METRICS_LATENCY_BUCKETS - 1;
+}
+
+#endif
@@ -1,10 +1,19 @@
 #include <stdio.h>
+#include <errno.h>
+#include <time.h>
 #include "monitor.h"
 
 int monitor_init(monitor_t* monitor) {
     monitor->signaled = 0;
+    monitor->latched = 0;
     if (pthread_mutex_init(&monitor->mutex, NULL)) return -1;
-    if (pthread_cond_init(&monitor->cond, NULL)) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    // Timed waits use the monotonic clock
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    int err = pthread_cond_init(&monitor->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    if (err) {
         pthread_mutex_destroy(&monitor->mutex);
         return -1;
     }
@@ -28,10 +37,21 @@ void monitor_signal(monitor_t* monitor) {
     return;
 }
 
+void monitor_broadcast(monitor_t* monitor) {
+    if (!monitor) return;
+    pthread_mutex_lock(&monitor->mutex);
+    monitor->signaled = 1;
+    monitor->latched = 1;
+    pthread_cond_broadcast(&monitor->cond);
+    pthread_mutex_unlock(&monitor->mutex);
+    return;
+}
+
 void monitor_reset(monitor_t* monitor) {
     if (!monitor) return;
     pthread_mutex_lock(&monitor->mutex);
     monitor->signaled = 0;
+    monitor->latched = 0;
     pthread_mutex_unlock(&monitor->mutex);
     return;
 }
@@ -42,7 +62,28 @@ int monitor_wait(monitor_t* monitor) {
     while (!monitor->signaled) {
         pthread_cond_wait(&monitor->cond, &monitor->mutex);
     }
-    monitor->signaled = 0;
+    if (!monitor->latched) monitor->signaled = 0;
     pthread_mutex_unlock(&monitor->mutex);
     return 0;
+}
+
+int monitor_timed_wait(monitor_t* monitor, long timeout_ms) {
+    if (!monitor || timeout_ms < 0) return -1;
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&monitor->mutex);
+    int rc = 0;
+    while (!monitor->signaled && rc != ETIMEDOUT) {
+        rc = pthread_cond_timedwait(&monitor->cond, &monitor->mutex, &deadline);
+    }
+    int signaled = monitor->signaled;
+    if (!monitor->latched) monitor->signaled = 0;
+    pthread_mutex_unlock(&monitor->mutex);
+    return signaled ? 0 : -1;
 }
\ No newline at end of file
@@ -7,6 +7,7 @@ typedef struct {
     pthread_mutex_t mutex; // Mutex for thread safety
     pthread_cond_t cond; // Condition variable
     int signaled; // Flag to remember if monitor has been signaled
+    int latched; // Set by monitor_broadcast: waits keep returning until monitor_reset
 } monitor_t;
 
 /**
@@ -28,6 +29,14 @@ void monitor_destroy(monitor_t* monitor);
  */
 void monitor_signal(monitor_t* monitor);
 
+/**
+ * Signal a monitor for good: every current waiter wakes up, and later waits
+ * return at once until monitor_reset. For states that never revert, such as
+ * a finished queue, where monitor_signal would wake only one of several waiters.
+ * @param monitor Pointer to the monitor structure
+ */
+void monitor_broadcast(monitor_t* monitor);
+
 /**
  * Reset a monitor (clear the monitor state)
  * @param monitor Pointer to the monitor structure
@@ -41,4 +50,13 @@ void monitor_reset(monitor_t* monitor);
  */
 int monitor_wait(monitor_t* monitor);
 
+/**
+ * Wait for a monitor to be signaled, giving up after a timeout
+ * The timeout is measured on the monotonic clock, so wall clock changes do not affect it
+ * @param monitor Pointer to the monitor structure
+ * @param timeout_ms Maximum time to wait in milliseconds
+ * @return 0 if signaled, -1 on timeout or failure
+ */
+int monitor_timed_wait(monitor_t* monitor, long timeout_ms);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,49 @@
+#include <stdlib.h>
+#include <string.h>
+#include "scratch_pool.h"
+
+void scratch_pool_init(scratch_pool_t* pool, size_t watermark) {
+    memset(pool->slots, 0, sizeof(pool->slots));
+    pool->watermark = watermark;
+    pool->rounds = 0;
+    pool->allocations = 0;
+}
+
+void scratch_pool_destroy(scratch_pool_t* pool) {
+    for (int i = 0; i < SCRATCH_POOL_SLOTS; i++) free(pool->slots[i].data);
+    memset(pool->slots, 0, sizeof(pool->slots));
+}
+
+static int resize(scratch_pool_t* pool, scratch_slot_t* slot, size_t size) {
+    char* data = realloc(slot->data, size);
+    if (!data) return -1;
+    slot->data = data;
+    slot->size = size;
+    pool->allocations++;
+    return 0;
+}
+
+char* scratch_pool_get(scratch_pool_t* pool, int slot, size_t size) {
+    scratch_slot_t* entry = &pool->slots[slot];
+    if (size > entry->peak) entry->peak = size;
+    if (size <= entry->size) return entry->data;
+    size_t grown = entry->size ? entry->size * 2 : SCRATCH_POOL_MIN_SIZE;
+    while (grown < size) grown *= 2;
+    return resize(pool, entry, grown) == 0 ? entry->data : NULL;
+}
+
+int scratch_pool_owns(const scratch_pool_t* pool, int slot, const void* ptr) {
+    return ptr != NULL && pool->slots[slot].data == ptr;
+}
+
+void scratch_pool_end_round(scratch_pool_t* pool) {
+    if (++pool->rounds < SCRATCH_POOL_TRIM_ROUNDS) return;
+    pool->rounds = 0;
+    for (int i = 0; i < SCRATCH_POOL_SLOTS; i++) {
+        scratch_slot_t* slot = &pool->slots[i];
+        size_t target = slot->peak * 2 > pool->watermark ? slot->peak * 2 : pool->watermark;
+        // A failed shrink keeps the larger buffer, which is still valid
+        if (slot->data && slot->peak < slot->size / 4 && target < slot->size) resize(pool, slot, target);
+        slot->peak = 0;
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef SCRATCH_POOL_H
+#define SCRATCH_POOL_H
+
+#include <stddef.h>
+
+#define SCRATCH_POOL_SLOTS 64 // Buffers per pool, one per line of the largest batch
+#define SCRATCH_POOL_MIN_SIZE 256 // First allocation of a slot
+#define SCRATCH_POOL_TRIM_ROUNDS 1024 // Rounds between two trims
+
+typedef struct {
+    char* data;
+    size_t size;
+    size_t peak; // Largest request since the last trim
+} scratch_slot_t;
+
+/**
+ * Reusable output buffers, one per slot
+ * A slot grows geometrically to the largest line it has held, so after a
+ * warm-up a steady stream of lines allocates nothing. Every
+ * SCRATCH_POOL_TRIM_ROUNDS rounds, a slot whose requests stayed under a quarter
+ * of its size shrinks to twice its peak, never below the watermark. Not thread
+ * safe: each consumer thread owns its pool.
+ */
+typedef struct {
+    scratch_slot_t slots[SCRATCH_POOL_SLOTS];
+    size_t watermark; // Size a slot is never trimmed below
+    int rounds; // Rounds since the last trim
+    unsigned long long allocations; // Allocations and reallocations made so far
+} scratch_pool_t;
+
+/**
+ * Initialize an empty pool; nothing is allocated until a slot is used
+ * @param pool Pointer to the pool structure
+ * @param watermark Bytes a used slot keeps across trims
+ */
+void scratch_pool_init(scratch_pool_t* pool, size_t watermark);
+
+/**
+ * Free every slot
+ * @param pool Pointer to the pool structure
+ */
+void scratch_pool_destroy(scratch_pool_t* pool);
+
+/**
+ * Buffer of a slot, grown to at least size bytes
+ * Growing keeps the contents, like realloc, but may move the buffer.
+ * @param pool Pointer to the pool structure
+ * @param slot Slot index, below SCRATCH_POOL_SLOTS
+ * @param size Bytes needed
+ * @return The slot's buffer, NULL when out of memory
+ */
+char* scratch_pool_get(scratch_pool_t* pool, int slot, size_t size);
+
+/**
+ * Whether a pointer is a slot's current buffer
+ * @param pool Pointer to the pool structure
+ * @param slot Slot index
+ * @param ptr Pointer to test
+ * @return Non-zero if ptr is the slot's buffer
+ */
+int scratch_pool_owns(const scratch_pool_t* pool, int slot, const void* ptr);
+
+/**
+ * Mark the end of a round (a batch); trims oversized slots now and then
+ * @param pool Pointer to the pool structure
+ */
+void scratch_pool_end_round(scratch_pool_t* pool);
+
+#endif
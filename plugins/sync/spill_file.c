@@ -0,0 +1,132 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "spill_file.h"
+
+// Room for the prefix, the '.' and any segment number
+#define SEGMENT_PATH_MAX (SPILL_PATH_MAX + 16)
+
+static void segment_path(const spill_file_t* spill, int segment, char* path, size_t size) {
+    snprintf(path, size, "%s.%d", spill->prefix, segment);
+}
+
+const char* spill_file_init(spill_file_t* spill, const char* dir, const char* name, size_t header_size) {
+    if (!spill || !dir || !name) return "Spill file, directory or name is NULL";
+    memset(spill, 0, sizeof(*spill));
+    if (snprintf(spill->prefix, sizeof(spill->prefix), "%s/%s", dir, name) >= (int)sizeof(spill->prefix)) {
+        return "Spill path too long";
+    }
+    spill->header_size = header_size;
+    return NULL;
+}
+
+void spill_file_destroy(spill_file_t* spill) {
+    if (!spill) return;
+    if (spill->writer) fclose(spill->writer);
+    if (spill->reader) fclose(spill->reader);
+    char path[SEGMENT_PATH_MAX];
+    for (int segment = spill->read_segment; segment <= spill->write_segment; segment++) {
+        segment_path(spill, segment, path, sizeof(path));
+        unlink(path);
+    }
+    spill->writer = NULL;
+    spill->reader = NULL;
+    // The next append starts a fresh segment, which the reader starts from too
+    spill->write_segment++;
+    spill->read_segment = spill->write_segment;
+    spill->write_bytes = 0;
+    spill->unflushed = 0;
+    spill->broken = 0;
+    spill->count = 0;
+    spill->bytes = 0;
+}
+
+// Cut a partly written record off the newest segment, so it ends on the last whole record
+static int rewind_writer(spill_file_t* spill) {
+    clearerr(spill->writer);
+    // The buffer may hold part of the record; it has to reach the file to be cut off
+    if (fflush(spill->writer) != 0) return -1;
+    // A failed flush drops the buffer: records appended before this one may be missing too
+    struct stat st;
+    if (fstat(fileno(spill->writer), &st) != 0 || st.st_size < (off_t)spill->write_bytes) return -1;
+    if (ftruncate(fileno(spill->writer), (off_t)spill->write_bytes) != 0) return -1;
+    return fseeko(spill->writer, (off_t)spill->write_bytes, SEEK_SET);
+}
+
+const char* spill_file_append(spill_file_t* spill, const char* item, const void* header) {
+    char path[SEGMENT_PATH_MAX];
+    if (spill->broken) return "Spill segment is broken by an earlier failed write";
+    if (spill->writer && spill->write_bytes >= SPILL_SEGMENT_BYTES) {
+        // Closing flushes the segment, so the reader can take it whole
+        fclose(spill->writer);
+        spill->writer = NULL;
+        spill->write_segment++;
+    }
+    if (!spill->writer) {
+        segment_path(spill, spill->write_segment, path, sizeof(path));
+        spill->writer = fopen(path, "wb");
+        if (!spill->writer) return "Could not create spill segment";
+        spill->write_bytes = 0;
+    }
+    uint32_t length = (uint32_t)strlen(item);
+    if (fwrite(header, spill->header_size, 1, spill->writer) != 1 ||
+        fwrite(&length, sizeof(length), 1, spill->writer) != 1 ||
+        fwrite(item, 1, length, spill->writer) != length) {
+        // A torn header or length would misframe every record appended after it
+        if (rewind_writer(spill) != 0) spill->broken = 1;
+        return "Could not write spill segment";
+    }
+    size_t record_bytes = spill->header_size + sizeof(length) + length;
+    spill->write_bytes += record_bytes;
+    spill->unflushed = 1;
+    spill->count++;
+    spill->bytes += record_bytes;
+    return NULL;
+}
+
+// Header of the next record, moving on to the next segment when this one is read through
+static const char* read_header(spill_file_t* spill, void* header) {
+    char path[SEGMENT_PATH_MAX];
+    for (;;) {
+        if (!spill->reader) {
+            segment_path(spill, spill->read_segment, path, sizeof(path));
+            spill->reader = fopen(path, "rb");
+            if (!spill->reader) return "Could not open spill segment";
+        }
+        // A segment still being written has to reach the file before it is read
+        if (spill->read_segment == spill->write_segment && spill->unflushed) {
+            if (fflush(spill->writer) != 0) return "Could not write spill segment";
+            spill->unflushed = 0;
+        }
+        clearerr(spill->reader);
+        if (fread(header, spill->header_size, 1, spill->reader) == 1) return NULL;
+        if (spill->read_segment == spill->write_segment) return "Spill segment ended early";
+        // Read through and closed by the writer: nothing will be added to it
+        fclose(spill->reader);
+        spill->reader = NULL;
+        segment_path(spill, spill->read_segment, path, sizeof(path));
+        unlink(path);
+        spill->read_segment++;
+    }
+}
+
+const char* spill_file_read(spill_file_t* spill, char** item, void* header) {
+    if (spill->count == 0) return "Spill file is empty";
+    const char* err = read_header(spill, header);
+    if (err) return err;
+    uint32_t length;
+    if (fread(&length, sizeof(length), 1, spill->reader) != 1) return "Spill segment ended early";
+    char* text = malloc(length + 1);
+    if (!text) return "Could not allocate memory for spilled record";
+    if (fread(text, 1, length, spill->reader) != length) {
+        free(text);
+        return "Spill segment ended early";
+    }
+    text[length] = '\0';
+    *item = text;
+    spill->count--;
+    spill->bytes -= spill->header_size + sizeof(length) + length;
+    return NULL;
+}
@@ -0,0 +1,67 @@
+#ifndef SPILL_FILE_H
+#define SPILL_FILE_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#define SPILL_SEGMENT_BYTES (16 * 1024 * 1024) // A segment is closed and a new one started past this size
+#define SPILL_PATH_MAX 512
+
+/**
+ * FIFO of records kept on disk, in segment files written sequentially
+ * Records are appended to the newest segment and read back from the oldest
+ * one; a segment is deleted as soon as it has been read through, so the disk
+ * holds little more than what is still queued. Each record is a fixed-size
+ * header (the caller's metadata), the string's length and its bytes.
+ * Not thread safe: the owner's lock guards it.
+ */
+typedef struct {
+    char prefix[SPILL_PATH_MAX]; // Segment n is <prefix>.<n>
+    FILE* writer; // Newest segment, NULL until the first append
+    FILE* reader; // Oldest segment, NULL until the first read
+    int write_segment;
+    int read_segment;
+    size_t write_bytes; // Bytes appended to the newest segment
+    int unflushed; // The writer holds buffered records the reader cannot see yet
+    int broken; // A failed append could not be cut off; later appends fail
+    size_t header_size;
+    unsigned long long count; // Records appended and not read back yet
+    unsigned long long bytes; // Bytes of those records
+} spill_file_t;
+
+/**
+ * Prepare an empty spill file; no file is created until the first append
+ * @param spill Pointer to the spill structure
+ * @param dir Existing directory receiving the segment files
+ * @param name Unique name of the segment files within dir
+ * @param header_size Bytes of the header stored with every record
+ * @return NULL on success, error message on failure
+ */
+const char* spill_file_init(spill_file_t* spill, const char* dir, const char* name, size_t header_size);
+
+/**
+ * Close and delete every segment, discarding the records left
+ * The spill is empty afterwards and can be appended to again.
+ * @param spill Pointer to the spill structure
+ */
+void spill_file_destroy(spill_file_t* spill);
+
+/**
+ * Append a record after every record already spilled
+ * @param spill Pointer to the spill structure
+ * @param item Record string
+ * @param header Record header, header_size bytes
+ * @return NULL on success, error message on failure
+ */
+const char* spill_file_append(spill_file_t* spill, const char* item, const void* header);
+
+/**
+ * Read back the oldest record; spill->count must be greater than 0
+ * @param spill Pointer to the spill structure
+ * @param item Output record string, allocated with malloc (caller takes ownership)
+ * @param header Output header, header_size bytes
+ * @return NULL on success, error message on failure
+ */
+const char* spill_file_read(spill_file_t* spill, char** item, void* header);
+
+#endif
@@ -0,0 +1,183 @@
+#include <stdlib.h>
+#include <string.h>
+#include "stage_cache.h"
+
+static cache_shard_t* shard_for(stage_cache_t* cache, uint64_t hash) {
+    // Low bits pick the bucket, high bits pick the shard
+    return &cache->shards[(hash >> 56) % (uint64_t)cache->num_shards];
+}
+
+static size_t entry_bytes(const cache_entry_t* entry) {
+    return sizeof(cache_entry_t) + entry->key_len + 1 + sizeof(cache_value_t) + entry->value->len + 1;
+}
+
+static void free_entry(cache_entry_t* entry) {
+    stage_cache_release(entry->value);
+    free(entry->key);
+    free(entry);
+}
+
+static void unlink_entry(cache_shard_t* shard, cache_entry_t* entry) {
+    cache_entry_t** link = &shard->buckets[entry->hash & (uint64_t)(shard->num_buckets - 1)];
+    while (*link != entry) link = &(*link)->next;
+    *link = entry->next;
+}
+
+// Caller holds the shard mutex and the shard is full: returns the slot it freed
+static int evict_one(cache_shard_t* shard) {
+    for (;;) {
+        cache_entry_t* entry = shard->slots[shard->hand];
+        int slot = shard->hand;
+        shard->hand = (shard->hand + 1) % shard->capacity;
+        if (entry->referenced) {
+            entry->referenced = 0;
+            continue;
+        }
+        unlink_entry(shard, entry);
+        shard->bytes -= entry_bytes(entry);
+        free_entry(entry);
+        shard->slots[slot] = NULL;
+        shard->count--;
+        shard->evictions++;
+        return slot;
+    }
+}
+
+const char* stage_cache_init(stage_cache_t* cache, int capacity) {
+    if (!cache) return "Cache is NULL";
+    if (capacity <= 0) return "Capacity must be greater than 0";
+    cache->num_shards = capacity < STAGE_CACHE_MAX_SHARDS ? capacity : STAGE_CACHE_MAX_SHARDS;
+    int per_shard = (capacity + cache->num_shards - 1) / cache->num_shards;
+    int num_buckets = 1;
+    while (num_buckets < per_shard * 2) num_buckets <<= 1;
+    for (int i = 0; i < cache->num_shards; i++) {
+        cache_shard_t* shard = &cache->shards[i];
+        memset(shard, 0, sizeof(*shard));
+        shard->capacity = per_shard;
+        shard->num_buckets = num_buckets;
+        shard->buckets = calloc(num_buckets, sizeof(cache_entry_t*));
+        shard->slots = calloc(per_shard, sizeof(cache_entry_t*));
+        if (!shard->buckets || !shard->slots) {
+            free(shard->buckets);
+            free(shard->slots);
+            cache->num_shards = i;
+            stage_cache_destroy(cache);
+            return "Failed to allocate memory";
+        }
+        pthread_mutex_init(&shard->mutex, NULL);
+    }
+    return NULL;
+}
+
+void stage_cache_destroy(stage_cache_t* cache) {
+    if (!cache) return;
+    for (int i = 0; i < cache->num_shards; i++) {
+        cache_shard_t* shard = &cache->shards[i];
+        for (int j = 0; j < shard->capacity; j++) {
+            if (shard->slots[j]) free_entry(shard->slots[j]);
+        }
+        free(shard->slots);
+        free(shard->buckets);
+        pthread_mutex_destroy(&shard->mutex);
+    }
+    cache->num_shards = 0;
+    return;
+}
+
+uint64_t stage_cache_hash(const char* data, size_t len) {
+    uint64_t hash = 0x9e3779b97f4a7c15ULL ^ (uint64_t)len;
+    uint64_t word;
+    while (len >= sizeof(word)) {
+        memcpy(&word, data, sizeof(word));
+        hash = (hash ^ word) * 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 32;
+        data += sizeof(word);
+        len -= sizeof(word);
+    }
+    word = 0;
+    memcpy(&word, data, len);
+    hash = (hash ^ word) * 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 29;
+    return hash;
+}
+
+cache_value_t* stage_cache_get(stage_cache_t* cache, const char* key, size_t key_len, uint64_t hash) {
+    if (!cache || !key) return NULL;
+    cache_shard_t* shard = shard_for(cache, hash);
+    pthread_mutex_lock(&shard->mutex);
+    cache_entry_t* entry = shard->buckets[hash & (uint64_t)(shard->num_buckets - 1)];
+    while (entry && (entry->hash != hash || entry->key_len != key_len || memcmp(entry->key, key, key_len) != 0)) {
+        entry = entry->next;
+    }
+    cache_value_t* value = NULL;
+    if (entry) {
+        entry->referenced = 1;
+        value = entry->value;
+        atomic_fetch_add_explicit(&value->refs, 1, memory_order_relaxed);
+        shard->hits++;
+    } else {
+        shard->misses++;
+    }
+    pthread_mutex_unlock(&shard->mutex);
+    return value;
+}
+
+cache_value_t* stage_cache_put(stage_cache_t* cache, const char* key, size_t key_len, uint64_t hash, const char* value) {
+    if (!cache || !key) return NULL;
+    size_t value_len = value ? strlen(value) : 0;
+    cache_entry_t* entry = malloc(sizeof(cache_entry_t));
+    char* key_copy = malloc(key_len + 1);
+    cache_value_t* stored = malloc(sizeof(cache_value_t) + value_len + 1);
+    if (!entry || !key_copy || !stored) {
+        free(entry);
+        free(key_copy);
+        free(stored);
+        return NULL;
+    }
+    memcpy(key_copy, key, key_len);
+    key_copy[key_len] = '\0';
+    memcpy(stored->data, value ? value : "", value_len + 1);
+    stored->len = value_len;
+    stored->dropped = value == NULL;
+    atomic_init(&stored->refs, 2); // The cache's and the caller's
+    entry->hash = hash;
+    entry->key = key_copy;
+    entry->key_len = key_len;
+    entry->value = stored;
+    entry->referenced = 0;
+
+    cache_shard_t* shard = shard_for(cache, hash);
+    pthread_mutex_lock(&shard->mutex);
+    // Evictions refill their slot at once, so free slots are always the tail
+    int slot = shard->count < shard->capacity ? shard->count : evict_one(shard);
+    cache_entry_t** bucket = &shard->buckets[hash & (uint64_t)(shard->num_buckets - 1)];
+    entry->next = *bucket;
+    *bucket = entry;
+    shard->slots[slot] = entry;
+    shard->count++;
+    shard->bytes += entry_bytes(entry);
+    pthread_mutex_unlock(&shard->mutex);
+    return stored;
+}
+
+void stage_cache_release(cache_value_t* value) {
+    if (!value) return;
+    if (atomic_fetch_sub_explicit(&value->refs, 1, memory_order_acq_rel) == 1) free(value);
+}
+
+void stage_cache_stats(stage_cache_t* cache, stage_cache_stats_t* stats) {
+    if (!cache || !stats) return;
+    memset(stats, 0, sizeof(*stats));
+    for (int i = 0; i < cache->num_shards; i++) {
+        cache_shard_t* shard = &cache->shards[i];
+        pthread_mutex_lock(&shard->mutex);
+        stats->hits += shard->hits;
+        stats->misses += shard->misses;
+        stats->evictions += shard->evictions;
+        stats->entries += shard->count;
+        stats->capacity += shard->capacity;
+        stats->bytes += shard->bytes;
+        pthread_mutex_unlock(&shard->mutex);
+    }
+    return;
+}
@@ -0,0 +1,113 @@
+#ifndef STAGE_CACHE_H
+#define STAGE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define STAGE_CACHE_MAX_SHARDS 16
+
+typedef struct {
+    atomic_int refs; // One reference held by the cache while resident, one per reader
+    size_t len; // Length of data, without the terminator
+    int dropped; // The input produced no output; data is empty
+    char data[]; // Stored output, NUL terminated
+} cache_value_t;
+
+typedef struct cache_entry {
+    uint64_t hash;
+    size_t key_len;
+    char* key;
+    cache_value_t* value;
+    int referenced; // CLOCK bit, set on every hit
+    struct cache_entry* next; // Next entry in the same bucket
+} cache_entry_t;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    cache_entry_t** buckets;
+    cache_entry_t** slots; // Resident entries, swept by the CLOCK hand
+    int num_buckets;
+    int capacity;
+    int count;
+    int hand;
+    size_t bytes;
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long evictions;
+} cache_shard_t;
+
+typedef struct {
+    cache_shard_t shards[STAGE_CACHE_MAX_SHARDS];
+    int num_shards;
+} stage_cache_t;
+
+typedef struct {
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long evictions;
+    int entries;
+    int capacity;
+    size_t bytes; // Keys, values and entry overhead currently resident
+} stage_cache_stats_t;
+
+/**
+ * Initialize a bounded memo cache
+ * Entries are spread over independently locked shards by hash. Eviction is
+ * CLOCK (second chance): a hit only sets a bit, so lookups never reorder lists.
+ * @param cache Pointer to the cache structure
+ * @param capacity Maximum number of resident entries
+ * @return NULL on success, error message on failure
+ */
+const char* stage_cache_init(stage_cache_t* cache, int capacity);
+
+/**
+ * Free every entry; values still referenced by readers stay valid until released
+ * @param cache Pointer to the cache structure
+ */
+void stage_cache_destroy(stage_cache_t* cache);
+
+/**
+ * Hash input bytes, eight at a time
+ * @param data Bytes to hash
+ * @param len Number of bytes
+ * @return 64-bit hash
+ */
+uint64_t stage_cache_hash(const char* data, size_t len);
+
+/**
+ * Look up the stored output for an input
+ * @param cache Pointer to the cache structure
+ * @param key Input bytes
+ * @param key_len Input length
+ * @param hash Hash of the input from stage_cache_hash
+ * @return Referenced value to pass to stage_cache_release, NULL on a miss
+ */
+cache_value_t* stage_cache_get(stage_cache_t* cache, const char* key, size_t key_len, uint64_t hash);
+
+/**
+ * Store the output computed for an input, evicting an entry if the shard is full
+ * @param cache Pointer to the cache structure
+ * @param key Input bytes
+ * @param key_len Input length
+ * @param hash Hash of the input from stage_cache_hash
+ * @param value Output string (copied), NULL to remember that the input is dropped
+ * @return Referenced stored value to pass to stage_cache_release, NULL if out of memory
+ */
+cache_value_t* stage_cache_put(stage_cache_t* cache, const char* key, size_t key_len, uint64_t hash, const char* value);
+
+/**
+ * Drop a reference returned by stage_cache_get or stage_cache_put
+ * @param value Value to release, may be NULL
+ */
+void stage_cache_release(cache_value_t* value);
+
+/**
+ * Sum the counters of every shard
+ * @param cache Pointer to the cache structure
+ * @param stats Output snapshot
+ */
+void stage_cache_stats(stage_cache_t* cache, stage_cache_stats_t* stats);
+
+#endif
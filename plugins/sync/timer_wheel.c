@@ -0,0 +1,170 @@
+#include <stdlib.h>
+#include <string.h>
+#include "timer_wheel.h"
+
+#define LEVEL_SPAN(level) (1ULL << (TIMER_WHEEL_BITS * (level))) // Ticks covered by one slot of a level
+
+const char* timer_wheel_init(timer_wheel_t* wheel, long long tick_ns, long long now_ns) {
+    if (!wheel) return "Wheel is NULL";
+    if (tick_ns <= 0) return "Tick must be greater than 0";
+    memset(wheel->slots, 0, sizeof(wheel->slots));
+    wheel->now = 0;
+    wheel->origin_ns = now_ns;
+    wheel->tick_ns = tick_ns;
+    wheel->pending = 0;
+    wheel->spare = NULL;
+    return NULL;
+}
+
+static void free_list(timer_entry_t* entry) {
+    while (entry) {
+        timer_entry_t* next = entry->next;
+        free(entry);
+        entry = next;
+    }
+}
+
+void timer_wheel_destroy(timer_wheel_t* wheel) {
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) free_list(wheel->slots[level][slot].head);
+    }
+    free_list(wheel->spare);
+    memset(wheel->slots, 0, sizeof(wheel->slots));
+    wheel->spare = NULL;
+    wheel->pending = 0;
+}
+
+// File an entry under the lowest level whose span still reaches its tick
+static void place(timer_wheel_t* wheel, timer_entry_t* entry) {
+    unsigned long long due = entry->due < wheel->now ? wheel->now : entry->due;
+    unsigned long long delta = due - wheel->now;
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= LEVEL_SPAN(level + 1)) level++;
+    // Beyond the top level: wait in its farthest slot, the real tick is kept for the next placement
+    if (delta >= LEVEL_SPAN(TIMER_WHEEL_LEVELS)) due = wheel->now + LEVEL_SPAN(TIMER_WHEEL_LEVELS) - 1;
+    timer_slot_t* slot = &wheel->slots[level][(due >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1)];
+    entry->next = NULL;
+    if (slot->tail) {
+        slot->tail->next = entry;
+    } else {
+        slot->head = entry;
+    }
+    slot->tail = entry;
+}
+
+static timer_entry_t* detach(timer_slot_t* slot) {
+    timer_entry_t* entry = slot->head;
+    slot->head = NULL;
+    slot->tail = NULL;
+    return entry;
+}
+
+static void recycle(timer_wheel_t* wheel, timer_entry_t* entry) {
+    entry->next = wheel->spare;
+    wheel->spare = entry;
+}
+
+const char* timer_wheel_schedule(timer_wheel_t* wheel, long long due_ns, timer_fn fn, void* arg) {
+    if (!wheel) return "Wheel is NULL";
+    if (!fn) return "Callback is NULL";
+    timer_entry_t* entry = wheel->spare;
+    if (entry) {
+        wheel->spare = entry->next;
+    } else {
+        entry = malloc(sizeof(timer_entry_t));
+        if (!entry) return "Could not allocate memory for timer";
+    }
+    // Round up, so a timer never fires before its time
+    long long offset = due_ns - wheel->origin_ns;
+    entry->due = offset <= 0 ? 0 : (unsigned long long)((offset + wheel->tick_ns - 1) / wheel->tick_ns);
+    entry->fn = fn;
+    entry->arg = arg;
+    place(wheel, entry);
+    wheel->pending++;
+    return NULL;
+}
+
+// Spread the higher-level slots that turn over at the current tick, then fire its level 0 slot
+static int fire_tick(timer_wheel_t* wheel) {
+    unsigned long long tick = wheel->now;
+    int top = 1;
+    while (top < TIMER_WHEEL_LEVELS && (tick & (LEVEL_SPAN(top) - 1)) == 0) top++;
+    // Highest level first, so timers it hands down are spread again by the level below
+    for (int level = top - 1; level >= 1; level--) {
+        timer_slot_t* slot = &wheel->slots[level][(tick >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1)];
+        timer_entry_t* entry = detach(slot);
+        while (entry) {
+            timer_entry_t* next = entry->next;
+            place(wheel, entry);
+            entry = next;
+        }
+    }
+    timer_entry_t* entry = detach(&wheel->slots[0][tick & (TIMER_WHEEL_SLOTS - 1)]);
+    // Timers the callbacks schedule for this tick or earlier land on the next one
+    wheel->now = tick + 1;
+    int fired = 0;
+    while (entry) {
+        timer_entry_t* next = entry->next;
+        timer_fn fn = entry->fn;
+        void* arg = entry->arg;
+        recycle(wheel, entry);
+        wheel->pending--;
+        fn(arg, 0);
+        fired++;
+        entry = next;
+    }
+    return fired;
+}
+
+int timer_wheel_advance(timer_wheel_t* wheel, long long now_ns) {
+    if (now_ns < wheel->origin_ns) return 0;
+    unsigned long long target = (unsigned long long)((now_ns - wheel->origin_ns) / wheel->tick_ns);
+    int fired = 0;
+    while (wheel->now <= target) {
+        if (wheel->pending == 0) {
+            // Nothing to spread or fire: an empty wheel jumps ahead
+            wheel->now = target + 1;
+            break;
+        }
+        fired += fire_tick(wheel);
+    }
+    return fired;
+}
+
+int timer_wheel_cancel_all(timer_wheel_t* wheel) {
+    int cancelled = 0;
+    while (wheel->pending > 0) {
+        for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+            for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+                timer_entry_t* entry = detach(&wheel->slots[level][slot]);
+                while (entry) {
+                    timer_entry_t* next = entry->next;
+                    timer_fn fn = entry->fn;
+                    void* arg = entry->arg;
+                    recycle(wheel, entry);
+                    wheel->pending--;
+                    fn(arg, 1);
+                    cancelled++;
+                    entry = next;
+                }
+            }
+        }
+    }
+    return cancelled;
+}
+
+long long timer_wheel_next_ns(const timer_wheel_t* wheel) {
+    if (wheel->pending == 0) return -1;
+    for (unsigned long long tick = wheel->now; tick < wheel->now + TIMER_WHEEL_SLOTS; tick++) {
+        if (wheel->slots[0][tick & (TIMER_WHEEL_SLOTS - 1)].head) {
+            return wheel->origin_ns + (long long)tick * wheel->tick_ns;
+        }
+    }
+    // Nothing on level 0: the next timer is handed down when level 0 wraps
+    unsigned long long wrap = ((wheel->now >> TIMER_WHEEL_BITS) + 1) << TIMER_WHEEL_BITS;
+    return wheel->origin_ns + (long long)wrap * wheel->tick_ns;
+}
+
+int timer_wheel_pending(const timer_wheel_t* wheel) {
+    return wheel->pending;
+}
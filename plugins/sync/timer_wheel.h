@@ -0,0 +1,99 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#define TIMER_WHEEL_BITS 6 // Slots per level, as a power of two
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4 // 64^4 ticks ahead; later timers wait in the last slot and are placed again
+
+/**
+ * Called when a timer is due, or with cancelled set when it is cancelled
+ * The callback may schedule new timers on the same wheel.
+ */
+typedef void (*timer_fn)(void* arg, int cancelled);
+
+typedef struct timer_entry {
+    struct timer_entry* next;
+    unsigned long long due; // Tick the timer fires at
+    timer_fn fn;
+    void* arg;
+} timer_entry_t;
+
+typedef struct {
+    timer_entry_t* head; // Timers in scheduling order, so equal ticks fire first come first served
+    timer_entry_t* tail;
+} timer_slot_t;
+
+/**
+ * Hierarchical timer wheel
+ * Level l holds timers due within 64^(l+1) ticks, hashed by their tick at that
+ * level; as the wheel turns, each slot of a higher level is spread over the
+ * level below just before its timers can be due. Scheduling and firing cost
+ * O(1) per timer, however many are pending. Not thread safe: one thread owns
+ * the wheel and drives it with timer_wheel_advance.
+ */
+typedef struct {
+    timer_slot_t slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    unsigned long long now; // Next tick to fire; every earlier timer has fired
+    long long origin_ns; // Time of tick 0
+    long long tick_ns;
+    int pending;
+    timer_entry_t* spare; // Fired entries kept for reuse
+} timer_wheel_t;
+
+/**
+ * Initialize an empty wheel
+ * @param wheel Pointer to the wheel structure
+ * @param tick_ns Resolution; timers fire at most one tick late
+ * @param now_ns Current time, on any clock the caller keeps using
+ * @return NULL on success, error message on failure
+ */
+const char* timer_wheel_init(timer_wheel_t* wheel, long long tick_ns, long long now_ns);
+
+/**
+ * Free the wheel; pending timers are dropped without calling them
+ * @param wheel Pointer to the wheel structure
+ */
+void timer_wheel_destroy(timer_wheel_t* wheel);
+
+/**
+ * Schedule a call, never earlier than due_ns
+ * @param wheel Pointer to the wheel structure
+ * @param due_ns When to call, a time in the past fires on the next advance
+ * @param fn Callback
+ * @param arg Passed to the callback
+ * @return NULL on success, error message on failure
+ */
+const char* timer_wheel_schedule(timer_wheel_t* wheel, long long due_ns, timer_fn fn, void* arg);
+
+/**
+ * Fire every timer due by now_ns, in due order
+ * @param wheel Pointer to the wheel structure
+ * @param now_ns Current time
+ * @return Number of timers fired
+ */
+int timer_wheel_advance(timer_wheel_t* wheel, long long now_ns);
+
+/**
+ * Call every pending timer with cancelled set, including timers the callbacks schedule
+ * @param wheel Pointer to the wheel structure
+ * @return Number of timers cancelled
+ */
+int timer_wheel_cancel_all(timer_wheel_t* wheel);
+
+/**
+ * When the wheel next needs to advance
+ * Exact while the earliest timer is less than 64 ticks away; otherwise the time
+ * the lowest level wraps, which is never later than the earliest timer.
+ * @param wheel Pointer to the wheel structure
+ * @return Time to advance at, -1 when no timer is pending
+ */
+long long timer_wheel_next_ns(const timer_wheel_t* wheel);
+
+/**
+ * Number of timers not yet fired or cancelled
+ * @param wheel Pointer to the wheel structure
+ * @return Pending timers
+ */
+int timer_wheel_pending(const timer_wheel_t* wheel);
+
+#endif
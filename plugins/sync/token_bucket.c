@@ -0,0 +1,71 @@
+#include <time.h>
+#include "token_bucket.h"
+
+static long long coarse_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static void sleep_ns(long long ns) {
+    struct timespec remaining = { ns / 1000000000LL, ns % 1000000000LL };
+    // A signal cuts the wait short; the debt stays recorded in refilled_ns
+    nanosleep(&remaining, NULL);
+}
+
+static int has_tokens(const token_bucket_t* bucket, long long lines, long long bytes) {
+    return (bucket->lines_per_sec == 0 || bucket->line_tokens >= lines) &&
+           (bucket->bytes_per_sec == 0 || bucket->byte_tokens >= bytes);
+}
+
+// Credit the tokens earned since the last refill, up to a full bucket
+static void refill(token_bucket_t* bucket, long long now_ns) {
+    if (now_ns <= bucket->refilled_ns) return;
+    double elapsed_s = (now_ns - bucket->refilled_ns) / 1e9;
+    bucket->line_tokens += elapsed_s * bucket->lines_per_sec;
+    if (bucket->line_tokens > bucket->line_burst) bucket->line_tokens = bucket->line_burst;
+    bucket->byte_tokens += elapsed_s * bucket->bytes_per_sec;
+    if (bucket->byte_tokens > bucket->byte_burst) bucket->byte_tokens = bucket->byte_burst;
+    bucket->refilled_ns = now_ns;
+}
+
+const char* token_bucket_init(token_bucket_t* bucket, double lines_per_sec, double bytes_per_sec) {
+    if (!bucket) return "Bucket is NULL";
+    if (lines_per_sec < 0 || bytes_per_sec < 0) return "Rate must not be negative";
+    bucket->lines_per_sec = lines_per_sec;
+    bucket->bytes_per_sec = bytes_per_sec;
+    bucket->line_burst = lines_per_sec * TOKEN_BUCKET_BURST_MS / 1000.0;
+    bucket->byte_burst = bytes_per_sec * TOKEN_BUCKET_BURST_MS / 1000.0;
+    bucket->line_tokens = bucket->line_burst;
+    bucket->byte_tokens = bucket->byte_burst;
+    bucket->refilled_ns = coarse_now_ns();
+    atomic_init(&bucket->throttled_ns, 0);
+    atomic_init(&bucket->waits, 0);
+    return NULL;
+}
+
+long long token_bucket_take(token_bucket_t* bucket, long long lines, long long bytes) {
+    if (!has_tokens(bucket, lines, bytes)) refill(bucket, coarse_now_ns());
+    bucket->line_tokens -= lines;
+    bucket->byte_tokens -= bytes;
+    // Wait until the rate has paid off the debt of the more limiting dimension
+    double wait_s = 0;
+    if (bucket->lines_per_sec > 0 && bucket->line_tokens < 0) wait_s = -bucket->line_tokens / bucket->lines_per_sec;
+    if (bucket->bytes_per_sec > 0 && bucket->byte_tokens < 0 && -bucket->byte_tokens / bucket->bytes_per_sec > wait_s) {
+        wait_s = -bucket->byte_tokens / bucket->bytes_per_sec;
+    }
+    if (wait_s <= 0) return 0;
+    long long wait_ns = (long long)(wait_s * 1e9);
+    sleep_ns(wait_ns);
+    // The tokens earned while asleep are credited here, without another clock read
+    bucket->line_tokens += wait_s * bucket->lines_per_sec;
+    bucket->byte_tokens += wait_s * bucket->bytes_per_sec;
+    bucket->refilled_ns += wait_ns;
+    atomic_fetch_add_explicit(&bucket->throttled_ns, (unsigned long long)wait_ns, memory_order_relaxed);
+    atomic_fetch_add_explicit(&bucket->waits, 1, memory_order_relaxed);
+    return wait_ns;
+}
+
+unsigned long long token_bucket_throttled_ns(token_bucket_t* bucket) {
+    return atomic_load_explicit(&bucket->throttled_ns, memory_order_relaxed);
+}
@@ -0,0 +1,53 @@
+#ifndef TOKEN_BUCKET_H
+#define TOKEN_BUCKET_H
+
+#include <stdatomic.h>
+
+#define TOKEN_BUCKET_BURST_MS 100 // Tokens a full bucket holds, in milliseconds of the rate
+
+/**
+ * Rate limit in lines per second and bytes per second
+ * Only one thread takes tokens from a bucket; the throttle counter can be read
+ * from any thread. The clock is read only when the tokens run out, and then
+ * CLOCK_MONOTONIC_COARSE is enough: a take may leave the bucket in debt, which
+ * the next sleep pays off exactly, so coarse readings never add up to drift.
+ */
+typedef struct {
+    double lines_per_sec; // 0 for no limit on lines
+    double bytes_per_sec; // 0 for no limit on bytes
+    double line_tokens;
+    double byte_tokens;
+    double line_burst;
+    double byte_burst;
+    long long refilled_ns; // Time up to which tokens were credited
+    atomic_ullong throttled_ns; // Total time spent waiting for tokens
+    atomic_ullong waits; // Number of takes that had to wait
+} token_bucket_t;
+
+/**
+ * Initialize a full bucket
+ * @param bucket Pointer to the bucket structure
+ * @param lines_per_sec Line rate, 0 for unlimited
+ * @param bytes_per_sec Byte rate, 0 for unlimited
+ * @return NULL on success, error message on failure
+ */
+const char* token_bucket_init(token_bucket_t* bucket, double lines_per_sec, double bytes_per_sec);
+
+/**
+ * Take tokens for a batch of lines, sleeping until the rate allows it
+ * A batch larger than the burst is let through and paid for by a longer wait.
+ * @param bucket Pointer to the bucket structure
+ * @param lines Number of lines
+ * @param bytes Total bytes of those lines
+ * @return Nanoseconds slept, 0 when tokens were available
+ */
+long long token_bucket_take(token_bucket_t* bucket, long long lines, long long bytes);
+
+/**
+ * Total time takes spent waiting for tokens
+ * @param bucket Pointer to the bucket structure
+ * @return Nanoseconds throttled
+ */
+unsigned long long token_bucket_throttled_ns(token_bucket_t* bucket);
+
+#endif
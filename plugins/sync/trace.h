@@ -0,0 +1,33 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <time.h>
+
+typedef enum {
+    TRACE_SPAN_PUT = 0, // Producer blocked in consumer_producer_put on a full queue
+    TRACE_SPAN_QUEUE,   // Record waited in the queue for the consumer thread
+    TRACE_SPAN_PROCESS  // Stage's process function ran on the record
+} trace_span_kind_t;
+
+/**
+ * Receiver of one span of a sampled record
+ * @param stage Index of the stage in the pipeline
+ * @param kind What the record was doing during the span
+ * @param trace_id Trace id of the sampled record
+ * @param start_ns Span start, from trace_now_ns
+ * @param end_ns Span end, from trace_now_ns
+ */
+typedef void (*trace_span_fn)(int stage, trace_span_kind_t kind, unsigned long long trace_id,
+                              long long start_ns, long long end_ns);
+
+/**
+ * Monotonic timestamp shared by every plugin namespace and the analyzer
+ * @return Nanoseconds since an arbitrary fixed point
+ */
+static inline long long trace_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+#endif
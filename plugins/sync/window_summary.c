@@ -0,0 +1,201 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "window_summary.h"
+
+// FNV-1a, then the splitmix64 finalizer so every bit of the HyperLogLog input is well mixed
+static uint64_t hash_key(const char* key, size_t len) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)key[i];
+        hash *= 0x100000001b3ULL;
+    }
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+    return hash;
+}
+
+const char* window_summary_init(window_summary_t* summary, int capacity) {
+    if (!summary) return "Summary is NULL";
+    if (capacity <= 0) return "Capacity must be greater than 0";
+    memset(summary, 0, sizeof(*summary));
+    summary->num_slots = 1;
+    while (summary->num_slots < capacity * 2) summary->num_slots <<= 1;
+    summary->counters = malloc(capacity * sizeof(summary_counter_t));
+    summary->heap = malloc(capacity * sizeof(int));
+    summary->slots = calloc(summary->num_slots, sizeof(int));
+    if (!summary->counters || !summary->heap || !summary->slots) {
+        window_summary_destroy(summary);
+        return "Could not allocate memory for summary";
+    }
+    summary->capacity = capacity;
+    return NULL;
+}
+
+void window_summary_destroy(window_summary_t* summary) {
+    if (!summary) return;
+    free(summary->counters);
+    free(summary->heap);
+    free(summary->slots);
+    summary->counters = NULL;
+    summary->heap = NULL;
+    summary->slots = NULL;
+}
+
+void window_summary_reset(window_summary_t* summary) {
+    memset(summary->slots, 0, summary->num_slots * sizeof(int));
+    memset(summary->registers, 0, sizeof(summary->registers));
+    summary->size = 0;
+    summary->lines = 0;
+}
+
+static void heap_swap(window_summary_t* summary, int a, int b) {
+    int counter_a = summary->heap[a];
+    int counter_b = summary->heap[b];
+    summary->heap[a] = counter_b;
+    summary->heap[b] = counter_a;
+    summary->counters[counter_b].heap_index = a;
+    summary->counters[counter_a].heap_index = b;
+}
+
+static unsigned long long heap_count(const window_summary_t* summary, int position) {
+    return summary->counters[summary->heap[position]].count;
+}
+
+static void sift_up(window_summary_t* summary, int position) {
+    while (position > 0 && heap_count(summary, (position - 1) / 2) > heap_count(summary, position)) {
+        heap_swap(summary, position, (position - 1) / 2);
+        position = (position - 1) / 2;
+    }
+}
+
+static void sift_down(window_summary_t* summary, int position) {
+    for (;;) {
+        int smallest = position;
+        int left = position * 2 + 1;
+        int right = left + 1;
+        if (left < summary->size && heap_count(summary, left) < heap_count(summary, smallest)) smallest = left;
+        if (right < summary->size && heap_count(summary, right) < heap_count(summary, smallest)) smallest = right;
+        if (smallest == position) return;
+        heap_swap(summary, position, smallest);
+        position = smallest;
+    }
+}
+
+// Table slot of the key, or of the empty slot where it would go
+static int find_slot(const window_summary_t* summary, const char* key, uint64_t hash) {
+    int mask = summary->num_slots - 1;
+    int slot = (int)(hash & (uint64_t)mask);
+    while (summary->slots[slot]) {
+        const summary_counter_t* counter = &summary->counters[summary->slots[slot] - 1];
+        if (counter->hash == hash && strcmp(counter->key, key) == 0) return slot;
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// Empty a slot, shifting later entries of the probe run back so no lookup stops short
+static void remove_slot(window_summary_t* summary, int slot) {
+    int mask = summary->num_slots - 1;
+    int hole = slot;
+    for (int next = (hole + 1) & mask; summary->slots[next]; next = (next + 1) & mask) {
+        int home = (int)(summary->counters[summary->slots[next] - 1].hash & (uint64_t)mask);
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            summary->slots[hole] = summary->slots[next];
+            hole = next;
+        }
+    }
+    summary->slots[hole] = 0;
+}
+
+static void count_key(window_summary_t* summary, const char* key, uint64_t hash,
+                      unsigned long long count, unsigned long long error) {
+    int slot = find_slot(summary, key, hash);
+    if (summary->slots[slot]) {
+        summary_counter_t* counter = &summary->counters[summary->slots[slot] - 1];
+        counter->count += count;
+        counter->error += error;
+        sift_down(summary, counter->heap_index);
+        return;
+    }
+    int index;
+    if (summary->size < summary->capacity) {
+        index = summary->size++;
+        summary->heap[index] = index;
+        summary->counters[index].heap_index = index;
+        summary->counters[index].count = 0;
+        summary->counters[index].error = 0;
+    } else {
+        // Space-saving: the new key takes over the smallest counter and its count
+        index = summary->heap[0];
+        remove_slot(summary, find_slot(summary, summary->counters[index].key, summary->counters[index].hash));
+        slot = find_slot(summary, key, hash);
+        summary->counters[index].error = summary->counters[index].count;
+    }
+    summary_counter_t* counter = &summary->counters[index];
+    counter->hash = hash;
+    strcpy(counter->key, key);
+    counter->count += count;
+    counter->error += error;
+    summary->slots[slot] = index + 1;
+    sift_up(summary, counter->heap_index);
+    sift_down(summary, counter->heap_index);
+}
+
+void window_summary_add(window_summary_t* summary, const char* key, size_t len) {
+    char stored[SUMMARY_KEY_MAX];
+    if (len >= SUMMARY_KEY_MAX) len = SUMMARY_KEY_MAX - 1;
+    memcpy(stored, key, len);
+    stored[len] = '\0';
+    uint64_t hash = hash_key(stored, len);
+    summary->lines++;
+    // The top bits pick the register, the rest give the rank of the first set bit
+    int reg = (int)(hash >> (64 - SUMMARY_HLL_BITS));
+    uint8_t rank = (uint8_t)(__builtin_clzll((hash << SUMMARY_HLL_BITS) | (1ULL << (SUMMARY_HLL_BITS - 1))) + 1);
+    if (rank > summary->registers[reg]) summary->registers[reg] = rank;
+    count_key(summary, stored, hash, 1, 0);
+}
+
+void window_summary_merge(window_summary_t* into, const window_summary_t* from) {
+    into->lines += from->lines;
+    for (int i = 0; i < SUMMARY_HLL_REGISTERS; i++) {
+        if (from->registers[i] > into->registers[i]) into->registers[i] = from->registers[i];
+    }
+    for (int i = 0; i < from->size; i++) {
+        const summary_counter_t* counter = &from->counters[i];
+        count_key(into, counter->key, counter->hash, counter->count, counter->error);
+    }
+}
+
+double window_summary_distinct(const window_summary_t* summary) {
+    const double m = SUMMARY_HLL_REGISTERS;
+    double sum = 0;
+    int zeros = 0;
+    for (int i = 0; i < SUMMARY_HLL_REGISTERS; i++) {
+        sum += ldexp(1.0, -summary->registers[i]);
+        if (summary->registers[i] == 0) zeros++;
+    }
+    double estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    // Linear counting is more accurate while many registers are still empty
+    if (estimate <= 2.5 * m && zeros > 0) estimate = m * log(m / zeros);
+    return estimate;
+}
+
+int window_summary_top(const window_summary_t* summary, const summary_counter_t** top, int k) {
+    int found = 0;
+    // Insertion into a sorted array of k: the summary holds few counters and k is smaller still
+    for (int i = 0; i < summary->size; i++) {
+        const summary_counter_t* counter = &summary->counters[i];
+        if (found == k && counter->count <= top[k - 1]->count) continue;
+        int position = found < k ? found++ : k - 1;
+        while (position > 0 && top[position - 1]->count < counter->count) {
+            top[position] = top[position - 1];
+            position--;
+        }
+        top[position] = counter;
+    }
+    return found;
+}
@@ -0,0 +1,95 @@
+#ifndef WINDOW_SUMMARY_H
+#define WINDOW_SUMMARY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SUMMARY_KEY_MAX 48 // Bytes kept of each key, terminator included; longer keys are truncated
+#define SUMMARY_HLL_BITS 12 // 4096 HyperLogLog registers, about 1.6% standard error
+#define SUMMARY_HLL_REGISTERS (1 << SUMMARY_HLL_BITS)
+
+/**
+ * One monitored key of the space-saving top-K
+ * count never underestimates the key's true count, and overestimates it by at most error.
+ */
+typedef struct {
+    uint64_t hash;
+    unsigned long long count;
+    unsigned long long error; // Count inherited from the key this counter replaced
+    int heap_index; // Position in the min-heap
+    char key[SUMMARY_KEY_MAX];
+} summary_counter_t;
+
+/**
+ * Bounded-memory summary of the keys seen in a window
+ * Counts lines exactly, distinct keys with a HyperLogLog and the heaviest keys
+ * with space-saving: capacity counters, found through an open-addressing table
+ * with linear probing, the smallest one replaced when a new key arrives at a
+ * full summary. Any key seen more than lines / capacity times is monitored.
+ * Memory is fixed at init, whatever the number of keys. Not thread safe.
+ */
+typedef struct {
+    summary_counter_t* counters;
+    int* heap; // Counter indexes, min-heap on count
+    int* slots; // Counter index + 1 per table slot, 0 when empty
+    int num_slots; // Power of two, at least twice capacity
+    int capacity;
+    int size;
+    unsigned long long lines;
+    uint8_t registers[SUMMARY_HLL_REGISTERS];
+} window_summary_t;
+
+/**
+ * Initialize an empty summary
+ * @param summary Pointer to the summary structure
+ * @param capacity Number of keys monitored for the top-K
+ * @return NULL on success, error message on failure
+ */
+const char* window_summary_init(window_summary_t* summary, int capacity);
+
+/**
+ * Free the summary's memory
+ * @param summary Pointer to the summary structure
+ */
+void window_summary_destroy(window_summary_t* summary);
+
+/**
+ * Forget every line, keeping the memory
+ * @param summary Pointer to the summary structure
+ */
+void window_summary_reset(window_summary_t* summary);
+
+/**
+ * Count one line with the given key
+ * @param summary Pointer to the summary structure
+ * @param key Key bytes, need not be NUL terminated
+ * @param len Key length
+ */
+void window_summary_add(window_summary_t* summary, const char* key, size_t len);
+
+/**
+ * Add the lines of another summary, as if they had been added to this one
+ * Line counts and distinct estimates merge exactly. Top-K counters merge as
+ * upper bounds, so the result is as accurate as one summary fed both streams.
+ * @param into Summary receiving the lines
+ * @param from Summary to add, unchanged
+ */
+void window_summary_merge(window_summary_t* into, const window_summary_t* from);
+
+/**
+ * Estimated number of distinct keys
+ * @param summary Pointer to the summary structure
+ * @return HyperLogLog estimate, exact to within a few percent
+ */
+double window_summary_distinct(const window_summary_t* summary);
+
+/**
+ * Heaviest keys, by decreasing count; equal counts keep the order keys were first monitored in
+ * @param summary Pointer to the summary structure
+ * @param top Output array of up to k counters, valid until the summary changes
+ * @param k Capacity of top
+ * @return Number of counters written
+ */
+int window_summary_top(const window_summary_t* summary, const summary_counter_t** top, int k);
+
+#endif
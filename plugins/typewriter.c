@@ -1,26 +1,146 @@
 
 #include "plugin_common.h"
+#include "plugin_sdk.h"
 #include <stdio.h>
 #include <unistd.h>
 
-const char* plugin_transform(const char* input) {
-    if (!input) {
-        return NULL;
-    }
-    
+#define TYPEWRITER_AHEAD 16 // Lines held beyond those being typed, each starting on a finished line's last tick
+
+// A line being typed or waiting its turn; lines are passed on in arrival order, whichever finishes first
+typedef struct typing {
+    struct typing* next;
+    char* text;
+    size_t length;
+    size_t typed; // Characters printed so far
+    long long next_ns; // When the next character is due
+    plugin_deferred_t* deferred;
+    int done;
+} typing_t;
+
+static long g_delay_ms = 100; // Pause after every character
+static int g_lines = 1; // Lines typed at once; more than one interleaves their characters
+static int g_typing = 0; // Lines started and not finished yet
+static typing_t* g_head = NULL; // Lines held, oldest first
+static typing_t* g_tail = NULL;
+static typing_t* g_waiting = NULL; // Oldest line not started yet; the ones after it wait too
+
+// The original blocking form, for runs without a consumer thread such as --offline
+static void type_blocking(const char* input) {
     printf("[typewriter] ");
     for (int i = 0; input[i] != '\0'; i++) {
         printf("%c", input[i]);
         fflush(stdout);
-        usleep(100000);
+        usleep(g_delay_ms * 1000);
     }
     printf("\n");
     fflush(stdout);
-    return input;
+}
+
+static void release_done(void) {
+    while (g_head && g_head->done) {
+        typing_t* line = g_head;
+        g_head = line->next;
+        if (!g_head) g_tail = NULL;
+        plugin_release(line->deferred);
+        free(line->text);
+        free(line);
+    }
+}
+
+static void type_next(void* arg, int cancelled);
+
+// Start waiting lines while fewer than g_lines are being typed, their first character due at due_ns
+static void start_waiting(long long due_ns) {
+    while (g_waiting && g_typing < g_lines) {
+        typing_t* line = g_waiting;
+        g_waiting = line->next;
+        line->next_ns = due_ns;
+        g_typing++;
+        if (plugin_schedule(line->next_ns, type_next, line) != NULL) {
+            printf("[typewriter] %s\n", line->text);
+            fflush(stdout);
+            line->done = 1;
+            g_typing--;
+        }
+    }
+    release_done();
+}
+
+// Timer callback: print the next character, or end the line one delay after the last one
+static void type_next(void* arg, int cancelled) {
+    typing_t* line = (typing_t*)arg;
+    if (line->typed == 0) printf("[typewriter] ");
+    if (cancelled) {
+        // Shutdown or a reload: the line still completes, just without the pauses
+        fputs(line->text + line->typed, stdout);
+        line->typed = line->length;
+    } else if (line->typed < line->length) {
+        putchar(line->text[line->typed++]);
+        fflush(stdout);
+        line->next_ns += g_delay_ms * 1000000LL;
+        if (plugin_schedule(line->next_ns, type_next, line) == NULL) return;
+        fputs(line->text + line->typed, stdout);
+    }
+    printf("\n");
+    fflush(stdout);
+    line->done = 1;
+    g_typing--;
+    // The next line goes on at this tick, so a single typed line follows the last without a gap
+    start_waiting(line->next_ns);
+}
+
+const char* plugin_transform(const char* input) {
+    if (!input) {
+        return NULL;
+    }
+    typing_t* line = calloc(1, sizeof(typing_t));
+    if (line) line->text = strdup(input);
+    plugin_deferred_t* deferred = line && line->text ? plugin_defer(input) : NULL;
+    if (!deferred) {
+        if (line) free(line->text);
+        free(line);
+        type_blocking(input);
+        return input;
+    }
+    line->length = strlen(input);
+    line->deferred = deferred;
+    if (g_tail) {
+        g_tail->next = line;
+    } else {
+        g_head = line;
+    }
+    g_tail = line;
+    if (!g_waiting) g_waiting = line;
+    // With a free slot the first character is due now and prints right after this batch
+    start_waiting(trace_now_ns());
+    return PLUGIN_DEFER;
+}
+
+static int parse_positive(const char* value, long* parsed) {
+    char* end;
+    *parsed = strtol(value, &end, 10);
+    return *value != '\0' && *end == '\0' && *parsed > 0 ? 0 : -1;
+}
+
+const char* plugin_configure(const char* key, const char* value) {
+    long parsed;
+    if (strcmp(key, "delay-ms") == 0) {
+        if (parse_positive(value, &parsed) != 0) return "delay-ms must be greater than 0";
+        g_delay_ms = parsed;
+    } else if (strcmp(key, "lines") == 0) {
+        if (parse_positive(value, &parsed) != 0 || parsed > 4096) return "lines must be between 1 and 4096";
+        g_lines = (int)parsed;
+    } else {
+        return "Unknown option, expected delay-ms or lines";
+    }
+    return NULL;
 }
 
 const char* plugin_init(int queue_size) {
-    return common_plugin_init(plugin_transform, "typewriter", queue_size);
+    const char* err = common_plugin_init(plugin_transform, "typewriter", queue_size);
+    if (err) return err;
+    plugin_set_defer_limit(g_lines + TYPEWRITER_AHEAD);
+    return NULL;
 }
 
 const char* get_plugin_name(void) {
@@ -10,21 +10,43 @@ const char* plugin_transform(const char* input) {
         return NULL;
     }
     
-    // Allocate memory for the output string
-    char* output = malloc(strlen(input) + 1);
+    size_t len = strlen(input);
+    // Same length as the input, so the result can take its place
+    char* output = plugin_in_place(input);
+    if (!output) {
+        output = plugin_output_buffer(len + 1);
+    }
     if (!output) {
         return NULL;
     }
     
     // Convert each character to uppercase
-    for (int i = 0; input[i] != '\0'; i++) {
+    for (size_t i = 0; i < len; i++) {
         output[i] = toupper(input[i]);
     }
-    output[strlen(input)] = '\0';
+    output[len] = '\0';
     
     return output;
 }
 
+const char* plugin_transform_batch(const char* lines, const size_t* offsets, int count,
+                                   char* output, size_t output_size, size_t* output_offsets) {
+    size_t total = offsets[count];
+    if (output_size < total) {
+        return "Output buffer too small";
+    }
+    
+    // Lines keep their length and terminators stay terminators, so the whole
+    // packed buffer converts in one branch-free loop the compiler can vectorize
+    for (size_t i = 0; i < total; i++) {
+        unsigned char c = (unsigned char)lines[i];
+        output[i] = (char)(c - ((unsigned char)(c - 'a') < 26 ? 32 : 0));
+    }
+    memcpy(output_offsets, offsets, (count + 1) * sizeof(size_t));
+    
+    return NULL;
+}
+
 const char* plugin_init(int queue_size) {
     return common_plugin_init(plugin_transform, "uppercaser", queue_size);
 }
@@ -33,3 +55,8 @@ const char* get_plugin_name(void) {
     return "uppercaser";
 }
 
+// Output depends only on the input bytes, so the analyzer may cache it
+int plugin_is_stateless(void) {
+    return 1;
+}
+
@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#include "autotune.h"
+#include "pipeline.h"
+#include "../plugins/plugin_common.h"
+
+#define AUTOTUNE_SAMPLE_MS 5 // Time between two occupancy samples
+#define AUTOTUNE_BATCH_NS 50000.0 // Work one batch should carry, so per-batch costs stay small
+#define AUTOTUNE_MIN_CAPACITY 16
+#define AUTOTUNE_MAX_CAPACITY 65536
+
+typedef struct {
+    unsigned long long peak; // Most lines queued or in flight at one sample
+    unsigned long long samples;
+    unsigned long long full; // Samples that found the queue at capacity
+} occupancy_t;
+
+static occupancy_t* g_occupancy = NULL;
+static pthread_t g_thread;
+static int g_running = 0;
+static int g_stop = 0;
+static pthread_mutex_t g_stop_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_stop_cond = PTHREAD_COND_INITIALIZER;
+
+static void sample_stages(void) {
+    pthread_mutex_lock(&g_stages_mutex);
+    for (int i = 0; i < g_num_plugins; i++) {
+        stage_metrics_t metrics;
+        plugin_handle_t* stage = &g_plugin_handles[i];
+        if (!stage->metrics || stage->metrics(&metrics) != NULL) continue;
+        unsigned long long depth = metrics.placed - metrics.retired;
+        occupancy_t* occupancy = &g_occupancy[i];
+        if (depth > occupancy->peak) occupancy->peak = depth;
+        if (depth >= (unsigned long long)metrics.capacity) occupancy->full++;
+        occupancy->samples++;
+    }
+    pthread_mutex_unlock(&g_stages_mutex);
+}
+
+static void* sampler_thread(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&g_stop_mutex);
+    while (!g_stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += AUTOTUNE_SAMPLE_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        int rc = 0;
+        while (!g_stop && rc != ETIMEDOUT) {
+            rc = pthread_cond_timedwait(&g_stop_cond, &g_stop_mutex, &deadline);
+        }
+        if (g_stop) break;
+        pthread_mutex_unlock(&g_stop_mutex);
+        sample_stages();
+        pthread_mutex_lock(&g_stop_mutex);
+    }
+    pthread_mutex_unlock(&g_stop_mutex);
+    return NULL;
+}
+
+const char* autotune_start(void) {
+    if (g_running) return "Autotune already running";
+    g_occupancy = calloc(g_num_plugins, sizeof(occupancy_t));
+    if (!g_occupancy) return "Could not allocate memory for autotune samples";
+    g_stop = 0;
+    if (pthread_create(&g_thread, NULL, sampler_thread, NULL) != 0) {
+        free(g_occupancy);
+        g_occupancy = NULL;
+        return "Could not create autotune thread";
+    }
+    g_running = 1;
+    return NULL;
+}
+
+int autotune_running(void) {
+    return g_running;
+}
+
+static int clamp(long value, long low, long high) {
+    if (value < low) return (int)low;
+    if (value > high) return (int)high;
+    return (int)value;
+}
+
+static int next_pow2(long value) {
+    long pow2 = 1;
+    while (pow2 < value) pow2 <<= 1;
+    return (int)pow2;
+}
+
+// Whether the stage can take more than one consumer thread
+static int can_parallelize(plugin_handle_t* stage) {
+    return stage->set_workers && stage->is_stateless && stage->is_stateless();
+}
+
+// Whether the stage flushes state between batches, which keeps it to one line per batch
+static int keeps_state(plugin_handle_t* stage) {
+    return dlsym(stage->handle, "plugin_flush") != NULL;
+}
+
+/*
+ * Spread the CPUs over the stages by their measured cost per line. Stages that
+ * keep state run one thread, so the slowest of them bounds the throughput and
+ * a stateless stage needs cost / that bound workers to keep up with it. Without
+ * such a stage the CPUs are shared in proportion to cost. Past the CPUs, the
+ * stage with the most workers gives one back until the total fits.
+ */
+static void choose_workers(int cpus, const stage_metrics_t* metrics, autotune_choice_t* choices) {
+    double serial_max = 0;
+    double total = 0;
+    for (int i = 0; i < g_num_plugins; i++) {
+        if (choices[i].service_ns <= 0) continue;
+        total += choices[i].service_ns;
+        if (!can_parallelize(&g_plugin_handles[i]) && choices[i].service_ns > serial_max) {
+            serial_max = choices[i].service_ns;
+        }
+    }
+    int used = 0;
+    for (int i = 0; i < g_num_plugins; i++) {
+        double cost = choices[i].service_ns;
+        long workers = metrics[i].workers > 0 ? metrics[i].workers : 1;
+        if (cost > 0 && !can_parallelize(&g_plugin_handles[i])) {
+            workers = 1;
+        } else if (cost > 0 && serial_max > 0) {
+            workers = (long)(cost / serial_max + 0.999);
+        } else if (cost > 0) {
+            workers = (long)(cpus * cost / total + 0.5);
+        }
+        // Workers are only ever added to a running stage
+        if (workers < metrics[i].workers) workers = metrics[i].workers;
+        choices[i].workers = clamp(workers, 1, cpus > 1 ? cpus : 1);
+        used += choices[i].workers;
+    }
+    while (used > cpus) {
+        int widest = -1;
+        for (int i = 0; i < g_num_plugins; i++) {
+            if (choices[i].workers > metrics[i].workers && choices[i].workers > 1 &&
+                (widest < 0 || choices[i].workers > choices[widest].workers)) {
+                widest = i;
+            }
+        }
+        if (widest < 0) break;
+        choices[widest].workers--;
+        used--;
+    }
+}
+
+int autotune_finish(int cpus, autotune_choice_t* choices, FILE* out) {
+    if (!g_running) return -1;
+    pthread_mutex_lock(&g_stop_mutex);
+    g_stop = 1;
+    pthread_cond_signal(&g_stop_cond);
+    pthread_mutex_unlock(&g_stop_mutex);
+    pthread_join(g_thread, NULL);
+    g_running = 0;
+    // One last sample, so a run shorter than the interval still has one
+    sample_stages();
+
+    stage_metrics_t* metrics = calloc(g_num_plugins, sizeof(stage_metrics_t));
+    if (!metrics) {
+        free(g_occupancy);
+        g_occupancy = NULL;
+        return -1;
+    }
+    pthread_mutex_lock(&g_stages_mutex);
+    for (int i = 0; i < g_num_plugins; i++) {
+        plugin_handle_t* stage = &g_plugin_handles[i];
+        if (!stage->metrics || stage->metrics(&metrics[i]) != NULL) {
+            memset(&metrics[i], 0, sizeof(stage_metrics_t));
+            metrics[i].capacity = g_queue_size;
+        }
+        choices[i].service_ns = metrics[i].processed > 0 ? (double)metrics[i].service_ns / metrics[i].processed : 0;
+    }
+    pthread_mutex_unlock(&g_stages_mutex);
+    choose_workers(cpus, metrics, choices);
+
+    int bottleneck = -1;
+    double slowest = 0;
+    for (int i = 0; i < g_num_plugins; i++) {
+        autotune_choice_t* choice = &choices[i];
+        const occupancy_t* occupancy = &g_occupancy[i];
+        if (choice->service_ns <= 0) {
+            choice->batch = metrics[i].batch > 0 ? metrics[i].batch : 1;
+            choice->capacity = metrics[i].capacity;
+            continue;
+        }
+        choice->batch = keeps_state(&g_plugin_handles[i])
+                            ? 1
+                            : clamp((long)(AUTOTUNE_BATCH_NS / choice->service_ns + 0.999), 1, PLUGIN_BATCH_MAX);
+        // A few batches per worker keep every worker fed while the next batch is placed
+        long capacity = 4L * choice->batch * choice->workers;
+        // A queue that was mostly full sits before a bottleneck, where more room only adds latency
+        int mostly_full = occupancy->samples > 0 && occupancy->full * 2 > occupancy->samples;
+        if (!mostly_full && (long)occupancy->peak * 2 > capacity) capacity = (long)occupancy->peak * 2;
+        choice->capacity = clamp(next_pow2(capacity), AUTOTUNE_MIN_CAPACITY, AUTOTUNE_MAX_CAPACITY);
+        double per_worker = choice->service_ns / choice->workers;
+        if (per_worker > slowest) {
+            slowest = per_worker;
+            bottleneck = i;
+        }
+    }
+
+    for (int i = 0; i < g_num_plugins; i++) {
+        const occupancy_t* occupancy = &g_occupancy[i];
+        const char* name = g_plugin_handles[i].name;
+        if (choices[i].service_ns <= 0) {
+            fprintf(out, "Autotune stage %d (%s): no line measured, settings kept\n", i, name);
+            continue;
+        }
+        fprintf(out, "Autotune stage %d (%s): %.2f us/line, peak depth %llu at capacity %d, full %.0f%% of the time"
+                     " -> capacity %d, batch %d, workers %d\n",
+                i, name, choices[i].service_ns / 1000.0, occupancy->peak, metrics[i].capacity,
+                occupancy->samples ? 100.0 * occupancy->full / occupancy->samples : 0.0,
+                choices[i].capacity, choices[i].batch, choices[i].workers);
+    }
+    if (bottleneck >= 0) {
+        fprintf(out, "Autotune bottleneck: stage %d (%s), %.2f us/line per worker\n", bottleneck,
+                g_plugin_handles[bottleneck].name, slowest / 1000.0);
+    }
+    fprintf(out, "Autotuned options:");
+    for (int i = 0; i < g_num_plugins; i++) fprintf(out, " --capacity %d:%d", i, choices[i].capacity);
+    for (int i = 0; i < g_num_plugins; i++) fprintf(out, " --batch %d:%d", i, choices[i].batch);
+    for (int i = 0; i < g_num_plugins; i++) {
+        if (choices[i].workers > 1) fprintf(out, " --workers %d:%d", i, choices[i].workers);
+    }
+    fprintf(out, "\n");
+    free(metrics);
+    free(g_occupancy);
+    g_occupancy = NULL;
+    return bottleneck;
+}
@@ -0,0 +1,42 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <stdio.h>
+
+typedef struct {
+    int capacity; // Queue capacity
+    int batch; // Most lines taken at once
+    int workers; // Consumer threads, 1 for a stage that keeps state
+    double service_ns; // Measured transform time per line, 0 when the stage processed no line
+} autotune_choice_t;
+
+/**
+ * Start sampling every stage's queue occupancy for the calibration
+ * The sampler reads plugin_metrics every few milliseconds, so it never blocks
+ * the pipeline. Stages keep their settings until autotune_finish.
+ * @return NULL on success, error message on failure
+ */
+const char* autotune_start(void);
+
+/**
+ * Stop sampling and pick each stage's settings from what was measured
+ * The transform time per line sets the workers: a stateless stage gets enough
+ * of them to keep up with the slowest stage that cannot run on several threads,
+ * within the CPUs. The batch amortizes the per-batch cost over about 50 us of
+ * work, and the capacity holds a few batches per worker, or twice the peak
+ * backlog of a queue that rarely filled. Stages that processed no line keep
+ * their settings. The choices and an option line reproducing them are printed.
+ * @param cpus CPUs the workers may use
+ * @param choices One entry per stage, filled in
+ * @param out Stream to print the report to
+ * @return Index of the bottleneck stage, -1 when nothing was measured
+ */
+int autotune_finish(int cpus, autotune_choice_t* choices, FILE* out);
+
+/**
+ * Whether autotune_start ran and autotune_finish did not yet
+ * @return Non-zero while sampling
+ */
+int autotune_running(void);
+
+#endif
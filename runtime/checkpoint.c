@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include "checkpoint.h"
+#include "sink.h"
+
+#define CHECKPOINT_PATH_MAX 4096
+
+static char g_path[CHECKPOINT_PATH_MAX];
+static char g_tmp_path[CHECKPOINT_PATH_MAX + 8];
+static char g_dir_path[CHECKPOINT_PATH_MAX];
+static int g_interval_ms = 0;
+static checkpoint_sync_fn g_sync_output = NULL;
+static atomic_llong g_committed = 0;
+static long long g_written = -1;
+// Offset waiting for the sinks to sync up to their marks, -1 if none
+static long long g_pending = -1;
+static unsigned long long g_marks[SINK_MAX];
+static pthread_t g_thread;
+static int g_running = 0;
+static int g_stop = 0;
+static pthread_mutex_t g_stop_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_stop_cond = PTHREAD_COND_INITIALIZER;
+
+long long checkpoint_load(const char* path) {
+    if (!path) return -1;
+    FILE* file = fopen(path, "r");
+    if (!file) return -1;
+    long long offset = -1;
+    if (fscanf(file, "%lld", &offset) != 1 || offset < 0) offset = -1;
+    fclose(file);
+    return offset;
+}
+
+static int write_checkpoint(long long offset) {
+    FILE* file = fopen(g_tmp_path, "w");
+    if (!file) return -1;
+    fprintf(file, "%lld\n", offset);
+    if (fflush(file) != 0 || fsync(fileno(file)) != 0) {
+        fclose(file);
+        unlink(g_tmp_path);
+        return -1;
+    }
+    fclose(file);
+    if (rename(g_tmp_path, g_path) != 0) {
+        unlink(g_tmp_path);
+        return -1;
+    }
+    // The rename itself is only durable once the directory is
+    int dir = open(g_dir_path, O_RDONLY | O_DIRECTORY);
+    if (dir < 0) return -1;
+    int synced = fsync(dir);
+    close(dir);
+    if (synced != 0) return -1;
+    g_written = offset;
+    return 0;
+}
+
+static void publish(long long offset) {
+    if (write_checkpoint(offset) != 0) {
+        fprintf(stderr, "Failed to write checkpoint %s: %s\n", g_path, strerror(errno));
+    }
+}
+
+/*
+ * A committed line may still sit in a stdio buffer, a compression block or a
+ * sink's queue. The offset is taken first, then the output is synced and every
+ * sink asked to sync up to what it holds now, which covers all lines up to the
+ * offset. The offset is written once the sinks got there, on this or a later tick.
+ */
+static void flush_checkpoint(void) {
+    if (g_pending >= 0) {
+        if (!sink_synced(g_marks)) return;
+        publish(g_pending);
+        g_pending = -1;
+    }
+    long long offset = atomic_load_explicit(&g_committed, memory_order_acquire);
+    if (offset == g_written) return;
+    if (g_sync_output) {
+        const char* err = g_sync_output();
+        if (err) {
+            fprintf(stderr, "Failed to sync output for checkpoint: %s\n", err);
+            return;
+        }
+    }
+    sink_request_sync(g_marks);
+    if (sink_synced(g_marks)) {
+        publish(offset);
+    } else {
+        g_pending = offset;
+    }
+}
+
+static void* checkpoint_thread(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&g_stop_mutex);
+    while (!g_stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += g_interval_ms / 1000;
+        deadline.tv_nsec += (long)(g_interval_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        int rc = 0;
+        while (!g_stop && rc != ETIMEDOUT) {
+            rc = pthread_cond_timedwait(&g_stop_cond, &g_stop_mutex, &deadline);
+        }
+        if (g_stop) break;
+        pthread_mutex_unlock(&g_stop_mutex);
+        flush_checkpoint();
+        pthread_mutex_lock(&g_stop_mutex);
+    }
+    pthread_mutex_unlock(&g_stop_mutex);
+    return NULL;
+}
+
+const char* checkpoint_start(const char* path, int interval_ms, long long start_offset, checkpoint_sync_fn sync_output) {
+    if (!path) return "Path is NULL";
+    if (strlen(path) >= CHECKPOINT_PATH_MAX) return "Checkpoint path too long";
+    if (interval_ms <= 0) return "Interval must be greater than 0";
+    if (g_running) return "Checkpointing already running";
+    snprintf(g_path, sizeof(g_path), "%s", path);
+    snprintf(g_tmp_path, sizeof(g_tmp_path), "%s.tmp", path);
+    // dirname may modify its argument
+    char copy[CHECKPOINT_PATH_MAX];
+    snprintf(copy, sizeof(copy), "%s", path);
+    snprintf(g_dir_path, sizeof(g_dir_path), "%s", dirname(copy));
+    g_interval_ms = interval_ms;
+    g_sync_output = sync_output;
+    atomic_store(&g_committed, start_offset < 0 ? 0 : start_offset);
+    g_written = -1;
+    g_pending = -1;
+    g_stop = 0;
+    if (pthread_create(&g_thread, NULL, checkpoint_thread, NULL) != 0) {
+        return "Could not create checkpoint thread";
+    }
+    g_running = 1;
+    return NULL;
+}
+
+const char* checkpoint_commit(const char* str, const record_meta_t* meta) {
+    (void)str;
+    if (meta && meta->end_offset >= 0) {
+        // Release, so the checkpoint thread that sees the offset also sees the line written
+        atomic_store_explicit(&g_committed, meta->end_offset, memory_order_release);
+    }
+    return NULL;
+}
+
+void checkpoint_stop(void) {
+    if (!g_running) return;
+    pthread_mutex_lock(&g_stop_mutex);
+    g_stop = 1;
+    pthread_cond_signal(&g_stop_cond);
+    pthread_mutex_unlock(&g_stop_mutex);
+    pthread_join(g_thread, NULL);
+    g_running = 0;
+    flush_checkpoint();
+    return;
+}
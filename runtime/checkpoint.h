@@ -0,0 +1,52 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "../plugins/sync/consumer_producer.h"
+
+/**
+ * Read the input offset stored in a checkpoint file
+ * @param path Checkpoint file path
+ * @return Stored offset, or -1 if the file is missing or malformed
+ */
+long long checkpoint_load(const char* path);
+
+/**
+ * Make the lines written to the analyzer's own output so far durable
+ * @return NULL on success, error message on failure
+ */
+typedef const char* (*checkpoint_sync_fn)(void);
+
+/**
+ * Start periodic checkpointing
+ * A background thread rewrites the checkpoint file (write to a temporary file,
+ * fsync, atomic rename, fsync of the directory) whenever the committed offset
+ * moved, so the hot path only pays for one atomic store per line. An offset is
+ * only written once the output and every sink synced the lines before it.
+ * @param path Checkpoint file path
+ * @param interval_ms Time between two checkpoint writes
+ * @param start_offset Offset to report until the first line is committed
+ * @param sync_output Syncs the output written in the committing thread, NULL if there is none
+ * @return NULL on success, error message on failure
+ */
+const char* checkpoint_start(const char* path, int interval_ms, long long start_offset, checkpoint_sync_fn sync_output);
+
+/**
+ * Mark a record as committed at the sink
+ * Matches the place_record signature so it can be attached after the last stage.
+ * Lines leave the pipeline in input order, so the end offset of the last
+ * committed line is the offset of the oldest line not yet committed. Call it
+ * after the line was handed to the output and the sinks.
+ * @param str Output of the last stage (unused)
+ * @param meta Record metadata carrying the input end offset
+ * @return NULL always
+ */
+const char* checkpoint_commit(const char* str, const record_meta_t* meta);
+
+/**
+ * Stop the checkpoint thread and write a final checkpoint
+ * Call it after sink_stop, so the sinks synced every line. Safe to call when
+ * checkpointing was never started
+ */
+void checkpoint_stop(void);
+
+#endif
@@ -0,0 +1,739 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <zlib.h>
+#include "compress.h"
+
+#define GZIP_BLOCK_INPUT 0xff00 // Keeps a worst-case BGZF member under 64KB
+#define GZIP_BLOCK_MAX 0x10000
+#define GZIP_HEADER_SIZE 18
+#define GZIP_TRAILER_SIZE 8
+#define ZSTD_BLOCK_INPUT (1024 * 1024)
+#define STREAM_CHUNK (128 * 1024)
+#define GZIP_LEVEL 6
+#define ZSTD_LEVEL 3
+
+/* zstd is loaded at runtime so neither the build nor plain runs need it */
+typedef struct ZSTD_DStream_s ZSTD_DStream;
+typedef struct { const void* src; size_t size; size_t pos; } zstd_in_buffer_t;
+typedef struct { void* dst; size_t size; size_t pos; } zstd_out_buffer_t;
+
+static struct {
+    void* handle;
+    const char* error;
+    size_t (*compress_bound)(size_t);
+    size_t (*compress)(void*, size_t, const void*, size_t, int);
+    unsigned (*is_error)(size_t);
+    ZSTD_DStream* (*create_dstream)(void);
+    size_t (*free_dstream)(ZSTD_DStream*);
+    size_t (*init_dstream)(ZSTD_DStream*);
+    size_t (*decompress_stream)(ZSTD_DStream*, zstd_out_buffer_t*, zstd_in_buffer_t*);
+} g_zstd;
+static pthread_once_t g_zstd_once = PTHREAD_ONCE_INIT;
+
+static void load_zstd_once(void) {
+    g_zstd.handle = dlopen("libzstd.so.1", RTLD_NOW | RTLD_LOCAL);
+    if (!g_zstd.handle) {
+        g_zstd.error = "zstd support needs libzstd.so.1";
+        return;
+    }
+    g_zstd.compress_bound = (size_t (*)(size_t))dlsym(g_zstd.handle, "ZSTD_compressBound");
+    g_zstd.compress = (size_t (*)(void*, size_t, const void*, size_t, int))dlsym(g_zstd.handle, "ZSTD_compress");
+    g_zstd.is_error = (unsigned (*)(size_t))dlsym(g_zstd.handle, "ZSTD_isError");
+    g_zstd.create_dstream = (ZSTD_DStream* (*)(void))dlsym(g_zstd.handle, "ZSTD_createDStream");
+    g_zstd.free_dstream = (size_t (*)(ZSTD_DStream*))dlsym(g_zstd.handle, "ZSTD_freeDStream");
+    g_zstd.init_dstream = (size_t (*)(ZSTD_DStream*))dlsym(g_zstd.handle, "ZSTD_initDStream");
+    g_zstd.decompress_stream = (size_t (*)(ZSTD_DStream*, zstd_out_buffer_t*, zstd_in_buffer_t*))
+        dlsym(g_zstd.handle, "ZSTD_decompressStream");
+    if (!g_zstd.compress_bound || !g_zstd.compress || !g_zstd.is_error || !g_zstd.create_dstream ||
+        !g_zstd.free_dstream || !g_zstd.init_dstream || !g_zstd.decompress_stream) {
+        g_zstd.error = "libzstd.so.1 is missing symbols";
+    }
+}
+
+static const char* load_zstd(void) {
+    pthread_once(&g_zstd_once, load_zstd_once);
+    return g_zstd.error;
+}
+
+codec_t compress_codec_from_path(const char* path) {
+    if (!path) return CODEC_NONE;
+    size_t len = strlen(path);
+    if (len > 3 && strcmp(path + len - 3, ".gz") == 0) return CODEC_GZIP;
+    if (len > 4 && strcmp(path + len - 4, ".zst") == 0) return CODEC_ZSTD;
+    return CODEC_NONE;
+}
+
+const char* compress_codec_from_name(const char* name, codec_t* codec) {
+    if (!name || !codec) return "Codec name is NULL";
+    if (strcmp(name, "gzip") == 0 || strcmp(name, "gz") == 0) *codec = CODEC_GZIP;
+    else if (strcmp(name, "zstd") == 0 || strcmp(name, "zst") == 0) *codec = CODEC_ZSTD;
+    else if (strcmp(name, "none") == 0) *codec = CODEC_NONE;
+    else return "Unknown codec (expected gzip, zstd or none)";
+    return NULL;
+}
+
+static void put_u16(unsigned char* out, unsigned value) {
+    out[0] = (unsigned char)value;
+    out[1] = (unsigned char)(value >> 8);
+}
+
+static void put_u32(unsigned char* out, unsigned long value) {
+    out[0] = (unsigned char)value;
+    out[1] = (unsigned char)(value >> 8);
+    out[2] = (unsigned char)(value >> 16);
+    out[3] = (unsigned char)(value >> 24);
+}
+
+static unsigned long get_u32(const unsigned char* in) {
+    return (unsigned long)in[0] | ((unsigned long)in[1] << 8) | ((unsigned long)in[2] << 16) | ((unsigned long)in[3] << 24);
+}
+
+static int write_all(int fd, const unsigned char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/*
+ * Ordered block pool
+ * Blocks are submitted with increasing sequence numbers, transformed by any
+ * worker, and written to fd strictly in submission order by one writer thread.
+ */
+
+typedef size_t (*block_fn)(const unsigned char* in, size_t in_len, unsigned char* out, size_t out_cap);
+#define BLOCK_ERROR ((size_t)-1)
+
+enum { BLOCK_FREE = 0, BLOCK_READY, BLOCK_BUSY, BLOCK_DONE };
+
+typedef struct {
+    unsigned char* in;
+    size_t in_len;
+    unsigned char* out;
+    size_t out_len;
+    int state;
+} block_t;
+
+typedef struct {
+    block_t* blocks;
+    int num_blocks;
+    size_t in_cap;
+    size_t out_cap;
+    pthread_t* workers;
+    int num_workers;
+    pthread_t writer;
+    int fd;
+    block_fn fn;
+    unsigned long long next_submit;
+    unsigned long long next_work;
+    unsigned long long next_write;
+    int closing;
+    const char* error;
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    pthread_cond_t free_cond;
+} block_pool_t;
+
+static void* block_worker(void* arg) {
+    block_pool_t* pool = (block_pool_t*)arg;
+    pthread_mutex_lock(&pool->mutex);
+    while (1) {
+        while (pool->next_work == pool->next_submit && !pool->closing) {
+            pthread_cond_wait(&pool->work_cond, &pool->mutex);
+        }
+        if (pool->next_work == pool->next_submit) break;
+        block_t* block = &pool->blocks[pool->next_work % pool->num_blocks];
+        pool->next_work++;
+        block->state = BLOCK_BUSY;
+        pthread_mutex_unlock(&pool->mutex);
+
+        block->out_len = pool->fn(block->in, block->in_len, block->out, pool->out_cap);
+
+        pthread_mutex_lock(&pool->mutex);
+        block->state = BLOCK_DONE;
+        pthread_cond_broadcast(&pool->done_cond);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+static void* block_writer(void* arg) {
+    block_pool_t* pool = (block_pool_t*)arg;
+    pthread_mutex_lock(&pool->mutex);
+    while (1) {
+        block_t* block = &pool->blocks[pool->next_write % pool->num_blocks];
+        while (!(pool->next_write < pool->next_submit && block->state == BLOCK_DONE) &&
+               !(pool->closing && pool->next_write == pool->next_submit)) {
+            pthread_cond_wait(&pool->done_cond, &pool->mutex);
+        }
+        if (pool->next_write == pool->next_submit) break;
+        pthread_mutex_unlock(&pool->mutex);
+
+        const char* err = NULL;
+        if (block->out_len == BLOCK_ERROR) err = "Block codec failed";
+        else if (write_all(pool->fd, block->out, block->out_len) != 0) err = "Could not write block";
+
+        pthread_mutex_lock(&pool->mutex);
+        if (err && !pool->error) pool->error = err;
+        block->state = BLOCK_FREE;
+        pool->next_write++;
+        pthread_cond_broadcast(&pool->free_cond);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+static void block_pool_free(block_pool_t* pool) {
+    for (int i = 0; i < pool->num_blocks; i++) {
+        free(pool->blocks[i].in);
+        free(pool->blocks[i].out);
+    }
+    free(pool->blocks);
+    free(pool->workers);
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_cond_destroy(&pool->done_cond);
+    pthread_cond_destroy(&pool->free_cond);
+    free(pool);
+}
+
+static const char* block_pool_create(int threads, size_t in_cap, size_t out_cap, int fd, block_fn fn, block_pool_t** out) {
+    if (threads < 1) threads = 1;
+    block_pool_t* pool = calloc(1, sizeof(block_pool_t));
+    if (!pool) return "Could not allocate block pool";
+    pool->num_blocks = threads * 2 + 1;
+    pool->in_cap = in_cap;
+    pool->out_cap = out_cap;
+    pool->fd = fd;
+    pool->fn = fn;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+    pthread_cond_init(&pool->free_cond, NULL);
+    pool->blocks = calloc(pool->num_blocks, sizeof(block_t));
+    pool->workers = calloc(threads, sizeof(pthread_t));
+    if (!pool->blocks || !pool->workers) {
+        block_pool_free(pool);
+        return "Could not allocate block pool";
+    }
+    for (int i = 0; i < pool->num_blocks; i++) {
+        pool->blocks[i].in = malloc(in_cap);
+        pool->blocks[i].out = malloc(out_cap);
+        if (!pool->blocks[i].in || !pool->blocks[i].out) {
+            block_pool_free(pool);
+            return "Could not allocate block buffers";
+        }
+    }
+    // Pool threads take no signals: a closed pipe or output must surface as EPIPE
+    // on our writes, and cancel signals belong to the thread reading the input
+    sigset_t block_all, old_mask;
+    sigfillset(&block_all);
+    pthread_sigmask(SIG_BLOCK, &block_all, &old_mask);
+    int created = 0;
+    for (; created < threads; created++) {
+        if (pthread_create(&pool->workers[created], NULL, block_worker, pool) != 0) break;
+    }
+    pool->num_workers = created;
+    int writer_ok = created > 0 && pthread_create(&pool->writer, NULL, block_writer, pool) == 0;
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+    if (!writer_ok) {
+        pthread_mutex_lock(&pool->mutex);
+        pool->closing = 1;
+        pthread_cond_broadcast(&pool->work_cond);
+        pthread_mutex_unlock(&pool->mutex);
+        for (int i = 0; i < pool->num_workers; i++) pthread_join(pool->workers[i], NULL);
+        block_pool_free(pool);
+        return "Could not create block pool threads";
+    }
+    *out = pool;
+    return NULL;
+}
+
+// Wait for the next free block; the caller fills in and in_len, then submits
+static block_t* block_pool_acquire(block_pool_t* pool) {
+    pthread_mutex_lock(&pool->mutex);
+    block_t* block = &pool->blocks[pool->next_submit % pool->num_blocks];
+    while (block->state != BLOCK_FREE) {
+        pthread_cond_wait(&pool->free_cond, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    block->in_len = 0;
+    return block;
+}
+
+static const char* block_pool_submit(block_pool_t* pool, block_t* block) {
+    pthread_mutex_lock(&pool->mutex);
+    block->state = BLOCK_READY;
+    pool->next_submit++;
+    pthread_cond_signal(&pool->work_cond);
+    const char* err = pool->error;
+    pthread_mutex_unlock(&pool->mutex);
+    return err;
+}
+
+static const char* block_pool_close(block_pool_t* pool) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->closing = 1;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_cond_broadcast(&pool->done_cond);
+    pthread_mutex_unlock(&pool->mutex);
+    for (int i = 0; i < pool->num_workers; i++) pthread_join(pool->workers[i], NULL);
+    pthread_join(pool->writer, NULL);
+    const char* err = pool->error;
+    block_pool_free(pool);
+    return err;
+}
+
+/* Block codecs */
+
+// One BGZF member: gzip header with a 'BC' extra field holding the member size
+static size_t gzip_compress_block(const unsigned char* in, size_t in_len, unsigned char* out, size_t out_cap) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, GZIP_LEVEL, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) return BLOCK_ERROR;
+    zs.next_in = (unsigned char*)in;
+    zs.avail_in = (uInt)in_len;
+    zs.next_out = out + GZIP_HEADER_SIZE;
+    zs.avail_out = (uInt)(out_cap - GZIP_HEADER_SIZE - GZIP_TRAILER_SIZE);
+    int rc = deflate(&zs, Z_FINISH);
+    size_t compressed = zs.total_out;
+    deflateEnd(&zs);
+    if (rc != Z_STREAM_END) return BLOCK_ERROR;
+
+    size_t total = GZIP_HEADER_SIZE + compressed + GZIP_TRAILER_SIZE;
+    static const unsigned char header[12] = { 0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0 };
+    memcpy(out, header, sizeof(header));
+    out[12] = 'B';
+    out[13] = 'C';
+    put_u16(out + 14, 2);
+    put_u16(out + 16, (unsigned)(total - 1));
+    unsigned char* trailer = out + GZIP_HEADER_SIZE + compressed;
+    put_u32(trailer, crc32(0L, in, (uInt)in_len));
+    put_u32(trailer + 4, (unsigned long)in_len);
+    return total;
+}
+
+static size_t gzip_decompress_block(const unsigned char* in, size_t in_len, unsigned char* out, size_t out_cap) {
+    if (in_len < 12 + GZIP_TRAILER_SIZE) return BLOCK_ERROR;
+    size_t data_start = 12 + (size_t)(in[10] | (in[11] << 8));
+    if (data_start + GZIP_TRAILER_SIZE > in_len) return BLOCK_ERROR;
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit2(&zs, -15) != Z_OK) return BLOCK_ERROR;
+    zs.next_in = (unsigned char*)in + data_start;
+    zs.avail_in = (uInt)(in_len - data_start - GZIP_TRAILER_SIZE);
+    zs.next_out = out;
+    zs.avail_out = (uInt)out_cap;
+    int rc = inflate(&zs, Z_FINISH);
+    size_t produced = zs.total_out;
+    inflateEnd(&zs);
+    const unsigned char* trailer = in + in_len - GZIP_TRAILER_SIZE;
+    if (rc != Z_STREAM_END || get_u32(trailer + 4) != produced ||
+        get_u32(trailer) != crc32(0L, out, (uInt)produced)) {
+        return BLOCK_ERROR;
+    }
+    return produced;
+}
+
+static size_t zstd_compress_block(const unsigned char* in, size_t in_len, unsigned char* out, size_t out_cap) {
+    size_t n = g_zstd.compress(out, out_cap, in, in_len, ZSTD_LEVEL);
+    return g_zstd.is_error(n) ? BLOCK_ERROR : n;
+}
+
+/* Output side: a cookie stream that cuts written bytes into blocks */
+
+typedef struct output_cookie {
+    block_pool_t* pool;
+    block_t* block;
+    size_t block_input;
+    FILE* stream; // The wrapper handed to the caller
+    struct output_cookie* next;
+} output_cookie_t;
+
+static output_cookie_t* g_encoders = NULL; // Open compressed outputs, for compress_sync_output
+static pthread_mutex_t g_encoders_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static ssize_t output_write(void* cookie, const char* buf, size_t size) {
+    output_cookie_t* out = (output_cookie_t*)cookie;
+    size_t done = 0;
+    while (done < size) {
+        size_t room = out->block_input - out->block->in_len;
+        size_t n = size - done < room ? size - done : room;
+        memcpy(out->block->in + out->block->in_len, buf + done, n);
+        out->block->in_len += n;
+        done += n;
+        if (out->block->in_len == out->block_input) {
+            if (block_pool_submit(out->pool, out->block) != NULL) return -1;
+            out->block = block_pool_acquire(out->pool);
+        }
+    }
+    return (ssize_t)size;
+}
+
+static int output_close(void* cookie) {
+    output_cookie_t* out = (output_cookie_t*)cookie;
+    pthread_mutex_lock(&g_encoders_mutex);
+    output_cookie_t** link = &g_encoders;
+    while (*link && *link != out) link = &(*link)->next;
+    if (*link) *link = out->next;
+    pthread_mutex_unlock(&g_encoders_mutex);
+    if (out->block->in_len > 0) block_pool_submit(out->pool, out->block);
+    const char* err = block_pool_close(out->pool);
+    free(out);
+    if (err) {
+        fprintf(stderr, "Compressed output failed: %s\n", err);
+        return -1;
+    }
+    return 0;
+}
+
+const char* compress_open_output(FILE* out, codec_t codec, int threads, FILE** wrapped) {
+    if (!out || !wrapped) return "Stream is NULL";
+    size_t block_input;
+    size_t block_max;
+    block_fn fn;
+    if (codec == CODEC_GZIP) {
+        block_input = GZIP_BLOCK_INPUT;
+        block_max = GZIP_BLOCK_MAX;
+        fn = gzip_compress_block;
+    } else if (codec == CODEC_ZSTD) {
+        const char* err = load_zstd();
+        if (err) return err;
+        block_input = ZSTD_BLOCK_INPUT;
+        block_max = g_zstd.compress_bound(ZSTD_BLOCK_INPUT);
+        fn = zstd_compress_block;
+    } else {
+        return "No codec selected";
+    }
+    fflush(out);
+
+    output_cookie_t* cookie = calloc(1, sizeof(output_cookie_t));
+    if (!cookie) return "Could not allocate compressed stream";
+    const char* err = block_pool_create(threads, block_input, block_max, fileno(out), fn, &cookie->pool);
+    if (err) {
+        free(cookie);
+        return err;
+    }
+    cookie->block_input = block_input;
+    cookie->block = block_pool_acquire(cookie->pool);
+
+    cookie_io_functions_t io = { NULL, output_write, NULL, output_close };
+    FILE* stream = fopencookie(cookie, "w", io);
+    if (!stream) {
+        block_pool_close(cookie->pool);
+        free(cookie);
+        return "Could not create compressed stream";
+    }
+    // Fill whole blocks per write call instead of the default small stdio buffer
+    setvbuf(stream, NULL, _IOFBF, STREAM_CHUNK);
+    cookie->stream = stream;
+    pthread_mutex_lock(&g_encoders_mutex);
+    cookie->next = g_encoders;
+    g_encoders = cookie;
+    pthread_mutex_unlock(&g_encoders_mutex);
+    *wrapped = stream;
+    return NULL;
+}
+
+const char* compress_sync_output(FILE* wrapped) {
+    pthread_mutex_lock(&g_encoders_mutex);
+    output_cookie_t* out = g_encoders;
+    while (out && out->stream != wrapped) out = out->next;
+    pthread_mutex_unlock(&g_encoders_mutex);
+    if (!out) return "Stream is not a compressed output";
+
+    // The stream lock keeps writers out while the partial block is cut off
+    flockfile(wrapped);
+    int flushed = fflush(wrapped) == 0;
+    if (flushed && out->block->in_len > 0) {
+        block_pool_submit(out->pool, out->block);
+        out->block = block_pool_acquire(out->pool);
+    }
+    block_pool_t* pool = out->pool;
+    pthread_mutex_lock(&pool->mutex);
+    unsigned long long target = pool->next_submit;
+    funlockfile(wrapped);
+    while (pool->next_write < target && !pool->error) {
+        pthread_cond_wait(&pool->free_cond, &pool->mutex);
+    }
+    const char* err = pool->error;
+    pthread_mutex_unlock(&pool->mutex);
+    if (!flushed) return "Could not flush compressed output";
+    if (err) return err;
+    // Pipes and terminals cannot be synced, and need not be
+    if (fsync(pool->fd) != 0 && errno != EINVAL && errno != EROFS) return "Could not sync compressed output";
+    return NULL;
+}
+
+/* Input side: decoder threads feeding a pipe */
+
+struct compress_input {
+    FILE* in;
+    unsigned char prefix[GZIP_HEADER_SIZE]; // Bytes read ahead of the decoder (magic number, peeked header)
+    size_t prefix_len;
+    size_t prefix_pos;
+    codec_t codec;
+    int threads;
+    int pipe_fd;
+    const char* error;
+    pthread_t thread;
+    FILE* decoded; // Read end of the pipe, handed to the caller
+};
+
+typedef compress_input_t decoder_t;
+
+static decoder_t* g_decoder = NULL; // Handle behind compress_open_input
+
+static size_t decoder_read(decoder_t* dec, unsigned char* buf, size_t len) {
+    size_t got = 0;
+    while (got < len && dec->prefix_pos < dec->prefix_len) {
+        buf[got++] = dec->prefix[dec->prefix_pos++];
+    }
+    if (got < len) got += fread(buf + got, 1, len - got, dec->in);
+    return got;
+}
+
+// Make up to len bytes visible at the front of the read-ahead buffer without consuming them
+static size_t decoder_peek(decoder_t* dec, size_t len, const unsigned char** data) {
+    size_t avail = dec->prefix_len - dec->prefix_pos;
+    if (avail < len) {
+        memmove(dec->prefix, dec->prefix + dec->prefix_pos, avail);
+        dec->prefix_pos = 0;
+        dec->prefix_len = avail + fread(dec->prefix + avail, 1, len - avail, dec->in);
+        avail = dec->prefix_len;
+    }
+    *data = dec->prefix + dec->prefix_pos;
+    return avail < len ? avail : len;
+}
+
+static const char* decode_passthrough(decoder_t* dec) {
+    unsigned char* buf = malloc(STREAM_CHUNK);
+    if (!buf) return "Could not allocate decode buffer";
+    size_t n;
+    while ((n = decoder_read(dec, buf, STREAM_CHUNK)) > 0) {
+        if (write_all(dec->pipe_fd, buf, n) != 0) break;
+    }
+    free(buf);
+    return NULL;
+}
+
+static const char* decode_gzip_stream(decoder_t* dec) {
+    unsigned char* in = malloc(STREAM_CHUNK);
+    unsigned char* out = malloc(STREAM_CHUNK);
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (!in || !out || inflateInit2(&zs, 15 + 16) != Z_OK) {
+        free(in);
+        free(out);
+        return "Could not initialize gzip decoder";
+    }
+    const char* err = NULL;
+    int done = 0;
+    while (!done && !err) {
+        zs.avail_in = (uInt)decoder_read(dec, in, STREAM_CHUNK);
+        zs.next_in = in;
+        if (zs.avail_in == 0) break;
+        while (zs.avail_in > 0 && !err) {
+            zs.next_out = out;
+            zs.avail_out = STREAM_CHUNK;
+            int rc = inflate(&zs, Z_NO_FLUSH);
+            if (rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR) {
+                err = "Corrupt gzip input";
+                break;
+            }
+            if (write_all(dec->pipe_fd, out, STREAM_CHUNK - zs.avail_out) != 0) {
+                done = 1;
+                break;
+            }
+            // Rotated logs are often concatenated gzip members
+            if (rc == Z_STREAM_END) inflateReset(&zs);
+        }
+    }
+    inflateEnd(&zs);
+    free(in);
+    free(out);
+    return err;
+}
+
+// Read one BGZF member into block; returns 1 on success, 0 at EOF, -1 if not BGZF
+static int read_bgzf_member(decoder_t* dec, block_t* block, size_t cap) {
+    unsigned char* p = block->in;
+    size_t got = decoder_read(dec, p, 12);
+    if (got == 0) return 0;
+    if (got != 12 || p[0] != 0x1f || p[1] != 0x8b || !(p[3] & 4)) return -1;
+    size_t xlen = (size_t)(p[10] | (p[11] << 8));
+    if (12 + xlen > cap || decoder_read(dec, p + 12, xlen) != xlen) return -1;
+    size_t bsize = 0;
+    for (size_t i = 12; i + 4 <= 12 + xlen; ) {
+        size_t sublen = (size_t)(p[i + 2] | (p[i + 3] << 8));
+        if (p[i] == 'B' && p[i + 1] == 'C' && sublen == 2) bsize = (size_t)(p[i + 4] | (p[i + 5] << 8)) + 1;
+        i += 4 + sublen;
+    }
+    if (bsize == 0 || bsize > cap || bsize < 12 + xlen) return -1;
+    size_t rest = bsize - 12 - xlen;
+    if (decoder_read(dec, p + 12 + xlen, rest) != rest) return -1;
+    block->in_len = bsize;
+    return 1;
+}
+
+static const char* decode_bgzf_parallel(decoder_t* dec) {
+    block_pool_t* pool;
+    const char* err = block_pool_create(dec->threads, GZIP_BLOCK_MAX, GZIP_BLOCK_MAX, dec->pipe_fd,
+                                        gzip_decompress_block, &pool);
+    if (err) return err;
+    while (1) {
+        block_t* block = block_pool_acquire(pool);
+        int rc = read_bgzf_member(dec, block, GZIP_BLOCK_MAX);
+        if (rc == 0) break;
+        if (rc < 0) {
+            err = "Corrupt block gzip input";
+            break;
+        }
+        if (block_pool_submit(pool, block) != NULL) break;
+    }
+    const char* close_err = block_pool_close(pool);
+    if (!err && close_err && strcmp(close_err, "Could not write block") != 0) err = "Corrupt block gzip input";
+    return err;
+}
+
+static const char* decode_zstd_stream(decoder_t* dec) {
+    const char* err = load_zstd();
+    if (err) return err;
+    ZSTD_DStream* stream = g_zstd.create_dstream();
+    unsigned char* in = malloc(STREAM_CHUNK);
+    unsigned char* out = malloc(STREAM_CHUNK);
+    if (!stream || !in || !out) {
+        if (stream) g_zstd.free_dstream(stream);
+        free(in);
+        free(out);
+        return "Could not initialize zstd decoder";
+    }
+    g_zstd.init_dstream(stream);
+    int done = 0;
+    while (!done && !err) {
+        zstd_in_buffer_t input = { in, decoder_read(dec, in, STREAM_CHUNK), 0 };
+        if (input.size == 0) break;
+        while (input.pos < input.size) {
+            zstd_out_buffer_t output = { out, STREAM_CHUNK, 0 };
+            size_t rc = g_zstd.decompress_stream(stream, &output, &input);
+            if (g_zstd.is_error(rc)) {
+                err = "Corrupt zstd input";
+                break;
+            }
+            if (write_all(dec->pipe_fd, out, output.pos) != 0) {
+                done = 1;
+                break;
+            }
+        }
+    }
+    g_zstd.free_dstream(stream);
+    free(in);
+    free(out);
+    return err;
+}
+
+static void* decoder_thread(void* arg) {
+    decoder_t* dec = (decoder_t*)arg;
+    if (dec->codec == CODEC_ZSTD) {
+        dec->error = decode_zstd_stream(dec);
+    } else if (dec->codec == CODEC_GZIP) {
+        // BGZF members announce their size in the first header and decode in parallel
+        const unsigned char* header;
+        size_t got = decoder_peek(dec, GZIP_HEADER_SIZE, &header);
+        int bgzf = got == GZIP_HEADER_SIZE && (header[3] & 4) && header[10] == 6 && header[11] == 0 &&
+                   header[12] == 'B' && header[13] == 'C' && header[14] == 2 && header[15] == 0;
+        dec->error = bgzf ? decode_bgzf_parallel(dec) : decode_gzip_stream(dec);
+    } else {
+        dec->error = decode_passthrough(dec);
+    }
+    close(dec->pipe_fd);
+    return NULL;
+}
+
+const char* compress_input_open(FILE* in, int threads, FILE** out, compress_input_t** input) {
+    if (!in || !out || !input) return "Stream is NULL";
+    *out = in;
+    *input = NULL;
+    int c = getc(in);
+    if (c == EOF) return NULL;
+    ungetc(c, in);
+    if (c != 0x1f && c != 0x28) return NULL;
+
+    decoder_t* dec = calloc(1, sizeof(decoder_t));
+    if (!dec) return "Could not allocate decoder";
+    dec->in = in;
+    dec->threads = threads < 1 ? 1 : threads;
+    size_t magic_len = c == 0x1f ? 2 : 4;
+    dec->prefix_len = fread(dec->prefix, 1, magic_len, in);
+    if (dec->prefix_len == 2 && dec->prefix[0] == 0x1f && dec->prefix[1] == 0x8b) {
+        dec->codec = CODEC_GZIP;
+    } else if (dec->prefix_len == 4 && memcmp(dec->prefix, "\x28\xb5\x2f\xfd", 4) == 0) {
+        dec->codec = CODEC_ZSTD;
+    } else {
+        // Plain text that happens to start like a magic number
+        dec->codec = CODEC_NONE;
+    }
+
+    int fds[2];
+    if (pipe(fds) != 0) {
+        free(dec);
+        return "Could not create decode pipe";
+    }
+    dec->pipe_fd = fds[1];
+    FILE* decoded = fdopen(fds[0], "r");
+    if (!decoded) {
+        close(fds[0]);
+        close(fds[1]);
+        free(dec);
+        return "Could not open decode pipe";
+    }
+    sigset_t block_all, old_mask;
+    sigfillset(&block_all);
+    pthread_sigmask(SIG_BLOCK, &block_all, &old_mask);
+    int rc = pthread_create(&dec->thread, NULL, decoder_thread, dec);
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+    if (rc != 0) {
+        fclose(decoded);
+        close(fds[1]);
+        free(dec);
+        return "Could not create decoder thread";
+    }
+    dec->decoded = decoded;
+    *input = dec;
+    *out = decoded;
+    return NULL;
+}
+
+const char* compress_input_close(compress_input_t* input) {
+    if (!input) return NULL;
+    // Closing the read end first unblocks a decoder stuck on a full pipe
+    fclose(input->decoded);
+    pthread_join(input->thread, NULL);
+    const char* err = input->error;
+    free(input);
+    return err;
+}
+
+const char* compress_open_input(FILE* in, int threads, FILE** out) {
+    return compress_input_open(in, threads, out, &g_decoder);
+}
+
+const char* compress_close_input(void) {
+    const char* err = compress_input_close(g_decoder);
+    g_decoder = NULL;
+    return err;
+}
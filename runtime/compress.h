@@ -0,0 +1,88 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stdio.h>
+
+typedef enum {
+    CODEC_NONE = 0,
+    CODEC_GZIP,
+    CODEC_ZSTD
+} codec_t;
+
+/**
+ * Pick a codec from a file name extension (.gz or .zst)
+ * @param path File name
+ * @return Matching codec, CODEC_NONE for anything else
+ */
+codec_t compress_codec_from_path(const char* path);
+
+/**
+ * Parse a codec name ("gzip", "zstd" or "none")
+ * @param name Codec name
+ * @param codec Output codec
+ * @return NULL on success, error message on failure
+ */
+const char* compress_codec_from_name(const char* name, codec_t* codec);
+
+typedef struct compress_input compress_input_t; // One decoded input stream
+
+/**
+ * Detect a compressed input stream by its magic number and decode it in-process
+ * Plain input is returned unchanged. Compressed input is decoded on dedicated
+ * threads that write into a pipe, so the caller keeps reading lines from a FILE.
+ * Block-gzip (BGZF) members, as written by compress_open_output, are inflated in
+ * parallel; other gzip and zstd streams use one streaming decoder thread.
+ * @param in Source stream
+ * @param threads Number of worker threads for parallel decoding
+ * @param out Stream to read decoded bytes from
+ * @return NULL on success, error message on failure
+ */
+const char* compress_open_input(FILE* in, int threads, FILE** out);
+
+/**
+ * Stop the decoder threads and close the decoded stream
+ * Safe to call when the input was not compressed
+ * @return NULL on success, error message if decoding failed
+ */
+const char* compress_close_input(void);
+
+/**
+ * Open one more input like compress_open_input, as a handle of its own
+ * Each handle has its own decoder thread, so several inputs can be decoded at once.
+ * @param in Source stream
+ * @param threads Number of worker threads for parallel decoding
+ * @param out Stream to read decoded bytes from
+ * @param input Output handle, NULL when the input was not compressed
+ * @return NULL on success, error message on failure
+ */
+const char* compress_input_open(FILE* in, int threads, FILE** out, compress_input_t** input);
+
+/**
+ * Stop the handle's decoder thread, close its decoded stream and free it
+ * @param input Handle from compress_input_open, may be NULL
+ * @return NULL on success, error message if decoding failed
+ */
+const char* compress_input_close(compress_input_t* input);
+
+/**
+ * Wrap an output stream with block-parallel compression
+ * Written bytes are cut into independent blocks (gzip members or zstd frames)
+ * that a worker pool compresses concurrently; a writer thread emits them in order.
+ * @param out Destination stream (written through its file descriptor)
+ * @param codec Codec to use, must not be CODEC_NONE
+ * @param threads Number of compression worker threads
+ * @param wrapped Output stream to write plain bytes to
+ * @return NULL on success, error message on failure
+ */
+const char* compress_open_output(FILE* out, codec_t codec, int threads, FILE** wrapped);
+
+/**
+ * Make everything written to a compressed output so far durable
+ * The partly filled block is compressed as a short block of its own, and the
+ * call returns once the writer thread wrote it and the file was synced.
+ * @param wrapped Stream from compress_open_output
+ * @return NULL on success, error message on failure
+ */
+const char* compress_sync_output(FILE* wrapped);
+
+#endif
@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include "control.h"
+
+#define CONTROL_POLL_MS 100
+#define CONTROL_CLIENT_TIMEOUT_MS 1000 // How long a client may take to send its command or read the reply
+#define CONTROL_MAX_COMMAND 1024
+#define CONTROL_MAX_REPLY 65536 // Fits a metrics scrape of a long pipeline
+
+static int g_listen_fd = -1;
+static char g_path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+static control_handler_fn g_handler = NULL;
+static pthread_t g_thread;
+static volatile int g_stop = 0;
+
+static int make_address(const char* path, struct sockaddr_un* addr) {
+    if (strlen(path) >= sizeof(addr->sun_path)) return -1;
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+// A peer that hung up fails the send with EPIPE instead of killing the process
+static void write_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        data += n;
+        len -= (size_t)n;
+    }
+}
+
+static void serve_client(int fd) {
+    // A client that stalls is dropped, so it cannot hold up other clients or control_stop
+    struct timeval timeout = { CONTROL_CLIENT_TIMEOUT_MS / 1000, (CONTROL_CLIENT_TIMEOUT_MS % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    char command[CONTROL_MAX_COMMAND];
+    size_t len = 0;
+    // One command per connection, ended by a newline or by the client closing its side
+    while (len < sizeof(command) - 1) {
+        ssize_t n = read(fd, command + len, sizeof(command) - 1 - len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return; // Timed out before the command was complete
+        if (n == 0) break;
+        len += (size_t)n;
+        if (memchr(command, '\n', len)) break;
+    }
+    command[len] = '\0';
+    command[strcspn(command, "\r\n")] = '\0';
+    static char reply[CONTROL_MAX_REPLY]; // Only the control thread serves clients
+    reply[0] = '\0';
+    g_handler(command, reply, sizeof(reply));
+    write_all(fd, reply, strlen(reply));
+    if (len == 0 || reply[0] == '\0' || reply[strlen(reply) - 1] != '\n') write_all(fd, "\n", 1);
+}
+
+static void* control_thread(void* arg) {
+    (void)arg;
+    struct pollfd pfd = { g_listen_fd, POLLIN, 0 };
+    while (!g_stop) {
+        // Poll with a timeout so control_stop is noticed without a connection
+        if (poll(&pfd, 1, CONTROL_POLL_MS) <= 0) continue;
+        int fd = accept(g_listen_fd, NULL, NULL);
+        if (fd < 0) continue;
+        serve_client(fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+const char* control_start(const char* path, control_handler_fn handler) {
+    if (!path || !handler) return "Path or handler is NULL";
+    if (g_listen_fd >= 0) return "Control socket already open";
+    struct sockaddr_un addr;
+    if (make_address(path, &addr) != 0) return "Socket path too long";
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return "Could not create control socket";
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 4) != 0) {
+        close(fd);
+        return "Could not bind control socket";
+    }
+    strcpy(g_path, path);
+    g_listen_fd = fd;
+    g_handler = handler;
+    g_stop = 0;
+    if (pthread_create(&g_thread, NULL, control_thread, NULL) != 0) {
+        close(fd);
+        unlink(path);
+        g_listen_fd = -1;
+        return "Could not create control thread";
+    }
+    return NULL;
+}
+
+void control_stop(void) {
+    if (g_listen_fd < 0) return;
+    g_stop = 1;
+    pthread_join(g_thread, NULL);
+    close(g_listen_fd);
+    unlink(g_path);
+    g_listen_fd = -1;
+    return;
+}
+
+int control_send(const char* path, const char* command) {
+    struct sockaddr_un addr;
+    if (make_address(path, &addr) != 0) {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return 1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        perror(path);
+        if (fd >= 0) close(fd);
+        return 1;
+    }
+    write_all(fd, command, strlen(command));
+    write_all(fd, "\n", 1);
+    shutdown(fd, SHUT_WR);
+    static char reply[CONTROL_MAX_REPLY];
+    size_t len = 0;
+    ssize_t n;
+    while (len < sizeof(reply) - 1 && (n = read(fd, reply + len, sizeof(reply) - 1 - len)) > 0) {
+        len += (size_t)n;
+    }
+    reply[len] = '\0';
+    close(fd);
+    fputs(reply, stdout);
+    return strncmp(reply, "ERR", 3) == 0 || len == 0 ? 1 : 0;
+}
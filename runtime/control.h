@@ -0,0 +1,40 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <stddef.h>
+
+/**
+ * Handler of one control command
+ * @param command Command line without the trailing newline
+ * @param reply Buffer for the reply text
+ * @param reply_size Size of the reply buffer
+ */
+typedef void (*control_handler_fn)(const char* command, char* reply, size_t reply_size);
+
+/**
+ * Listen for commands on a local UNIX socket
+ * Each connection sends one command line and receives one reply, handled in
+ * order on the control thread, so commands never run concurrently. A client
+ * that takes longer than a second to send its command or read the reply is
+ * dropped.
+ * @param path Socket path (an existing socket file is replaced)
+ * @param handler Function answering each command
+ * @return NULL on success, error message on failure
+ */
+const char* control_start(const char* path, control_handler_fn handler);
+
+/**
+ * Stop the control thread, close the socket and remove its file
+ * Waits for a command in progress. Safe to call when control was never started.
+ */
+void control_stop(void);
+
+/**
+ * Send one command to a control socket and print the reply to stdout
+ * @param path Socket path
+ * @param command Command line
+ * @return 0 on success, 1 if the command failed (reply starts with "ERR") or no reply came
+ */
+int control_send(const char* path, const char* command);
+
+#endif
@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "framing.h"
+
+static uint32_t g_crc_table[256];
+static pthread_once_t g_crc_table_once = PTHREAD_ONCE_INIT;
+
+static void init_crc_table(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        g_crc_table[i] = c;
+    }
+}
+
+uint32_t frame_crc32(uint32_t crc, const void* data, size_t len) {
+    pthread_once(&g_crc_table_once, init_crc_table);
+    const unsigned char* bytes = (const unsigned char*)data;
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc = g_crc_table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void put_u32(unsigned char* out, uint32_t value) {
+    out[0] = (unsigned char)value;
+    out[1] = (unsigned char)(value >> 8);
+    out[2] = (unsigned char)(value >> 16);
+    out[3] = (unsigned char)(value >> 24);
+}
+
+static uint32_t get_u32(const unsigned char* in) {
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+void frame_reader_init(frame_reader_t* reader, FILE* file, long long start_offset) {
+    if (!reader) return;
+    reader->file = file;
+    reader->buffer = NULL;
+    reader->buffer_size = 0;
+    reader->crc = 0;
+    reader->count = 0;
+    reader->verify = start_offset == 0;
+    reader->offset = start_offset;
+}
+
+void frame_reader_destroy(frame_reader_t* reader) {
+    if (!reader) return;
+    free(reader->buffer);
+    reader->buffer = NULL;
+    reader->buffer_size = 0;
+}
+
+const char* frame_read(frame_reader_t* reader, const char** record) {
+    if (!reader || !record) return "Reader is NULL";
+    *record = NULL;
+    while (1) {
+        unsigned char header[FRAME_HEADER_SIZE];
+        size_t got = fread(header, 1, sizeof(header), reader->file);
+        if (got == 0 && feof(reader->file)) return "Stream ended without an end frame";
+        if (got != sizeof(header)) return "Truncated frame header";
+        uint32_t len = get_u32(header + 1);
+        if (len > FRAME_MAX_PAYLOAD) return "Frame payload too large";
+
+        if (len + 1 > reader->buffer_size) {
+            size_t size = reader->buffer_size ? reader->buffer_size : 1024;
+            while (size < len + 1) size *= 2;
+            char* buffer = realloc(reader->buffer, size);
+            if (!buffer) return "Could not allocate frame buffer";
+            reader->buffer = buffer;
+            reader->buffer_size = size;
+        }
+        if (len > 0 && fread(reader->buffer, 1, len, reader->file) != len) return "Truncated frame payload";
+        reader->buffer[len] = '\0';
+        reader->offset += FRAME_HEADER_SIZE + len;
+
+        switch (header[0]) {
+            case FRAME_DATA:
+                // A NUL would end the record early everywhere downstream
+                if (memchr(reader->buffer, '\0', len)) return "Frame payload contains a NUL byte";
+                reader->crc = frame_crc32(reader->crc, reader->buffer, len);
+                reader->count++;
+                *record = reader->buffer;
+                return NULL;
+            case FRAME_CHECKSUM: {
+                if (len != 8) return "Malformed checksum frame";
+                const unsigned char* payload = (const unsigned char*)reader->buffer;
+                if (reader->verify &&
+                    (get_u32(payload) != reader->count || get_u32(payload + 4) != reader->crc)) {
+                    return "Checksum mismatch";
+                }
+                reader->verify = 1;
+                reader->crc = 0;
+                reader->count = 0;
+                break;
+            }
+            case FRAME_END:
+                return NULL;
+            default:
+                return "Unknown frame type";
+        }
+    }
+}
+
+void frame_writer_init(frame_writer_t* writer, FILE* file, int checksum_every) {
+    if (!writer) return;
+    writer->file = file;
+    writer->crc = 0;
+    writer->count = 0;
+    writer->checksum_every = checksum_every > 0 ? checksum_every : 0;
+}
+
+static const char* write_frame(frame_writer_t* writer, char type, const void* payload, uint32_t len) {
+    unsigned char header[FRAME_HEADER_SIZE];
+    header[0] = (unsigned char)type;
+    put_u32(header + 1, len);
+    if (fwrite(header, 1, sizeof(header), writer->file) != sizeof(header)) return "Could not write frame";
+    if (len > 0 && fwrite(payload, 1, len, writer->file) != len) return "Could not write frame";
+    return NULL;
+}
+
+static const char* write_checksum(frame_writer_t* writer) {
+    unsigned char payload[8];
+    put_u32(payload, writer->count);
+    put_u32(payload + 4, writer->crc);
+    writer->crc = 0;
+    writer->count = 0;
+    return write_frame(writer, FRAME_CHECKSUM, payload, sizeof(payload));
+}
+
+const char* frame_write(frame_writer_t* writer, const char* record, size_t len) {
+    if (!writer || !record) return "Writer is NULL";
+    if (len > FRAME_MAX_PAYLOAD) return "Record too large for a frame";
+    const char* err = write_frame(writer, FRAME_DATA, record, (uint32_t)len);
+    if (err) return err;
+    if (writer->checksum_every) {
+        writer->crc = frame_crc32(writer->crc, record, len);
+        writer->count++;
+        if (writer->count == (uint32_t)writer->checksum_every) return write_checksum(writer);
+    }
+    return NULL;
+}
+
+const char* frame_write_end(frame_writer_t* writer) {
+    if (!writer) return "Writer is NULL";
+    if (writer->checksum_every && writer->count > 0) {
+        const char* err = write_checksum(writer);
+        if (err) return err;
+    }
+    const char* err = write_frame(writer, FRAME_END, NULL, 0);
+    if (err) return err;
+    if (fflush(writer->file) != 0) return "Could not flush output";
+    return NULL;
+}
@@ -0,0 +1,97 @@
+#ifndef FRAMING_H
+#define FRAMING_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * Length-prefixed binary record framing
+ * Every frame is a 1 byte type followed by a 4 byte little-endian payload length:
+ *   'D' <len> <payload>           one record, no scanning or escaping needed
+ *   'C' 8     <count> <crc32>     checksum of the data payloads since the last 'C'
+ *   'E' 0                         explicit end of stream
+ * Records travel through the pipeline as C strings: place_record, the queues and
+ * every plugin's transform see a NUL as the end of the line. Rather than cut a
+ * record short, frame_read rejects a data payload holding a NUL byte, the one
+ * scan it does; newlines and <END> need no escaping.
+ */
+
+#define FRAME_DATA 'D'
+#define FRAME_CHECKSUM 'C'
+#define FRAME_END 'E'
+#define FRAME_HEADER_SIZE 5
+#define FRAME_MAX_PAYLOAD (64u * 1024u * 1024u)
+
+typedef struct {
+    FILE* file; // Source stream
+    char* buffer; // Payload buffer, grown on demand
+    size_t buffer_size; // Allocated size of buffer
+    uint32_t crc; // Running CRC32 of the current batch
+    uint32_t count; // Records in the current batch
+    int verify; // Zero until the first checksum frame when starting mid-stream
+    long long offset; // Stream offset just past the last frame read
+} frame_reader_t;
+
+typedef struct {
+    FILE* file; // Destination stream
+    uint32_t crc; // Running CRC32 of the current batch
+    uint32_t count; // Records in the current batch
+    int checksum_every; // Records per checksum frame, 0 to disable
+} frame_writer_t;
+
+/**
+ * Compute or continue a CRC32 (IEEE) checksum
+ * @param crc Previous value, 0 to start
+ * @param data Bytes to add
+ * @param len Number of bytes
+ * @return Updated checksum
+ */
+uint32_t frame_crc32(uint32_t crc, const void* data, size_t len);
+
+/**
+ * Initialize a frame reader
+ * @param reader Reader to initialize
+ * @param file Source stream
+ * @param start_offset Offset the stream is positioned at (non-zero when resuming)
+ */
+void frame_reader_init(frame_reader_t* reader, FILE* file, long long start_offset);
+
+/**
+ * Read the next data record, verifying checksum frames on the way
+ * @param reader Frame reader
+ * @param record Output NUL-terminated record owned by the reader, NULL at end of stream
+ * @return NULL on success, error message on malformed input or checksum mismatch
+ */
+const char* frame_read(frame_reader_t* reader, const char** record);
+
+/**
+ * Release the reader's buffer
+ * @param reader Frame reader
+ */
+void frame_reader_destroy(frame_reader_t* reader);
+
+/**
+ * Initialize a frame writer
+ * @param writer Writer to initialize
+ * @param file Destination stream
+ * @param checksum_every Emit a checksum frame after this many records, 0 to disable
+ */
+void frame_writer_init(frame_writer_t* writer, FILE* file, int checksum_every);
+
+/**
+ * Write one data frame
+ * @param writer Frame writer
+ * @param record Payload bytes
+ * @param len Payload length
+ * @return NULL on success, error message on failure
+ */
+const char* frame_write(frame_writer_t* writer, const char* record, size_t len);
+
+/**
+ * Close the batch with a checksum frame if needed, then write the end frame
+ * @param writer Frame writer
+ * @return NULL on success, error message on failure
+ */
+const char* frame_write_end(frame_writer_t* writer);
+
+#endif
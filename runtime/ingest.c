@@ -0,0 +1,353 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <glob.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include "ingest.h"
+#include "compress.h"
+#include "framing.h"
+#include "../plugins/sync/trace.h"
+
+#define INGEST_MAX_LINE 1024 // Same split as stdin: longer lines continue on the next read
+#define INGEST_BATCH_BYTES (64 * 1024) // Lines gathered before a reader hands them over
+#define INGEST_BUFFER_BUDGET (64 * 1024 * 1024) // Ordered mode: bytes later files may read ahead
+#define INGEST_POLL_MS 100 // Waits wake up this often to notice a cancel
+
+// Lines of one file, NUL terminated back to back
+typedef struct batch {
+    struct batch* next;
+    size_t capacity;
+    size_t used;
+    int lines;
+    char data[];
+} batch_t;
+
+typedef struct {
+    char* path;
+    long long size;
+    atomic_ullong lines;
+    atomic_ullong bytes;
+    atomic_int state;
+    atomic_llong start_ns;
+    atomic_llong end_ns;
+    batch_t* head; // Ordered mode: batches read but not placed yet
+    batch_t* tail;
+} input_file_t;
+
+static input_file_t* g_files = NULL;
+static int g_num_files = 0;
+static atomic_int g_next_file; // Next file a reader takes
+static atomic_int g_failed;
+static ingest_order_t g_order;
+static int g_framed;
+static int g_decode_threads;
+static ingest_place_fn g_place;
+static volatile sig_atomic_t* g_cancel;
+static pthread_mutex_t g_place_mutex = PTHREAD_MUTEX_INITIALIZER; // Unordered mode: one reader places at a time
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER; // Ordered mode: batch lists and budget
+static pthread_cond_t g_cond = PTHREAD_COND_INITIALIZER;
+static size_t g_buffered = 0; // Ordered mode: bytes of batches waiting
+static int g_current = 0; // Ordered mode: file being placed
+
+const char* ingest_add(const char* pattern) {
+    glob_t matches;
+    int rc = glob(pattern, 0, NULL, &matches);
+    if (rc == GLOB_NOMATCH) return "No input file matches";
+    if (rc != 0) return "Could not expand input pattern";
+    if (g_num_files + (int)matches.gl_pathc > INGEST_MAX_FILES) {
+        globfree(&matches);
+        return "Too many input files";
+    }
+    input_file_t* grown = realloc(g_files, (g_num_files + matches.gl_pathc) * sizeof(input_file_t));
+    if (!grown) {
+        globfree(&matches);
+        return "Could not allocate memory for input files";
+    }
+    g_files = grown;
+    for (size_t i = 0; i < matches.gl_pathc; i++) {
+        input_file_t* file = &g_files[g_num_files];
+        memset(file, 0, sizeof(*file));
+        file->path = strdup(matches.gl_pathv[i]);
+        if (!file->path) {
+            globfree(&matches);
+            return "Could not allocate memory for input files";
+        }
+        struct stat info;
+        file->size = stat(file->path, &info) == 0 ? (long long)info.st_size : -1;
+        g_num_files++;
+    }
+    globfree(&matches);
+    return NULL;
+}
+
+int ingest_file_count(void) {
+    return g_num_files;
+}
+
+static int stopped(void) {
+    return *g_cancel || atomic_load(&g_failed);
+}
+
+static void wait_briefly(void) {
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_nsec += INGEST_POLL_MS * 1000000L;
+    if (until.tv_nsec >= 1000000000L) {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&g_cond, &g_mutex, &until);
+}
+
+// Place every line of a batch, counting them against their file
+static int place_batch(input_file_t* file, const batch_t* batch) {
+    const char* line = batch->data;
+    for (int i = 0; i < batch->lines; i++) {
+        size_t length = strlen(line);
+        // One stream of several files has no single offset to checkpoint
+        if (g_place(line, -1) != 0) return -1;
+        atomic_fetch_add_explicit(&file->lines, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&file->bytes, length + 1, memory_order_relaxed);
+        line += length + 1;
+    }
+    return 0;
+}
+
+// Hand a full batch over: place it now (unordered) or queue it for the placer (ordered)
+static int submit_batch(int index, batch_t* batch) {
+    input_file_t* file = &g_files[index];
+    if (g_order == INGEST_UNORDERED) {
+        pthread_mutex_lock(&g_place_mutex);
+        int rc = place_batch(file, batch);
+        pthread_mutex_unlock(&g_place_mutex);
+        free(batch);
+        return rc;
+    }
+    pthread_mutex_lock(&g_mutex);
+    // The file being placed never waits, so the budget cannot deadlock the placer
+    while (index != g_current && g_buffered >= INGEST_BUFFER_BUDGET && !stopped()) wait_briefly();
+    batch->next = NULL;
+    if (file->tail) {
+        file->tail->next = batch;
+    } else {
+        file->head = batch;
+    }
+    file->tail = batch;
+    g_buffered += batch->capacity;
+    pthread_cond_broadcast(&g_cond);
+    pthread_mutex_unlock(&g_mutex);
+    return 0;
+}
+
+static int add_line(int index, batch_t** batch, const char* line, size_t length) {
+    if (*batch && (*batch)->used + length + 1 > (*batch)->capacity) {
+        if (submit_batch(index, *batch) != 0) {
+            *batch = NULL;
+            return -1;
+        }
+        *batch = NULL;
+    }
+    if (!*batch) {
+        size_t capacity = length + 1 > INGEST_BATCH_BYTES ? length + 1 : INGEST_BATCH_BYTES;
+        *batch = malloc(sizeof(batch_t) + capacity);
+        if (!*batch) return -1;
+        (*batch)->next = NULL;
+        (*batch)->capacity = capacity;
+        (*batch)->used = 0;
+        (*batch)->lines = 0;
+    }
+    memcpy((*batch)->data + (*batch)->used, line, length);
+    (*batch)->data[(*batch)->used + length] = '\0';
+    (*batch)->used += length + 1;
+    (*batch)->lines++;
+    return 0;
+}
+
+static int read_lines(int index, FILE* in, batch_t** batch) {
+    char line[INGEST_MAX_LINE];
+    while (!stopped() && fgets(line, sizeof(line), in) != NULL) {
+        size_t len = strlen(line);
+        if (line[0] == '<' && (strcmp(line, "<END>\n") == 0 || strcmp(line, "<END>") == 0)) break;
+        if (len > 0 && line[len - 1] == '\n') line[--len] = '\0';
+        if (add_line(index, batch, line, len) != 0) return -1;
+    }
+    return 0;
+}
+
+static int read_frames(int index, FILE* in, batch_t** batch) {
+    frame_reader_t reader;
+    frame_reader_init(&reader, in, 0);
+    const char* record;
+    const char* err;
+    int status = 0;
+    while (!stopped() && (err = frame_read(&reader, &record)) == NULL && record != NULL) {
+        if (add_line(index, batch, record, strlen(record)) != 0) {
+            status = -1;
+            break;
+        }
+    }
+    if (err && !stopped()) {
+        fprintf(stderr, "Invalid framed input in %s at offset %lld: %s\n", g_files[index].path, reader.offset, err);
+        status = -1;
+    }
+    frame_reader_destroy(&reader);
+    return status;
+}
+
+static int read_file(int index) {
+    input_file_t* file = &g_files[index];
+    atomic_store(&file->start_ns, trace_now_ns());
+    atomic_store(&file->state, 1);
+    FILE* raw = fopen(file->path, "rb");
+    if (!raw) {
+        fprintf(stderr, "Failed to open input %s: %s\n", file->path, strerror(errno));
+        return -1;
+    }
+    FILE* in;
+    compress_input_t* decoder;
+    const char* err = compress_input_open(raw, g_decode_threads, &in, &decoder);
+    if (err) {
+        fprintf(stderr, "Failed to open input %s: %s\n", file->path, err);
+        fclose(raw);
+        return -1;
+    }
+    batch_t* batch = NULL;
+    int status = g_framed ? read_frames(index, in, &batch) : read_lines(index, in, &batch);
+    if (batch && status == 0) {
+        status = submit_batch(index, batch);
+    } else {
+        free(batch);
+    }
+    err = compress_input_close(decoder);
+    if (err) {
+        fprintf(stderr, "Failed to decode input %s: %s\n", file->path, err);
+        status = -1;
+    }
+    fclose(raw);
+    return status;
+}
+
+static void* reader_thread(void* arg) {
+    (void)arg;
+    for (;;) {
+        int index = atomic_fetch_add(&g_next_file, 1);
+        if (index >= g_num_files || stopped()) break;
+        int status = read_file(index);
+        input_file_t* file = &g_files[index];
+        atomic_store(&file->end_ns, trace_now_ns());
+        if (status != 0) atomic_store(&g_failed, 1);
+        pthread_mutex_lock(&g_mutex);
+        atomic_store(&file->state, status == 0 ? 2 : -1);
+        pthread_cond_broadcast(&g_cond);
+        pthread_mutex_unlock(&g_mutex);
+    }
+    return NULL;
+}
+
+// Ordered mode: place the files' batches in list order as readers produce them
+static void place_in_order(void) {
+    pthread_mutex_lock(&g_mutex);
+    for (int index = 0; index < g_num_files && !stopped(); index++) {
+        input_file_t* file = &g_files[index];
+        g_current = index;
+        pthread_cond_broadcast(&g_cond);
+        for (;;) {
+            while (!file->head && atomic_load(&file->state) < 2 && atomic_load(&file->state) >= 0 && !stopped()) {
+                wait_briefly();
+            }
+            batch_t* batch = file->head;
+            if (!batch || stopped()) break;
+            file->head = batch->next;
+            if (!file->head) file->tail = NULL;
+            g_buffered -= batch->capacity;
+            pthread_cond_broadcast(&g_cond);
+            pthread_mutex_unlock(&g_mutex);
+            int rc = place_batch(file, batch);
+            free(batch);
+            pthread_mutex_lock(&g_mutex);
+            if (rc != 0) atomic_store(&g_failed, 1);
+        }
+    }
+    g_current = g_num_files;
+    pthread_cond_broadcast(&g_cond);
+    pthread_mutex_unlock(&g_mutex);
+}
+
+int ingest_run(int threads, ingest_order_t order, int framed, int decode_threads, ingest_place_fn place,
+               volatile sig_atomic_t* cancel) {
+    if (g_num_files == 0) return 0;
+    g_order = order;
+    g_framed = framed;
+    g_decode_threads = decode_threads;
+    g_place = place;
+    g_cancel = cancel;
+    atomic_store(&g_next_file, 0);
+    atomic_store(&g_failed, 0);
+    g_buffered = 0;
+    g_current = 0;
+    if (threads > g_num_files) threads = g_num_files;
+    if (threads < 1) threads = 1;
+    pthread_t* readers = malloc(threads * sizeof(pthread_t));
+    if (!readers) return 1;
+
+    // Readers take no signals, so a cancel always lands on the calling thread
+    sigset_t block_all, old_mask;
+    sigfillset(&block_all);
+    pthread_sigmask(SIG_BLOCK, &block_all, &old_mask);
+    int started = 0;
+    while (started < threads && pthread_create(&readers[started], NULL, reader_thread, NULL) == 0) started++;
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+    if (started == 0) {
+        free(readers);
+        fprintf(stderr, "Failed to start input readers\n");
+        return 1;
+    }
+
+    if (order == INGEST_ORDERED) place_in_order();
+    for (int i = 0; i < started; i++) pthread_join(readers[i], NULL);
+    free(readers);
+    // Batches left behind by a cancel or a failure are never placed
+    for (int i = 0; i < g_num_files; i++) {
+        while (g_files[i].head) {
+            batch_t* next = g_files[i].head->next;
+            free(g_files[i].head);
+            g_files[i].head = next;
+        }
+        g_files[i].tail = NULL;
+    }
+    return atomic_load(&g_failed) ? 1 : 0;
+}
+
+void ingest_progress(int index, ingest_progress_t* progress) {
+    const input_file_t* file = &g_files[index];
+    progress->path = file->path;
+    progress->size = file->size;
+    progress->lines = atomic_load_explicit(&file->lines, memory_order_relaxed);
+    progress->bytes = atomic_load_explicit(&file->bytes, memory_order_relaxed);
+    progress->state = atomic_load(&file->state);
+    progress->start_ns = atomic_load(&file->start_ns);
+    progress->end_ns = atomic_load(&file->end_ns);
+}
+
+void ingest_report(FILE* out) {
+    for (int i = 0; i < g_num_files; i++) {
+        ingest_progress_t progress;
+        ingest_progress(i, &progress);
+        if (progress.state == 0) {
+            fprintf(out, "Input %s: not read\n", progress.path);
+            continue;
+        }
+        double seconds = progress.end_ns > progress.start_ns ? (progress.end_ns - progress.start_ns) / 1e9 : 0.0;
+        fprintf(out, "Input %s: %llu lines, %llu KB in %.3f s%s\n", progress.path, progress.lines,
+                progress.bytes / 1024, seconds, progress.state < 0 ? " (failed)" : "");
+    }
+}
+
+void ingest_free(void) {
+    for (int i = 0; i < g_num_files; i++) free(g_files[i].path);
+    free(g_files);
+    g_files = NULL;
+    g_num_files = 0;
+}
@@ -0,0 +1,82 @@
+#ifndef RUNTIME_INGEST_H
+#define RUNTIME_INGEST_H
+
+#include <stdio.h>
+#include <signal.h>
+
+#define INGEST_MAX_FILES 4096
+
+typedef enum {
+    INGEST_ORDERED, // Every line of a file before any line of the next one, in list order
+    INGEST_UNORDERED // Files interleave in batches, as fast as each one is read
+} ingest_order_t;
+
+/**
+ * Progress of one input file, readable while the files are being read
+ */
+typedef struct {
+    const char* path;
+    long long size; // Bytes on disk, -1 if unknown
+    unsigned long long lines; // Lines placed in the first stage
+    unsigned long long bytes; // Decoded bytes of those lines
+    int state; // 0 waiting, 1 reading, 2 done, -1 failed
+    long long start_ns;
+    long long end_ns;
+} ingest_progress_t;
+
+/**
+ * Places one line in the first stage; returns 0 on success
+ */
+typedef int (*ingest_place_fn)(const char* line, long long end_offset);
+
+/**
+ * Add the files a path or glob pattern names, in sorted order
+ * @param pattern File path or glob pattern
+ * @return NULL on success, error message if nothing matches or too many files do
+ */
+const char* ingest_add(const char* pattern);
+
+/**
+ * Number of files added so far
+ * @return File count, 0 when the input is stdin
+ */
+int ingest_file_count(void);
+
+/**
+ * Read every added file on a pool of reader threads and place its lines
+ * Readers take files in list order, so at most threads files are open at once.
+ * Lines are gathered into batches; in unordered mode each reader places its
+ * batches itself, one reader at a time. In ordered mode the calling thread
+ * places them, file after file, while readers of later files buffer ahead
+ * within a bounded budget. Returns once every line was placed, a reader
+ * failed or cancel became non-zero.
+ * @param threads Reader threads
+ * @param order Ordered or unordered merge
+ * @param framed Non-zero to read length-prefixed frames instead of text lines
+ * @param decode_threads Worker threads per compressed file
+ * @param place Called for every line, never concurrently with itself
+ * @param cancel Polled while reading; reading stops once it is non-zero
+ * @return 0 on success, 1 if a file could not be read or a line not placed
+ */
+int ingest_run(int threads, ingest_order_t order, int framed, int decode_threads, ingest_place_fn place,
+               volatile sig_atomic_t* cancel);
+
+/**
+ * Snapshot the progress of one file
+ * @param index File index, below ingest_file_count()
+ * @param progress Output snapshot
+ */
+void ingest_progress(int index, ingest_progress_t* progress);
+
+/**
+ * Print lines, bytes and read rate of every file
+ * @param out Stream to print to
+ */
+void ingest_report(FILE* out);
+
+/**
+ * Forget every added file
+ */
+void ingest_free(void);
+
+#endif
@@ -0,0 +1,310 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "metrics.h"
+#include "pipeline.h"
+#include "ingest.h"
+#include "sink.h"
+
+typedef struct {
+    char* out;
+    size_t size;
+    size_t len;
+} text_buffer_t;
+
+static const double g_quantiles[] = { 0.5, 0.9, 0.99 };
+
+static atomic_ullong g_lane_latency[CP_MAX_LANES][METRICS_LATENCY_BUCKETS];
+static atomic_ullong g_lane_latency_sum_ns[CP_MAX_LANES];
+static const char* g_lane_labels[CP_MAX_LANES];
+static unsigned long long* g_last_processed = NULL; // Lines processed per stage at the previous scrape
+static long long g_last_scrape_ns = 0;
+static token_bucket_t* g_ingest_limiter = NULL;
+
+static void append(text_buffer_t* text, const char* format, ...) {
+    if (text->len >= text->size) return;
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(text->out + text->len, text->size - text->len, format, args);
+    va_end(args);
+    if (n < 0) return;
+    text->len += (size_t)n;
+    if (text->len >= text->size) text->len = text->size - 1;
+}
+
+static void header(text_buffer_t* text, const char* name, const char* type, const char* help) {
+    append(text, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/*
+ * Upper bound, in seconds, of the latency bucket holding quantile q.
+ * Buckets are powers of two, so the estimate is within 2x of the true value.
+ */
+static double latency_quantile(const unsigned long long* buckets, double q) {
+    unsigned long long total = 0;
+    for (int i = 0; i < METRICS_LATENCY_BUCKETS; i++) total += buckets[i];
+    if (total == 0) return 0.0;
+    unsigned long long rank = (unsigned long long)(q * total);
+    if (rank >= total) rank = total - 1;
+    unsigned long long seen = 0;
+    for (int i = 0; i < METRICS_LATENCY_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen > rank) return (double)(1ULL << i) / 1e9;
+    }
+    return (double)(1ULL << (METRICS_LATENCY_BUCKETS - 1)) / 1e9;
+}
+
+// Copy one lane's histogram; returns the number of lines it counted
+static unsigned long long lane_snapshot(int lane, unsigned long long* buckets) {
+    unsigned long long count = 0;
+    for (int i = 0; i < METRICS_LATENCY_BUCKETS; i++) {
+        buckets[i] = atomic_load_explicit(&g_lane_latency[lane][i], memory_order_relaxed);
+        count += buckets[i];
+    }
+    return count;
+}
+
+void metrics_name_lane(int lane, const char* label) {
+    if (lane >= 0 && lane < CP_MAX_LANES) g_lane_labels[lane] = label;
+}
+
+void metrics_lane_latency(int lane, long long ns) {
+    if (lane < 0 || lane >= CP_MAX_LANES) return;
+    atomic_fetch_add_explicit(&g_lane_latency[lane][metrics_latency_bucket(ns)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_lane_latency_sum_ns[lane], (unsigned long long)ns, memory_order_relaxed);
+}
+
+void metrics_report_lanes(FILE* out) {
+    for (int lane = 0; lane < CP_MAX_LANES; lane++) {
+        unsigned long long buckets[METRICS_LATENCY_BUCKETS];
+        unsigned long long count = lane_snapshot(lane, buckets);
+        if (count == 0) continue;
+        fprintf(out, "Lane %d (%s): %llu lines, latency p50 <= %.3f ms, p99 <= %.3f ms\n", lane,
+                g_lane_labels[lane] ? g_lane_labels[lane] : "default", count,
+                latency_quantile(buckets, 0.5) * 1e3, latency_quantile(buckets, 0.99) * 1e3);
+    }
+}
+
+// Print one labelled sample per stage that reported metrics
+static void gauge_per_stage(text_buffer_t* text, const char* metric, const stage_metrics_t* all, const int* valid,
+                            unsigned long long (*value)(const stage_metrics_t*)) {
+    for (int i = 0; i < g_num_plugins; i++) {
+        if (!valid[i]) continue;
+        append(text, "%s{stage=\"%d\",plugin=\"%s\"} %llu\n", metric, i, g_plugin_handles[i].name, value(&all[i]));
+    }
+}
+
+static unsigned long long depth_of(const stage_metrics_t* m) { return m->placed - m->retired; }
+static unsigned long long capacity_of(const stage_metrics_t* m) { return (unsigned long long)m->capacity; }
+static unsigned long long finished_of(const stage_metrics_t* m) { return (unsigned long long)m->finished; }
+static unsigned long long paused_of(const stage_metrics_t* m) { return (unsigned long long)m->paused; }
+static unsigned long long placed_of(const stage_metrics_t* m) { return m->placed; }
+static unsigned long long processed_of(const stage_metrics_t* m) { return m->processed; }
+static unsigned long long filtered_of(const stage_metrics_t* m) { return m->filtered; }
+static unsigned long long spilled_of(const stage_metrics_t* m) { return m->spilled; }
+static unsigned long long spilled_total_of(const stage_metrics_t* m) { return m->spilled_total; }
+static unsigned long long workers_of(const stage_metrics_t* m) { return (unsigned long long)m->workers; }
+static unsigned long long batch_of(const stage_metrics_t* m) { return (unsigned long long)m->batch; }
+static unsigned long long buffer_allocations_of(const stage_metrics_t* m) { return m->buffer_allocations; }
+
+// Escape a label value: backslash, double quote and newline
+static void label_value(const char* raw, char* out, size_t size) {
+    size_t used = 0;
+    for (; *raw && used + 3 < size; raw++) {
+        if (*raw == '\\' || *raw == '"') out[used++] = '\\';
+        if (*raw == '\n') {
+            out[used++] = '\\';
+            out[used++] = 'n';
+            continue;
+        }
+        out[used++] = *raw;
+    }
+    out[used] = '\0';
+}
+
+// Per-file progress of --input files
+static void render_inputs(text_buffer_t* text) {
+    int count = ingest_file_count();
+    ingest_progress_t* all = calloc(count, sizeof(ingest_progress_t));
+    if (!all) return;
+    for (int i = 0; i < count; i++) ingest_progress(i, &all[i]);
+    char file[512];
+    header(text, "analyzer_input_lines_total", "counter", "Lines of each input file placed in the first stage");
+    for (int i = 0; i < count; i++) {
+        label_value(all[i].path, file, sizeof(file));
+        append(text, "analyzer_input_lines_total{file=\"%s\"} %llu\n", file, all[i].lines);
+    }
+    header(text, "analyzer_input_bytes_total", "counter", "Decoded bytes of each input file placed in the first stage");
+    for (int i = 0; i < count; i++) {
+        label_value(all[i].path, file, sizeof(file));
+        append(text, "analyzer_input_bytes_total{file=\"%s\"} %llu\n", file, all[i].bytes);
+    }
+    header(text, "analyzer_input_state", "gauge", "0 waiting, 1 reading, 2 read through, -1 failed");
+    for (int i = 0; i < count; i++) {
+        label_value(all[i].path, file, sizeof(file));
+        append(text, "analyzer_input_state{file=\"%s\"} %d\n", file, all[i].state);
+    }
+    free(all);
+}
+
+// Per-sink counters of --sink destinations
+static void render_sinks(text_buffer_t* text) {
+    int count = sink_count();
+    sink_progress_t* all = calloc(count, sizeof(sink_progress_t));
+    if (!all) return;
+    for (int i = 0; i < count; i++) sink_progress(i, &all[i]);
+    char path[512];
+    header(text, "analyzer_sink_lines_written_total", "counter", "Lines each sink handed to its destination");
+    for (int i = 0; i < count; i++) {
+        label_value(all[i].path, path, sizeof(path));
+        append(text, "analyzer_sink_lines_written_total{sink=\"%s\"} %llu\n", path, all[i].written);
+    }
+    header(text, "analyzer_sink_lines_dropped_total", "counter",
+           "Lines a sink discarded: full buffer under policy=drop, or a failed destination");
+    for (int i = 0; i < count; i++) {
+        label_value(all[i].path, path, sizeof(path));
+        append(text, "analyzer_sink_lines_dropped_total{sink=\"%s\"} %llu\n", path, all[i].dropped);
+    }
+    header(text, "analyzer_sink_lines_spilled_total", "counter", "Lines a sink wrote to disk because its buffer was full");
+    for (int i = 0; i < count; i++) {
+        label_value(all[i].path, path, sizeof(path));
+        append(text, "analyzer_sink_lines_spilled_total{sink=\"%s\"} %llu\n", path, all[i].spilled);
+    }
+    header(text, "analyzer_sink_buffered", "gauge", "Lines waiting for a sink's writer, in memory or on disk");
+    for (int i = 0; i < count; i++) {
+        label_value(all[i].path, path, sizeof(path));
+        append(text, "analyzer_sink_buffered{sink=\"%s\"} %llu\n", path, all[i].buffered);
+    }
+    header(text, "analyzer_sink_blocked_seconds_total", "counter", "Time the last stage waited on a full sink buffer");
+    for (int i = 0; i < count; i++) {
+        label_value(all[i].path, path, sizeof(path));
+        append(text, "analyzer_sink_blocked_seconds_total{sink=\"%s\"} %.6f\n", path, all[i].blocked_ns / 1e9);
+    }
+    header(text, "analyzer_sink_state", "gauge", "0 waiting for the destination, 1 writing, 2 closed, -1 failed");
+    for (int i = 0; i < count; i++) {
+        label_value(all[i].path, path, sizeof(path));
+        append(text, "analyzer_sink_state{sink=\"%s\"} %d\n", path, all[i].state);
+    }
+    free(all);
+}
+
+void metrics_watch_ingest(token_bucket_t* limiter) {
+    g_ingest_limiter = limiter;
+}
+
+void metrics_start(void) {
+    g_last_scrape_ns = trace_now_ns();
+}
+
+size_t metrics_render(char* out, size_t size) {
+    text_buffer_t text = { out, size, 0 };
+    if (size == 0) return 0;
+    out[0] = '\0';
+    stage_metrics_t* all = calloc(g_num_plugins, sizeof(stage_metrics_t));
+    int* valid = calloc(g_num_plugins, sizeof(int));
+    if (!g_last_processed) g_last_processed = calloc(g_num_plugins, sizeof(unsigned long long));
+    if (!all || !valid || !g_last_processed) {
+        free(all);
+        free(valid);
+        append(&text, "# metrics unavailable: out of memory\n");
+        return text.len;
+    }
+    for (int i = 0; i < g_num_plugins; i++) {
+        plugin_handle_t* stage = &g_plugin_handles[i];
+        valid[i] = stage->metrics && stage->metrics(&all[i]) == NULL;
+    }
+    long long now_ns = trace_now_ns();
+    double interval_s = g_last_scrape_ns ? (now_ns - g_last_scrape_ns) / 1e9 : 0.0;
+    g_last_scrape_ns = now_ns;
+
+    header(&text, "analyzer_queue_depth", "gauge", "Lines queued in the stage or being processed by it");
+    gauge_per_stage(&text, "analyzer_queue_depth", all, valid, depth_of);
+    header(&text, "analyzer_queue_capacity", "gauge", "Current capacity of the stage's queue");
+    gauge_per_stage(&text, "analyzer_queue_capacity", all, valid, capacity_of);
+    header(&text, "analyzer_stage_finished", "gauge", "1 once the stage's consumer thread exited");
+    gauge_per_stage(&text, "analyzer_stage_finished", all, valid, finished_of);
+    header(&text, "analyzer_stage_paused", "gauge", "1 while the stage is held paused");
+    gauge_per_stage(&text, "analyzer_stage_paused", all, valid, paused_of);
+    header(&text, "analyzer_lines_placed_total", "counter", "Lines accepted into the stage's queue");
+    gauge_per_stage(&text, "analyzer_lines_placed_total", all, valid, placed_of);
+    header(&text, "analyzer_lines_processed_total", "counter", "Lines transformed and passed on by the stage");
+    gauge_per_stage(&text, "analyzer_lines_processed_total", all, valid, processed_of);
+    header(&text, "analyzer_lines_filtered_total", "counter", "Lines the stage dropped instead of passing on");
+    gauge_per_stage(&text, "analyzer_lines_filtered_total", all, valid, filtered_of);
+    header(&text, "analyzer_queue_spilled", "gauge", "Lines on disk waiting for room in the stage's queue");
+    gauge_per_stage(&text, "analyzer_queue_spilled", all, valid, spilled_of);
+    header(&text, "analyzer_lines_spilled_total", "counter", "Lines written to disk because the stage's queue was full");
+    gauge_per_stage(&text, "analyzer_lines_spilled_total", all, valid, spilled_total_of);
+    header(&text, "analyzer_stage_workers", "gauge", "Consumer threads of the stage");
+    gauge_per_stage(&text, "analyzer_stage_workers", all, valid, workers_of);
+    header(&text, "analyzer_stage_batch", "gauge", "Most lines the stage takes from its queue at once");
+    gauge_per_stage(&text, "analyzer_stage_batch", all, valid, batch_of);
+    header(&text, "analyzer_stage_buffer_allocations_total", "counter",
+           "Output buffers the stage allocated or resized; flat once its buffers fit the lines");
+    gauge_per_stage(&text, "analyzer_stage_buffer_allocations_total", all, valid, buffer_allocations_of);
+
+    header(&text, "analyzer_stage_throughput", "gauge", "Lines per second processed since the previous scrape");
+    for (int i = 0; i < g_num_plugins; i++) {
+        if (!valid[i]) continue;
+        // A reloaded stage starts counting from zero again
+        unsigned long long last = g_last_processed[i] <= all[i].processed ? g_last_processed[i] : 0;
+        double rate = interval_s > 0 ? (all[i].processed - last) / interval_s : 0.0;
+        g_last_processed[i] = all[i].processed;
+        append(&text, "analyzer_stage_throughput{stage=\"%d\",plugin=\"%s\"} %.1f\n", i, g_plugin_handles[i].name, rate);
+    }
+
+    header(&text, "analyzer_stage_throttled_seconds_total", "counter", "Time the stage waited on its rate limit");
+    for (int i = 0; i < g_num_plugins; i++) {
+        if (!valid[i]) continue;
+        append(&text, "analyzer_stage_throttled_seconds_total{stage=\"%d\",plugin=\"%s\"} %.6f\n", i,
+               g_plugin_handles[i].name, all[i].throttled_ns / 1e9);
+    }
+    header(&text, "analyzer_stage_service_seconds_total", "counter", "Time spent in the stage's transform, over all workers");
+    for (int i = 0; i < g_num_plugins; i++) {
+        if (!valid[i]) continue;
+        append(&text, "analyzer_stage_service_seconds_total{stage=\"%d\",plugin=\"%s\"} %.6f\n", i,
+               g_plugin_handles[i].name, all[i].service_ns / 1e9);
+    }
+    if (g_ingest_limiter) {
+        header(&text, "analyzer_ingest_throttled_seconds_total", "counter", "Time input reading waited on its rate limit");
+        append(&text, "analyzer_ingest_throttled_seconds_total %.6f\n", token_bucket_throttled_ns(g_ingest_limiter) / 1e9);
+    }
+    if (ingest_file_count() > 0) render_inputs(&text);
+    if (sink_count() > 0) render_sinks(&text);
+
+    header(&text, "analyzer_stage_latency_seconds", "summary",
+           "Time from dequeuing a line to placing its result downstream");
+    for (int i = 0; i < g_num_plugins; i++) {
+        if (!valid[i]) continue;
+        const char* name = g_plugin_handles[i].name;
+        for (size_t q = 0; q < sizeof(g_quantiles) / sizeof(g_quantiles[0]); q++) {
+            append(&text, "analyzer_stage_latency_seconds{stage=\"%d\",plugin=\"%s\",quantile=\"%g\"} %.9f\n",
+                   i, name, g_quantiles[q], latency_quantile(all[i].latency, g_quantiles[q]));
+        }
+        unsigned long long count = 0;
+        for (int b = 0; b < METRICS_LATENCY_BUCKETS; b++) count += all[i].latency[b];
+        append(&text, "analyzer_stage_latency_seconds_sum{stage=\"%d\",plugin=\"%s\"} %.9f\n", i, name,
+               all[i].latency_sum_ns / 1e9);
+        append(&text, "analyzer_stage_latency_seconds_count{stage=\"%d\",plugin=\"%s\"} %llu\n", i, name, count);
+    }
+
+    header(&text, "analyzer_lane_latency_seconds", "summary", "Time from reading a line to its arrival at the sink");
+    for (int lane = 0; lane < CP_MAX_LANES; lane++) {
+        unsigned long long buckets[METRICS_LATENCY_BUCKETS];
+        unsigned long long count = lane_snapshot(lane, buckets);
+        if (count == 0) continue;
+        for (size_t q = 0; q < sizeof(g_quantiles) / sizeof(g_quantiles[0]); q++) {
+            append(&text, "analyzer_lane_latency_seconds{lane=\"%d\",quantile=\"%g\"} %.9f\n",
+                   lane, g_quantiles[q], latency_quantile(buckets, g_quantiles[q]));
+        }
+        append(&text, "analyzer_lane_latency_seconds_sum{lane=\"%d\"} %.9f\n", lane,
+               atomic_load_explicit(&g_lane_latency_sum_ns[lane], memory_order_relaxed) / 1e9);
+        append(&text, "analyzer_lane_latency_seconds_count{lane=\"%d\"} %llu\n", lane, count);
+    }
+
+    free(all);
+    free(valid);
+    return text.len;
+}
@@ -0,0 +1,52 @@
+#ifndef RUNTIME_METRICS_H
+#define RUNTIME_METRICS_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include "../plugins/sync/token_bucket.h"
+
+/**
+ * Start the first throughput interval, normally when the pipeline starts
+ */
+void metrics_start(void);
+
+/**
+ * Name a priority lane in the lane latency metrics
+ * @param lane Lane index, below CP_MAX_LANES
+ * @param label Label value reported for the lane (kept, not copied)
+ */
+void metrics_name_lane(int lane, const char* label);
+
+/**
+ * Record the end-to-end latency of one line at the sink
+ * Lock-free; safe to call from any plugin's consumer thread
+ * @param lane Lane the line travelled in
+ * @param ns Time from reading the line to its arrival at the sink
+ */
+void metrics_lane_latency(int lane, long long ns);
+
+/**
+ * Print the line count and latency quantiles of each lane that carried lines
+ * @param out Stream to print to
+ */
+void metrics_report_lanes(FILE* out);
+
+/**
+ * Report the throttle time of the ingest rate limit in the metrics
+ * @param limiter Bucket applied to input lines (kept, not copied)
+ */
+void metrics_watch_ingest(token_bucket_t* limiter);
+
+/**
+ * Render every stage's counters in the Prometheus text exposition format
+ * Stages are read through plugin_metrics, which only loads atomics, so a scrape
+ * never blocks the pipeline. Throughput is measured since the previous call.
+ * Lanes that carried lines also report their end-to-end latency.
+ * Must not run concurrently with itself or with a reload.
+ * @param out Output buffer
+ * @param size Size of the output buffer
+ * @return Number of bytes written, excluding the terminating NUL
+ */
+size_t metrics_render(char* out, size_t size);
+
+#endif
@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "offline.h"
+#include "pipeline.h"
+#include "../plugins/plugin_sdk.h"
+
+#define OFFLINE_MAX_GROWTH 64 // Largest output/input ratio a stage is retried with
+
+typedef struct {
+    char* data; // Packed NUL-terminated lines
+    size_t size; // Bytes used in data
+    size_t capacity;
+    size_t* offsets; // Start of each line, count + 1 entries
+    int count;
+    int offsets_capacity;
+    huge_region_t data_region; // Backs data
+    huge_region_t offsets_region; // Backs offsets
+} line_buffer_t;
+
+// One contiguous range of lines transformed by one thread
+typedef struct {
+    transform_batch_fn transform;
+    const char* lines; // First input line of the range
+    size_t* offsets; // Input offsets rebased to lines, count + 1 entries
+    int count;
+    char* output; // Region of the output buffer reserved for this range
+    size_t output_size;
+    size_t* output_offsets; // Result offsets within output, count + 1 entries
+    const char* err;
+} slice_t;
+
+static line_buffer_t g_buffers[2];
+static int g_current = 0; // Buffer holding the input of the next stage
+static char g_error[256];
+static huge_pages_t g_huge_pages = HUGE_PAGES_OFF;
+
+static int reserve_data(line_buffer_t* buffer, size_t needed) {
+    if (buffer->capacity >= needed) return 0;
+    size_t capacity = buffer->capacity ? buffer->capacity : 65536;
+    while (capacity < needed) capacity *= 2;
+    if (huge_realloc(&buffer->data_region, capacity, g_huge_pages) != NULL) return -1;
+    buffer->data = buffer->data_region.ptr;
+    buffer->capacity = buffer->data_region.size;
+    return 0;
+}
+
+static int reserve_offsets(line_buffer_t* buffer, int needed) {
+    if (buffer->offsets_capacity >= needed) return 0;
+    int capacity = buffer->offsets_capacity ? buffer->offsets_capacity : 4096;
+    while (capacity < needed) capacity *= 2;
+    if (huge_realloc(&buffer->offsets_region, capacity * sizeof(size_t), g_huge_pages) != NULL) return -1;
+    buffer->offsets = buffer->offsets_region.ptr;
+    buffer->offsets_capacity = (int)(buffer->offsets_region.size / sizeof(size_t));
+    return 0;
+}
+
+void offline_set_huge_pages(huge_pages_t mode) {
+    g_huge_pages = mode;
+}
+
+const char* offline_add_line(const char* line) {
+    line_buffer_t* buffer = &g_buffers[g_current];
+    size_t length = strlen(line) + 1;
+    if (reserve_data(buffer, buffer->size + length) != 0 ||
+        reserve_offsets(buffer, buffer->count + 2) != 0) {
+        return "Could not allocate memory for input";
+    }
+    buffer->offsets[buffer->count] = buffer->size;
+    memcpy(buffer->data + buffer->size, line, length);
+    buffer->size += length;
+    buffer->count++;
+    buffer->offsets[buffer->count] = buffer->size;
+    return NULL;
+}
+
+static void* transform_slice(void* arg) {
+    slice_t* slice = (slice_t*)arg;
+    slice->err = slice->transform(slice->lines, slice->offsets, slice->count, slice->output,
+                                  slice->output_size, slice->output_offsets);
+    return NULL;
+}
+
+/*
+ * Cut the input into ranges of about equal bytes, one per slice, each writing
+ * to its own region of the output: growth times the bytes of its input.
+ */
+static int prepare_slices(slice_t* slices, int num_slices, transform_batch_fn transform,
+                          const line_buffer_t* in, line_buffer_t* out, size_t growth) {
+    int first = 0;
+    for (int s = 0; s < num_slices; s++) {
+        int last = in->count;
+        if (s < num_slices - 1) {
+            size_t target = in->size / num_slices * (s + 1);
+            last = first < in->count ? first + 1 : first;
+            while (last < in->count && in->offsets[last] < target) last++;
+        }
+        slice_t* slice = &slices[s];
+        slice->transform = transform;
+        slice->lines = in->data + in->offsets[first];
+        slice->count = last - first;
+        slice->offsets = malloc((slice->count + 1) * sizeof(size_t));
+        slice->output_offsets = malloc((slice->count + 1) * sizeof(size_t));
+        if (!slice->offsets || !slice->output_offsets) return -1;
+        for (int i = 0; i <= slice->count; i++) slice->offsets[i] = in->offsets[first + i] - in->offsets[first];
+        slice->output = out->data + in->offsets[first] * growth;
+        slice->output_size = slice->offsets[slice->count] * growth;
+        slice->err = NULL;
+        first = last;
+    }
+    return 0;
+}
+
+// Close the gaps between the slices' output regions and skip dropped lines; every region only moves down
+static void compact_slices(const slice_t* slices, int num_slices, line_buffer_t* out) {
+    size_t used = 0;
+    int line = 0;
+    for (int s = 0; s < num_slices; s++) {
+        const slice_t* slice = &slices[s];
+        size_t length = slice->output_offsets[slice->count];
+        memmove(out->data + used, slice->output, length);
+        for (int i = 0; i < slice->count; i++) {
+            if (slice->output_offsets[i] != PLUGIN_DROP_OFFSET) out->offsets[line++] = used + slice->output_offsets[i];
+        }
+        used += length;
+    }
+    out->offsets[line] = used;
+    out->count = line;
+    out->size = used;
+}
+
+static void free_slices(slice_t* slices, int num_slices) {
+    for (int s = 0; s < num_slices; s++) {
+        free(slices[s].offsets);
+        free(slices[s].output_offsets);
+    }
+    free(slices);
+}
+
+static const char* run_stage(const plugin_handle_t* stage, int threads) {
+    line_buffer_t* in = &g_buffers[g_current];
+    line_buffer_t* out = &g_buffers[1 - g_current];
+    if (in->count == 0) return NULL;
+    // A stage with side effects must see its lines once and in order
+    int num_slices = stage->is_stateless && stage->is_stateless() ? threads : 1;
+    if (num_slices > in->count) num_slices = in->count;
+    if (num_slices < 1) num_slices = 1;
+    if (reserve_offsets(out, in->count + 1) != 0) return "Could not allocate memory for results";
+    // Results rarely outgrow twice their input; a stage that does is rerun with more room
+    for (size_t growth = 2; growth <= OFFLINE_MAX_GROWTH; growth *= 2) {
+        if (reserve_data(out, in->size * growth + 1) != 0) return "Could not allocate memory for results";
+        slice_t* slices = calloc(num_slices, sizeof(slice_t));
+        if (!slices) return "Could not allocate memory for results";
+        if (prepare_slices(slices, num_slices, stage->transform_lines, in, out, growth) != 0) {
+            free_slices(slices, num_slices);
+            return "Could not allocate memory for results";
+        }
+        pthread_t* workers = calloc(num_slices, sizeof(pthread_t));
+        int* started = calloc(num_slices, sizeof(int));
+        // The calling thread takes the first slice, and any slice whose thread could not start
+        for (int s = 1; s < num_slices && workers && started; s++) {
+            started[s] = pthread_create(&workers[s], NULL, transform_slice, &slices[s]) == 0;
+        }
+        for (int s = 0; s < num_slices; s++) {
+            if (!started || !started[s]) transform_slice(&slices[s]);
+        }
+        for (int s = 1; s < num_slices && workers && started; s++) {
+            if (started[s]) pthread_join(workers[s], NULL);
+        }
+        free(workers);
+        free(started);
+
+        const char* err = NULL;
+        int too_small = 0;
+        for (int s = 0; s < num_slices && !err; s++) {
+            if (!slices[s].err) continue;
+            if (strcmp(slices[s].err, "Output buffer too small") == 0) {
+                too_small = 1;
+            } else {
+                err = slices[s].err;
+            }
+        }
+        if (!err && !too_small) compact_slices(slices, num_slices, out);
+        free_slices(slices, num_slices);
+        if (err) {
+            snprintf(g_error, sizeof(g_error), "plugin %s: %s", stage->name, err);
+            return g_error;
+        }
+        if (!too_small) {
+            g_current = 1 - g_current;
+            return NULL;
+        }
+    }
+    snprintf(g_error, sizeof(g_error), "plugin %s: results more than %dx larger than the input",
+             stage->name, OFFLINE_MAX_GROWTH);
+    return g_error;
+}
+
+const char* offline_run(int threads) {
+    for (int i = 0; i < g_num_plugins; i++) {
+        const char* err = run_stage(&g_plugin_handles[i], threads);
+        if (err) return err;
+    }
+    return NULL;
+}
+
+void offline_emit(const char* (*emit)(const char*, const record_meta_t*)) {
+    const line_buffer_t* buffer = &g_buffers[g_current];
+    for (int i = 0; i < buffer->count; i++) emit(buffer->data + buffer->offsets[i], NULL);
+}
+
+huge_backing_t offline_buffer_backing(size_t* bytes) {
+    huge_backing_t backing = HUGE_BACKING_EXPLICIT;
+    *bytes = 0;
+    for (int i = 0; i < 2; i++) {
+        const huge_region_t* regions[2] = { &g_buffers[i].data_region, &g_buffers[i].offsets_region };
+        for (int r = 0; r < 2; r++) {
+            if (!regions[r]->ptr) continue;
+            if (regions[r]->backing < backing) backing = regions[r]->backing;
+            *bytes += regions[r]->size;
+        }
+    }
+    return *bytes ? backing : HUGE_BACKING_HEAP;
+}
+
+void offline_free(void) {
+    for (int i = 0; i < 2; i++) {
+        huge_free(&g_buffers[i].data_region);
+        huge_free(&g_buffers[i].offsets_region);
+        memset(&g_buffers[i], 0, sizeof(g_buffers[i]));
+    }
+    g_current = 0;
+}
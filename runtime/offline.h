@@ -0,0 +1,49 @@
+#ifndef OFFLINE_H
+#define OFFLINE_H
+
+#include "../plugins/sync/consumer_producer.h"
+
+/**
+ * Choose the backing of the line buffers; takes effect as they next grow
+ * @param mode Requested backing, HUGE_PAGES_OFF (default) for the heap
+ */
+void offline_set_huge_pages(huge_pages_t mode);
+
+/**
+ * Append one input line to the in-memory input of an offline run
+ * Lines are packed back to back, NUL terminated, into one contiguous buffer.
+ * @param line Input line
+ * @return NULL on success, error message on failure
+ */
+const char* offline_add_line(const char* line);
+
+/**
+ * Run every stage over all buffered lines, one stage at a time
+ * Each stage reads one buffer and writes the other; the two are swapped between
+ * stages. Stateless stages split the lines across worker threads, stages with
+ * side effects (logger, typewriter) run on the calling thread in input order.
+ * Nothing is queued, so the stages' plugin_init is never called.
+ * @param threads Worker threads for stateless stages
+ * @return NULL on success, error message on failure
+ */
+const char* offline_run(int threads);
+
+/**
+ * Pass every result of the last stage to the sink, in input order
+ * @param emit Sink, called with NULL metadata
+ */
+void offline_emit(const char* (*emit)(const char*, const record_meta_t*));
+
+/**
+ * Report what backs the line buffers
+ * @param bytes Output total bytes held by the buffers
+ * @return Weakest backing among the buffers, HUGE_BACKING_HEAP if none is allocated
+ */
+huge_backing_t offline_buffer_backing(size_t* bytes);
+
+/**
+ * Release the line buffers
+ */
+void offline_free(void);
+
+#endif
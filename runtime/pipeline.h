@@ -0,0 +1,79 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <pthread.h>
+#include "../plugins/sync/consumer_producer.h"
+#include "../plugins/sync/stage_cache.h"
+#include "../plugins/sync/metrics.h"
+
+typedef const char* (*init_fn)(int);
+typedef const char* (*place_work_fn)(const char*);
+typedef void (*attach_fn)(const char* (*next_place_work)(const char*));
+typedef const char* (*wait_finished_fn)(void);
+typedef const char* (*fini_fn)(void);
+typedef const char* (*queue_stats_fn)(consumer_producer_stats_t*, int);
+typedef const char* (*resize_queue_fn)(int);
+typedef const char* (*place_record_fn)(const char*, const record_meta_t*);
+typedef void (*attach_record_fn)(place_record_fn);
+typedef void (*attach_tracer_fn)(trace_span_fn, int);
+typedef int (*drain_fn)(long);
+typedef int (*abort_fn)(void);
+typedef const char* (*enable_cache_fn)(int);
+typedef const char* (*cache_stats_fn)(stage_cache_stats_t*);
+typedef const char* (*transform_batch_fn)(const char*, const size_t*, int, char*, size_t, size_t*);
+typedef void (*pause_fn)(void);
+typedef void (*resume_fn)(void);
+typedef const char* (*handoff_fn)(place_record_fn);
+typedef const char* (*metrics_fn)(stage_metrics_t*);
+typedef void (*set_verbosity_fn)(int);
+typedef const char* (*set_lane_weights_fn)(const int*, int);
+typedef int (*is_stateless_fn)(void);
+typedef const char* (*set_rate_limit_fn)(double, double);
+typedef const char* (*set_huge_pages_fn)(int);
+typedef const char* (*set_spill_fn)(const char*);
+typedef const char* (*configure_fn)(const char*, const char*);
+typedef const char* (*set_workers_fn)(int);
+typedef const char* (*set_batch_fn)(int);
+
+typedef struct {
+    char* name;
+    void* handle;
+    init_fn init;
+    place_work_fn place_work;
+    attach_fn attach;
+    wait_finished_fn wait_finished;
+    fini_fn fini;
+    // Optional hooks, up to set_batch: NULL when the plugin does not export them
+    queue_stats_fn queue_stats; // Snapshot of the input queue's counters
+    resize_queue_fn resize_queue; // Change the input queue's capacity while it runs
+    place_record_fn place_record; // Enqueue a line with its metadata, preferred over place_work
+    attach_record_fn attach_record; // Connect to the next stage's place_record
+    attach_tracer_fn attach_tracer; // Report spans of sampled records to the tracer
+    drain_fn drain; // Finish the input and wait a bounded time for the queue to empty
+    abort_fn abort; // Discard queued lines so the stage exits without draining
+    enable_cache_fn enable_cache; // Memoize transform results for a stateless plugin
+    cache_stats_fn cache_stats; // Hits, misses and evictions of that cache
+    transform_batch_fn transform_batch; // Transform many packed lines per call instead of one by one
+    pause_fn pause; // Hold the stage at the next batch boundary
+    resume_fn resume; // Release a pause; pauses nest
+    handoff_fn handoff; // Forward queued lines untransformed to a replacement on reload
+    metrics_fn metrics; // Counters and latency histogram for the metrics endpoint
+    set_verbosity_fn set_verbosity; // Change the log level at runtime
+    set_lane_weights_fn set_lane_weights; // Share the consumer between priority lanes by weight
+    transform_batch_fn transform_lines; // Pure transform over a buffer of lines, required by --offline
+    is_stateless_fn is_stateless; // Whether the transform has no side effects, so results can be cached
+    set_rate_limit_fn set_rate_limit; // Throttle the consumer to lines and bytes per second
+    set_huge_pages_fn set_huge_pages; // Back the queue rings with huge pages
+    set_spill_fn set_spill; // Spill lines that find the queue full to a directory
+    configure_fn configure; // Apply a plugin-specific key=value option
+    set_workers_fn set_workers; // Run the transform on more consumer threads
+    set_batch_fn set_batch; // Lines the consumer takes from the queue at once
+    int paused; // Set while a control command holds the stage paused
+} plugin_handle_t;
+
+extern int g_queue_size;
+extern int g_num_plugins;
+extern plugin_handle_t* g_plugin_handles;
+extern pthread_mutex_t g_stages_mutex; // Held while a stage's handle is replaced by a reload
+
+#endif
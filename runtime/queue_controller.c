@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include "queue_controller.h"
+#include "pipeline.h"
+
+typedef struct {
+    unsigned long long puts;
+    unsigned long long gets;
+    unsigned long long full_waits;
+} stage_sample_t;
+
+static queue_controller_config_t g_config;
+static pthread_t g_thread;
+static int g_running = 0;
+static int g_stop = 0;
+static pthread_mutex_t g_stop_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_stop_cond = PTHREAD_COND_INITIALIZER;
+
+static int clamp_capacity(long capacity) {
+    if (capacity < g_config.min_capacity) return g_config.min_capacity;
+    if (capacity > g_config.max_capacity) return g_config.max_capacity;
+    return (int)capacity;
+}
+
+/*
+ * Pick the next capacity for one queue from the last interval.
+ * A producer that blocked means the stage is falling behind: grow by at least
+ * 2x, or by the backlog the rate difference would build over one interval.
+ * A queue whose peak stayed under a quarter of its capacity gives memory back,
+ * keeping twice the observed peak as headroom.
+ */
+static int next_capacity(const consumer_producer_stats_t* stats, const stage_sample_t* last, double interval_s) {
+    double in_rate = (double)(stats->puts - last->puts) / interval_s;
+    double out_rate = (double)(stats->gets - last->gets) / interval_s;
+    unsigned long long blocked = stats->full_waits - last->full_waits;
+
+    if (blocked > 0) {
+        long target = (long)stats->capacity * 2;
+        long backlog = (long)((in_rate - out_rate) * interval_s);
+        if (stats->capacity + backlog > target) target = stats->capacity + backlog;
+        return clamp_capacity(target);
+    }
+    if (stats->high_watermark < stats->capacity / 4) {
+        long target = stats->capacity / 2;
+        if (stats->high_watermark * 2 > target) target = stats->high_watermark * 2;
+        return clamp_capacity(target);
+    }
+    return stats->capacity;
+}
+
+static void* controller_thread(void* arg) {
+    (void)arg;
+    stage_sample_t* samples = calloc(g_num_plugins, sizeof(stage_sample_t));
+    if (!samples) return NULL;
+    double interval_s = g_config.interval_ms / 1000.0;
+
+    pthread_mutex_lock(&g_stop_mutex);
+    while (!g_stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += g_config.interval_ms / 1000;
+        deadline.tv_nsec += (long)(g_config.interval_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        int rc = 0;
+        while (!g_stop && rc != ETIMEDOUT) {
+            rc = pthread_cond_timedwait(&g_stop_cond, &g_stop_mutex, &deadline);
+        }
+        if (g_stop) break;
+        pthread_mutex_unlock(&g_stop_mutex);
+
+        pthread_mutex_lock(&g_stages_mutex);
+        for (int i = 0; i < g_num_plugins; i++) {
+            plugin_handle_t* stage = &g_plugin_handles[i];
+            if (!stage->queue_stats || !stage->resize_queue) continue;
+            consumer_producer_stats_t stats;
+            // Only the controller restarts the watermark, so each sample covers one interval
+            if (stage->queue_stats(&stats, 1) != NULL) continue;
+            // A reloaded stage starts counting from zero again
+            if (stats.puts < samples[i].puts || stats.gets < samples[i].gets ||
+                stats.full_waits < samples[i].full_waits) {
+                memset(&samples[i], 0, sizeof(samples[i]));
+            }
+            int capacity = next_capacity(&stats, &samples[i], interval_s);
+            if (capacity != stats.capacity) {
+                const char* err = stage->resize_queue(capacity);
+                if (err) {
+                    fprintf(stderr, "Failed to resize queue of plugin %s: %s\n", stage->name, err);
+                }
+            }
+            samples[i].puts = stats.puts;
+            samples[i].gets = stats.gets;
+            samples[i].full_waits = stats.full_waits;
+        }
+        pthread_mutex_unlock(&g_stages_mutex);
+
+        pthread_mutex_lock(&g_stop_mutex);
+    }
+    pthread_mutex_unlock(&g_stop_mutex);
+    free(samples);
+    return NULL;
+}
+
+const char* queue_controller_start(const queue_controller_config_t* config) {
+    if (!config) return "Config is NULL";
+    if (config->min_capacity <= 0 || config->max_capacity < config->min_capacity) {
+        return "Invalid capacity bounds";
+    }
+    if (config->interval_ms <= 0) return "Interval must be greater than 0";
+    if (g_running) return "Controller already running";
+    g_config = *config;
+    g_stop = 0;
+    if (pthread_create(&g_thread, NULL, controller_thread, NULL) != 0) {
+        return "Could not create controller thread";
+    }
+    g_running = 1;
+    return NULL;
+}
+
+void queue_controller_stop(void) {
+    if (!g_running) return;
+    pthread_mutex_lock(&g_stop_mutex);
+    g_stop = 1;
+    pthread_cond_signal(&g_stop_cond);
+    pthread_mutex_unlock(&g_stop_mutex);
+    pthread_join(g_thread, NULL);
+    g_running = 0;
+    return;
+}
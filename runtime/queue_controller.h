@@ -0,0 +1,26 @@
+#ifndef QUEUE_CONTROLLER_H
+#define QUEUE_CONTROLLER_H
+
+typedef struct {
+    int min_capacity; // Smallest capacity a queue may shrink to
+    int max_capacity; // Largest capacity a queue may grow to
+    int interval_ms; // Time between two sampling rounds
+} queue_controller_config_t;
+
+/**
+ * Start the queue controller thread
+ * Every interval the controller samples each stage's queue counters and resizes
+ * the queue: it grows when the producer blocked on a full queue, and shrinks
+ * when the queue stayed mostly empty. Stages without resize support are skipped.
+ * @param config Controller configuration (copied)
+ * @return NULL on success, error message on failure
+ */
+const char* queue_controller_start(const queue_controller_config_t* config);
+
+/**
+ * Stop the queue controller thread and wait for it to exit
+ * Safe to call when the controller was never started
+ */
+void queue_controller_stop(void);
+
+#endif
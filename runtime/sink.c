@@ -0,0 +1,648 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include "sink.h"
+#include "framing.h"
+#include "../plugins/sync/spill_file.h"
+#include "../plugins/sync/trace.h"
+
+#define SINK_DEFAULT_BUFFER 4096 // Lines a sink holds before its policy applies
+#define SINK_MAX_BUFFER (1 << 20)
+#define SINK_DEFAULT_KEEP 5 // Rotated files kept next to the current one
+#define SINK_FILE_BUFFER (64 * 1024) // stdio buffer of each destination
+#define SINK_OPEN_POLL_MS 20 // Retry interval while a named pipe has no reader
+#define SINK_OPEN_GRACE_MS 5000 // How long a stopping sink still waits for a reader
+
+// Lines waiting for the writer: an 8 byte sequence number, then the NUL terminated line, back to back
+typedef struct {
+    char* data;
+    size_t used;
+    size_t size;
+    int lines;
+} sink_batch_t;
+
+typedef struct {
+    char* path;
+    int to_stdout;
+    sink_format_t format;
+    sink_policy_t policy;
+    int capacity; // Lines in pending before the policy applies
+    long long rotate_bytes; // 0 to never rotate
+    int keep;
+    pthread_t thread;
+    int started;
+    pthread_mutex_t mutex; // Guards pending, spill, the sequence numbers and stopping
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    sink_batch_t pending;
+    spill_file_t spill;
+    int spill_ready;
+    unsigned long long next_seq;
+    unsigned long long sync_seq; // Lines up to here were asked to be made durable
+    unsigned long long synced_seq; // Lines up to here are on disk or were dropped
+    int stopping;
+    atomic_int state;
+    atomic_ullong written;
+    atomic_ullong dropped;
+    atomic_ullong spilled;
+    atomic_ullong rotations;
+    atomic_llong blocked_ns;
+    // Owned by the writer thread
+    FILE* file;
+    char* file_buffer;
+    long long file_bytes; // Bytes in the current file, for rotation
+    frame_writer_t frames;
+} sink_t;
+
+static sink_t* g_sinks[SINK_MAX];
+static int g_num_sinks = 0;
+// Guards started and the per-sink locks, which the checkpoint thread uses while sinks start and stop
+static pthread_mutex_t g_lifecycle_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static const char* const g_format_names[] = { "raw", "json", "framed" };
+static const char* const g_policy_names[] = { "block", "drop", "spill" };
+
+const char* sink_format_name(sink_format_t format) {
+    return g_format_names[format];
+}
+
+static int parse_choice(const char* value, const char* const* names, int count) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(value, names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+// Byte count with an optional k or m suffix
+static long long parse_size(const char* value) {
+    char* end;
+    long long size = strtoll(value, &end, 10);
+    if (end == value || size <= 0) return -1;
+    if (*end == 'k' || *end == 'K') {
+        size *= 1024;
+        end++;
+    } else if (*end == 'm' || *end == 'M') {
+        size *= 1024 * 1024;
+        end++;
+    }
+    return *end == '\0' ? size : -1;
+}
+
+static const char* apply_option(sink_t* sink, const char* key, const char* value) {
+    char* end;
+    long number;
+    if (strcmp(key, "format") == 0) {
+        int format = parse_choice(value, g_format_names, 3);
+        if (format < 0) return "format must be raw, json or framed";
+        sink->format = (sink_format_t)format;
+    } else if (strcmp(key, "policy") == 0) {
+        int policy = parse_choice(value, g_policy_names, 3);
+        if (policy < 0) return "policy must be block, drop or spill";
+        sink->policy = (sink_policy_t)policy;
+    } else if (strcmp(key, "buffer") == 0) {
+        number = strtol(value, &end, 10);
+        if (end == value || *end != '\0' || number <= 0 || number > SINK_MAX_BUFFER) {
+            return "buffer must be between 1 and 1048576 lines";
+        }
+        sink->capacity = (int)number;
+    } else if (strcmp(key, "rotate") == 0) {
+        sink->rotate_bytes = parse_size(value);
+        if (sink->rotate_bytes < 0) return "rotate must be a size in bytes, optionally with k or m";
+    } else if (strcmp(key, "keep") == 0) {
+        number = strtol(value, &end, 10);
+        if (end == value || *end != '\0' || number <= 0 || number > 1000) return "keep must be between 1 and 1000";
+        sink->keep = (int)number;
+    } else {
+        return "Unknown sink option, expected format, policy, buffer, rotate or keep";
+    }
+    return NULL;
+}
+
+static void free_sink(sink_t* sink) {
+    free(sink->path);
+    free(sink->pending.data);
+    free(sink->file_buffer);
+    free(sink);
+}
+
+const char* sink_add(const char* spec) {
+    if (g_num_sinks == SINK_MAX) return "Too many sinks";
+    sink_t* sink = calloc(1, sizeof(sink_t));
+    if (!sink) return "Could not allocate memory for sink";
+    sink->format = SINK_RAW;
+    sink->policy = SINK_BLOCK;
+    sink->capacity = SINK_DEFAULT_BUFFER;
+    sink->keep = SINK_DEFAULT_KEEP;
+    const char* comma = strchr(spec, ',');
+    size_t path_length = comma ? (size_t)(comma - spec) : strlen(spec);
+    sink->path = strndup(spec, path_length);
+    if (!sink->path) {
+        free_sink(sink);
+        return "Could not allocate memory for sink";
+    }
+    if (path_length == 0) {
+        free_sink(sink);
+        return "Sink path is empty";
+    }
+    sink->to_stdout = strcmp(sink->path, "-") == 0;
+    while (comma) {
+        const char* option = comma + 1;
+        comma = strchr(option, ',');
+        size_t length = comma ? (size_t)(comma - option) : strlen(option);
+        const char* equals = memchr(option, '=', length);
+        char key[32];
+        char value[64];
+        if (!equals || equals == option || (size_t)(equals - option) >= sizeof(key) ||
+            length - (equals - option) - 1 >= sizeof(value)) {
+            free_sink(sink);
+            return "Invalid sink option, expected <key>=<value>";
+        }
+        memcpy(key, option, equals - option);
+        key[equals - option] = '\0';
+        memcpy(value, equals + 1, length - (equals - option) - 1);
+        value[length - (equals - option) - 1] = '\0';
+        const char* err = apply_option(sink, key, value);
+        if (err) {
+            free_sink(sink);
+            return err;
+        }
+    }
+    if (sink->to_stdout && sink->rotate_bytes > 0) {
+        free_sink(sink);
+        return "stdout cannot be rotated";
+    }
+    g_sinks[g_num_sinks++] = sink;
+    return NULL;
+}
+
+int sink_count(void) {
+    return g_num_sinks;
+}
+
+int sink_uses_stdout(void) {
+    for (int i = 0; i < g_num_sinks; i++) {
+        if (g_sinks[i]->to_stdout) return 1;
+    }
+    return 0;
+}
+
+static int is_fifo(const char* path) {
+    struct stat info;
+    return stat(path, &info) == 0 && S_ISFIFO(info.st_mode);
+}
+
+static int is_stopping(sink_t* sink) {
+    pthread_mutex_lock(&sink->mutex);
+    int stopping = sink->stopping;
+    pthread_mutex_unlock(&sink->mutex);
+    return stopping;
+}
+
+/*
+ * Opening a named pipe for writing waits for a reader. Opening it non-blocking
+ * fails with ENXIO until one shows up, so the writer polls instead, which lets
+ * a stopping pipeline give up on a reader that never comes.
+ */
+static int open_fifo(sink_t* sink) {
+    long waited_ms = 0;
+    for (;;) {
+        int fd = open(sink->path, O_WRONLY | O_NONBLOCK);
+        if (fd >= 0) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+            return fd;
+        }
+        if (errno != ENXIO) return -1;
+        if (is_stopping(sink)) {
+            if (waited_ms >= SINK_OPEN_GRACE_MS) return -1;
+            waited_ms += SINK_OPEN_POLL_MS;
+        }
+        usleep(SINK_OPEN_POLL_MS * 1000);
+    }
+}
+
+static int open_destination(sink_t* sink) {
+    int fd;
+    if (sink->to_stdout) {
+        // A copy of the descriptor, so closing the sink leaves stdout open for the final messages
+        fd = dup(STDOUT_FILENO);
+    } else if (is_fifo(sink->path)) {
+        fd = open_fifo(sink);
+    } else {
+        fd = open(sink->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    if (fd < 0) return -1;
+    sink->file = fdopen(fd, "w");
+    if (!sink->file) {
+        close(fd);
+        return -1;
+    }
+    if (sink->file_buffer) setvbuf(sink->file, sink->file_buffer, _IOFBF, SINK_FILE_BUFFER);
+    sink->file_bytes = 0;
+    if (sink->format == SINK_FRAMED) frame_writer_init(&sink->frames, sink->file, 0);
+    return 0;
+}
+
+// Flushed lines reach the disk; pipes and terminals cannot be synced, and need not be
+static int sync_destination(sink_t* sink) {
+    if (fsync(fileno(sink->file)) != 0 && errno != EINVAL && errno != EROFS) return -1;
+    return 0;
+}
+
+static int close_destination(sink_t* sink) {
+    if (!sink->file) return 0;
+    int failed = 0;
+    if (sink->format == SINK_FRAMED && frame_write_end(&sink->frames) != NULL) failed = 1;
+    if (fflush(sink->file) != 0 || sync_destination(sink) != 0) failed = 1;
+    if (fclose(sink->file) != 0) failed = 1;
+    sink->file = NULL;
+    return failed ? -1 : 0;
+}
+
+// path.<keep-1> becomes path.<keep> and so on, down to path becoming path.1
+static int rotate(sink_t* sink) {
+    if (close_destination(sink) != 0) return -1;
+    size_t size = strlen(sink->path) + 16;
+    char* from = malloc(size);
+    char* to = malloc(size);
+    if (!from || !to) {
+        free(from);
+        free(to);
+        return -1;
+    }
+    for (int i = sink->keep - 1; i >= 0; i--) {
+        if (i == 0) {
+            snprintf(from, size, "%s", sink->path);
+        } else {
+            snprintf(from, size, "%s.%d", sink->path, i);
+        }
+        snprintf(to, size, "%s.%d", sink->path, i + 1);
+        rename(from, to);
+    }
+    free(from);
+    free(to);
+    atomic_fetch_add(&sink->rotations, 1);
+    return open_destination(sink);
+}
+
+// JSON string body; control characters become \u escapes
+static long long write_json_string(FILE* file, const char* line) {
+    long long bytes = 0;
+    for (const unsigned char* p = (const unsigned char*)line; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            fputc('\\', file);
+            fputc(*p, file);
+            bytes += 2;
+        } else if (*p == '\n') {
+            fputs("\\n", file);
+            bytes += 2;
+        } else if (*p == '\t') {
+            fputs("\\t", file);
+            bytes += 2;
+        } else if (*p < 0x20) {
+            bytes += fprintf(file, "\\u%04x", *p);
+        } else {
+            fputc(*p, file);
+            bytes++;
+        }
+    }
+    return bytes;
+}
+
+static int write_line(sink_t* sink, unsigned long long seq, const char* line, size_t length) {
+    if (sink->format == SINK_FRAMED) {
+        if (frame_write(&sink->frames, line, length) != NULL) return -1;
+        sink->file_bytes += FRAME_HEADER_SIZE + (long long)length;
+    } else if (sink->format == SINK_JSON) {
+        int prefix = fprintf(sink->file, "{\"seq\":%llu,\"line\":\"", seq);
+        long long body = write_json_string(sink->file, line);
+        fputs("\"}\n", sink->file);
+        sink->file_bytes += prefix + body + 3;
+    } else {
+        fwrite(line, 1, length, sink->file);
+        fputc('\n', sink->file);
+        sink->file_bytes += (long long)length + 1;
+    }
+    if (ferror(sink->file)) return -1;
+    if (sink->rotate_bytes > 0 && sink->file_bytes >= sink->rotate_bytes) return rotate(sink);
+    return 0;
+}
+
+// Write a batch, then flush so a reader sees it without waiting for the next one
+static int write_batch(sink_t* sink, const sink_batch_t* batch, unsigned long long* last_seq) {
+    const char* record = batch->data;
+    for (int i = 0; i < batch->lines; i++) {
+        unsigned long long seq;
+        memcpy(&seq, record, sizeof(seq));
+        *last_seq = seq;
+        const char* line = record + sizeof(seq);
+        size_t length = strlen(line);
+        if (write_line(sink, seq, line, length) != 0) {
+            atomic_fetch_add(&sink->dropped, (unsigned long long)(batch->lines - i));
+            return -1;
+        }
+        atomic_fetch_add_explicit(&sink->written, 1, memory_order_relaxed);
+        record = line + length + 1;
+    }
+    return fflush(sink->file) == 0 ? 0 : -1;
+}
+
+static int batch_append(sink_batch_t* batch, unsigned long long seq, const char* line) {
+    size_t length = strlen(line);
+    size_t needed = batch->used + sizeof(seq) + length + 1;
+    if (needed > batch->size) {
+        size_t size = batch->size ? batch->size : 4096;
+        while (size < needed) size *= 2;
+        char* grown = realloc(batch->data, size);
+        if (!grown) return -1;
+        batch->data = grown;
+        batch->size = size;
+    }
+    memcpy(batch->data + batch->used, &seq, sizeof(seq));
+    memcpy(batch->data + batch->used + sizeof(seq), line, length + 1);
+    batch->used = needed;
+    batch->lines++;
+    return 0;
+}
+
+/*
+ * Take what is waiting: the pending lines if there are any, else up to a
+ * buffer's worth from the spill file. Lines only spill once pending is full,
+ * and keep spilling until the file is empty, so this preserves their order.
+ */
+static void take_lines(sink_t* sink, sink_batch_t* batch) {
+    if (sink->pending.lines > 0) {
+        sink_batch_t taken = sink->pending;
+        sink->pending = *batch;
+        *batch = taken;
+        return;
+    }
+    while (sink->spill.count > 0 && batch->lines < sink->capacity) {
+        char* line;
+        unsigned long long seq;
+        if (spill_file_read(&sink->spill, &line, &seq) != NULL) {
+            // The rest of the file cannot be trusted either
+            atomic_fetch_add(&sink->dropped, sink->spill.count);
+            spill_file_destroy(&sink->spill);
+            return;
+        }
+        if (batch_append(batch, seq, line) != 0) atomic_fetch_add(&sink->dropped, 1);
+        free(line);
+    }
+}
+
+static void* writer_thread(void* arg) {
+    sink_t* sink = (sink_t*)arg;
+    // A reader that goes away fails the write with EPIPE instead of killing the process
+    sigset_t pipe_signal;
+    sigemptyset(&pipe_signal);
+    sigaddset(&pipe_signal, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe_signal, NULL);
+
+    int failed = open_destination(sink) != 0;
+    if (failed) {
+        fprintf(stderr, "Failed to open sink %s: %s\n", sink->path, strerror(errno));
+    } else {
+        atomic_store(&sink->state, 1);
+    }
+    sink_batch_t batch = { NULL, 0, 0, 0 };
+    pthread_mutex_lock(&sink->mutex);
+    if (failed) {
+        atomic_store(&sink->state, -1);
+        pthread_cond_broadcast(&sink->not_full);
+    }
+    for (;;) {
+        while (sink->pending.lines == 0 && sink->spill.count == 0 && !sink->stopping &&
+               (failed || sink->sync_seq <= sink->synced_seq)) {
+            pthread_cond_wait(&sink->not_empty, &sink->mutex);
+        }
+        if (sink->pending.lines == 0 && sink->spill.count == 0) {
+            if (sink->stopping) break;
+            // Idle, so every line handed over so far was written or dropped
+            unsigned long long seq = sink->next_seq;
+            pthread_mutex_unlock(&sink->mutex);
+            failed = sync_destination(sink) != 0;
+            if (failed) fprintf(stderr, "Failed to sync sink %s: %s\n", sink->path, strerror(errno));
+            pthread_mutex_lock(&sink->mutex);
+            if (!failed) sink->synced_seq = seq;
+        } else {
+            batch.used = 0;
+            batch.lines = 0;
+            take_lines(sink, &batch);
+            int sync = sink->sync_seq > sink->synced_seq;
+            pthread_cond_broadcast(&sink->not_full);
+            pthread_mutex_unlock(&sink->mutex);
+            unsigned long long last_seq = 0;
+            if (failed) {
+                atomic_fetch_add(&sink->dropped, (unsigned long long)batch.lines);
+            } else if (write_batch(sink, &batch, &last_seq) != 0 || (sync && sync_destination(sink) != 0)) {
+                fprintf(stderr, "Failed to write sink %s: %s\n", sink->path, strerror(errno));
+                failed = 1;
+            }
+            pthread_mutex_lock(&sink->mutex);
+            if (!failed && sync && last_seq > sink->synced_seq) sink->synced_seq = last_seq;
+        }
+        if (failed && atomic_load(&sink->state) != -1) {
+            // Nothing is written from here on, so no line waits for room any more
+            atomic_store(&sink->state, -1);
+            pthread_cond_broadcast(&sink->not_full);
+        }
+    }
+    pthread_mutex_unlock(&sink->mutex);
+    free(batch.data);
+    if (close_destination(sink) != 0 && !failed) {
+        fprintf(stderr, "Failed to close sink %s\n", sink->path);
+        failed = 1;
+    }
+    if (!failed) {
+        pthread_mutex_lock(&sink->mutex);
+        sink->synced_seq = sink->next_seq;
+        pthread_mutex_unlock(&sink->mutex);
+        atomic_store(&sink->state, 2);
+    }
+    return NULL;
+}
+
+static const char* init_spill(sink_t* sink, int index, const char* spill_dir) {
+    char* copy = NULL;
+    const char* dir = spill_dir;
+    if (!dir && sink->to_stdout) dir = ".";
+    if (!dir) {
+        copy = strdup(sink->path);
+        if (!copy) return "Could not allocate memory for sink";
+        dir = dirname(copy);
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "analyzer-%d-sink-%d", (int)getpid(), index);
+    const char* err = spill_file_init(&sink->spill, dir, name, sizeof(unsigned long long));
+    free(copy);
+    if (err) return err;
+    sink->spill_ready = 1;
+    return NULL;
+}
+
+const char* sink_start(const char* spill_dir) {
+    for (int i = 0; i < g_num_sinks; i++) {
+        sink_t* sink = g_sinks[i];
+        if (sink->rotate_bytes > 0 && is_fifo(sink->path)) {
+            sink_stop();
+            return "A named pipe cannot be rotated";
+        }
+        if (sink->policy == SINK_SPILL) {
+            const char* err = init_spill(sink, i, spill_dir);
+            if (err) {
+                sink_stop();
+                return err;
+            }
+        }
+        sink->file_buffer = malloc(SINK_FILE_BUFFER);
+        pthread_mutex_init(&sink->mutex, NULL);
+        pthread_cond_init(&sink->not_empty, NULL);
+        pthread_cond_init(&sink->not_full, NULL);
+        if (pthread_create(&sink->thread, NULL, writer_thread, sink) != 0) {
+            pthread_cond_destroy(&sink->not_full);
+            pthread_cond_destroy(&sink->not_empty);
+            pthread_mutex_destroy(&sink->mutex);
+            if (sink->spill_ready) spill_file_destroy(&sink->spill);
+            sink->spill_ready = 0;
+            sink_stop();
+            return "Could not create sink writer thread";
+        }
+        pthread_mutex_lock(&g_lifecycle_mutex);
+        sink->started = 1;
+        pthread_mutex_unlock(&g_lifecycle_mutex);
+    }
+    return NULL;
+}
+
+static void emit_one(sink_t* sink, const char* line) {
+    pthread_mutex_lock(&sink->mutex);
+    unsigned long long seq = ++sink->next_seq;
+    if (sink->policy == SINK_BLOCK && sink->pending.lines >= sink->capacity && atomic_load(&sink->state) != -1) {
+        long long start = trace_now_ns();
+        while (sink->pending.lines >= sink->capacity && atomic_load(&sink->state) != -1) {
+            pthread_cond_wait(&sink->not_full, &sink->mutex);
+        }
+        atomic_fetch_add(&sink->blocked_ns, trace_now_ns() - start);
+    }
+    if (atomic_load(&sink->state) == -1) {
+        atomic_fetch_add(&sink->dropped, 1);
+    } else if (sink->spill.count == 0 && sink->pending.lines < sink->capacity) {
+        if (batch_append(&sink->pending, seq, line) != 0) {
+            atomic_fetch_add(&sink->dropped, 1);
+        } else if (sink->pending.lines == 1) {
+            pthread_cond_signal(&sink->not_empty);
+        }
+    } else if (sink->policy == SINK_SPILL && spill_file_append(&sink->spill, line, &seq) == NULL) {
+        atomic_fetch_add(&sink->spilled, 1);
+        pthread_cond_signal(&sink->not_empty);
+    } else {
+        atomic_fetch_add(&sink->dropped, 1);
+    }
+    pthread_mutex_unlock(&sink->mutex);
+}
+
+void sink_emit(const char* line) {
+    for (int i = 0; i < g_num_sinks; i++) {
+        if (g_sinks[i]->started) emit_one(g_sinks[i], line);
+    }
+}
+
+void sink_request_sync(unsigned long long* marks) {
+    pthread_mutex_lock(&g_lifecycle_mutex);
+    for (int i = 0; i < g_num_sinks; i++) {
+        sink_t* sink = g_sinks[i];
+        marks[i] = 0;
+        if (!sink->started) continue;
+        pthread_mutex_lock(&sink->mutex);
+        marks[i] = sink->next_seq;
+        if (marks[i] > sink->sync_seq) {
+            sink->sync_seq = marks[i];
+            pthread_cond_signal(&sink->not_empty);
+        }
+        pthread_mutex_unlock(&sink->mutex);
+    }
+    pthread_mutex_unlock(&g_lifecycle_mutex);
+}
+
+int sink_synced(const unsigned long long* marks) {
+    int synced = 1;
+    pthread_mutex_lock(&g_lifecycle_mutex);
+    for (int i = 0; i < g_num_sinks && synced; i++) {
+        sink_t* sink = g_sinks[i];
+        // A stopped sink set synced_seq before its writer exited
+        if (sink->started) pthread_mutex_lock(&sink->mutex);
+        synced = sink->synced_seq >= marks[i];
+        if (sink->started) pthread_mutex_unlock(&sink->mutex);
+    }
+    pthread_mutex_unlock(&g_lifecycle_mutex);
+    return synced;
+}
+
+void sink_stop(void) {
+    for (int i = 0; i < g_num_sinks; i++) {
+        sink_t* sink = g_sinks[i];
+        if (!sink->started) continue;
+        pthread_mutex_lock(&sink->mutex);
+        sink->stopping = 1;
+        pthread_cond_signal(&sink->not_empty);
+        pthread_mutex_unlock(&sink->mutex);
+    }
+    // Every writer drains at once, so a slow sink does not hold back the others
+    for (int i = 0; i < g_num_sinks; i++) {
+        sink_t* sink = g_sinks[i];
+        if (!sink->started) continue;
+        pthread_join(sink->thread, NULL);
+        if (sink->spill_ready) spill_file_destroy(&sink->spill);
+        sink->spill_ready = 0;
+        pthread_mutex_lock(&g_lifecycle_mutex);
+        pthread_cond_destroy(&sink->not_full);
+        pthread_cond_destroy(&sink->not_empty);
+        pthread_mutex_destroy(&sink->mutex);
+        sink->started = 0;
+        pthread_mutex_unlock(&g_lifecycle_mutex);
+    }
+}
+
+void sink_progress(int index, sink_progress_t* progress) {
+    sink_t* sink = g_sinks[index];
+    progress->path = sink->path;
+    progress->format = sink->format;
+    progress->policy = sink->policy;
+    progress->written = atomic_load(&sink->written);
+    progress->dropped = atomic_load(&sink->dropped);
+    progress->spilled = atomic_load(&sink->spilled);
+    progress->rotations = atomic_load(&sink->rotations);
+    progress->blocked_ns = atomic_load(&sink->blocked_ns);
+    progress->state = atomic_load(&sink->state);
+    progress->buffered = 0;
+    if (sink->started) {
+        pthread_mutex_lock(&sink->mutex);
+        progress->buffered = (unsigned long long)sink->pending.lines + sink->spill.count;
+        pthread_mutex_unlock(&sink->mutex);
+    }
+}
+
+void sink_report(FILE* out) {
+    for (int i = 0; i < g_num_sinks; i++) {
+        sink_progress_t progress;
+        sink_progress(i, &progress);
+        fprintf(out, "Sink %s (%s, %s): %llu lines written, %llu dropped, %llu spilled, blocked %.3f s",
+                progress.path, g_format_names[progress.format], g_policy_names[progress.policy], progress.written,
+                progress.dropped, progress.spilled, progress.blocked_ns / 1e9);
+        if (progress.rotations > 0) fprintf(out, ", %llu rotations", progress.rotations);
+        fprintf(out, "%s\n", progress.state == -1 ? ", failed" : "");
+    }
+}
+
+void sink_free(void) {
+    for (int i = 0; i < g_num_sinks; i++) free_sink(g_sinks[i]);
+    g_num_sinks = 0;
+}
@@ -0,0 +1,115 @@
+#ifndef RUNTIME_SINK_H
+#define RUNTIME_SINK_H
+
+#include <stdio.h>
+
+#define SINK_MAX 16
+
+typedef enum {
+    SINK_RAW,   // The line and a newline
+    SINK_JSON,  // {"seq":<n>,"line":"<escaped line>"} per line
+    SINK_FRAMED // Length-prefixed binary frames, as --framed-output writes them
+} sink_format_t;
+
+typedef enum {
+    SINK_BLOCK, // A full buffer holds the last stage until the writer catches up
+    SINK_DROP,  // A full buffer discards the line for this sink only
+    SINK_SPILL  // A full buffer sends lines to disk; they are written in order later
+} sink_policy_t;
+
+/**
+ * Counters of one sink, readable while the pipeline runs
+ */
+typedef struct {
+    const char* path; // Destination, "-" for stdout
+    sink_format_t format;
+    sink_policy_t policy;
+    unsigned long long written; // Lines handed to the destination
+    unsigned long long dropped; // Lines the policy or a failed destination discarded
+    unsigned long long spilled; // Lines that went through the spill file
+    unsigned long long buffered; // Lines waiting in memory or on disk
+    unsigned long long rotations; // Files rotated away
+    long long blocked_ns; // Time the last stage waited on a full buffer
+    int state; // 0 waiting for the destination, 1 writing, 2 closed, -1 failed
+} sink_progress_t;
+
+/**
+ * Add a sink from <path>[,<key>=<value>...]; keys are format=raw|json|framed,
+ * policy=block|drop|spill, buffer=<lines>, rotate=<bytes>[k|m] and keep=<files>
+ * @param spec Sink specification; "-" as path writes to stdout
+ * @return NULL on success, error message on an invalid specification
+ */
+const char* sink_add(const char* spec);
+
+/**
+ * Number of sinks added so far
+ * @return Sink count
+ */
+int sink_count(void);
+
+/**
+ * Whether a sink writes to stdout, which then carries the pipeline output only
+ * @return Non-zero if one does
+ */
+int sink_uses_stdout(void);
+
+/**
+ * Start one writer thread per sink; a named pipe is opened by its writer once a reader appears
+ * @param spill_dir Directory for the spill files of policy=spill sinks, NULL for next to the destination
+ * @return NULL on success, error message on failure (no sink is left running)
+ */
+const char* sink_start(const char* spill_dir);
+
+/**
+ * Hand a line to every sink; returns once each one took, spilled or dropped it
+ * @param line Line to write, copied before returning
+ */
+void sink_emit(const char* line);
+
+/**
+ * Ask every sink to make the lines handed to it so far durable
+ * Each writer syncs its destination once it wrote up to the mark.
+ * @param marks Output, one position per sink, to pass to sink_synced
+ */
+void sink_request_sync(unsigned long long* marks);
+
+/**
+ * Whether every sink wrote, flushed and synced its lines up to the marks
+ * Lines a sink dropped count as done; a failed sink never gets there.
+ * @param marks Positions from sink_request_sync
+ * @return Non-zero once all have
+ */
+int sink_synced(const unsigned long long* marks);
+
+/**
+ * Write everything buffered or spilled, then close every sink and join its writer
+ * A named pipe nobody opened within a few seconds gives up and drops its lines.
+ */
+void sink_stop(void);
+
+/**
+ * Snapshot the counters of one sink
+ * @param index Sink index, below sink_count()
+ * @param progress Output snapshot
+ */
+void sink_progress(int index, sink_progress_t* progress);
+
+/**
+ * Print the counters of every sink
+ * @param out Stream to print to
+ */
+void sink_report(FILE* out);
+
+/**
+ * Name of a format, as sink_add accepts it
+ * @param format Sink format
+ * @return Static name
+ */
+const char* sink_format_name(sink_format_t format);
+
+/**
+ * Forget every added sink; sink_stop must have run if they were started
+ */
+void sink_free(void);
+
+#endif
@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include "tracer.h"
+
+#define TRACE_BUFFER_SPANS 8192
+#define TRACE_FLUSH_MS 100
+
+typedef struct {
+    int stage;
+    trace_span_kind_t kind;
+    unsigned long long trace_id;
+    long long start_ns;
+    long long end_ns;
+} span_t;
+
+typedef struct {
+    span_t spans[TRACE_BUFFER_SPANS];
+    int count;
+} span_buffer_t;
+
+static FILE* g_file = NULL;
+static int g_sample_every = 0;
+static unsigned long long g_seen = 0;
+static unsigned long long g_next_id = 0;
+static long long g_base_ns = 0;
+static int g_first_event = 1;
+
+// Spans are filled on plugin threads, which belong to another libc namespace and
+// must not touch this one's stdio. They only copy into the active buffer; the
+// writer thread swaps buffers and formats the JSON.
+static span_buffer_t g_buffers[2];
+static span_buffer_t* g_active = &g_buffers[0];
+static unsigned long long g_dropped = 0;
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t g_writer;
+static int g_stop = 0;
+static pthread_mutex_t g_stop_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_stop_cond = PTHREAD_COND_INITIALIZER;
+
+static const char* span_name(trace_span_kind_t kind) {
+    switch (kind) {
+        case TRACE_SPAN_PUT: return "put";
+        case TRACE_SPAN_QUEUE: return "queue";
+        case TRACE_SPAN_PROCESS: return "process";
+    }
+    return "unknown";
+}
+
+// Timestamps in the trace are microseconds since the tracer was opened
+static double to_us(long long ns) {
+    return (double)(ns - g_base_ns) / 1000.0;
+}
+
+static void begin_event(void) {
+    if (!g_first_event) fputs(",\n", g_file);
+    g_first_event = 0;
+}
+
+static void write_span(const span_t* span) {
+    const char* name = span_name(span->kind);
+    begin_event();
+    if (span->kind == TRACE_SPAN_PROCESS) {
+        fprintf(g_file, "{\"ph\":\"X\",\"name\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+                        "\"args\":{\"trace_id\":%llu}}",
+                name, span->stage, to_us(span->start_ns), (double)(span->end_ns - span->start_ns) / 1000.0,
+                span->trace_id);
+        return;
+    }
+    fprintf(g_file, "{\"ph\":\"b\",\"cat\":\"%s\",\"name\":\"%s\",\"id\":\"0x%llx\",\"pid\":1,\"tid\":%d,"
+                    "\"ts\":%.3f,\"args\":{\"trace_id\":%llu}},\n",
+            name, name, span->trace_id, span->stage, to_us(span->start_ns), span->trace_id);
+    fprintf(g_file, "{\"ph\":\"e\",\"cat\":\"%s\",\"name\":\"%s\",\"id\":\"0x%llx\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}",
+            name, name, span->trace_id, span->stage, to_us(span->end_ns));
+}
+
+static void flush_spans(void) {
+    pthread_mutex_lock(&g_mutex);
+    span_buffer_t* full = g_active;
+    g_active = (full == &g_buffers[0]) ? &g_buffers[1] : &g_buffers[0];
+    pthread_mutex_unlock(&g_mutex);
+    for (int i = 0; i < full->count; i++) write_span(&full->spans[i]);
+    full->count = 0;
+}
+
+static void* writer_thread(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&g_stop_mutex);
+    while (!g_stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += TRACE_FLUSH_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        int rc = 0;
+        while (!g_stop && rc != ETIMEDOUT) {
+            rc = pthread_cond_timedwait(&g_stop_cond, &g_stop_mutex, &deadline);
+        }
+        pthread_mutex_unlock(&g_stop_mutex);
+        flush_spans();
+        pthread_mutex_lock(&g_stop_mutex);
+    }
+    pthread_mutex_unlock(&g_stop_mutex);
+    return NULL;
+}
+
+const char* tracer_open(const char* path, int sample_every) {
+    if (!path) return "Path is NULL";
+    if (sample_every <= 0) return "Sample rate must be greater than 0";
+    if (g_file) return "Tracer already open";
+    g_file = fopen(path, "w");
+    if (!g_file) return "Could not open trace file";
+    g_sample_every = sample_every;
+    g_seen = 0;
+    g_next_id = 0;
+    g_dropped = 0;
+    g_first_event = 1;
+    g_stop = 0;
+    g_base_ns = trace_now_ns();
+    fputs("{\"traceEvents\":[\n", g_file);
+    begin_event();
+    fputs("{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"analyzer\"}}", g_file);
+    if (pthread_create(&g_writer, NULL, writer_thread, NULL) != 0) {
+        fclose(g_file);
+        g_file = NULL;
+        return "Could not create trace writer thread";
+    }
+    return NULL;
+}
+
+unsigned long long tracer_sample(void) {
+    if (!g_file) return 0;
+    if (++g_seen % (unsigned long long)g_sample_every != 0) return 0;
+    return ++g_next_id;
+}
+
+void tracer_name_stage(int stage, const char* name) {
+    if (!g_file) return;
+    // Only called before any span exists, so the writer thread has nothing to write yet
+    begin_event();
+    fprintf(g_file, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%d: %s\"}}",
+            stage, stage, name);
+    begin_event();
+    fprintf(g_file, "{\"ph\":\"M\",\"name\":\"thread_sort_index\",\"pid\":1,\"tid\":%d,\"args\":{\"sort_index\":%d}}",
+            stage, stage);
+}
+
+void tracer_span(int stage, trace_span_kind_t kind, unsigned long long trace_id,
+                 long long start_ns, long long end_ns) {
+    if (end_ns < start_ns) return;
+    pthread_mutex_lock(&g_mutex);
+    if (g_active->count < TRACE_BUFFER_SPANS) {
+        span_t* span = &g_active->spans[g_active->count++];
+        span->stage = stage;
+        span->kind = kind;
+        span->trace_id = trace_id;
+        span->start_ns = start_ns;
+        span->end_ns = end_ns;
+    } else {
+        g_dropped++;
+    }
+    pthread_mutex_unlock(&g_mutex);
+}
+
+void tracer_close(void) {
+    if (!g_file) return;
+    pthread_mutex_lock(&g_stop_mutex);
+    g_stop = 1;
+    pthread_cond_signal(&g_stop_cond);
+    pthread_mutex_unlock(&g_stop_mutex);
+    pthread_join(g_writer, NULL);
+    flush_spans();
+    fputs("\n],\"displayTimeUnit\":\"ms\"}\n", g_file);
+    fclose(g_file);
+    g_file = NULL;
+    if (g_dropped > 0) {
+        fprintf(stderr, "Trace buffer overflowed, %llu spans dropped (raise --trace-sample)\n", g_dropped);
+    }
+}
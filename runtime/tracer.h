@@ -0,0 +1,49 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include "../plugins/sync/trace.h"
+
+/**
+ * Start writing sampled record traces to a Chrome trace / Perfetto JSON file
+ * @param path Output file path
+ * @param sample_every Trace one record out of this many
+ * @return NULL on success, error message on failure
+ */
+const char* tracer_open(const char* path, int sample_every);
+
+/**
+ * Decide whether the next input record is traced
+ * Only called from the input thread, so sampling itself needs no locking.
+ * @return Trace id for a sampled record, 0 otherwise (also when tracing is off)
+ */
+unsigned long long tracer_sample(void);
+
+/**
+ * Label the track of one stage in the trace viewer
+ * @param stage Index of the stage in the pipeline
+ * @param name Stage name
+ */
+void tracer_name_stage(int stage, const char* name);
+
+/**
+ * Record one span of a sampled record (matches trace_span_fn)
+ * Runs on plugin threads: the span is only copied into a buffer that a writer
+ * thread flushes periodically. Spans arriving while the buffer is full are dropped.
+ * Queue spans overlap between records, so they are written as async events;
+ * process spans never overlap on a stage's consumer thread and are complete events.
+ * @param stage Index of the stage in the pipeline
+ * @param kind What the record was doing during the span
+ * @param trace_id Trace id of the sampled record
+ * @param start_ns Span start, from trace_now_ns
+ * @param end_ns Span end, from trace_now_ns
+ */
+void tracer_span(int stage, trace_span_kind_t kind, unsigned long long trace_id,
+                 long long start_ns, long long end_ns);
+
+/**
+ * Flush the remaining spans, finish the JSON document and close the trace file
+ * Every stage must be drained first. Safe to call when tracing was never started.
+ */
+void tracer_close(void);
+
+#endif
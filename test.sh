@@ -142,6 +142,644 @@ timeout 10s bash -c 'echo -e "hi\n<END>" | ./output/analyzer 5 typewriter >/dev/
     exit 1
 }
 
+print_status "Test 13: Queue autosize keeps every line"
+LINE_COUNT=$( (seq 1 2000; echo "<END>") | ./output/analyzer --autosize 1:64 --autosize-interval 5 2 uppercaser rotator logger 2>/dev/null | grep -c "\[logger\]")
+
+if [ "$LINE_COUNT" -eq 2000 ]; then
+    print_status "Test 13 PASSED"
+else
+    print_error "Test 13 FAILED: Expected 2000 lines, got $LINE_COUNT"
+    exit 1
+fi
+
+print_status "Test 14: Error handling - invalid autosize bounds"
+./output/analyzer --autosize 8:2 10 logger 2>/dev/null && {
+    print_error "Test 14 FAILED: Should have failed with invalid autosize bounds"
+    exit 1
+} || {
+    print_status "Test 14 PASSED: Correctly failed with invalid autosize bounds"
+}
+
+print_status "Test 15: Checkpoint records the committed input offset"
+CHECKPOINT_INPUT=$(mktemp)
+CHECKPOINT_FILE=$(mktemp -u)
+seq 1 500 > "$CHECKPOINT_INPUT"
+./output/analyzer --checkpoint "$CHECKPOINT_FILE" 10 uppercaser logger < "$CHECKPOINT_INPUT" >/dev/null 2>&1
+EXPECTED=$(stat -c %s "$CHECKPOINT_INPUT")
+ACTUAL=$(cat "$CHECKPOINT_FILE" 2>/dev/null)
+
+if [ "$ACTUAL" == "$EXPECTED" ]; then
+    print_status "Test 15 PASSED"
+else
+    print_error "Test 15 FAILED: Expected offset '$EXPECTED', got '$ACTUAL'"
+    exit 1
+fi
+
+print_status "Test 16: Resume from checkpoint"
+# Offset of line 401: 9 one-digit + 90 two-digit + 300 three-digit lines
+echo 1492 > "$CHECKPOINT_FILE"
+OUTPUT=$(./output/analyzer --checkpoint "$CHECKPOINT_FILE" --resume 10 logger < "$CHECKPOINT_INPUT" 2>/dev/null | grep "\[logger\]")
+FIRST=$(echo "$OUTPUT" | head -1)
+LINE_COUNT=$(echo "$OUTPUT" | wc -l)
+rm -f "$CHECKPOINT_INPUT" "$CHECKPOINT_FILE"
+
+if [ "$FIRST" == "[logger] 401" ] && [ "$LINE_COUNT" -eq 100 ]; then
+    print_status "Test 16 PASSED"
+else
+    print_error "Test 16 FAILED: Expected 100 lines from '[logger] 401', got $LINE_COUNT from '$FIRST'"
+    exit 1
+fi
+
+print_status "Test 17: Framed input with embedded newline"
+EXPECTED="[logger] TWO"
+ACTUAL=$(printf 'D\x05\x00\x00\x00helloD\x09\x00\x00\x00two\nlinesE\x00\x00\x00\x00' | ./output/analyzer --framed-input 10 uppercaser logger 2>/dev/null | grep "\[logger\]" | tail -1)
+
+if [ "$ACTUAL" == "$EXPECTED" ]; then
+    print_status "Test 17 PASSED"
+else
+    print_error "Test 17 FAILED: Expected '$EXPECTED', got '$ACTUAL'"
+    exit 1
+fi
+
+print_status "Test 18: Framed output round trip with checksums"
+EXPECTED="[logger] HELLO"
+ACTUAL=$(echo -e "olleh\n<END>" | ./output/analyzer --framed-output --frame-checksum 1 10 flipper 2>/dev/null | ./output/analyzer --framed-input 10 uppercaser logger 2>/dev/null | grep "\[logger\]" | head -1)
+
+if [ "$ACTUAL" == "$EXPECTED" ]; then
+    print_status "Test 18 PASSED"
+else
+    print_error "Test 18 FAILED: Expected '$EXPECTED', got '$ACTUAL'"
+    exit 1
+fi
+
+print_status "Test 19: Error handling - framed checksum mismatch"
+printf 'D\x02\x00\x00\x00hiC\x08\x00\x00\x00\x01\x00\x00\x00\x00\x00\x00\x00E\x00\x00\x00\x00' | ./output/analyzer --framed-input 10 logger >/dev/null 2>&1 && {
+    print_error "Test 19 FAILED: Should have failed with a checksum mismatch"
+    exit 1
+} || {
+    print_status "Test 19 PASSED: Correctly failed with a checksum mismatch"
+}
+
+print_status "Test 20: Gzip input is detected and decoded"
+EXPECTED="[logger] HELLO"
+ACTUAL=$(echo -e "hello\n<END>" | gzip -c | ./output/analyzer 10 uppercaser logger 2>/dev/null | grep "\[logger\]" | head -1)
+
+if [ "$ACTUAL" == "$EXPECTED" ]; then
+    print_status "Test 20 PASSED"
+else
+    print_error "Test 20 FAILED: Expected '$EXPECTED', got '$ACTUAL'"
+    exit 1
+fi
+
+print_status "Test 21: Block-compressed output round trip"
+COMPRESS_DIR=$(mktemp -d)
+seq 1 100000 > "$COMPRESS_DIR/input.txt"
+./output/analyzer --output "$COMPRESS_DIR/out.gz" --compress-threads 2 10 uppercaser < "$COMPRESS_DIR/input.txt" >/dev/null 2>&1
+./output/analyzer --output "$COMPRESS_DIR/back.txt" 10 uppercaser < "$COMPRESS_DIR/out.gz" >/dev/null 2>&1
+
+if zcat "$COMPRESS_DIR/out.gz" | cmp -s - "$COMPRESS_DIR/input.txt" && cmp -s "$COMPRESS_DIR/back.txt" "$COMPRESS_DIR/input.txt"; then
+    print_status "Test 21 PASSED"
+else
+    print_error "Test 21 FAILED: Compressed output does not match the input"
+    rm -rf "$COMPRESS_DIR"
+    exit 1
+fi
+
+print_status "Test 22: Zstd output round trip"
+if ./output/analyzer --output "$COMPRESS_DIR/out.zst" 10 flipper < "$COMPRESS_DIR/input.txt" >/dev/null 2>&1; then
+    ./output/analyzer --output "$COMPRESS_DIR/back.txt" 10 flipper < "$COMPRESS_DIR/out.zst" >/dev/null 2>&1
+    if cmp -s "$COMPRESS_DIR/back.txt" "$COMPRESS_DIR/input.txt"; then
+        print_status "Test 22 PASSED"
+    else
+        print_error "Test 22 FAILED: Zstd round trip does not match the input"
+        rm -rf "$COMPRESS_DIR"
+        exit 1
+    fi
+else
+    print_warning "Test 22 SKIPPED: libzstd.so.1 not available"
+fi
+rm -rf "$COMPRESS_DIR"
+
+print_status "Test 23: Sampled tracing writes one process span per sampled line and stage"
+TRACE_FILE=$(mktemp)
+seq 1 100 | ./output/analyzer --trace "$TRACE_FILE" --trace-sample 10 10 uppercaser logger >/dev/null 2>&1
+ACTUAL=$(grep -c '"ph":"X","name":"process"' "$TRACE_FILE")
+LAST_LINE=$(tail -1 "$TRACE_FILE")
+rm -f "$TRACE_FILE"
+
+if [ "$ACTUAL" -eq 20 ] && [ "$LAST_LINE" == '],"displayTimeUnit":"ms"}' ]; then
+    print_status "Test 23 PASSED"
+else
+    print_error "Test 23 FAILED: Expected 20 process spans in a closed trace, got $ACTUAL"
+    exit 1
+fi
+
+print_status "Test 24: Deadline shutdown drops what the slow stage cannot finish"
+START=$(date +%s%N)
+ACTUAL=$(printf 'aaaaaaaaaa\nbbbbbbbbbb\ncccccccccc\ndddddddddd\n' | ./output/analyzer --shutdown deadline:300 10 typewriter logger 2>&1 >/dev/null | grep -o "[0-9]* lines dropped")
+ELAPSED_MS=$(( ($(date +%s%N) - START) / 1000000 ))
+
+# The line already being typed (1s) still completes, the other three are dropped
+if [ "$ACTUAL" == "4 lines dropped" ] && [ "$ELAPSED_MS" -lt 3000 ]; then
+    print_status "Test 24 PASSED"
+else
+    print_error "Test 24 FAILED: Expected '4 lines dropped' within 3s, got '$ACTUAL' after ${ELAPSED_MS}ms"
+    exit 1
+fi
+
+print_status "Test 25: Abort shutdown reports every queued line"
+ACTUAL=$(printf 'one\ntwo\nthree\n' | ./output/analyzer --shutdown abort 10 typewriter logger 2>&1 | grep -o "[0-9]* lines dropped")
+
+if [ "$ACTUAL" == "3 lines dropped" ]; then
+    print_status "Test 25 PASSED"
+else
+    print_error "Test 25 FAILED: Expected '3 lines dropped', got '$ACTUAL'"
+    exit 1
+fi
+
+print_status "Test 26: Result cache keeps the output and serves repeated lines"
+CACHE_INPUT=$(mktemp)
+for i in $(seq 1 50); do echo "heartbeat ok"; echo "line $i"; done > "$CACHE_INPUT"
+EXPECTED=$(./output/analyzer 10 uppercaser flipper logger < "$CACHE_INPUT" 2>/dev/null)
+ACTUAL=$(./output/analyzer --cache 64 10 uppercaser flipper logger < "$CACHE_INPUT" 2>/dev/null)
+HITS=$(./output/analyzer --cache 64 10 uppercaser flipper logger < "$CACHE_INPUT" 2>&1 >/dev/null | grep -c "Cache .*: 100 lookups, 49.0% hits")
+rm -f "$CACHE_INPUT"
+
+if [ "$ACTUAL" == "$EXPECTED" ] && [ "$HITS" -eq 2 ]; then
+    print_status "Test 26 PASSED"
+else
+    print_error "Test 26 FAILED: Cached output differs or hit rate not reported for both stateless stages"
+    exit 1
+fi
+
+print_status "Test 27: Batch transforms match the per-line results"
+BATCH_INPUT=$(mktemp)
+seq 1 2000 | sed 's/$/ quick brown fox/' > "$BATCH_INPUT"
+EXPECTED=$(tr 'a-z' 'A-Z' < "$BATCH_INPUT" | rev | sed 's/^/[logger] /')
+ACTUAL=$(./output/analyzer 64 uppercaser flipper logger < "$BATCH_INPUT" 2>/dev/null | grep "\[logger\]")
+rm -f "$BATCH_INPUT"
+
+if [ "$ACTUAL" == "$EXPECTED" ]; then
+    print_status "Test 27 PASSED"
+else
+    print_error "Test 27 FAILED: Batched uppercaser/flipper output differs from tr/rev"
+    exit 1
+fi
+
+print_status "Test 28: Reloading stages mid-stream loses and reorders no lines"
+RELOAD_INPUT=$(mktemp)
+RELOAD_OUTPUT=$(mktemp)
+RELOAD_SOCKET=$(mktemp -u)
+seq 1 40000 | sed 's/$/ quick brown fox/' > "$RELOAD_INPUT"
+{ head -n 20000 "$RELOAD_INPUT"; sleep 1; tail -n +20001 "$RELOAD_INPUT"; } | \
+    ./output/analyzer --control "$RELOAD_SOCKET" --output "$RELOAD_OUTPUT" 16 uppercaser flipper > /dev/null 2>&1 &
+RELOAD_PID=$!
+for i in $(seq 1 50); do [ -S "$RELOAD_SOCKET" ] && break; sleep 0.02; done
+RELOADED=0
+for target in flipper 0 1; do
+    ./output/analyzer --send "$RELOAD_SOCKET" reload $target > /dev/null && RELOADED=$((RELOADED + 1))
+done
+wait $RELOAD_PID
+EXPECTED=$(tr 'a-z' 'A-Z' < "$RELOAD_INPUT" | rev)
+ACTUAL=$(cat "$RELOAD_OUTPUT")
+rm -f "$RELOAD_INPUT" "$RELOAD_OUTPUT"
+
+if [ "$RELOADED" -eq 3 ] && [ "$ACTUAL" == "$EXPECTED" ]; then
+    print_status "Test 28 PASSED"
+else
+    print_error "Test 28 FAILED: $RELOADED of 3 reloads succeeded, or output lost or reordered lines"
+    exit 1
+fi
+
+print_status "Test 29: Control socket reports metrics and pauses a stage"
+METRICS_SOCKET=$(mktemp -u)
+{ seq 1 100; sleep 1; echo late; sleep 1; } | \
+    ./output/analyzer --control "$METRICS_SOCKET" 10 uppercaser flipper logger > /dev/null 2>&1 &
+METRICS_PID=$!
+for i in $(seq 1 50); do [ -S "$METRICS_SOCKET" ] && break; sleep 0.02; done
+sleep 0.3
+./output/analyzer --send "$METRICS_SOCKET" pause flipper > /dev/null
+sleep 1
+METRICS=$(./output/analyzer --send "$METRICS_SOCKET" metrics)
+./output/analyzer --send "$METRICS_SOCKET" resume flipper > /dev/null
+wait $METRICS_PID
+
+if echo "$METRICS" | grep -q 'analyzer_lines_processed_total{stage="0",plugin="uppercaser"} 101' && \
+   echo "$METRICS" | grep -q 'analyzer_queue_depth{stage="1",plugin="flipper"} 1' && \
+   echo "$METRICS" | grep -q 'analyzer_stage_paused{stage="1",plugin="flipper"} 1' && \
+   echo "$METRICS" | grep -q 'analyzer_stage_latency_seconds{stage="2",plugin="logger",quantile="0.99"}'; then
+    print_status "Test 29 PASSED"
+else
+    print_error "Test 29 FAILED: Unexpected metrics while flipper was paused"
+    echo "$METRICS"
+    exit 1
+fi
+
+print_status "Test 30: Priority lanes deliver every line and count urgent ones separately"
+LANE_INPUT=$(mktemp)
+for i in $(seq 1 500); do
+    echo "web-$i INFO request $i"
+    if [ $((i % 25)) -eq 0 ]; then echo "web-$i ERROR disk full"; fi
+done > "$LANE_INPUT"
+EXPECTED=$(tr 'a-z' 'A-Z' < "$LANE_INPUT" | sort)
+LANE_OUTPUT=$(mktemp)
+LANE_REPORT=$(./output/analyzer --lane '4:#2=ERROR' --output "$LANE_OUTPUT" 8 uppercaser < "$LANE_INPUT" 2>&1 | \
+    grep -c "Lane 1 (#2=ERROR): 20 lines")
+ACTUAL=$(sort "$LANE_OUTPUT")
+rm -f "$LANE_INPUT" "$LANE_OUTPUT"
+
+if [ "$ACTUAL" == "$EXPECTED" ] && [ "$LANE_REPORT" -eq 1 ]; then
+    print_status "Test 30 PASSED"
+else
+    print_error "Test 30 FAILED: Lines lost across lanes or lane report missing"
+    exit 1
+fi
+
+print_status "Test 31: Offline mode matches the streaming pipeline"
+OFFLINE_INPUT=$(mktemp)
+for i in $(seq 1 2000); do echo "line $i of the offline batch"; done > "$OFFLINE_INPUT"
+STREAMED=$(./output/analyzer 16 uppercaser flipper expander rotator logger < "$OFFLINE_INPUT" 2>&1)
+OFFLINE=$(./output/analyzer --offline --offline-threads 3 16 uppercaser flipper expander rotator logger < "$OFFLINE_INPUT" 2>&1)
+rm -f "$OFFLINE_INPUT"
+
+if [ "$OFFLINE" == "$STREAMED" ] && [ "$(echo "$OFFLINE" | grep -c '^\[logger\]')" -eq 2000 ]; then
+    print_status "Test 31 PASSED"
+else
+    print_error "Test 31 FAILED: Offline output differs from the streaming pipeline"
+    exit 1
+fi
+
+print_status "Test 32: Rate limits hold ingest and a stage to their token rate"
+RATE_INPUT=$(mktemp)
+for i in $(seq 1 600); do echo "rate line $i"; done > "$RATE_INPUT"
+START_NS=$(date +%s%N)
+RATE_OUTPUT=$(./output/analyzer --rate-limit ingest:2000 --rate-limit logger:1000 16 uppercaser logger < "$RATE_INPUT" 2>&1)
+ELAPSED_MS=$(( ($(date +%s%N) - START_NS) / 1000000 ))
+rm -f "$RATE_INPUT"
+LOGGED=$(echo "$RATE_OUTPUT" | grep -c '^\[logger\] RATE LINE')
+
+# 600 lines at 1000/s, less the 100 line burst, take at least 500 ms
+if [ "$LOGGED" -eq 600 ] && [ "$ELAPSED_MS" -ge 450 ] && [ "$ELAPSED_MS" -lt 2000 ] && \
+   echo "$RATE_OUTPUT" | grep -q "Rate limit of plugin logger: throttled" && \
+   echo "$RATE_OUTPUT" | grep -q "Rate limit at ingest: throttled"; then
+    print_status "Test 32 PASSED"
+else
+    print_error "Test 32 FAILED: $LOGGED lines in $ELAPSED_MS ms"
+    exit 1
+fi
+
+print_status "Test 33: Huge page queues report their backing and keep the output unchanged"
+HUGE_INPUT=$(mktemp)
+HUGE_OUTPUT=$(mktemp)
+for i in $(seq 1 2000); do echo "huge line $i"; done > "$HUGE_INPUT"
+# 40000 slots make each ring a few MB; the backing depends on the kernel, the output must not
+HUGE_REPORT=$(./output/analyzer --huge-pages explicit --output "$HUGE_OUTPUT" 40000 uppercaser flipper < "$HUGE_INPUT" 2>&1)
+EXPECTED=$(tr 'a-z' 'A-Z' < "$HUGE_INPUT" | rev)
+ACTUAL=$(cat "$HUGE_OUTPUT")
+rm -f "$HUGE_INPUT" "$HUGE_OUTPUT"
+
+if [ "$ACTUAL" == "$EXPECTED" ] &&    [ "$(echo "$HUGE_REPORT" | grep -cE '^Queue of plugin (uppercaser|flipper): (explicit huge pages|transparent huge pages|heap) \([0-9]+ KB\)$')" -eq 2 ]; then
+    print_status "Test 33 PASSED"
+else
+    print_error "Test 33 FAILED: Output changed or backing report missing"
+    echo "$HUGE_REPORT"
+    exit 1
+fi
+
+print_status "Test 34: grep drops lines early, streaming and offline alike"
+GREP_INPUT=$(mktemp)
+GREP_OUTPUT=$(mktemp)
+for i in $(seq 1 3000); do
+    if [ $((i % 100)) -eq 0 ]; then echo "alert $i disk full"; elif [ $((i % 250)) -eq 0 ]; then echo "fatal $i"; else echo "info $i ok"; fi
+done > "$GREP_INPUT"
+EXPECTED=$(grep -E 'alert|^fatal' "$GREP_INPUT" | tr 'a-z' 'A-Z' | rev)
+./output/analyzer --set grep:pattern=alert --set 0:regex='^fatal' --output "$GREP_OUTPUT" 64 grep uppercaser flipper < "$GREP_INPUT" > /dev/null
+STREAMED=$(cat "$GREP_OUTPUT")
+./output/analyzer --offline --set grep:pattern=alert --set 0:regex='^fatal' --output "$GREP_OUTPUT" 64 grep uppercaser flipper < "$GREP_INPUT" > /dev/null
+OFFLINE=$(cat "$GREP_OUTPUT")
+INVERTED=$(./output/analyzer --set grep:pattern=ok --set grep:invert=1 8 grep logger < "$GREP_INPUT" | grep -c '^\[logger\]')
+rm -f "$GREP_INPUT" "$GREP_OUTPUT"
+
+if [ "$STREAMED" == "$EXPECTED" ] && [ "$OFFLINE" == "$EXPECTED" ] && [ "$INVERTED" -eq 36 ]; then
+    print_status "Test 34 PASSED"
+else
+    print_error "Test 34 FAILED: Filtered output differs from grep"
+    exit 1
+fi
+
+print_status "Test 35: aggregator summarizes tumbling and sliding windows"
+AGG_INPUT=$(mktemp)
+for i in $(seq 1 26); do
+    case $((i % 6)) in 0|1|2) key=a;; 3|4) key=b;; *) key=c;; esac
+    echo "$key request $i"
+done > "$AGG_INPUT"
+TUMBLING=$(./output/analyzer --set aggregator:key=1 --set aggregator:window=10 --set aggregator:top=2 8 aggregator logger < "$AGG_INPUT" | grep '^\[logger\]')
+SLIDING=$(./output/analyzer --set aggregator:key=1 --set aggregator:window=10 --set aggregator:slide=5 --set aggregator:top=1 8 aggregator logger < "$AGG_INPUT" | grep '^\[logger\]' | tail -2)
+OFFLINE_STATUS=0
+./output/analyzer --offline 8 aggregator logger < "$AGG_INPUT" > /dev/null 2>&1 || OFFLINE_STATUS=$?
+rm -f "$AGG_INPUT"
+
+# The last window holds the 6 lines left when the input ends
+EXPECTED_TUMBLING="[logger] window=0 lines=10 distinct=3 top=a:5,b:4
+[logger] window=1 lines=10 distinct=3 top=a:6,c:2
+[logger] window=2 lines=6 distinct=3 top=a:3,b:2"
+EXPECTED_SLIDING="[logger] window=4 lines=10 distinct=3 top=a:5
+[logger] window=5 lines=6 distinct=3 top=a:3"
+if [ "$TUMBLING" == "$EXPECTED_TUMBLING" ] && [ "$SLIDING" == "$EXPECTED_SLIDING" ] && [ "$OFFLINE_STATUS" -ne 0 ]; then
+    print_status "Test 35 PASSED"
+else
+    print_error "Test 35 FAILED: Window summaries differ: $TUMBLING / $SLIDING"
+    exit 1
+fi
+
+print_status "Test 36: A slow stage spills to disk without losing or reordering lines"
+SPILL_DIR=$(mktemp -d)
+SPILL_INPUT=$(mktemp)
+SPILL_OUTPUT=$(mktemp)
+seq 1 3000 | sed 's/^/spill line /' > "$SPILL_INPUT"
+SPILL_LOG=$(./output/analyzer --spill "$SPILL_DIR" --rate-limit 1:20000 --output "$SPILL_OUTPUT" 8 uppercaser flipper < "$SPILL_INPUT" 2>&1)
+EXPECTED=$(tr 'a-z' 'A-Z' < "$SPILL_INPUT" | rev)
+SPILLED=$(cat "$SPILL_OUTPUT")
+LEFT=$(ls -A "$SPILL_DIR" | wc -l)
+rm -rf "$SPILL_DIR" "$SPILL_INPUT" "$SPILL_OUTPUT"
+
+# Only 8 lines fit ahead of the throttled flipper, so most of them must have gone to disk
+if [ "$SPILLED" == "$EXPECTED" ] && echo "$SPILL_LOG" | grep -qE "Queue of plugin flipper: spilled [0-9]{4} lines" && [ "$LEFT" -eq 0 ]; then
+    print_status "Test 36 PASSED"
+else
+    print_error "Test 36 FAILED: Spilled output differs or spill files were left: $SPILL_LOG"
+    exit 1
+fi
+
+print_status "Test 37: Ordered and unordered multi-file input, gzip included"
+INPUT_DIR=$(mktemp -d)
+INPUT_OUTPUT=$(mktemp)
+seq 1 20000 | sed 's/^/first /' > "$INPUT_DIR/part-1.log"
+seq 1 30000 | sed 's/^/second /' | gzip > "$INPUT_DIR/part-2.log.gz"
+seq 1 5000 | sed 's/^/third /' > "$INPUT_DIR/part-3.log"
+EXPECTED=$(cat "$INPUT_DIR/part-1.log"; gunzip -c "$INPUT_DIR/part-2.log.gz"; cat "$INPUT_DIR/part-3.log")
+ORDERED_LOG=$(./output/analyzer --input "$INPUT_DIR/part-*" --input-threads 3 --output "$INPUT_OUTPUT" 64 uppercaser < /dev/null 2>&1)
+ORDERED=$(cat "$INPUT_OUTPUT")
+./output/analyzer --input "$INPUT_DIR/part-1.log" --input "$INPUT_DIR/part-[23]*" --input-order unordered \
+    --output "$INPUT_OUTPUT" 64 uppercaser < /dev/null > /dev/null 2>&1
+UNORDERED=$(sort "$INPUT_OUTPUT")
+rm -rf "$INPUT_DIR" "$INPUT_OUTPUT"
+
+if [ "$ORDERED" == "$(echo "$EXPECTED" | tr 'a-z' 'A-Z')" ] && \
+   [ "$UNORDERED" == "$(echo "$EXPECTED" | tr 'a-z' 'A-Z' | sort)" ] && \
+   echo "$ORDERED_LOG" | grep -q "part-2.log.gz: 30000 lines"; then
+    print_status "Test 37 PASSED"
+else
+    print_error "Test 37 FAILED: Multi-file input lost or reordered lines: $ORDERED_LOG"
+    exit 1
+fi
+
+print_status "Test 38: typewriter types whole lines in turn, or several at once, without reordering them"
+START=$(date +%s%N)
+ACTUAL=$(seq 10 17 | ./output/analyzer --set typewriter:lines=8 --set typewriter:delay-ms=200 16 typewriter logger 2>/dev/null | grep "^\[logger\]" | tr '\n' ' ')
+ELAPSED_MS=$(( ($(date +%s%N) - START) / 1000000 ))
+# By default the held lines are typed one after another, each whole on its own line
+TYPED=$(seq 10 17 | ./output/analyzer --set typewriter:delay-ms=20 16 typewriter 2>/dev/null | grep "^\[typewriter\]" | tr '\n' ' ')
+
+# 8 lines of 2 characters take 400 ms each: 3.2 s one at a time, well under 2 s together
+if [ "$ACTUAL" == "$(seq 10 17 | sed 's/^/[logger] /' | tr '\n' ' ')" ] && [ "$ELAPSED_MS" -lt 2000 ] && \
+   [ "$TYPED" == "$(seq 10 17 | sed 's/^/[typewriter] /' | tr '\n' ' ')" ]; then
+    print_status "Test 38 PASSED"
+else
+    print_error "Test 38 FAILED: Expected 8 ordered lines within 2s, got '$ACTUAL' after ${ELAPSED_MS}ms, typed '$TYPED'"
+    exit 1
+fi
+
+print_status "Test 39: Per-stage workers and autotune keep the output in order"
+TUNE_DIR=$(mktemp -d)
+seq 1 20000 | sed 's/^/record /' > "$TUNE_DIR/in.txt"
+tr 'a-z' 'A-Z' < "$TUNE_DIR/in.txt" | rev > "$TUNE_DIR/expected.txt"
+./output/analyzer --workers 0:4 --workers flipper:3 --batch 0:1 --batch flipper:5 --output "$TUNE_DIR/workers.txt" \
+    16 uppercaser flipper < "$TUNE_DIR/in.txt" > /dev/null 2>&1
+./output/analyzer --autotune 5000 --output "$TUNE_DIR/tuned.txt" 16 uppercaser flipper \
+    < "$TUNE_DIR/in.txt" > /dev/null 2> "$TUNE_DIR/report.txt"
+REJECTED=$(./output/analyzer --workers logger:2 16 uppercaser logger < /dev/null 2>&1 | grep -c "not stateless")
+
+if cmp -s "$TUNE_DIR/workers.txt" "$TUNE_DIR/expected.txt" && cmp -s "$TUNE_DIR/tuned.txt" "$TUNE_DIR/expected.txt" && \
+   grep -q "^Autotune sample: 5000 lines" "$TUNE_DIR/report.txt" && \
+   grep -q "^Autotuned options: --capacity 0:[0-9]* --capacity 1:[0-9]* --batch 0:" "$TUNE_DIR/report.txt" && \
+   [ "$REJECTED" -eq 1 ]; then
+    print_status "Test 39 PASSED"
+    rm -rf "$TUNE_DIR"
+else
+    print_error "Test 39 FAILED: Output or report differs in $TUNE_DIR"
+    cat "$TUNE_DIR/report.txt"
+    exit 1
+fi
+
+print_status "Test 40: Line transforms reuse their output buffers"
+SCRATCH_SOCKET=$(mktemp -u)
+SCRATCH_DIR=$(mktemp -d)
+seq 1 50000 | sed 's/^/entry /' > "$SCRATCH_DIR/in.txt"
+{ cat "$SCRATCH_DIR/in.txt"; sleep 1; } | ./output/analyzer --control "$SCRATCH_SOCKET" --output "$SCRATCH_DIR/streamed.txt" \
+    64 rotator uppercaser expander flipper > /dev/null 2>&1 &
+SCRATCH_PID=$!
+for i in $(seq 1 50); do [ -S "$SCRATCH_SOCKET" ] && break; sleep 0.02; done
+sleep 0.6
+METRICS=$(./output/analyzer --send "$SCRATCH_SOCKET" metrics)
+wait $SCRATCH_PID
+./output/analyzer --offline --output "$SCRATCH_DIR/offline.txt" 64 rotator uppercaser expander flipper \
+    < "$SCRATCH_DIR/in.txt" > /dev/null 2>&1
+# 50000 lines through four per-line stages: a handful of buffer growths at most
+ALLOCATIONS=$(echo "$METRICS" | grep '^analyzer_stage_buffer_allocations_total' | awk '{ sum += $2 } END { print sum + 0 }')
+
+if echo "$METRICS" | grep -q 'analyzer_lines_processed_total{stage="3",plugin="flipper"} 50000' && \
+   [ "$ALLOCATIONS" -le 8 ] && cmp -s "$SCRATCH_DIR/streamed.txt" "$SCRATCH_DIR/offline.txt" && \
+   [ "$(head -1 "$SCRATCH_DIR/streamed.txt")" == "  Y R T N E 1" ]; then
+    print_status "Test 40 PASSED"
+    rm -rf "$SCRATCH_DIR"
+else
+    print_error "Test 40 FAILED: $ALLOCATIONS buffer allocations, or output differs in $SCRATCH_DIR"
+    exit 1
+fi
+
+print_status "Test 41: Output sinks write several formats and keep slow readers within their policy"
+SINK_DIR=$(mktemp -d)
+seq 1 20000 | sed 's/^/row /' > "$SINK_DIR/in.txt"
+tr 'a-z' 'A-Z' < "$SINK_DIR/in.txt" > "$SINK_DIR/expected.txt"
+./output/analyzer --sink "$SINK_DIR/raw.txt" --sink "$SINK_DIR/lines.jsonl,format=json" \
+    --sink "$SINK_DIR/frames.bin,format=framed" --sink "$SINK_DIR/rotated.log,rotate=64k,keep=2" \
+    64 uppercaser < "$SINK_DIR/in.txt" > /dev/null 2>&1
+./output/analyzer --framed-input --sink "$SINK_DIR/decoded.txt" 64 logger < "$SINK_DIR/frames.bin" > /dev/null 2>&1
+# A reader that shows up late: the drop sink keeps its buffer only, the spill sink everything, in order
+mkfifo "$SINK_DIR/late-drop" "$SINK_DIR/late-spill"
+( sleep 1; cat "$SINK_DIR/late-drop" > "$SINK_DIR/dropped.txt" ) &
+DROP_READER=$!
+( sleep 1; cat "$SINK_DIR/late-spill" > "$SINK_DIR/spilled.txt" ) &
+SPILL_READER=$!
+./output/analyzer --sink "$SINK_DIR/late-drop,policy=drop,buffer=16" --sink "$SINK_DIR/late-spill,policy=spill,buffer=16" \
+    64 uppercaser < "$SINK_DIR/in.txt" > /dev/null 2> "$SINK_DIR/report.txt"
+wait $DROP_READER $SPILL_READER
+STDOUT_SINK=$(echo "stdout sink" | ./output/analyzer --sink - 8 uppercaser 2> /dev/null)
+
+if cmp -s "$SINK_DIR/raw.txt" "$SINK_DIR/expected.txt" && cmp -s "$SINK_DIR/decoded.txt" "$SINK_DIR/expected.txt" && \
+   [ "$(wc -l < "$SINK_DIR/lines.jsonl")" -eq 20000 ] && \
+   [ "$(tail -1 "$SINK_DIR/lines.jsonl")" == '{"seq":20000,"line":"ROW 20000"}' ] && \
+   [ -s "$SINK_DIR/rotated.log.2" ] && [ ! -e "$SINK_DIR/rotated.log.3" ] && \
+   [ "$(stat -c %s "$SINK_DIR/rotated.log.1")" -lt 66000 ] && \
+   [ "$(wc -l < "$SINK_DIR/dropped.txt")" -eq 16 ] && \
+   grep -q "late-drop (raw, drop): 16 lines written, 19984 dropped" "$SINK_DIR/report.txt" && \
+   cmp -s "$SINK_DIR/spilled.txt" "$SINK_DIR/expected.txt" && ! ls "$SINK_DIR" | grep -q "sink-1\." && \
+   [ "$STDOUT_SINK" == "STDOUT SINK" ]; then
+    print_status "Test 41 PASSED"
+    rm -rf "$SINK_DIR"
+else
+    print_error "Test 41 FAILED: Sink output differs in $SINK_DIR"
+    cat "$SINK_DIR/report.txt"
+    exit 1
+fi
+
+print_status "Test 42: A checkpoint written before a crash never runs ahead of the output and the sinks"
+CRASH_DIR=$(mktemp -d)
+seq 1 1000000 | sed 's/^/line /' > "$CRASH_DIR/in.txt"
+CRASH_OK=1
+# A short interval keeps the checkpoint close behind the last stage, where buffered output used to be missed
+for DELAY in 0.2 0.4 0.6; do
+    rm -f "$CRASH_DIR/out.gz" "$CRASH_DIR/sink.txt" "$CRASH_DIR/ck"
+    ./output/analyzer --output "$CRASH_DIR/out.gz" --sink "$CRASH_DIR/sink.txt" \
+        --checkpoint "$CRASH_DIR/ck" --checkpoint-interval 1 64 uppercaser < "$CRASH_DIR/in.txt" > /dev/null 2>&1 &
+    CRASH_PID=$!
+    sleep $DELAY
+    kill -9 $CRASH_PID 2> /dev/null
+    wait $CRASH_PID 2> /dev/null || true
+    CRASH_COVERED=$(head -c "$(cat "$CRASH_DIR/ck" 2> /dev/null || echo 0)" "$CRASH_DIR/in.txt" | wc -l)
+    CRASH_OUTPUT=$(gzip -dc "$CRASH_DIR/out.gz" 2> /dev/null | wc -l)
+    CRASH_SINK=$(wc -l < "$CRASH_DIR/sink.txt")
+    echo "  killed after ${DELAY}s: checkpoint covers $CRASH_COVERED lines, output has $CRASH_OUTPUT, sink has $CRASH_SINK"
+    if [ "$CRASH_COVERED" -gt "$CRASH_OUTPUT" ] || [ "$CRASH_COVERED" -gt "$CRASH_SINK" ]; then
+        CRASH_OK=0
+    fi
+done
+
+if [ $CRASH_OK -eq 1 ]; then
+    print_status "Test 42 PASSED"
+    rm -rf "$CRASH_DIR"
+else
+    print_error "Test 42 FAILED: Checkpoint covers lines missing from the output in $CRASH_DIR"
+    exit 1
+fi
+
+print_status "Test 43: Control socket is up before input and survives clients that hang up or stall"
+if command -v python3 > /dev/null; then
+    CONTROL_DIR=$(mktemp -d)
+    CONTROL_START=$(date +%s%N)
+    { sleep 1; echo "after hangup"; } | \
+        ./output/analyzer --control "$CONTROL_DIR/sock" --output "$CONTROL_DIR/out.txt" 8 uppercaser > /dev/null 2>&1 &
+    CONTROL_PID=$!
+    for i in $(seq 1 25); do [ -S "$CONTROL_DIR/sock" ] && break; sleep 0.02; done
+    CONTROL_EARLY=0
+    [ -S "$CONTROL_DIR/sock" ] && CONTROL_EARLY=1
+    # Scrapes that hang up before the reply, then a client that never sends its command
+    python3 -c 'import socket, sys
+for _ in range(20):
+    s = socket.socket(socket.AF_UNIX); s.connect(sys.argv[1]); s.sendall(b"metrics\n"); s.close()' \
+        "$CONTROL_DIR/sock" 2> /dev/null || true
+    python3 -c 'import socket, sys, time
+s = socket.socket(socket.AF_UNIX); s.connect(sys.argv[1]); time.sleep(10)' "$CONTROL_DIR/sock" 2> /dev/null &
+    SILENT_PID=$!
+    CONTROL_STATUS=0
+    wait $CONTROL_PID || CONTROL_STATUS=$?
+    CONTROL_MS=$(( ($(date +%s%N) - CONTROL_START) / 1000000 ))
+    kill $SILENT_PID 2> /dev/null || true
+    wait $SILENT_PID 2> /dev/null || true
+
+    if [ $CONTROL_EARLY -eq 1 ] && [ $CONTROL_STATUS -eq 0 ] && [ $CONTROL_MS -lt 4000 ] && \
+       [ "$(cat "$CONTROL_DIR/out.txt")" == "AFTER HANGUP" ]; then
+        print_status "Test 43 PASSED"
+        rm -rf "$CONTROL_DIR"
+    else
+        print_error "Test 43 FAILED: socket early $CONTROL_EARLY, exit status $CONTROL_STATUS, run took $CONTROL_MS ms"
+        exit 1
+    fi
+else
+    print_warning "Test 43 SKIPPED: python3 not available"
+fi
+
+print_status "Test 44: Reloading a stage with several workers hands its queue to the new instance"
+HANDOFF_DIR=$(mktemp -d)
+seq 1 5000 | sed 's/^/line /' > "$HANDOFF_DIR/in.txt"
+./output/analyzer --control "$HANDOFF_DIR/sock" --workers 0:2 --rate-limit 0:2000 --output "$HANDOFF_DIR/out.txt" \
+    2000 uppercaser < "$HANDOFF_DIR/in.txt" > /dev/null 2>&1 &
+HANDOFF_PID=$!
+sleep 0.5
+HANDOFF_REPLY=$(./output/analyzer --send "$HANDOFF_DIR/sock" reload 0 flipper)
+wait $HANDOFF_PID
+# Each output line back to its input number, whether uppercaser or flipper wrote it
+HANDOFF_MISPLACED=$(awk '{ if ($0 ~ /^LINE /) { n = substr($0, 6) } else { r = ""; for (i = length($0); i > 0; i--) r = r substr($0, i, 1); n = substr(r, 6) }
+    if (n != NR) bad++ } END { print bad + NR - 5000 }' "$HANDOFF_DIR/out.txt")
+HANDOFF_PAUSE=$(echo "$HANDOFF_REPLY" | sed -n 's/.*paused \([0-9]*\)\..*/\1/p')
+# A reload under --autosize must not read the fresh queue's counters against the old ones
+{ seq 1 1500; sleep 3; } | ./output/analyzer --control "$HANDOFF_DIR/auto" --autosize 16:4096 --autosize-interval 1000 \
+    --rate-limit 0:5000 16 uppercaser > /dev/null 2>&1 &
+HANDOFF_PID=$!
+sleep 1.5
+./output/analyzer --send "$HANDOFF_DIR/auto" reload 0 > /dev/null
+sleep 1.1
+HANDOFF_CAPACITY=$(./output/analyzer --send "$HANDOFF_DIR/auto" metrics | \
+    sed -n 's/^analyzer_queue_capacity{stage="0",plugin="uppercaser"} //p')
+wait $HANDOFF_PID
+
+# Draining 2000 queued lines through the old instance at 2000 lines/s would pause for a second
+if [ "$HANDOFF_MISPLACED" -eq 0 ] && [ -n "$HANDOFF_PAUSE" ] && [ "$HANDOFF_PAUSE" -lt 500 ] && \
+   [ "$HANDOFF_CAPACITY" -le 32 ]; then
+    print_status "Test 44 PASSED"
+    rm -rf "$HANDOFF_DIR"
+else
+    print_error "Test 44 FAILED: $HANDOFF_MISPLACED lines lost or misplaced, reply '$HANDOFF_REPLY', capacity after reload $HANDOFF_CAPACITY"
+    exit 1
+fi
+
+print_status "Test 45: Reloading stage 0 while it is paused with a full queue"
+PAUSED_DIR=$(mktemp -d)
+mkfifo "$PAUSED_DIR/in"
+./output/analyzer --control "$PAUSED_DIR/sock" --output "$PAUSED_DIR/out.txt" 16 uppercaser \
+    < "$PAUSED_DIR/in" > /dev/null 2>&1 &
+PAUSED_PID=$!
+# Lines arrive only once stage 0 is paused, so the reader blocks on its full queue
+{ sleep 1; seq 1 20000 | sed 's/^/line /'; } > "$PAUSED_DIR/in" &
+PAUSED_WRITER=$!
+sleep 0.5
+./output/analyzer --send "$PAUSED_DIR/sock" pause 0 > /dev/null
+sleep 1.5
+PAUSED_REPLY=$(timeout 5 ./output/analyzer --send "$PAUSED_DIR/sock" reload 0 || true)
+# The control socket must still answer after the reload
+PAUSED_METRICS=$(timeout 5 ./output/analyzer --send "$PAUSED_DIR/sock" metrics | grep -c '^analyzer_stage_paused{stage="0".*} 1' || true)
+timeout 5 ./output/analyzer --send "$PAUSED_DIR/sock" resume 0 > /dev/null || true
+if [ -z "$PAUSED_REPLY" ]; then
+    kill -9 $PAUSED_PID $PAUSED_WRITER 2>/dev/null || true
+fi
+wait $PAUSED_PID || true
+wait $PAUSED_WRITER 2>/dev/null || true
+
+if echo "$PAUSED_REPLY" | grep -q "^OK stage 0" && [ "$PAUSED_METRICS" -eq 1 ] && \
+   [ "$(cat "$PAUSED_DIR/out.txt")" == "$(seq 1 20000 | sed 's/^/LINE /')" ]; then
+    print_status "Test 45 PASSED"
+    rm -rf "$PAUSED_DIR"
+else
+    print_error "Test 45 FAILED: reply '$PAUSED_REPLY', paused after reload: $PAUSED_METRICS, $(wc -l < "$PAUSED_DIR/out.txt") lines out"
+    exit 1
+fi
+
+print_status "Test 46: Framed input rejects a payload with a NUL byte"
+NUL_LOG=$(mktemp)
+printf 'D\x02\x00\x00\x00hiD\x03\x00\x00\x00a\x00bE\x00\x00\x00\x00' | \
+    ./output/analyzer --framed-input 10 uppercaser logger > "$NUL_LOG" 2>&1 && NUL_STATUS=0 || NUL_STATUS=$?
+
+# Records are C strings inside the pipeline: a NUL would silently cut the line short
+if [ "$NUL_STATUS" -ne 0 ] && grep -q "at offset 15: Frame payload contains a NUL byte" "$NUL_LOG" && \
+   grep -q "^\[logger\] HI$" "$NUL_LOG"; then
+    print_status "Test 46 PASSED"
+    rm -f "$NUL_LOG"
+else
+    print_error "Test 46 FAILED: exit $NUL_STATUS, output: $(cat "$NUL_LOG")"
+    exit 1
+fi
+
 print_status "========================================="
 print_status "All tests passed successfully!"
 print_status "========================================="
@@ -0,0 +1,7 @@
+#!/bin/bash
+set -e
+
+gcc -g tests/token_bucket_test.c plugins/sync/token_bucket.c -o tests/token_bucket_test
+./tests/token_bucket_test
+
+rm tests/token_bucket_test
@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../plugins/plugin_common.h"
+
+// Static counterpart of a perf c2c report for the queue and plugin context.
+// Every field is tagged with who writes it: a thread role, or the lock that
+// guards it (a lock and what it guards move between cores together). A cache
+// line holding fields of more than one writer, or a written field next to
+// read-mostly ones, bounces between cores: each such line is reported with its
+// fields, the way c2c lists contended lines, and the test fails on any. A
+// writer that stores into a field once, as the stage shuts down, is listed
+// after a '+' but does not count: one write never makes a line bounce.
+//
+// The second half is the dynamic side: a producer and consumer threads run the
+// hot path's stores and loads against the layout before the regrouping and the
+// current one, and ops/sec of both are printed. It only reports, as the gap
+// depends on the cores the threads land on and is zero on a single CPU.
+
+#define MAX_WRITERS 8
+#define BENCH_OPS 2000000
+#define BENCH_CONSUMERS 2
+#define BENCH_ROUNDS 3
+
+typedef struct {
+    const char* name;
+    size_t offset;
+    size_t size;
+    const char* writer; // "read-mostly", a thread role or a lock
+    const char* once; // Writer that stores once at shutdown, NULL for none
+} field_t;
+
+#define FIELD(type, field, writer) { #field, offsetof(type, field), sizeof(((type*)0)->field), writer, NULL }
+#define FIELD_ONCE(type, field, writer, once) { #field, offsetof(type, field), sizeof(((type*)0)->field), writer, once }
+
+static const field_t g_context_fields[] = {
+    FIELD(plugin_context_t, name, "read-mostly"),
+    FIELD(plugin_context_t, queue, "read-mostly"),
+    FIELD(plugin_context_t, next_place_work, "read-mostly"),
+    FIELD(plugin_context_t, next_place_record, "read-mostly"),
+    FIELD(plugin_context_t, process_function, "read-mostly"),
+    FIELD(plugin_context_t, trace_span, "read-mostly"),
+    FIELD(plugin_context_t, cache, "read-mostly"),
+    FIELD(plugin_context_t, limiter, "read-mostly"),
+    FIELD(plugin_context_t, timers, "read-mostly"),
+    FIELD(plugin_context_t, trace_stage, "read-mostly"),
+    FIELD(plugin_context_t, initialized, "read-mostly"),
+    FIELD(plugin_context_t, defer_limit, "read-mostly"),
+    FIELD(plugin_context_t, batch, "read-mostly"),
+    FIELD(plugin_context_t, workers, "read-mostly"),
+    FIELD(plugin_context_t, capacity, "read-mostly"),
+    FIELD(plugin_context_t, consumer_thread, "read-mostly"),
+    FIELD(plugin_context_t, extra_workers, "read-mostly"),
+    FIELD(plugin_context_t, placed, "producer"),
+    FIELD_ONCE(plugin_context_t, retired, "consumer", "abort"),
+    FIELD(plugin_context_t, processed, "consumer"),
+    FIELD(plugin_context_t, filtered, "consumer"),
+    FIELD(plugin_context_t, latency_sum_ns, "consumer"),
+    FIELD(plugin_context_t, service_ns, "consumer"),
+    FIELD(plugin_context_t, buffer_allocations, "consumer"),
+    FIELD_ONCE(plugin_context_t, deferred_dropped, "consumer", "abort"),
+    FIELD_ONCE(plugin_context_t, deferred, "consumer", "abort"),
+    FIELD(plugin_context_t, latency, "consumer"),
+    FIELD(plugin_context_t, take_mutex, "take_mutex"),
+    FIELD(plugin_context_t, next_ticket, "take_mutex"),
+    FIELD(plugin_context_t, next_mutex, "next_mutex"),
+    FIELD(plugin_context_t, turn, "next_mutex"),
+    FIELD(plugin_context_t, running, "next_mutex"),
+    FIELD(plugin_context_t, pause_count, "next_mutex"),
+    FIELD(plugin_context_t, forward_to, "next_mutex"),
+    FIELD(plugin_context_t, handed_off, "next_mutex"),
+    FIELD(plugin_context_t, paused, "next_mutex"),
+    FIELD(plugin_context_t, current_meta, "next_mutex"),
+    FIELD(plugin_context_t, resume_cond, "next_mutex"),
+    FIELD(plugin_context_t, finished, "exit"),
+    FIELD(plugin_context_t, done_monitor, "exit"),
+};
+
+static const field_t g_queue_fields[] = {
+    FIELD(consumer_producer_t, mutex, "mutex"),
+    FIELD(consumer_producer_t, size, "mutex"),
+    FIELD(consumer_producer_t, finished, "mutex"),
+    FIELD(consumer_producer_t, waiting_consumers, "mutex"),
+    FIELD(consumer_producer_t, waiting_producers, "mutex"),
+    FIELD(consumer_producer_t, puts, "mutex"),
+    FIELD(consumer_producer_t, gets, "mutex"),
+    FIELD(consumer_producer_t, full_waits, "mutex"),
+    FIELD(consumer_producer_t, dropped, "mutex"),
+    FIELD(consumer_producer_t, high_watermark, "mutex"),
+    FIELD(consumer_producer_t, capacity, "mutex"),
+    FIELD(consumer_producer_t, huge_pages, "mutex"),
+    FIELD(consumer_producer_t, spill_dir, "mutex"),
+    FIELD(consumer_producer_t, refill_cond, "mutex"),
+    FIELD(consumer_producer_t, lanes, "mutex"),
+    FIELD(consumer_producer_t, not_full_monitor, "not_full_monitor"),
+    FIELD(consumer_producer_t, not_empty_monitor, "not_empty_monitor"),
+    FIELD(consumer_producer_t, finished_monitor, "finished_monitor"),
+    FIELD(consumer_producer_t, spilled, "spill"),
+    FIELD(consumer_producer_t, spilled_total, "spill"),
+    FIELD(consumer_producer_t, spill_bytes, "spill"),
+};
+
+// Print every line with more than one writer; returns how many there are
+static int report_lines(const char* type, size_t type_size, const field_t* fields, int count) {
+    size_t lines = (type_size + CP_CACHE_LINE - 1) / CP_CACHE_LINE;
+    int contended = 0;
+    printf("%s: %zu bytes on %zu cache lines\n", type, type_size, lines);
+    for (size_t line = 0; line < lines; line++) {
+        size_t start = line * CP_CACHE_LINE;
+        size_t end = start + CP_CACHE_LINE;
+        const char* writers[MAX_WRITERS];
+        int num_writers = 0;
+        int written = 0;
+        for (int i = 0; i < count; i++) {
+            if (fields[i].offset >= end || fields[i].offset + fields[i].size <= start) continue;
+            int known = 0;
+            for (int w = 0; w < num_writers; w++) known |= strcmp(writers[w], fields[i].writer) == 0;
+            if (!known && num_writers < MAX_WRITERS) writers[num_writers++] = fields[i].writer;
+            written |= strcmp(fields[i].writer, "read-mostly") != 0;
+        }
+        if (num_writers < 2 || !written) continue;
+        contended++;
+        printf("  line %2zu (offset %4zu):", line, start);
+        for (int i = 0; i < count; i++) {
+            if (fields[i].offset >= end || fields[i].offset + fields[i].size <= start) continue;
+            if (fields[i].once) printf(" %s[%s+%s]", fields[i].name, fields[i].writer, fields[i].once);
+            else printf(" %s[%s]", fields[i].name, fields[i].writer);
+        }
+        printf("\n");
+    }
+    printf("  %d contended cache line(s)\n", contended);
+    return contended;
+}
+
+
+// plugin_context_t as laid out before the fields were grouped by writer
+typedef struct {
+    const char* name;
+    consumer_producer_t* queue;
+    pthread_t consumer_thread;
+    pthread_t extra_workers[PLUGIN_MAX_WORKERS - 1];
+    atomic_int workers;
+    int running;
+    pthread_mutex_t take_mutex;
+    unsigned long long next_ticket;
+    unsigned long long turn;
+    atomic_int batch;
+    const char* (*next_place_work)(const char*);
+    const char* (*next_place_record)(const char*, const record_meta_t*);
+    const char* (*process_function)(const char*);
+    trace_span_fn trace_span;
+    int trace_stage;
+    int initialized;
+    atomic_int finished;
+    monitor_t done_monitor;
+    stage_cache_t* cache;
+    token_bucket_t* limiter;
+    pthread_mutex_t next_mutex;
+    pthread_cond_t resume_cond;
+    int pause_count;
+    const char* (*forward_to)(const char*, const record_meta_t*);
+    atomic_ullong placed;
+    atomic_ullong retired;
+    atomic_ullong processed;
+    atomic_ullong filtered;
+    atomic_ullong latency_sum_ns;
+    atomic_ullong service_ns;
+    atomic_ullong buffer_allocations;
+    atomic_ullong latency[METRICS_LATENCY_BUCKETS];
+    atomic_int capacity;
+    atomic_int paused;
+    timer_wheel_t* timers;
+    const record_meta_t* current_meta;
+    atomic_uint deferred;
+    int defer_limit;
+    atomic_ullong deferred_dropped;
+} old_context_t;
+
+typedef struct {
+    void* context;
+    int ops;
+} bench_arg_t;
+
+static double now_sec(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// The upstream stage counts every line it places; the workers count every line
+// they retire, reading the configuration a batch needs on the way
+#define BENCH_ROLES(type)                                                                      \
+    static void* type##_producer(void* arg) {                                                  \
+        type* c = ((bench_arg_t*)arg)->context;                                                \
+        for (int i = 0; i < ((bench_arg_t*)arg)->ops; i++) {                                   \
+            atomic_fetch_add_explicit(&c->placed, 1, memory_order_relaxed);                    \
+        }                                                                                      \
+        return NULL;                                                                           \
+    }                                                                                          \
+    static void* type##_consumer(void* arg) {                                                  \
+        type* c = ((bench_arg_t*)arg)->context;                                                \
+        unsigned long long seen = 0;                                                           \
+        for (int i = 0; i < ((bench_arg_t*)arg)->ops; i++) {                                   \
+            seen += atomic_load_explicit(&c->batch, memory_order_relaxed);                     \
+            seen += *(void* volatile*)&c->process_function != NULL;                            \
+            seen += *(void* volatile*)&c->limiter != NULL;                                     \
+            atomic_fetch_add_explicit(&c->processed, 1, memory_order_relaxed);                 \
+            atomic_fetch_add_explicit(&c->latency_sum_ns, seen, memory_order_relaxed);         \
+            atomic_fetch_add_explicit(&c->latency[i % METRICS_LATENCY_BUCKETS], 1,             \
+                                      memory_order_relaxed);                                   \
+            atomic_fetch_add_explicit(&c->retired, 1, memory_order_relaxed);                   \
+        }                                                                                      \
+        return NULL;                                                                           \
+    }
+
+BENCH_ROLES(old_context_t)
+BENCH_ROLES(plugin_context_t)
+
+// Best ops/sec of a few rounds, counting every thread's operations
+static double bench_layout(size_t size, void* (*producer)(void*), void* (*consumer)(void*), int ops) {
+    double best = 0;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        void* context = aligned_alloc(CP_CACHE_LINE, (size + CP_CACHE_LINE - 1) / CP_CACHE_LINE * CP_CACHE_LINE);
+        if (!context) return 0;
+        memset(context, 0, size);
+        bench_arg_t arg = { context, ops };
+        pthread_t threads[BENCH_CONSUMERS + 1];
+        double start = now_sec();
+        pthread_create(&threads[0], NULL, producer, &arg);
+        for (int i = 1; i <= BENCH_CONSUMERS; i++) pthread_create(&threads[i], NULL, consumer, &arg);
+        for (int i = 0; i <= BENCH_CONSUMERS; i++) pthread_join(threads[i], NULL);
+        double rate = (double)ops * (BENCH_CONSUMERS + 1) / (now_sec() - start);
+        if (rate > best) best = rate;
+        free(context);
+    }
+    return best;
+}
+
+static void run_benchmark(void) {
+    const char* env = getenv("CACHE_LINE_BENCH_OPS");
+    int ops = env ? atoi(env) : BENCH_OPS;
+    if (ops <= 0) ops = BENCH_OPS;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    printf("=== Contention benchmark (1 producer, %d consumers, %d ops each, %ld CPU(s)) ===\n",
+           BENCH_CONSUMERS, ops, cpus);
+    double before = bench_layout(sizeof(old_context_t), old_context_t_producer, old_context_t_consumer, ops);
+    double after = bench_layout(sizeof(plugin_context_t), plugin_context_t_producer, plugin_context_t_consumer, ops);
+    printf("  ungrouped layout: %12.0f ops/s\n", before);
+    printf("  grouped layout:   %12.0f ops/s, %.2fx\n", after, before > 0 ? after / before : 0);
+    if (cpus < 2) printf("  one CPU: the threads never run on two cores at once, so no line bounces\n");
+}
+
+int main() {
+    printf("=== Cache line layout ===\n");
+    int contended = report_lines("plugin_context_t", sizeof(plugin_context_t), g_context_fields,
+                                 sizeof(g_context_fields) / sizeof(g_context_fields[0]));
+    contended += report_lines("consumer_producer_t", sizeof(consumer_producer_t), g_queue_fields,
+                              sizeof(g_queue_fields) / sizeof(g_queue_fields[0]));
+    if (contended > 0) {
+        fprintf(stderr, "cache line test failed: %d contended line(s)\n", contended);
+        return 1;
+    }
+    run_benchmark();
+    printf("All tests done\n");
+    return 0;
+}
@@ -0,0 +1,9 @@
+#!/bin/bash
+set -e
+
+# Optimized build: the second half times the old and current context layouts
+# CACHE_LINE_BENCH_OPS sets the operations per thread
+gcc -O2 -g tests/cache_line_test.c -lpthread -o tests/cache_line_test
+./tests/cache_line_test
+
+rm tests/cache_line_test
@@ -0,0 +1,7 @@
+#!/bin/bash
+set -e
+
+gcc -fsanitize=address -g tests/stage_cache_test.c plugins/sync/stage_cache.c -lpthread -o tests/stage_cache_test
+./tests/stage_cache_test
+
+rm tests/stage_cache_test
@@ -1,7 +1,7 @@
 #!/bin/bash
 set -e
 
-gcc tests/consumer_producer_test.c plugins/sync/consumer_producer.c plugins/sync/monitor.c -lpthread -o tests/consumer_producer_test
+gcc tests/consumer_producer_test.c plugins/sync/consumer_producer.c plugins/sync/monitor.c plugins/sync/huge_alloc.c plugins/sync/spill_file.c -lpthread -o tests/consumer_producer_test
 ./tests/consumer_producer_test
 
 rm tests/consumer_producer_test
\ No newline at end of file
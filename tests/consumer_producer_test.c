@@ -3,7 +3,10 @@
 #include <string.h>
 #include <pthread.h>
 #include <unistd.h>
+#include <signal.h>
+#include <sys/resource.h>
 #include "../plugins/sync/consumer_producer.h"
+#include "../plugins/sync/spill_file.h"
 
 #define CAPACITY 10
 #define NUM_PRODUCERS 3
@@ -41,6 +44,368 @@ void* consumer_thread(void* arg) {
     return NULL;
 }
 
+int test_resize() {
+    printf("=== consumer_producer resize Tests ===\n");
+    consumer_producer_t q;
+    if (consumer_producer_init(&q, 2) != NULL) return 1;
+
+    char item[16];
+    consumer_producer_put(&q, "Item 0");
+    consumer_producer_put(&q, "Item 1");
+    if (consumer_producer_resize(&q, 8) != NULL) return 1;
+    for (int i = 2; i < 8; i++) {
+        snprintf(item, sizeof(item), "Item %d", i);
+        consumer_producer_put(&q, item);
+    }
+
+    // Shrinking below the queued size must keep every item
+    consumer_producer_resize(&q, 1);
+    consumer_producer_stats_t stats;
+    consumer_producer_stats(&q, &stats, 0);
+    if (stats.capacity != 8 || stats.size != 8) {
+        printf("[R] Unexpected capacity %d size %d after shrink\n", stats.capacity, stats.size);
+        return 1;
+    }
+    for (int i = 0; i < 8; i++) {
+        char* out = consumer_producer_get(&q);
+        snprintf(item, sizeof(item), "Item %d", i);
+        if (!out || strcmp(out, item) != 0) {
+            printf("[R] Expected %s, got %s\n", item, out ? out : "NULL");
+            return 1;
+        }
+        free(out);
+    }
+    consumer_producer_resize(&q, 1);
+    consumer_producer_stats(&q, &stats, 0);
+    if (stats.capacity != 1 || stats.puts != 8 || stats.gets != 8) {
+        printf("[R] Unexpected stats after drain\n");
+        return 1;
+    }
+    consumer_producer_destroy(&q);
+    printf("[R] Resize keeps order and bounds\n");
+    return 0;
+}
+
+int test_lanes() {
+    printf("=== consumer_producer lane Tests ===\n");
+    consumer_producer_t q;
+    if (consumer_producer_init(&q, 4) != NULL) return 1;
+    int weights[2] = { 1, 3 };
+    if (consumer_producer_set_lane_weights(&q, weights, 2) != NULL) return 1;
+
+    char item[16];
+    record_meta_t meta;
+    memset(&meta, 0, sizeof(meta));
+    for (int i = 0; i < 4; i++) {
+        snprintf(item, sizeof(item), "B%d", i);
+        consumer_producer_put_meta(&q, item, &meta);
+    }
+    // Lane 0 is full; the urgent lane must still accept items without blocking
+    meta.lane = 1;
+    for (int i = 0; i < 4; i++) {
+        snprintf(item, sizeof(item), "U%d", i);
+        consumer_producer_put_meta(&q, item, &meta);
+    }
+
+    const char* expected[] = { "U0", "B0", "U1", "U2", "U3", "B1", "B2", "B3" };
+    char* items[8];
+    record_meta_t metas[8];
+    int count = consumer_producer_get_batch(&q, items, metas, 8);
+    if (count != 8) {
+        printf("[L] Expected 8 items, got %d\n", count);
+        return 1;
+    }
+    for (int i = 0; i < count; i++) {
+        int lane = items[i][0] == 'U' ? 1 : 0;
+        if (strcmp(items[i], expected[i]) != 0 || metas[i].lane != lane) {
+            printf("[L] Expected %s at %d, got %s\n", expected[i], i, items[i]);
+            return 1;
+        }
+        free(items[i]);
+    }
+    consumer_producer_destroy(&q);
+    printf("[L] Lanes are served 3:1 by weight and stay in order\n");
+    return 0;
+}
+
+int test_huge_pages() {
+    printf("=== consumer_producer huge page Tests ===\n");
+    // 40000 slots of items and metas need several MB, enough for huge pages
+    consumer_producer_t q;
+    if (consumer_producer_init(&q, 40000) != NULL) return 1;
+    consumer_producer_put(&q, "Item 0");
+    consumer_producer_put(&q, "Item 1");
+    if (consumer_producer_set_huge_pages(&q, HUGE_PAGES_EXPLICIT) != NULL) return 1;
+
+    // Whatever backing the kernel gave, the rings must keep items in order and work at full capacity
+    consumer_producer_stats_t stats;
+    consumer_producer_stats(&q, &stats, 0);
+    printf("[H] Rings backed by %s (%zu KB)\n", huge_backing_name(stats.backing), stats.ring_bytes / 1024);
+    if (stats.ring_bytes < 40000 * (sizeof(char*) + sizeof(record_meta_t))) {
+        printf("[H] Ring of %zu bytes is too small\n", stats.ring_bytes);
+        return 1;
+    }
+    char item[16];
+    for (int i = 2; i < 40000; i++) {
+        snprintf(item, sizeof(item), "Item %d", i);
+        consumer_producer_put(&q, item);
+    }
+    if (consumer_producer_set_huge_pages(&q, HUGE_PAGES_OFF) != NULL) return 1;
+    consumer_producer_stats(&q, &stats, 0);
+    if (stats.backing != HUGE_BACKING_HEAP || stats.size != 40000) {
+        printf("[H] Expected 40000 items on the heap, got %d on %s\n", stats.size, huge_backing_name(stats.backing));
+        return 1;
+    }
+    for (int i = 0; i < 40000; i++) {
+        char* out = consumer_producer_get(&q);
+        snprintf(item, sizeof(item), "Item %d", i);
+        if (!out || strcmp(out, item) != 0) {
+            printf("[H] Expected %s, got %s\n", item, out ? out : "NULL");
+            return 1;
+        }
+        free(out);
+    }
+    consumer_producer_destroy(&q);
+    printf("[H] Changing the backing keeps every item in order\n");
+    return 0;
+}
+
+int test_spill() {
+    printf("=== consumer_producer spill Tests ===\n");
+    char dir[] = "/tmp/spill_testXXXXXX";
+    if (!mkdtemp(dir)) return 1;
+    consumer_producer_t q;
+    if (consumer_producer_init(&q, 4) != NULL) return 1;
+    if (consumer_producer_set_spill(&q, dir) != NULL) return 1;
+
+    // Without a consumer, every put past the 4 ring slots goes to disk instead of blocking
+    char item[32];
+    record_meta_t meta;
+    memset(&meta, 0, sizeof(meta));
+    for (int i = 0; i < 5000; i++) {
+        snprintf(item, sizeof(item), "Item %d", i);
+        meta.end_offset = i;
+        if (consumer_producer_put_meta(&q, item, &meta) != NULL) return 1;
+        // Room in the ring must not let an item overtake the spilled ones
+        if (i == 2000) free(consumer_producer_get(&q));
+    }
+    consumer_producer_stats_t stats;
+    consumer_producer_stats(&q, &stats, 0);
+    if (stats.size != 3 || stats.spilled != 4996 || stats.spilled_total != 4996) {
+        printf("[S] Expected 3 queued and 4996 spilled, got %d and %llu\n", stats.size, stats.spilled);
+        return 1;
+    }
+    consumer_producer_signal_finished(&q);
+    for (int i = 1; i < 5000; i++) {
+        char* out = consumer_producer_get_meta(&q, &meta);
+        snprintf(item, sizeof(item), "Item %d", i);
+        if (!out || strcmp(out, item) != 0 || meta.end_offset != i) {
+            printf("[S] Expected %s, got %s\n", item, out ? out : "NULL");
+            return 1;
+        }
+        free(out);
+    }
+    if (consumer_producer_get(&q) != NULL) return 1;
+    consumer_producer_destroy(&q);
+    if (rmdir(dir) != 0) {
+        printf("[S] Spill files left in %s\n", dir);
+        return 1;
+    }
+    printf("[S] 4996 spilled items read back in order\n");
+    return 0;
+}
+
+// A write cut short by a full disk must not leave a torn record in front of later ones
+int test_spill_torn_write() {
+    printf("=== spill_file torn write Tests ===\n");
+    char dir[] = "/tmp/spill_testXXXXXX";
+    if (!mkdtemp(dir)) return 1;
+    spill_file_t spill;
+    if (spill_file_init(&spill, dir, "torn", sizeof(int)) != NULL) return 1;
+
+    // The file size limit stands in for a full disk
+    struct rlimit old_limit, limit;
+    getrlimit(RLIMIT_FSIZE, &old_limit);
+    limit = old_limit;
+    limit.rlim_cur = 10000;
+    signal(SIGXFSZ, SIG_IGN);
+    if (setrlimit(RLIMIT_FSIZE, &limit) != 0) return 1;
+    char item[128];
+    int appended = 0;
+    const char* err = NULL;
+    while (!err && appended < 1000) {
+        snprintf(item, sizeof(item), "%0100d", appended);
+        err = spill_file_append(&spill, item, &appended);
+        if (!err) appended++;
+    }
+    setrlimit(RLIMIT_FSIZE, &old_limit);
+    if (!err) {
+        printf("[T] No append failed under the size limit\n");
+        return 1;
+    }
+    printf("[T] Append %d failed: %s\n", appended, err);
+
+    // Past the failure, an append either lands after the last whole record or is
+    // refused; records the failed flush lost read back as an error, never as garbage
+    snprintf(item, sizeof(item), "%0100d", appended);
+    int refused = spill_file_append(&spill, item, &appended) != NULL;
+    if (!refused) appended++;
+    if (refused != spill.broken || spill.count != (unsigned long long)appended) return 1;
+    int got = 0;
+    for (; got < appended; got++) {
+        char* out = NULL;
+        int header = -1;
+        snprintf(item, sizeof(item), "%0100d", got);
+        if (spill_file_read(&spill, &out, &header) != NULL) break;
+        if (header != got || strcmp(out, item) != 0) {
+            printf("[T] Record %d misread\n", got);
+            return 1;
+        }
+        free(out);
+    }
+    if (!spill.broken && got != appended) return 1;
+    int spill_broken = spill.broken;
+    spill_file_destroy(&spill);
+    if (rmdir(dir) != 0) return 1;
+    printf("[T] %d of %d records read back whole, spill %s\n", got, appended, spill_broken ? "refusing appends" : "still usable");
+    return 0;
+}
+
+static void* spill_put_thread(void* arg) {
+    consumer_producer_t* q = (consumer_producer_t*)arg;
+    record_meta_t meta;
+    memset(&meta, 0, sizeof(meta));
+    meta.end_offset = 3;
+    return (void*)consumer_producer_put_meta(q, "Item 3", &meta);
+}
+
+// A stalled disk holds up only the item being spilled, not the queue's other users
+int test_spill_outside_lock() {
+    printf("=== consumer_producer spill outside the lock Tests ===\n");
+    char dir[] = "/tmp/spill_testXXXXXX";
+    if (!mkdtemp(dir)) return 1;
+    consumer_producer_t q;
+    if (consumer_producer_init(&q, 2) != NULL) return 1;
+    if (consumer_producer_set_spill(&q, dir) != NULL) return 1;
+    record_meta_t meta;
+    memset(&meta, 0, sizeof(meta));
+    char item[32];
+    for (int i = 0; i < 3; i++) {
+        snprintf(item, sizeof(item), "Item %d", i);
+        meta.end_offset = i;
+        if (consumer_producer_put_meta(&q, item, &meta) != NULL) return 1;
+    }
+
+    // Holding the lane's spill lock stands in for a write that never returns
+    alarm(10);
+    pthread_mutex_lock(&q.lanes[0].spill->mutex);
+    pthread_t producer;
+    pthread_create(&producer, NULL, spill_put_thread, &q);
+    consumer_producer_stats_t stats;
+    for (int waited = 0; waited < 2000; waited++) {
+        consumer_producer_stats(&q, &stats, 0);
+        if (stats.spilled == 2) break;
+        usleep(1000);
+    }
+    if (stats.spilled != 2) {
+        printf("[O] Second spill never started\n");
+        return 1;
+    }
+    // Another lane still takes puts and gives items back while the disk is stuck
+    meta.lane = 1;
+    if (consumer_producer_put_meta(&q, "Lane 1", &meta) != NULL) return 1;
+    int weights[2] = { 1, 1000 };
+    if (consumer_producer_set_lane_weights(&q, weights, 2) != NULL) return 1;
+    char* out = consumer_producer_get(&q);
+    if (!out || strcmp(out, "Lane 1") != 0) {
+        printf("[O] Expected the lane 1 item, got %s\n", out ? out : "NULL");
+        return 1;
+    }
+    free(out);
+    pthread_mutex_unlock(&q.lanes[0].spill->mutex);
+    void* err = NULL;
+    pthread_join(producer, &err);
+    alarm(0);
+    if (err) return 1;
+
+    consumer_producer_signal_finished(&q);
+    for (int i = 0; i < 4; i++) {
+        out = consumer_producer_get_meta(&q, &meta);
+        snprintf(item, sizeof(item), "Item %d", i);
+        if (!out || strcmp(out, item) != 0 || meta.end_offset != i) {
+            printf("[O] Expected %s, got %s\n", item, out ? out : "NULL");
+            return 1;
+        }
+        free(out);
+    }
+    if (consumer_producer_get(&q) != NULL) return 1;
+    consumer_producer_destroy(&q);
+    if (rmdir(dir) != 0) return 1;
+    printf("[O] Stats, puts and gets on other lanes went on while a spill was stuck\n");
+    return 0;
+}
+
+#define SPILL_PRODUCERS 3
+#define SPILL_ITEMS 20000
+
+static void* spill_producer_thread(void* arg) {
+    consumer_producer_t* q = ((void**)arg)[0];
+    int id = (int)(long)((void**)arg)[1];
+    char item[32];
+    for (int i = 0; i < SPILL_ITEMS; i++) {
+        snprintf(item, sizeof(item), "%d %d", id, i);
+        if (consumer_producer_put(q, item) != NULL) return (void*)1;
+    }
+    return NULL;
+}
+
+// Producers spilling at once, while the consumer reads back, keep each producer's order
+int test_spill_concurrent() {
+    printf("=== consumer_producer concurrent spill Tests ===\n");
+    char dir[] = "/tmp/spill_testXXXXXX";
+    if (!mkdtemp(dir)) return 1;
+    consumer_producer_t q;
+    if (consumer_producer_init(&q, 4) != NULL) return 1;
+    if (consumer_producer_set_spill(&q, dir) != NULL) return 1;
+    pthread_t producers[SPILL_PRODUCERS];
+    void* args[SPILL_PRODUCERS][2];
+    for (int p = 0; p < SPILL_PRODUCERS; p++) {
+        args[p][0] = &q;
+        args[p][1] = (void*)(long)p;
+        pthread_create(&producers[p], NULL, spill_producer_thread, args[p]);
+    }
+    int next[SPILL_PRODUCERS] = { 0 };
+    int received = 0;
+    char* items[16];
+    while (received < SPILL_PRODUCERS * SPILL_ITEMS) {
+        int count = consumer_producer_get_batch(&q, items, NULL, 16);
+        for (int i = 0; i < count; i++) {
+            int id, seq;
+            if (sscanf(items[i], "%d %d", &id, &seq) != 2 || id < 0 || id >= SPILL_PRODUCERS || seq != next[id]) {
+                printf("[Q] Out of order: %s\n", items[i]);
+                return 1;
+            }
+            next[id]++;
+            free(items[i]);
+        }
+        received += count;
+    }
+    for (int p = 0; p < SPILL_PRODUCERS; p++) {
+        void* err = NULL;
+        pthread_join(producers[p], &err);
+        if (err) return 1;
+    }
+    consumer_producer_stats_t stats;
+    consumer_producer_stats(&q, &stats, 0);
+    consumer_producer_destroy(&q);
+    if (rmdir(dir) != 0 || stats.spilled != 0 || stats.spill_bytes != 0) {
+        printf("[Q] %llu items and %llu bytes left on disk\n", stats.spilled, stats.spill_bytes);
+        return 1;
+    }
+    printf("[Q] %d items from %d producers in order, %llu through disk\n", received, SPILL_PRODUCERS,
+           stats.spilled_total);
+    return 0;
+}
 
 int main() {
     printf("=== consumer_producer Tests ===\n");
@@ -63,6 +428,34 @@ int main() {
     pthread_join(cons, NULL);
 
     consumer_producer_destroy(&q);
+    if (test_resize() != 0) {
+        fprintf(stderr, "resize test failed\n");
+        return 1;
+    }
+    if (test_lanes() != 0) {
+        fprintf(stderr, "lane test failed\n");
+        return 1;
+    }
+    if (test_huge_pages() != 0) {
+        fprintf(stderr, "huge page test failed\n");
+        return 1;
+    }
+    if (test_spill() != 0) {
+        fprintf(stderr, "spill test failed\n");
+        return 1;
+    }
+    if (test_spill_outside_lock() != 0) {
+        fprintf(stderr, "spill outside the lock test failed\n");
+        return 1;
+    }
+    if (test_spill_concurrent() != 0) {
+        fprintf(stderr, "concurrent spill test failed\n");
+        return 1;
+    }
+    if (test_spill_torn_write() != 0) {
+        fprintf(stderr, "spill torn write test failed\n");
+        return 1;
+    }
     printf("All tests done\n");
     return 0;
 }
@@ -201,6 +201,30 @@ void test_multiple_signals() {
     monitor_destroy(&monitor);
 }
 
+void test_timed_wait() {
+    printf("\n=== Testing Timed Wait ===\n");
+
+    monitor_t monitor;
+    monitor_init(&monitor);
+
+    if (monitor_timed_wait(&monitor, 50) == -1) {
+        printf("PASSED: Timed wait on unsignaled monitor timed out\n");
+    } else {
+        printf("FAILED: Timed wait returned without a signal\n");
+        test_passed = 0;
+    }
+
+    monitor_signal(&monitor);
+    if (monitor_timed_wait(&monitor, 50) == 0) {
+        printf("PASSED: Timed wait received signal\n");
+    } else {
+        printf("FAILED: Timed wait missed the signal\n");
+        test_passed = 0;
+    }
+
+    monitor_destroy(&monitor);
+}
+
 void test_edge_cases() {
     printf("\n=== Testing Edge Cases ===\n");
     
@@ -208,6 +232,7 @@ void test_edge_cases() {
     monitor_signal(NULL);
     monitor_reset(NULL);
     monitor_wait(NULL);
+    monitor_timed_wait(NULL, 0);
     monitor_destroy(NULL);
     printf("PASSED: NULL monitor handling\n");
     
@@ -226,6 +251,7 @@ int main() {
     test_reset_functionality();
     test_immediate_signal();
     test_multiple_signals();
+    test_timed_wait();
     test_edge_cases();
     
     printf("\nTest Summary\n");
@@ -1,7 +1,7 @@
 #!/bin/bash
 set -e
 
-gcc tests/plugins_test.c ./plugins/plugin_common.c ./plugins/sync/consumer_producer.c ./plugins/sync/monitor.c -o tests/plugins_test
+gcc tests/plugins_test.c ./plugins/plugin_common.c ./plugins/sync/consumer_producer.c ./plugins/sync/monitor.c ./plugins/sync/stage_cache.c ./plugins/sync/token_bucket.c ./plugins/sync/huge_alloc.c plugins/sync/spill_file.c plugins/sync/timer_wheel.c plugins/sync/scratch_pool.c -o tests/plugins_test
 ./tests/plugins_test
 
 rm tests/plugins_test
\ No newline at end of file
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <string.h>
+#include "../plugins/sync/scratch_pool.h"
+
+int test_growth_and_reuse() {
+    scratch_pool_t pool;
+    scratch_pool_init(&pool, 4096);
+    char* buffer = scratch_pool_get(&pool, 0, 10);
+    if (!buffer || pool.slots[0].size != SCRATCH_POOL_MIN_SIZE || pool.allocations != 1) {
+        printf("[G] First request did not allocate the minimum size\n");
+        return 1;
+    }
+    strcpy(buffer, "kept");
+    // Doubling: 256 -> 4096 in one step, with the contents kept
+    buffer = scratch_pool_get(&pool, 0, 3000);
+    if (!buffer || pool.slots[0].size != 4096 || pool.allocations != 2 || strcmp(buffer, "kept") != 0) {
+        printf("[G] Growth to 3000 bytes gave %zu bytes after %llu allocations\n", pool.slots[0].size,
+               pool.allocations);
+        return 1;
+    }
+    // Lines that fit never allocate again
+    for (int round = 0; round < 10000; round++) {
+        for (int slot = 0; slot < 4; slot++) {
+            char* line = scratch_pool_get(&pool, slot, 100 + (size_t)(round % 7) * 10);
+            if (!scratch_pool_owns(&pool, slot, line) || scratch_pool_owns(&pool, slot, line + 1)) {
+                printf("[G] Slot %d does not own its buffer\n", slot);
+                return 1;
+            }
+        }
+        scratch_pool_end_round(&pool);
+    }
+    if (pool.allocations != 5) {
+        printf("[G] Steady state made %llu allocations, expected 5\n", pool.allocations);
+        return 1;
+    }
+    scratch_pool_destroy(&pool);
+    printf("[G] Slots grow geometrically and steady lines allocate nothing\n");
+    return 0;
+}
+
+int test_trim() {
+    scratch_pool_t pool;
+    scratch_pool_init(&pool, 1024);
+    scratch_pool_get(&pool, 0, 100000);
+    scratch_pool_get(&pool, 1, 100000);
+    scratch_pool_end_round(&pool);
+    // One long line, then short ones: slot 0 shrinks to twice its peak, slot 1 to the watermark
+    for (int round = 0; round < 2 * SCRATCH_POOL_TRIM_ROUNDS; round++) {
+        scratch_pool_get(&pool, 0, 3000);
+        scratch_pool_get(&pool, 1, 10);
+        scratch_pool_end_round(&pool);
+    }
+    if (pool.slots[0].size != 6000 || pool.slots[1].size != 1024) {
+        printf("[T] Trimmed to %zu and %zu bytes, expected 6000 and 1024\n", pool.slots[0].size, pool.slots[1].size);
+        return 1;
+    }
+    // A slot that is still used near its size keeps it
+    size_t before = pool.slots[0].size;
+    for (int round = 0; round < SCRATCH_POOL_TRIM_ROUNDS; round++) {
+        scratch_pool_get(&pool, 0, 3000);
+        scratch_pool_end_round(&pool);
+    }
+    if (pool.slots[0].size != before) {
+        printf("[T] A busy slot was trimmed from %zu to %zu bytes\n", before, pool.slots[0].size);
+        return 1;
+    }
+    scratch_pool_destroy(&pool);
+    printf("[T] Idle space is trimmed, never below the watermark\n");
+    return 0;
+}
+
+int main() {
+    printf("=== scratch_pool Tests ===\n");
+    if (test_growth_and_reuse() != 0 || test_trim() != 0) {
+        fprintf(stderr, "scratch pool test failed\n");
+        return 1;
+    }
+    printf("All tests done\n");
+    return 0;
+}
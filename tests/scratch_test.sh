@@ -0,0 +1,7 @@
+#!/bin/bash
+set -e
+
+gcc -g -fsanitize=address tests/scratch_pool_test.c plugins/sync/scratch_pool.c -o tests/scratch_pool_test
+./tests/scratch_pool_test
+
+rm tests/scratch_pool_test
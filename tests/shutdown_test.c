@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include "../plugins/plugin_common.h"
+#include "../plugins/plugin_sdk.h"
+
+// Built with -fsanitize=address: LeakSanitizer fails the run if any queued,
+// in-flight or transformed buffer is not freed by a shutdown mode.
+
+#define NUM_ITEMS 6
+
+static int g_delay_us = 0;
+static int g_delivered = 0;
+
+static const char* slow_uppercase(const char* input) {
+    char* output = malloc(strlen(input) + 1);
+    if (!output) return NULL;
+    for (int i = 0; input[i] != '\0'; i++) output[i] = toupper(input[i]);
+    output[strlen(input)] = '\0';
+    usleep(g_delay_us);
+    return output;
+}
+
+static const char* count_sink(const char* str) {
+    (void)str;
+    g_delivered++;
+    return NULL;
+}
+
+static int start_stage(int delay_us) {
+    g_delay_us = delay_us;
+    g_delivered = 0;
+    if (common_plugin_init(slow_uppercase, "shutdown_test", NUM_ITEMS) != NULL) return 1;
+    plugin_attach(count_sink);
+    char item[16];
+    for (int i = 0; i < NUM_ITEMS; i++) {
+        snprintf(item, sizeof(item), "item %d", i);
+        if (plugin_place_work(item) != NULL) return 1;
+    }
+    return 0;
+}
+
+// Every placed item is either delivered or counted as dropped
+static int finish_stage(const char* mode) {
+    if (plugin_wait_finished() != NULL) return 1;
+    consumer_producer_stats_t stats;
+    consumer_producer_stats_t again;
+    if (plugin_queue_stats(&stats, 0) != NULL || plugin_queue_stats(&again, 0) != NULL) return 1;
+    if (plugin_fini() != NULL) return 1;
+    // Reading the stats must not take the watermark away from the queue controller
+    if (stats.high_watermark == 0 || again.high_watermark != stats.high_watermark) {
+        printf("[%s] High watermark %d reset to %d by a read\n", mode, stats.high_watermark, again.high_watermark);
+        return 1;
+    }
+    if (g_delivered + (int)stats.dropped != NUM_ITEMS) {
+        printf("[%s] %d delivered + %llu dropped != %d placed\n", mode, g_delivered, stats.dropped, NUM_ITEMS);
+        return 1;
+    }
+    printf("[%s] %d delivered, %llu dropped\n", mode, g_delivered, stats.dropped);
+    return 0;
+}
+
+int test_drain() {
+    if (start_stage(1000) != 0) return 1;
+    if (plugin_drain(5000) != 0) {
+        printf("[drain] Stage did not drain in time\n");
+        return 1;
+    }
+    if (g_delivered != NUM_ITEMS) {
+        printf("[drain] Expected %d delivered, got %d\n", NUM_ITEMS, g_delivered);
+        return 1;
+    }
+    return finish_stage("drain");
+}
+
+int test_deadline() {
+    if (start_stage(50000) != 0) return 1;
+    if (plugin_drain(60) == 0) {
+        printf("[deadline] Slow stage drained before the deadline\n");
+        return 1;
+    }
+    int discarded = plugin_abort();
+    if (discarded <= 0) {
+        printf("[deadline] Expected queued items to be discarded, got %d\n", discarded);
+        return 1;
+    }
+    return finish_stage("deadline");
+}
+
+int test_abort() {
+    if (start_stage(50000) != 0) return 1;
+    plugin_abort();
+    if (finish_stage("abort") != 0) return 1;
+    if (g_delivered > 1) {
+        printf("[abort] Only the in-flight item may be delivered, got %d\n", g_delivered);
+        return 1;
+    }
+    return 0;
+}
+
+int main() {
+    printf("=== shutdown mode Tests ===\n");
+    if (test_drain() != 0 || test_deadline() != 0 || test_abort() != 0) {
+        fprintf(stderr, "shutdown test failed\n");
+        return 1;
+    }
+    printf("All tests done\n");
+    return 0;
+}
@@ -0,0 +1,7 @@
+#!/bin/bash
+set -e
+
+gcc -fsanitize=address -g tests/shutdown_test.c plugins/plugin_common.c plugins/sync/consumer_producer.c plugins/sync/monitor.c plugins/sync/stage_cache.c plugins/sync/token_bucket.c plugins/sync/huge_alloc.c plugins/sync/spill_file.c plugins/sync/timer_wheel.c plugins/sync/scratch_pool.c -lpthread -o tests/shutdown_test
+./tests/shutdown_test
+
+rm tests/shutdown_test
@@ -0,0 +1,503 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "../plugins/sync/consumer_producer.h"
+#include "../plugins/sync/monitor.h"
+
+// Concurrency stress and throughput regression suite for the queue and monitor.
+// Timing is perturbed from seeded per-thread generators (STRESS_SEED), so a
+// failing schedule can be replayed with the same seed. A watchdog turns a lost
+// wakeup into a failure instead of a hang. Throughput is compared with the
+// baselines file given as argv[1]: a run below STRESS_TOLERANCE (default 0.4,
+// loose enough for a shared machine) times its baseline fails.
+// STRESS_UPDATE_BASELINE=1 rewrites the file.
+
+#define WATCHDOG_SECONDS 20
+#define MAX_BASELINES 32
+
+typedef struct {
+    const char* name;
+    int producers;
+    int consumers;
+    int items; // Per producer
+    int capacity;
+    int batch; // Items per get, 1 uses consumer_producer_get_meta
+    int lanes; // Producer p puts into lane p % lanes
+    int resize; // Run a thread that resizes the queue at random
+} scenario_t;
+
+typedef struct {
+    const scenario_t* scenario;
+    consumer_producer_t* queue;
+    unsigned long long seed;
+    int id;
+    int perturb;
+    atomic_uchar* seen; // Deliveries per item, producers * items entries
+    atomic_int* stop;
+    int failed;
+    long long delivered;
+} worker_t;
+
+static unsigned long long g_seed = 1;
+static const char* g_current = "";
+static char g_baseline_names[MAX_BASELINES][64];
+static double g_baseline_values[MAX_BASELINES];
+static int g_num_baselines = 0;
+static char g_result_names[MAX_BASELINES][64];
+static double g_result_values[MAX_BASELINES];
+static int g_num_results = 0;
+
+static unsigned long long next_random(unsigned long long* state) {
+    // xorshift64*
+    unsigned long long x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+// Yield, sleep briefly or spin at random points, so rare interleavings show up
+static void perturb(unsigned long long* state) {
+    unsigned long long r = next_random(state);
+    switch (r % 16) {
+        case 0:
+            sched_yield();
+            break;
+        case 1:
+            usleep((r >> 8) % 50);
+            break;
+        case 2:
+        case 3:
+            for (volatile int i = 0; i < (int)((r >> 8) % 200); i++) { }
+            break;
+        default:
+            break;
+    }
+}
+
+static double now_s(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void on_watchdog(int sig) {
+    (void)sig;
+    static const char message[] = "[W] Watchdog expired: a thread never woke up\n";
+    write(STDOUT_FILENO, message, sizeof(message) - 1);
+    _exit(1);
+}
+
+static void arm_watchdog(const char* name) {
+    g_current = name;
+    alarm(WATCHDOG_SECONDS);
+}
+
+static void* producer_main(void* arg) {
+    worker_t* worker = (worker_t*)arg;
+    const scenario_t* scenario = worker->scenario;
+    char item[32];
+    record_meta_t meta;
+    memset(&meta, 0, sizeof(meta));
+    meta.lane = worker->id % scenario->lanes;
+    for (int seq = 0; seq < scenario->items; seq++) {
+        if (worker->perturb) perturb(&worker->seed);
+        snprintf(item, sizeof(item), "%d:%d", worker->id, seq);
+        const char* err = consumer_producer_put_meta(worker->queue, item, &meta);
+        if (err) {
+            printf("[%s] Put failed: %s\n", scenario->name, err);
+            worker->failed = 1;
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+// Check one delivery: exactly once overall, in order per producer as seen by this consumer
+static int check_item(worker_t* worker, const char* item, int* last_seq) {
+    const scenario_t* scenario = worker->scenario;
+    int producer = -1, seq = -1;
+    if (sscanf(item, "%d:%d", &producer, &seq) != 2 || producer < 0 || producer >= scenario->producers ||
+        seq < 0 || seq >= scenario->items) {
+        printf("[%s] Corrupt item '%s'\n", scenario->name, item);
+        return -1;
+    }
+    if (atomic_fetch_add(&worker->seen[producer * scenario->items + seq], 1) != 0) {
+        printf("[%s] Item %s delivered twice\n", scenario->name, item);
+        return -1;
+    }
+    if (seq <= last_seq[producer]) {
+        printf("[%s] Item %s after %d:%d\n", scenario->name, item, producer, last_seq[producer]);
+        return -1;
+    }
+    last_seq[producer] = seq;
+    worker->delivered++;
+    return 0;
+}
+
+static void* consumer_main(void* arg) {
+    worker_t* worker = (worker_t*)arg;
+    const scenario_t* scenario = worker->scenario;
+    int* last_seq = malloc(scenario->producers * sizeof(int));
+    char** items = malloc(scenario->batch * sizeof(char*));
+    for (int p = 0; p < scenario->producers; p++) last_seq[p] = -1;
+    for (;;) {
+        if (worker->perturb) perturb(&worker->seed);
+        int count;
+        if (scenario->batch == 1) {
+            items[0] = consumer_producer_get_meta(worker->queue, NULL);
+            count = items[0] ? 1 : 0;
+        } else {
+            count = consumer_producer_get_batch(worker->queue, items, NULL, scenario->batch);
+        }
+        if (count == 0) break;
+        for (int i = 0; i < count; i++) {
+            if (!worker->failed && check_item(worker, items[i], last_seq) != 0) worker->failed = 1;
+            free(items[i]);
+        }
+    }
+    free(items);
+    free(last_seq);
+    return NULL;
+}
+
+static void* resizer_main(void* arg) {
+    worker_t* worker = (worker_t*)arg;
+    while (!atomic_load(worker->stop)) {
+        perturb(&worker->seed);
+        int capacity = 1 + (int)(next_random(&worker->seed) % (worker->scenario->capacity * 2));
+        consumer_producer_resize(worker->queue, capacity);
+    }
+    return NULL;
+}
+
+/*
+ * Run producers and consumers to completion, then close the queue.
+ * Returns the elapsed seconds, or -1 if an item was lost, duplicated or reordered.
+ */
+static double run_scenario(const scenario_t* scenario, unsigned long long seed, int perturbed) {
+    consumer_producer_t queue;
+    if (consumer_producer_init(&queue, scenario->capacity) != NULL) return -1;
+    if (scenario->lanes > 1) {
+        int weights[CP_MAX_LANES];
+        for (int l = 0; l < scenario->lanes; l++) weights[l] = l + 1;
+        consumer_producer_set_lane_weights(&queue, weights, scenario->lanes);
+    }
+    long total = (long)scenario->producers * scenario->items;
+    atomic_uchar* seen = calloc(total, sizeof(atomic_uchar));
+    int workers_count = scenario->producers + scenario->consumers + 1;
+    worker_t* workers = calloc(workers_count, sizeof(worker_t));
+    pthread_t* threads = calloc(workers_count, sizeof(pthread_t));
+    atomic_int stop = 0;
+    for (int i = 0; i < workers_count; i++) {
+        workers[i].scenario = scenario;
+        workers[i].queue = &queue;
+        workers[i].seed = (seed ^ (0x9E3779B97F4A7C15ULL * (i + 1))) | 1;
+        workers[i].id = i < scenario->producers ? i : i - scenario->producers;
+        workers[i].perturb = perturbed;
+        workers[i].seen = seen;
+        workers[i].stop = &stop;
+    }
+    double start = now_s();
+    worker_t* consumers = &workers[scenario->producers];
+    worker_t* resizer = &workers[workers_count - 1];
+    for (int c = 0; c < scenario->consumers; c++) {
+        pthread_create(&threads[scenario->producers + c], NULL, consumer_main, &consumers[c]);
+    }
+    if (scenario->resize) pthread_create(&threads[workers_count - 1], NULL, resizer_main, resizer);
+    for (int p = 0; p < scenario->producers; p++) pthread_create(&threads[p], NULL, producer_main, &workers[p]);
+    for (int p = 0; p < scenario->producers; p++) pthread_join(threads[p], NULL);
+    atomic_store(&stop, 1);
+    if (scenario->resize) pthread_join(threads[workers_count - 1], NULL);
+    consumer_producer_signal_finished(&queue);
+    for (int c = 0; c < scenario->consumers; c++) pthread_join(threads[scenario->producers + c], NULL);
+    double elapsed = now_s() - start;
+
+    int failed = 0;
+    long long delivered = 0;
+    for (int i = 0; i < workers_count; i++) {
+        failed |= workers[i].failed;
+        if (i >= scenario->producers) delivered += workers[i].delivered;
+    }
+    if (!failed && delivered != total) {
+        printf("[%s] %lld of %ld items delivered\n", scenario->name, delivered, total);
+        failed = 1;
+    }
+    consumer_producer_destroy(&queue);
+    free(seen);
+    free(workers);
+    free(threads);
+    return failed ? -1 : elapsed;
+}
+
+static int test_delivery(void) {
+    static const scenario_t scenarios[] = {
+        { "spsc", 1, 1, 20000, 4, 1, 1, 0 },
+        { "spsc-batch", 1, 1, 20000, 8, 16, 1, 0 },
+        { "mpsc", 4, 1, 5000, 4, 8, 1, 0 },
+        { "mpmc", 4, 4, 5000, 2, 1, 1, 0 },
+        { "mpmc-batch", 4, 3, 5000, 8, 4, 1, 0 },
+        { "lanes", 4, 2, 5000, 2, 4, 3, 0 },
+        { "resize", 3, 2, 5000, 4, 4, 2, 1 },
+    };
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        arm_watchdog(scenarios[i].name);
+        for (int round = 0; round < 3; round++) {
+            unsigned long long seed = g_seed + round;
+            if (run_scenario(&scenarios[i], seed, 1) < 0) {
+                printf("[D] %s failed with STRESS_SEED=%llu\n", scenarios[i].name, seed);
+                return 1;
+            }
+        }
+        printf("[D] %s: every item delivered once, in order per producer\n", scenarios[i].name);
+    }
+    alarm(0);
+    return 0;
+}
+
+typedef struct {
+    consumer_producer_t* queue;
+    unsigned long long seed;
+    long long put; // Items accepted by the queue
+    long long taken;
+} closer_worker_t;
+
+static void* closing_producer(void* arg) {
+    closer_worker_t* worker = (closer_worker_t*)arg;
+    for (;;) {
+        perturb(&worker->seed);
+        if (consumer_producer_put(worker->queue, "item") != NULL) return NULL;
+        worker->put++;
+    }
+}
+
+static void* closing_consumer(void* arg) {
+    closer_worker_t* worker = (closer_worker_t*)arg;
+    char* items[4];
+    int count;
+    for (;;) {
+        perturb(&worker->seed);
+        count = consumer_producer_get_batch(worker->queue, items, NULL, 1 + (int)(next_random(&worker->seed) % 4));
+        if (count == 0) return NULL;
+        for (int i = 0; i < count; i++) free(items[i]);
+        worker->taken += count;
+    }
+}
+
+/*
+ * Close a queue while several producers block on a full queue and several
+ * consumers block on an empty one. Every thread has to wake up and return, and
+ * every accepted item is either consumed or, after an abort, discarded.
+ */
+static int test_close_races(void) {
+    const int producers = 3, consumers = 3, rounds = 150;
+    arm_watchdog("close");
+    for (int round = 0; round < rounds; round++) {
+        int abort_queue = round % 2;
+        unsigned long long seed = g_seed * 1000 + round;
+        consumer_producer_t queue;
+        consumer_producer_init(&queue, 1 + round % 3);
+        closer_worker_t workers[producers + consumers];
+        pthread_t threads[producers + consumers];
+        for (int i = 0; i < producers + consumers; i++) {
+            workers[i].queue = &queue;
+            workers[i].seed = (seed ^ (0x9E3779B97F4A7C15ULL * (i + 1))) | 1;
+            workers[i].put = 0;
+            workers[i].taken = 0;
+            pthread_create(&threads[i], NULL, i < producers ? closing_producer : closing_consumer, &workers[i]);
+        }
+        usleep(next_random(&seed) % 2000);
+        long long discarded = 0;
+        if (abort_queue) {
+            discarded = consumer_producer_abort(&queue);
+        } else {
+            consumer_producer_signal_finished(&queue);
+        }
+        for (int i = 0; i < producers + consumers; i++) pthread_join(threads[i], NULL);
+        long long put = 0, taken = 0;
+        for (int i = 0; i < producers + consumers; i++) {
+            put += workers[i].put;
+            taken += workers[i].taken;
+        }
+        consumer_producer_destroy(&queue);
+        if (put != taken + discarded) {
+            printf("[C] %s round %d: %lld put, %lld taken, %lld discarded\n",
+                   abort_queue ? "abort" : "finish", round, put, taken, discarded);
+            return 1;
+        }
+    }
+    alarm(0);
+    printf("[C] Blocked producers and consumers all return when the queue is finished or aborted\n");
+    return 0;
+}
+
+typedef struct {
+    monitor_t* monitor;
+    atomic_int* woken;
+} waiter_t;
+
+static void* monitor_waiter(void* arg) {
+    waiter_t* waiter = (waiter_t*)arg;
+    monitor_wait(waiter->monitor);
+    atomic_fetch_add(waiter->woken, 1);
+    return NULL;
+}
+
+// A broadcast must wake every waiter, including one that starts waiting just after it
+static int test_monitor_broadcast(void) {
+    arm_watchdog("monitor");
+    for (int round = 0; round < 200; round++) {
+        monitor_t monitor;
+        monitor_init(&monitor);
+        atomic_int woken = 0;
+        waiter_t waiter = { &monitor, &woken };
+        pthread_t threads[4];
+        for (int i = 0; i < 4; i++) pthread_create(&threads[i], NULL, monitor_waiter, &waiter);
+        if (round % 2) usleep(round % 500);
+        monitor_broadcast(&monitor);
+        for (int i = 0; i < 4; i++) pthread_join(threads[i], NULL);
+        monitor_destroy(&monitor);
+        if (atomic_load(&woken) != 4) {
+            printf("[M] Only %d of 4 waiters woke up\n", atomic_load(&woken));
+            return 1;
+        }
+    }
+    alarm(0);
+    printf("[M] Broadcast wakes every waiter\n");
+    return 0;
+}
+
+static void load_baselines(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) return;
+    char name[64];
+    double value;
+    while (g_num_baselines < MAX_BASELINES && fscanf(file, "%63s %lf", name, &value) == 2) {
+        snprintf(g_baseline_names[g_num_baselines], sizeof(g_baseline_names[0]), "%s", name);
+        g_baseline_values[g_num_baselines++] = value;
+    }
+    fclose(file);
+}
+
+static double baseline_of(const char* name) {
+    for (int i = 0; i < g_num_baselines; i++) {
+        if (strcmp(g_baseline_names[i], name) == 0) return g_baseline_values[i];
+    }
+    return 0;
+}
+
+// Compare ops/sec with its baseline; a drop below the tolerated fraction fails
+static int record_throughput(const char* name, double ops_per_sec, double tolerance) {
+    if (g_num_results < MAX_BASELINES) {
+        snprintf(g_result_names[g_num_results], sizeof(g_result_names[0]), "%s", name);
+        g_result_values[g_num_results++] = ops_per_sec;
+    }
+    double baseline = baseline_of(name);
+    if (baseline <= 0) {
+        printf("[P] %-16s %12.0f ops/s (no baseline)\n", name, ops_per_sec);
+        return 0;
+    }
+    double ratio = ops_per_sec / baseline;
+    printf("[P] %-16s %12.0f ops/s, %.2fx baseline\n", name, ops_per_sec, ratio);
+    if (ratio < tolerance) {
+        printf("[P] %s regressed below %.0f%% of its baseline %.0f ops/s\n", name, tolerance * 100, baseline);
+        return 1;
+    }
+    return 0;
+}
+
+static void* ping_pong(void* arg) {
+    monitor_t* monitors = (monitor_t*)arg;
+    for (int i = 0; i < 20000; i++) {
+        monitor_wait(&monitors[0]);
+        monitor_signal(&monitors[1]);
+    }
+    return NULL;
+}
+
+static int test_throughput(double tolerance) {
+    static const scenario_t scenarios[] = {
+        { "queue-spsc", 1, 1, 200000, 64, 1, 1, 0 },
+        { "queue-spsc-batch", 1, 1, 500000, 1024, 64, 1, 0 },
+        { "queue-mpmc", 4, 4, 50000, 256, 16, 1, 0 },
+        { "queue-lanes", 2, 1, 100000, 256, 64, 2, 0 },
+    };
+    int failed = 0;
+    arm_watchdog("throughput");
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        // Best of three, so one descheduled run does not count as a regression
+        double best = 0;
+        for (int run = 0; run < 3; run++) {
+            double elapsed = run_scenario(&scenarios[i], g_seed, 0);
+            if (elapsed < 0) return 1;
+            double rate = (double)scenarios[i].producers * scenarios[i].items / elapsed;
+            if (rate > best) best = rate;
+        }
+        failed |= record_throughput(scenarios[i].name, best, tolerance);
+    }
+
+    monitor_t monitors[2];
+    monitor_init(&monitors[0]);
+    monitor_init(&monitors[1]);
+    pthread_t thread;
+    double start = now_s();
+    pthread_create(&thread, NULL, ping_pong, monitors);
+    for (int i = 0; i < 20000; i++) {
+        monitor_signal(&monitors[0]);
+        monitor_wait(&monitors[1]);
+    }
+    pthread_join(thread, NULL);
+    failed |= record_throughput("monitor-pingpong", 20000 / (now_s() - start), tolerance);
+    monitor_destroy(&monitors[0]);
+    monitor_destroy(&monitors[1]);
+    alarm(0);
+    return failed;
+}
+
+static void save_baselines(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        perror(path);
+        return;
+    }
+    for (int i = 0; i < g_num_results; i++) fprintf(file, "%s %.0f\n", g_result_names[i], g_result_values[i]);
+    fclose(file);
+    printf("Baselines written to %s\n", path);
+}
+
+int main(int argc, char** argv) {
+    const char* baseline_path = argc > 1 ? argv[1] : NULL;
+    const char* seed = getenv("STRESS_SEED");
+    const char* tolerance = getenv("STRESS_TOLERANCE");
+    const char* update = getenv("STRESS_UPDATE_BASELINE");
+    if (seed) g_seed = strtoull(seed, NULL, 10);
+    double min_ratio = tolerance ? atof(tolerance) : 0.4;
+    signal(SIGALRM, on_watchdog);
+    setvbuf(stdout, NULL, _IONBF, 0);
+    if (baseline_path) load_baselines(baseline_path);
+
+    printf("=== sync layer stress tests (STRESS_SEED=%llu) ===\n", g_seed);
+    if (test_delivery() != 0 || test_close_races() != 0 || test_monitor_broadcast() != 0) {
+        fprintf(stderr, "stress test failed in %s\n", g_current);
+        return 1;
+    }
+    int regressed = test_throughput(min_ratio);
+    if (update && strcmp(update, "1") == 0 && baseline_path) {
+        save_baselines(baseline_path);
+        regressed = 0;
+    }
+    if (regressed) {
+        fprintf(stderr, "throughput regression, rerun with STRESS_UPDATE_BASELINE=1 if it is expected\n");
+        return 1;
+    }
+    printf("All tests done\n");
+    return 0;
+}
@@ -0,0 +1,9 @@
+#!/bin/bash
+set -e
+
+# Optimized build: the throughput half compares against tests/stress_baseline.txt
+# STRESS_SEED replays a schedule, STRESS_UPDATE_BASELINE=1 records new baselines
+gcc -O2 -g tests/stress_test.c plugins/sync/consumer_producer.c plugins/sync/monitor.c plugins/sync/huge_alloc.c plugins/sync/spill_file.c -lpthread -o tests/stress_test
+./tests/stress_test tests/stress_baseline.txt
+
+rm tests/stress_test
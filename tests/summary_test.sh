@@ -0,0 +1,7 @@
+#!/bin/bash
+set -e
+
+gcc -g tests/window_summary_test.c plugins/sync/window_summary.c -o tests/window_summary_test -lm
+./tests/window_summary_test
+
+rm tests/window_summary_test
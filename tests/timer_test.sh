@@ -0,0 +1,7 @@
+#!/bin/bash
+set -e
+
+gcc -g tests/timer_wheel_test.c plugins/sync/timer_wheel.c -o tests/timer_wheel_test
+./tests/timer_wheel_test
+
+rm tests/timer_wheel_test
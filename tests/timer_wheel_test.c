@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include "../plugins/sync/timer_wheel.h"
+
+#define TICK_NS 1000000LL
+
+static long long g_fired[64];
+static int g_num_fired = 0;
+static int g_num_cancelled = 0;
+
+static void record(void* arg, int cancelled) {
+    if (cancelled) {
+        g_num_cancelled++;
+        return;
+    }
+    g_fired[g_num_fired++] = (long long)(size_t)arg;
+}
+
+static timer_wheel_t* g_chain_wheel;
+static int g_chain_left;
+
+// Reschedules itself one tick later until the count runs out
+static void chain(void* arg, int cancelled) {
+    long long due = (long long)(size_t)arg;
+    if (cancelled || --g_chain_left == 0) return;
+    timer_wheel_schedule(g_chain_wheel, due + TICK_NS, chain, (void*)(size_t)(due + TICK_NS));
+}
+
+int test_due_order() {
+    timer_wheel_t wheel;
+    if (timer_wheel_init(&wheel, TICK_NS, 0) != NULL) return 1;
+    g_num_fired = 0;
+    // Spread over every level, scheduled out of order
+    long long dues[] = {5, 3, 70, 4100, 1, 70, 300000, 64, 263000};
+    int count = sizeof(dues) / sizeof(dues[0]);
+    for (int i = 0; i < count; i++) timer_wheel_schedule(&wheel, dues[i] * TICK_NS, record, (void*)(size_t)dues[i]);
+    long long now = 0;
+    while (timer_wheel_pending(&wheel) > 0) {
+        long long next = timer_wheel_next_ns(&wheel);
+        if (next < now) {
+            printf("[O] Next wake-up %lld is in the past of %lld\n", next, now);
+            return 1;
+        }
+        now = next;
+        int before = g_num_fired;
+        timer_wheel_advance(&wheel, now);
+        // Nothing may fire later than its tick
+        for (int i = before; i < g_num_fired; i++) {
+            if (g_fired[i] * TICK_NS != now) {
+                printf("[O] Timer due at %lld fired at %lld ms\n", g_fired[i], now / TICK_NS);
+                return 1;
+            }
+        }
+    }
+    long long expected[] = {1, 3, 5, 64, 70, 70, 4100, 263000, 300000};
+    for (int i = 0; i < count; i++) {
+        if (g_fired[i] != expected[i]) {
+            printf("[O] Timer %d fired due %lld, expected %lld\n", i, g_fired[i], expected[i]);
+            return 1;
+        }
+    }
+    timer_wheel_destroy(&wheel);
+    printf("[O] %d timers fired in due order, each on its tick\n", count);
+    return 0;
+}
+
+int test_beyond_top_level() {
+    timer_wheel_t wheel;
+    if (timer_wheel_init(&wheel, TICK_NS, 0) != NULL) return 1;
+    g_num_fired = 0;
+    // Past the 64^4 ticks the wheel spans, so it waits in the top level and is placed again
+    long long far = (1LL << 24) + 12345;
+    timer_wheel_schedule(&wheel, far * TICK_NS, record, (void*)(size_t)far);
+    timer_wheel_advance(&wheel, (far - 1) * TICK_NS);
+    if (g_num_fired != 0) {
+        printf("[F] Far timer fired early\n");
+        return 1;
+    }
+    timer_wheel_advance(&wheel, far * TICK_NS);
+    if (g_num_fired != 1 || g_fired[0] != far) {
+        printf("[F] Far timer did not fire on its tick\n");
+        return 1;
+    }
+    timer_wheel_destroy(&wheel);
+    printf("[F] Timer beyond the top level fired on its tick\n");
+    return 0;
+}
+
+int test_reschedule_and_cancel() {
+    timer_wheel_t wheel;
+    if (timer_wheel_init(&wheel, TICK_NS, 0) != NULL) return 1;
+    g_chain_wheel = &wheel;
+    g_chain_left = 200;
+    timer_wheel_schedule(&wheel, 0, chain, (void*)0);
+    // One advance fires the whole chain, one link per tick
+    int fired = timer_wheel_advance(&wheel, 1000 * TICK_NS);
+    if (fired != 200 || timer_wheel_pending(&wheel) != 0) {
+        printf("[C] Chain fired %d links, %d pending\n", fired, timer_wheel_pending(&wheel));
+        return 1;
+    }
+    g_num_cancelled = 0;
+    for (int i = 1; i <= 10; i++) timer_wheel_schedule(&wheel, (1000 + i * 1000) * TICK_NS, record, NULL);
+    if (timer_wheel_cancel_all(&wheel) != 10 || g_num_cancelled != 10 || timer_wheel_next_ns(&wheel) != -1) {
+        printf("[C] Cancelled %d of 10 timers\n", g_num_cancelled);
+        return 1;
+    }
+    timer_wheel_destroy(&wheel);
+    printf("[C] Rescheduling callbacks and cancel work\n");
+    return 0;
+}
+
+int main() {
+    printf("=== timer_wheel Tests ===\n");
+    if (test_due_order() != 0 || test_beyond_top_level() != 0 || test_reschedule_and_cancel() != 0) {
+        fprintf(stderr, "timer wheel test failed\n");
+        return 1;
+    }
+    printf("All tests done\n");
+    return 0;
+}
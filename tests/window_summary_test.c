@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <string.h>
+#include "../plugins/sync/window_summary.h"
+
+int test_distinct_estimate() {
+    window_summary_t summary;
+    if (window_summary_init(&summary, 64) != NULL) return 1;
+    int sizes[] = { 100, 5000, 200000 };
+    char key[32];
+    for (int s = 0; s < 3; s++) {
+        window_summary_reset(&summary);
+        // Every key twice: repeats must not count
+        for (int round = 0; round < 2; round++) {
+            for (int i = 0; i < sizes[s]; i++) {
+                int len = snprintf(key, sizeof(key), "user-%d", i);
+                window_summary_add(&summary, key, len);
+            }
+        }
+        double estimate = window_summary_distinct(&summary);
+        double error = (estimate - sizes[s]) / sizes[s];
+        printf("[D] %d distinct keys estimated as %.0f\n", sizes[s], estimate);
+        if (error < -0.05 || error > 0.05 || summary.lines != 2ULL * sizes[s]) {
+            window_summary_destroy(&summary);
+            return 1;
+        }
+    }
+    window_summary_destroy(&summary);
+    return 0;
+}
+
+int test_heavy_keys() {
+    window_summary_t summary;
+    if (window_summary_init(&summary, 64) != NULL) return 1;
+    // Three heavy keys among 10000 keys seen once each; 11750 lines over 64 counters
+    // guarantee every key above 184 lines is monitored
+    char key[32];
+    for (int i = 0; i < 10000; i++) {
+        int len = snprintf(key, sizeof(key), "rare-%d", i);
+        window_summary_add(&summary, key, len);
+        if (i % 10 == 0) window_summary_add(&summary, "alpha", 5);
+        if (i % 20 == 0) window_summary_add(&summary, "beta", 4);
+        if (i % 40 == 0) window_summary_add(&summary, "gamma", 5);
+    }
+    const summary_counter_t* top[3];
+    int found = window_summary_top(&summary, top, 3);
+    const char* expected[] = { "alpha", "beta", "gamma" };
+    unsigned long long counts[] = { 1000, 500, 250 };
+    for (int i = 0; i < 3; i++) {
+        // Counts are upper bounds, off by at most the inherited error
+        if (i >= found || strcmp(top[i]->key, expected[i]) != 0 || top[i]->count < counts[i] ||
+            top[i]->count - top[i]->error > counts[i]) {
+            printf("[H] Heavy key %d is not %s\n", i, expected[i]);
+            window_summary_destroy(&summary);
+            return 1;
+        }
+    }
+    printf("[H] Top keys %s:%llu %s:%llu %s:%llu\n", top[0]->key, top[0]->count, top[1]->key, top[1]->count,
+           top[2]->key, top[2]->count);
+    window_summary_destroy(&summary);
+    return 0;
+}
+
+int test_merge() {
+    window_summary_t first, second, merged;
+    if (window_summary_init(&first, 8) != NULL || window_summary_init(&second, 8) != NULL ||
+        window_summary_init(&merged, 8) != NULL) return 1;
+    const char* keys[] = { "a", "b", "c" };
+    for (int i = 0; i < 30; i++) window_summary_add(&first, keys[i % 3], 1);
+    for (int i = 0; i < 20; i++) window_summary_add(&second, keys[i % 2], 1);
+    window_summary_merge(&merged, &first);
+    window_summary_merge(&merged, &second);
+    const summary_counter_t* top[3];
+    int found = window_summary_top(&merged, top, 3);
+    int ok = found == 3 && merged.lines == 50 && strcmp(top[0]->key, "a") == 0 && top[0]->count == 20 &&
+             strcmp(top[1]->key, "b") == 0 && top[1]->count == 20 && top[2]->count == 10 &&
+             window_summary_distinct(&merged) > 2.5 && window_summary_distinct(&merged) < 3.5;
+    printf("[M] Merged %llu lines, top %s:%llu\n", merged.lines, top[0]->key, top[0]->count);
+    window_summary_destroy(&first);
+    window_summary_destroy(&second);
+    window_summary_destroy(&merged);
+    return ok ? 0 : 1;
+}
+
+int main() {
+    printf("=== window_summary Tests ===\n");
+    if (test_distinct_estimate() != 0 || test_heavy_keys() != 0 || test_merge() != 0) {
+        fprintf(stderr, "window summary test failed\n");
+        return 1;
+    }
+    printf("All tests done\n");
+    return 0;
+}